@@ -16,6 +16,7 @@ Controls
 #include <math.h>
 #include <lince.h>
 #include <lince/physics/boxcollider.h>
+#include <lince/physics/aabb_tree.h>
 
 #define TAG_MAX 100
 typedef struct LinceTag {
@@ -30,19 +31,22 @@ enum ECSComponents{
     Component_Shader
 };
 
-/*
 static const char* COMPNAMES[] = {
     "Tag",
     "BoxCollider",
     "Sprite",
     "Shader"
 };
-*/
 
 typedef struct EditorState {
     LinceEntityRegistry* reg;
+    LinceEntityQuery* tag_query;
+    LinceEntityQuery* box_query;
     LinceCamera* camera;
 
+    LinceAABBTree* collider_tree; // Box colliders, for picking
+    uint32_t selected;            // Entity picked with the mouse, or LINCE_AABB_TREE_NONE
+
     LinceBool mouse_drag;
     vec2 mouse_drag_from;
 } EditorState;
@@ -139,6 +143,66 @@ void GUIShader(){
 }
 
 
+/* Memory usage of the registry, and the cost of its queries since the last frame */
+void RegistryStatsGUI(struct nk_context* ctx){
+    static LinceEntityRegistryStats stats;
+    LinceGetEntityRegistryStats(STATE.reg, &stats);
+
+    if (!nk_tree_push(ctx, NK_TREE_TAB, "Registry", NK_MINIMIZED)) {
+        LinceResetEntityQueryStats(STATE.reg);
+        return;
+    }
+
+    nk_layout_row_dynamic(ctx, 20, 1);
+    nk_labelf(ctx, NK_TEXT_LEFT, "Live: %u  Dead: %u  Pooled: %u",
+        stats.live_count, stats.dead_count, stats.pooled_count);
+    nk_labelf(ctx, NK_TEXT_LEFT, "Archetypes: %u (%u empty)",
+        stats.archetype_count, stats.empty_archetype_count);
+    nk_labelf(ctx, NK_TEXT_LEFT, "Entities: %.1f KiB  Tables: %.1f KiB",
+        stats.entity_bytes / 1024.0, stats.table_bytes / 1024.0);
+    nk_labelf(ctx, NK_TEXT_LEFT, "Components: %.1f / %.1f KiB",
+        stats.used_bytes / 1024.0, stats.allocated_bytes / 1024.0);
+
+    if (nk_tree_push(ctx, NK_TREE_NODE, "Components", NK_MINIMIZED)) {
+        for(uint32_t i = 0; i != STATE.reg->component_count; ++i){
+            LinceComponentStats* comp = &stats.components[i];
+            nk_labelf(ctx, NK_TEXT_LEFT, "%s: %u / %u", COMPNAMES[i], comp->count, comp->capacity);
+            nk_labelf(ctx, NK_TEXT_LEFT, "  %.1f KiB, %.1f KiB wasted", comp->used_bytes / 1024.0,
+                (comp->allocated_bytes - comp->used_bytes) / 1024.0);
+        }
+        nk_tree_pop(ctx);
+    }
+
+    if (nk_tree_push(ctx, NK_TREE_NODE, "Queries", NK_MINIMIZED)) {
+        nk_labelf(ctx, NK_TEXT_LEFT, "%u queries, %u calls, %.3f ms",
+            stats.query_count, stats.query_calls, stats.query_ms);
+        for(uint32_t i = 0; i != STATE.reg->queries.size; ++i){
+            LinceEntityQuery* query = *(LinceEntityQuery**)array_get(&STATE.reg->queries, i);
+            uint32_t first = *(uint32_t*)array_get(&query->component_ids, 0);
+            nk_labelf(ctx, NK_TEXT_LEFT, "  {%s%s}: %u calls, %.3f ms", COMPNAMES[first],
+                query->component_ids.size > 1 ? ", ..." : "", query->call_count, query->time_ms);
+        }
+        nk_tree_pop(ctx);
+    }
+
+    nk_tree_pop(ctx);
+    LinceResetEntityQueryStats(STATE.reg);
+}
+
+/* Components of the entity picked with Control and left click */
+void SelectedEntityGUI(struct nk_context* ctx){
+    if(STATE.selected == LINCE_AABB_TREE_NONE) return;
+    if(!LinceIsEntityActive(STATE.reg, STATE.selected)){
+        STATE.selected = LINCE_AABB_TREE_NONE;
+        return;
+    }
+    LinceTag* tag = LinceGetEntityComponent(STATE.reg, STATE.selected, Component_Tag);
+    nk_layout_row_dynamic(ctx, 30, 1);
+    nk_labelf(ctx, NK_TEXT_CENTERED, "Selected: %s", tag ? tag->tag : "");
+    SpriteGUI(ctx, STATE.selected);
+    BoxColliderGUI(ctx, STATE.selected);
+}
+
 void DrawGUI(){
 
     LinceUILayer* ui = LinceGetApp()->ui;
@@ -172,17 +236,20 @@ void DrawGUI(){
             LINCE_ASSERT(n > 0, "Failed to format entity tag string");
             LinceAddEntityComponent(STATE.reg, id, Component_Tag, &tag);
             // Add collision box
-            LinceBoxCollider box = {0};
+            LinceBoxCollider box = {.w=1.0, .h=1.0};
             LinceAddEntityComponent(STATE.reg, id, Component_BoxCollider, &box);
             // Add sprite
             LinceSprite sprite = {.w=1.0, .h=1.0, .color={1,1,1,1}};
             LinceAddEntityComponent(STATE.reg, id, Component_Sprite, &sprite);
         }
 
+        RegistryStatsGUI(ctx);
+        SelectedEntityGUI(ctx);
+
         // Tree of entities
         array_t query;
         array_init(&query, sizeof(uint32_t));
-        LinceQueryEntities(STATE.reg, &query, 1, Component_Tag);
+        LinceFetchEntityQuery(STATE.reg, STATE.tag_query, &query);
 
         // Number of entities
         nk_labelf(ctx, NK_TEXT_CENTERED,
@@ -217,19 +284,34 @@ void DrawGUI(){
 }
 
 void DrawEntities(){
-    array_t query;
-    array_init(&query, sizeof(uint32_t));
-    LinceQueryEntities(STATE.reg, &query, 1, Component_Sprite);
-
     LinceBeginScene(STATE.camera);
-    for(uint32_t i = 0; i != query.size; ++i){
-        uint32_t id = *(uint32_t*)array_get(&query, i);
-        LinceSprite* sprite = LinceGetEntityComponent(STATE.reg, id, Component_Sprite);
-        LinceDrawSprite(sprite, NULL);
-    }
+    LinceDrawEntitySprites(STATE.reg, Component_Sprite, STATE.camera, NULL);
     LinceEndScene();
+}
 
-    array_uninit(&query);
+/* Selects the entity whose collider is under the mouse.
+   Where colliders overlap, the newest entity is picked. */
+void PickEntity(){
+    vec2 mouse_pos;
+    LinceGetMousePosWorld(mouse_pos, STATE.camera);
+    array_t picked;
+    array_init(&picked, sizeof(uint32_t));
+    LinceQueryAABBTreePoint(STATE.collider_tree, mouse_pos, &picked);
+
+    STATE.selected = LINCE_AABB_TREE_NONE;
+    for(uint32_t i = 0; i != picked.size; ++i){
+        uint32_t id = *(uint32_t*)array_get(&picked, i);
+        if(STATE.selected == LINCE_AABB_TREE_NONE || id > STATE.selected) STATE.selected = id;
+    }
+    array_uninit(&picked);
+}
+
+void UpdateColliderTree(){
+    array_t entities;
+    array_init(&entities, sizeof(uint32_t));
+    LinceFetchEntityQuery(STATE.reg, STATE.box_query, &entities);
+    LinceUpdateAABBTree(STATE.collider_tree, STATE.reg, &entities, Component_BoxCollider);
+    array_uninit(&entities);
 }
 
 void MoveCamera(float dt){
@@ -241,8 +323,12 @@ void MoveCamera(float dt){
     if(LinceIsKeyPressed(LinceKey_a)) STATE.camera->pos[0] -= ds;
 
     if(LinceIsMouseButtonPressed(LinceMouseButton_Left)
-        // && LinceIsKeyPressed(LinceKey_LeftControl)
+        && LinceIsKeyPressed(LinceKey_LeftControl)
     ){
+        PickEntity();
+        STATE.mouse_drag = LinceFalse;
+
+    } else if(LinceIsMouseButtonPressed(LinceMouseButton_Left)){
         vec2 mouse_pos;
         LinceGetMousePosWorld(mouse_pos, STATE.camera);
         if(!STATE.mouse_drag){
@@ -270,10 +356,15 @@ void EditorInit(){
         sizeof(LinceSprite),
         sizeof(LinceShader)
     );
+    STATE.tag_query = LinceCreateEntityQuery(STATE.reg, 1, Component_Tag);
+    STATE.box_query = LinceCreateEntityQuery(STATE.reg, 1, Component_BoxCollider);
+    STATE.collider_tree = LinceCreateAABBTree(0.1f);
+    STATE.selected = LINCE_AABB_TREE_NONE;
     STATE.camera = LinceCreateCamera(LinceGetAspectRatio());
 }
 
 void EditorOnUpdate(float dt){
+    UpdateColliderTree();
     MoveCamera(dt);
     LinceResizeCameraView(STATE.camera, LinceGetAspectRatio());
 	LinceUpdateCamera(STATE.camera);
@@ -293,6 +384,7 @@ void EditorOnEvent(LinceEvent* event){
 
 
 void EditorTerminate(){
+    LinceDestroyAABBTree(STATE.collider_tree);
     LinceDestroyEntityRegistry(STATE.reg);
     LinceDeleteCamera(STATE.camera);
 }
\ No newline at end of file
@@ -10,6 +10,8 @@
 #include "lince/core/memory.h"
 #include "lince/core/uuid.h"
 #include "lince/core/fileio.h"
+#include "lince/core/cpu.h"
+#include "lince/core/threadpool.h"
 
 /* Input */
 #include "lince/input/input.h"
@@ -29,6 +31,8 @@
 #include "lince/renderer/shader.h"
 #include "lince/renderer/texture.h"
 #include "lince/renderer/camera.h"
+#include "lince/renderer/capture.h"
+#include "lince/renderer/lighting.h"
 
 /* Tilesets & tilemaps */
 #include "lince/tiles/tileset.h"
@@ -40,6 +44,10 @@
 
 /* ECS */
 #include "lince/entity/entity.h"
+#include "lince/entity/system.h"
+#include "lince/entity/command_buffer.h"
+#include "lince/entity/transform.h"
+#include "lince/entity/snapshot.h"
 
 /* Scene */
 #include "lince/scene/scene.h"
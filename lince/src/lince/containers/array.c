@@ -116,6 +116,34 @@ array_t* array_resize(array_t* array, uint32_t size){
 	return array;
 }
 
+array_t* array_reserve(array_t* array, uint32_t capacity){
+	if(!array || array->element_size == 0) return NULL;
+	if(capacity <= array->capacity) return array;
+
+	capacity = nearest_pow2(capacity);
+	void* data = LinceRealloc(array->data, capacity * array->element_size);
+	if(!data) return NULL;
+	array->capacity = capacity;
+	array->data = data;
+	return array;
+}
+
+array_t* array_shrink_to_fit(array_t* array){
+	if(!array || array->element_size == 0) return NULL;
+	if(array->capacity == array->size) return array;
+
+	if(array->size == 0){
+		LinceFree(array->data);
+		array->capacity = 0;
+		return array;
+	}
+	void* data = LinceRealloc(array->data, array->size * array->element_size);
+	if(!data) return NULL;
+	array->capacity = array->size;
+	array->data = data;
+	return array;
+}
+
 // -- SETTERS
 /* Overwrites an element at the given index with the given data */
 void* array_set(array_t* array, void* element, uint32_t index){
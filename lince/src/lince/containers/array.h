@@ -58,6 +58,18 @@ If a size of zero or empty data are provided, no elements are added to the array
 */
 array_t* array_resize(array_t* array, uint32_t size);
 
+/** @brief Allocates memory for at least a given number of elements
+* without changing the size of the array, so that later insertions do not reallocate.
+* @param array Array to grow.
+* @param capacity Minimum number of elements to hold.
+*/
+array_t* array_reserve(array_t* array, uint32_t capacity);
+
+/** @brief Releases the memory allocated beyond the size of the array.
+* @param array Array to shrink.
+*/
+array_t* array_shrink_to_fit(array_t* array);
+
 /** @brief Sets the value of an element.
 * Any previously data contained in the element is overwritten.
 * If the given pointer to data is NULL, the specified element is filled with zeros.
@@ -6,6 +6,7 @@
 
 #include "core/app.h"
 #include "renderer/renderer.h"
+#include "renderer/capture.h"
 #include "gui/ui_layer.h"
 #include "input/input.h"
 #include "core/profiler.h"
@@ -306,6 +307,7 @@ static void LinceOnUpdate(){
 
     // Update user application
     if (app.on_update) app.on_update(app.dt);
+    LinceUpdateRenderCapture();
 
     LinceEndUIRender(app.ui);
     LinceUpdateWindow(app.window);
@@ -316,6 +318,7 @@ static void LinceTerminate(){
 
     if (app.on_terminate) app.on_terminate();
 
+    LinceStopRenderCapture();
     LinceTerminateRenderer();
     
     // Destroy layer stacks
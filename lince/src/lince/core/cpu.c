@@ -0,0 +1,40 @@
+#include "core/cpu.h"
+
+static uint32_t cpu_features = 0;
+static uint32_t cpu_feature_mask = UINT32_MAX;
+static LinceBool cpu_detected = LinceFalse;
+
+
+static uint32_t LinceDetectCPUFeatures(){
+    uint32_t features = 0;
+
+#if defined(LINCE_X86) && defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 1);
+    if(regs[3] & (1 << 26)) features |= LinceCPUFeature_SSE2;
+
+    // AVX2 also needs the OS to save the 256-bit registers
+    LinceBool os_avx = (regs[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(regs, 7, 0);
+    if(os_avx && (regs[1] & (1 << 5))) features |= LinceCPUFeature_AVX2;
+
+#elif defined(LINCE_X86) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse2")) features |= LinceCPUFeature_SSE2;
+    if(__builtin_cpu_supports("avx2")) features |= LinceCPUFeature_AVX2;
+#endif
+
+    return features;
+}
+
+uint32_t LinceGetCPUFeatures(){
+    if(!cpu_detected){
+        cpu_features = LinceDetectCPUFeatures();
+        cpu_detected = LinceTrue;
+    }
+    return cpu_features & cpu_feature_mask;
+}
+
+void LinceSetCPUFeatureMask(uint32_t mask){
+    cpu_feature_mask = mask;
+}
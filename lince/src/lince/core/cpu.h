@@ -0,0 +1,61 @@
+/** @file cpu.h
+* Detection of the instruction sets supported by the CPU at runtime,
+* so that vectorised code paths can be chosen with a scalar fallback.
+*
+* Functions that use an instruction set beyond the compiler defaults must be
+* marked with its `LINCE_TARGET_*` macro, and only called when
+* `LinceGetCPUFeatures` reports it.
+*/
+
+#ifndef LINCE_CPU_H
+#define LINCE_CPU_H
+
+#include "lince/core/core.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define LINCE_X86 ///< Defined when compiling for x86 processors
+#endif
+
+#if defined(LINCE_X86) && (defined(__GNUC__) || defined(__clang__))
+    #define LINCE_TARGET_SSE2 __attribute__((target("sse2"))) ///< Compiles a function with SSE2
+    #define LINCE_TARGET_AVX2 __attribute__((target("avx2"))) ///< Compiles a function with AVX2
+#else
+    #define LINCE_TARGET_SSE2
+    #define LINCE_TARGET_AVX2
+#endif
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+/** @enum LinceCPUFeature
+* @brief Instruction sets that may be supported by the CPU
+*/
+typedef enum LinceCPUFeature {
+    LinceCPUFeature_SSE2 = 0x1, ///< 128-bit integer and double vectors
+    LinceCPUFeature_AVX2 = 0x2, ///< 256-bit integer vectors
+} LinceCPUFeature;
+
+/** @brief Returns the `LinceCPUFeature` flags supported by the CPU.
+* Detected on the first call.
+*/
+uint32_t LinceGetCPUFeatures();
+
+/** @brief Restricts the features reported by `LinceGetCPUFeatures` to the given flags,
+* e.g. to test or benchmark the fallback code paths.
+* Pass `UINT32_MAX` to report every supported feature again.
+*/
+void LinceSetCPUFeatureMask(uint32_t mask);
+
+/** @brief Returns the index of the lowest set bit. The value must not be zero. */
+static inline uint32_t LinceCountTrailingZeros64(uint64_t x){
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctzll(x);
+#endif
+}
+
+#endif /* LINCE_CPU_H */
@@ -0,0 +1,246 @@
+#include "core/threadpool.h"
+#include "core/memory.h"
+#include "containers/array.h"
+
+#ifdef LINCE_WINDOWS
+    #include <windows.h>
+    typedef CRITICAL_SECTION   LinceMutex;
+    typedef CONDITION_VARIABLE LinceCond;
+    typedef HANDLE             LinceThread;
+    #define LinceLockMutex(m)        EnterCriticalSection(m)
+    #define LinceUnlockMutex(m)      LeaveCriticalSection(m)
+    #define LinceWaitCond(c, m)      SleepConditionVariableCS(c, m, INFINITE)
+    #define LinceSignalCond(c)       WakeConditionVariable(c)
+    #define LinceBroadcastCond(c)    WakeAllConditionVariable(c)
+    #define LINCE_THREAD_LOCAL       __declspec(thread)
+#else
+    #include <pthread.h>
+    #include <unistd.h>
+    typedef pthread_mutex_t LinceMutex;
+    typedef pthread_cond_t  LinceCond;
+    typedef pthread_t       LinceThread;
+    #define LinceLockMutex(m)        pthread_mutex_lock(m)
+    #define LinceUnlockMutex(m)      pthread_mutex_unlock(m)
+    #define LinceWaitCond(c, m)      pthread_cond_wait(c, m)
+    #define LinceSignalCond(c)       pthread_cond_signal(c)
+    #define LinceBroadcastCond(c)    pthread_cond_broadcast(c)
+    #define LINCE_THREAD_LOCAL       __thread
+#endif
+
+typedef struct LinceTask {
+    LinceTaskFn fn;
+    void* data;
+    LinceTaskGroup* group; // optional
+} LinceTask;
+
+/* Arguments of each worker thread */
+typedef struct LinceWorker {
+    LinceThreadPool* pool;
+    uint32_t index;
+} LinceWorker;
+
+struct LinceThreadPool {
+    LinceMutex mutex;
+    LinceCond work;       // signalled when tasks are queued
+    LinceCond done;       // signalled when the queue empties and no task is running
+    array_t tasks;        // array<LinceTask>, queue of pending tasks from `next` onwards
+    uint32_t next;        // first pending task
+    uint32_t running;     // number of tasks being run
+    LinceBool stop;       // tells the threads to exit
+
+    uint32_t thread_count;
+    LinceThread* threads;
+    LinceWorker* workers;
+};
+
+/* Worker of the current thread, so that tasks that wait on other tasks keep their index */
+static LINCE_THREAD_LOCAL LinceWorker* current_worker = NULL;
+
+
+/* Pops the next pending task. The mutex must be locked */
+static LinceBool LinceTakeTask(LinceThreadPool* pool, LinceTask* task){
+    if(pool->next == pool->tasks.size) return LinceFalse;
+    *task = *(LinceTask*)array_get(&pool->tasks, pool->next++);
+    if(pool->next == pool->tasks.size){
+        array_clear(&pool->tasks);
+        pool->next = 0;
+    }
+    pool->running++;
+    return LinceTrue;
+}
+
+/* Runs a task taken from the queue. The mutex must be locked, and is locked again on return */
+static void LinceRunTask(LinceThreadPool* pool, LinceTask* task, uint32_t worker){
+    LinceUnlockMutex(&pool->mutex);
+    task->fn(task->data, worker);
+    LinceLockMutex(&pool->mutex);
+    pool->running--;
+    if(task->group) task->group->pending--;
+    if(task->group || (pool->running == 0 && pool->next == pool->tasks.size)){
+        LinceBroadcastCond(&pool->done);
+    }
+}
+
+static void LinceWorkerLoop(LinceWorker* worker){
+    LinceThreadPool* pool = worker->pool;
+    LinceTask task;
+    current_worker = worker;
+    LinceLockMutex(&pool->mutex);
+    while(1){
+        while(!pool->stop && pool->next == pool->tasks.size){
+            LinceWaitCond(&pool->work, &pool->mutex);
+        }
+        if(pool->stop) break;
+        LinceTakeTask(pool, &task);
+        LinceRunTask(pool, &task, worker->index);
+    }
+    LinceUnlockMutex(&pool->mutex);
+}
+
+#ifdef LINCE_WINDOWS
+static DWORD WINAPI LinceWorkerMain(LPVOID arg){
+    LinceWorkerLoop(arg);
+    return 0;
+}
+#else
+static void* LinceWorkerMain(void* arg){
+    LinceWorkerLoop(arg);
+    return NULL;
+}
+#endif
+
+
+uint32_t LinceGetCoreCount(){
+#ifdef LINCE_WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (uint32_t)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (uint32_t)count : 1;
+#endif
+}
+
+LinceThreadPool* LinceCreateThreadPool(uint32_t thread_count){
+    if(thread_count == 0) thread_count = LinceGetCoreCount() - 1;
+
+    LinceThreadPool* pool = LinceCalloc(sizeof(LinceThreadPool));
+    LINCE_ASSERT_ALLOC(pool, sizeof(LinceThreadPool));
+    array_init(&pool->tasks, sizeof(LinceTask));
+    pool->thread_count = thread_count;
+
+#ifdef LINCE_WINDOWS
+    InitializeCriticalSection(&pool->mutex);
+    InitializeConditionVariable(&pool->work);
+    InitializeConditionVariable(&pool->done);
+#else
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+#endif
+
+    if(thread_count == 0) return pool;
+    pool->threads = LinceCalloc(sizeof(LinceThread) * thread_count);
+    pool->workers = LinceCalloc(sizeof(LinceWorker) * thread_count);
+    for(uint32_t i = 0; i != thread_count; ++i){
+        pool->workers[i] = (LinceWorker){.pool = pool, .index = i};
+#ifdef LINCE_WINDOWS
+        pool->threads[i] = CreateThread(NULL, 0, LinceWorkerMain, &pool->workers[i], 0, NULL);
+        LINCE_ASSERT(pool->threads[i], "Failed to create worker thread");
+#else
+        int err = pthread_create(&pool->threads[i], NULL, LinceWorkerMain, &pool->workers[i]);
+        LINCE_ASSERT(err == 0, "Failed to create worker thread");
+#endif
+    }
+    LINCE_INFO("Created thread pool with %u threads", thread_count);
+    return pool;
+}
+
+void LinceDestroyThreadPool(LinceThreadPool* pool){
+    if(!pool) return;
+    LinceWaitThreadPool(pool);
+
+    LinceLockMutex(&pool->mutex);
+    pool->stop = LinceTrue;
+    LinceBroadcastCond(&pool->work);
+    LinceUnlockMutex(&pool->mutex);
+
+    for(uint32_t i = 0; i != pool->thread_count; ++i){
+#ifdef LINCE_WINDOWS
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+#else
+        pthread_join(pool->threads[i], NULL);
+#endif
+    }
+
+#ifdef LINCE_WINDOWS
+    DeleteCriticalSection(&pool->mutex);
+#else
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->done);
+#endif
+
+    array_uninit(&pool->tasks);
+    LinceFree(pool->threads);
+    LinceFree(pool->workers);
+    LinceFree(pool);
+}
+
+uint32_t LinceGetThreadPoolWorkers(LinceThreadPool* pool){
+    LINCE_ASSERT(pool, "NULL pointer");
+    return pool->thread_count + 1;
+}
+
+uint32_t LinceGetWorkerIndex(LinceThreadPool* pool){
+    LINCE_ASSERT(pool, "NULL pointer");
+    if(current_worker && current_worker->pool == pool) return current_worker->index;
+    return pool->thread_count;
+}
+
+void LinceSubmitTask(LinceThreadPool* pool, LinceTaskFn fn, void* data){
+    LINCE_ASSERT(pool && fn, "NULL pointer");
+    LinceSubmitGroupTask(pool, NULL, fn, data);
+}
+
+void LinceSubmitGroupTask(LinceThreadPool* pool, LinceTaskGroup* group, LinceTaskFn fn, void* data){
+    LINCE_ASSERT(pool && fn, "NULL pointer");
+    LinceTask task = {.fn = fn, .data = data, .group = group};
+    LinceLockMutex(&pool->mutex);
+    if(group) group->pending++;
+    array_push_back(&pool->tasks, &task);
+    LinceSignalCond(&pool->work);
+    LinceUnlockMutex(&pool->mutex);
+}
+
+void LinceWaitThreadPool(LinceThreadPool* pool){
+    LINCE_ASSERT(pool, "NULL pointer");
+    LinceTask task;
+    LinceLockMutex(&pool->mutex);
+    while(1){
+        // Help with pending tasks
+        if(LinceTakeTask(pool, &task)){
+            LinceRunTask(pool, &task, pool->thread_count);
+            continue;
+        }
+        if(pool->running == 0) break;
+        LinceWaitCond(&pool->done, &pool->mutex);
+    }
+    LinceUnlockMutex(&pool->mutex);
+}
+
+void LinceWaitTaskGroup(LinceThreadPool* pool, LinceTaskGroup* group){
+    LINCE_ASSERT(pool && group, "NULL pointer");
+    uint32_t worker = LinceGetWorkerIndex(pool);
+    LinceTask task;
+    LinceLockMutex(&pool->mutex);
+    while(group->pending > 0){
+        if(LinceTakeTask(pool, &task)){
+            LinceRunTask(pool, &task, worker);
+            continue;
+        }
+        LinceWaitCond(&pool->done, &pool->mutex);
+    }
+    LinceUnlockMutex(&pool->mutex);
+}
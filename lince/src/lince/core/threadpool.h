@@ -0,0 +1,79 @@
+/** @file threadpool.h
+* Pool of worker threads that run queued tasks.
+*
+* The thread that waits on the pool also runs tasks while it waits,
+* so a pool created with zero threads runs every task serially on the caller.
+*
+* Usage:
+* ```c
+* LinceThreadPool* pool = LinceCreateThreadPool(0); // one thread per extra core
+* for(uint32_t i = 0; i != 10; ++i) LinceSubmitTask(pool, MyTask, &jobs[i]);
+* LinceWaitThreadPool(pool); // returns once all tasks have finished
+* LinceDestroyThreadPool(pool);
+* ```
+*/
+
+#ifndef LINCE_THREADPOOL_H
+#define LINCE_THREADPOOL_H
+
+#include "lince/core/core.h"
+
+/** @brief Function run by a thread pool.
+* @param data User data passed to `LinceSubmitTask`
+* @param worker Index of the thread that runs the task,
+* from zero to `LinceGetThreadPoolWorkers` minus one.
+* Tasks that run at the same time always have different indices,
+* which can be used to give each thread its own scratch memory.
+*/
+typedef void (*LinceTaskFn)(void* data, uint32_t worker);
+
+/** @brief Pool of worker threads. Its contents are platform-specific. */
+typedef struct LinceThreadPool LinceThreadPool;
+
+/** @struct LinceTaskGroup
+* @brief Set of tasks that can be waited on separately from the rest of the pool,
+* e.g. from within another task. Must be zero-initialised.
+*/
+typedef struct LinceTaskGroup {
+    uint32_t pending; ///< Tasks of the group that have not finished
+} LinceTaskGroup;
+
+/** @brief Returns the number of logical processors of the system */
+uint32_t LinceGetCoreCount();
+
+/** @brief Creates a pool of worker threads.
+* @param thread_count Number of threads to spawn. If zero, one less than the
+* number of cores is used, as the thread that waits on the pool also runs tasks.
+*/
+LinceThreadPool* LinceCreateThreadPool(uint32_t thread_count);
+
+/** @brief Waits for the queued tasks and joins all threads */
+void LinceDestroyThreadPool(LinceThreadPool* pool);
+
+/** @brief Returns the number of threads that may run tasks,
+* which includes the thread that waits on the pool.
+*/
+uint32_t LinceGetThreadPoolWorkers(LinceThreadPool* pool);
+
+/** @brief Returns the worker index of the calling thread, as passed to `LinceTaskFn`.
+* Threads outside the pool, such as the one that waits on it, get the last index.
+*/
+uint32_t LinceGetWorkerIndex(LinceThreadPool* pool);
+
+/** @brief Queues a task to be run by any of the threads. May be called from tasks. */
+void LinceSubmitTask(LinceThreadPool* pool, LinceTaskFn fn, void* data);
+
+/** @brief Runs queued tasks until all of them, including those queued
+* in the meantime, have finished. Must not be called from a task.
+*/
+void LinceWaitThreadPool(LinceThreadPool* pool);
+
+/** @brief Queues a task that belongs to a group */
+void LinceSubmitGroupTask(LinceThreadPool* pool, LinceTaskGroup* group, LinceTaskFn fn, void* data);
+
+/** @brief Runs queued tasks until all the tasks of a group have finished.
+* May be called from a task, which lets tasks split their work further.
+*/
+void LinceWaitTaskGroup(LinceThreadPool* pool, LinceTaskGroup* group);
+
+#endif /* LINCE_THREADPOOL_H */
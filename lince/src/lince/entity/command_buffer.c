@@ -0,0 +1,134 @@
+#include "entity/command_buffer.h"
+
+#define CheckWorker(cmds, worker) do{ \
+    LINCE_ASSERT(cmds, "NULL pointer"); \
+    LINCE_ASSERT(worker < cmds->list_count, "Invalid worker index %u", worker); \
+} while(0)
+
+
+/* Returns the real ID of an entity, or of a deferred entity already played back */
+static uint32_t LinceResolveEntity(LinceEntityCommandList* list, uint32_t entity_id){
+    if(!(entity_id & LINCE_DEFERRED_ENTITY)) return entity_id;
+    return *(uint32_t*)array_get(&list->created, entity_id & ~LINCE_DEFERRED_ENTITY);
+}
+
+static void LinceRecordEntityCommand(LinceEntityCommandList* list, LinceEntityCommand* cmd){
+    array_push_back(&list->commands, cmd);
+}
+
+
+LinceEntityCommandBuffer* LinceCreateEntityCommandBuffer(LinceEntityRegistry* reg, uint32_t thread_count){
+    LINCE_ASSERT(reg, "NULL pointer");
+    LINCE_ASSERT(thread_count > 0, "Thread count must be greater than zero");
+
+    LinceEntityCommandBuffer* cmds = LinceCalloc(sizeof(LinceEntityCommandBuffer));
+    LINCE_ASSERT_ALLOC(cmds, sizeof(LinceEntityCommandBuffer));
+    cmds->reg = reg;
+    cmds->list_count = thread_count;
+    cmds->lists = LinceCalloc(sizeof(LinceEntityCommandList) * thread_count);
+    for(uint32_t i = 0; i != thread_count; ++i){
+        array_init(&cmds->lists[i].commands, sizeof(LinceEntityCommand));
+        array_init(&cmds->lists[i].data, sizeof(uint8_t));
+        array_init(&cmds->lists[i].created, sizeof(uint32_t));
+    }
+    return cmds;
+}
+
+void LinceDestroyEntityCommandBuffer(LinceEntityCommandBuffer* cmds){
+    if(!cmds) return;
+    for(uint32_t i = 0; i != cmds->list_count; ++i){
+        array_uninit(&cmds->lists[i].commands);
+        array_uninit(&cmds->lists[i].data);
+        array_uninit(&cmds->lists[i].created);
+    }
+    LinceFree(cmds->lists);
+    LinceFree(cmds);
+}
+
+uint32_t LinceDeferCreateEntity(LinceEntityCommandBuffer* cmds, uint32_t worker){
+    CheckWorker(cmds, worker);
+    LinceEntityCommandList* list = &cmds->lists[worker];
+    // The slot of the real ID is filled on playback
+    uint32_t deferred = list->created.size | LINCE_DEFERRED_ENTITY;
+    array_push_back(&list->created, NULL);
+    LinceRecordEntityCommand(list, &(LinceEntityCommand){
+        .type = LinceEntityCommand_Create, .entity = deferred});
+    return deferred;
+}
+
+void LinceDeferDeleteEntity(LinceEntityCommandBuffer* cmds, uint32_t worker, uint32_t entity_id){
+    CheckWorker(cmds, worker);
+    LinceRecordEntityCommand(&cmds->lists[worker], &(LinceEntityCommand){
+        .type = LinceEntityCommand_Delete, .entity = entity_id});
+}
+
+void LinceDeferAddComponent(LinceEntityCommandBuffer* cmds, uint32_t worker,
+    uint32_t entity_id, uint32_t component_id, void* data)
+{
+    CheckWorker(cmds, worker);
+    LINCE_ASSERT(data, "NULL pointer");
+    LINCE_ASSERT(component_id < cmds->reg->component_count, "Invalid component ID");
+
+    LinceEntityCommandList* list = &cmds->lists[worker];
+    uint32_t size = *(uint32_t*)array_get(&cmds->reg->component_sizes, component_id);
+    uint32_t offset = list->data.size;
+    array_resize(&list->data, offset + size);
+    memcpy(array_get(&list->data, offset), data, size);
+
+    LinceRecordEntityCommand(list, &(LinceEntityCommand){
+        .type = LinceEntityCommand_Add, .entity = entity_id,
+        .component = component_id, .offset = offset});
+}
+
+void LinceDeferRemoveComponent(LinceEntityCommandBuffer* cmds, uint32_t worker,
+    uint32_t entity_id, uint32_t component_id)
+{
+    CheckWorker(cmds, worker);
+    LINCE_ASSERT(component_id < cmds->reg->component_count, "Invalid component ID");
+    LinceRecordEntityCommand(&cmds->lists[worker], &(LinceEntityCommand){
+        .type = LinceEntityCommand_Remove, .entity = entity_id, .component = component_id});
+}
+
+void LincePlaybackEntityCommands(LinceEntityCommandBuffer* cmds){
+    LINCE_ASSERT(cmds, "NULL pointer");
+    LinceEntityRegistry* reg = cmds->reg;
+
+    // Grow the registry once for all new entities
+    uint32_t created = 0;
+    for(uint32_t i = 0; i != cmds->list_count; ++i) created += cmds->lists[i].created.size;
+    if(created > 0) LinceReserveEntities(reg, created);
+
+    for(uint32_t i = 0; i != cmds->list_count; ++i){
+        LinceEntityCommandList* list = &cmds->lists[i];
+
+        for(uint32_t j = 0; j != list->commands.size; ++j){
+            LinceEntityCommand* cmd = array_get(&list->commands, j);
+            if(cmd->type == LinceEntityCommand_Create){
+                uint32_t id = LinceCreateEntity(reg);
+                array_set(&list->created, &id, cmd->entity & ~LINCE_DEFERRED_ENTITY);
+                continue;
+            }
+
+            uint32_t id = LinceResolveEntity(list, cmd->entity);
+            if(!LinceIsEntityActive(reg, id)) continue;
+
+            switch(cmd->type){
+            case LinceEntityCommand_Delete:
+                LinceDeleteEntity(reg, id);
+                break;
+            case LinceEntityCommand_Add:
+                LinceAddEntityComponent(reg, id, cmd->component, array_get(&list->data, cmd->offset));
+                break;
+            case LinceEntityCommand_Remove:
+                LinceRemoveEntityComponent(reg, id, cmd->component);
+                break;
+            default:
+                break;
+            }
+        }
+
+        array_clear(&list->commands);
+        array_clear(&list->data);
+        array_clear(&list->created);
+    }
+}
@@ -0,0 +1,117 @@
+/** @file command_buffer.h
+* Deferred structural changes to an entity registry.
+*
+* Creating and deleting entities, and adding and removing components,
+* moves entities between tables and may reallocate them, which is unsafe
+* while iterating a query or running systems in parallel.
+* Instead, these operations can be recorded into a command buffer,
+* and played back later at a point where nothing else uses the registry.
+*
+* Each thread records into its own list, chosen by its worker index
+* (see `LinceTaskFn` and `LinceGetWorkerIndex`), so recording needs no locks.
+* Only the threads of the pool and one other thread may record at the same time,
+* since every thread outside the pool gets the same worker index and so the same list.
+*
+* Commands name entities by ID, which is only resolved on playback.
+* If an earlier list deletes entity X and a create command then recycles its ID,
+* the commands on X from later lists apply to the new entity.
+*
+* Usage:
+* ```c
+* LinceEntityCommandBuffer* cmds = LinceCreateEntityCommandBuffer(reg, LinceGetThreadPoolWorkers(pool));
+*
+* // In a system or parallel for-each
+* uint32_t worker = LinceGetWorkerIndex(pool);
+* uint32_t bullet = LinceDeferCreateEntity(cmds, worker);
+* LinceDeferAddComponent(cmds, worker, bullet, Component_Sprite, &sprite);
+* LinceDeferDeleteEntity(cmds, worker, dead_enemy);
+*
+* // Once all systems have finished
+* LincePlaybackEntityCommands(cmds);
+* ```
+*/
+
+#ifndef LINCE_COMMAND_BUFFER_H
+#define LINCE_COMMAND_BUFFER_H
+
+#include "lince/core/core.h"
+#include "lince/entity/entity.h"
+
+/** @brief Bit set on the IDs returned by `LinceDeferCreateEntity`,
+* which only become real entities when played back.
+*/
+#define LINCE_DEFERRED_ENTITY 0x80000000u
+
+/** @enum LinceEntityCommandType
+* @brief Operations that can be recorded
+*/
+typedef enum LinceEntityCommandType {
+    LinceEntityCommand_Create = 0,  ///< Creates an entity
+    LinceEntityCommand_Delete,      ///< Deletes an entity
+    LinceEntityCommand_Add,         ///< Adds or overwrites a component
+    LinceEntityCommand_Remove,      ///< Removes a component
+} LinceEntityCommandType;
+
+/** @struct LinceEntityCommand
+* @brief Recorded operation
+*/
+typedef struct LinceEntityCommand {
+    LinceEntityCommandType type; ///< Operation
+    uint32_t entity;             ///< Entity ID, or deferred ID
+    uint32_t component;          ///< Component ID, if any
+    uint32_t offset;             ///< Location of the component data in the list, if any
+} LinceEntityCommand;
+
+/** @struct LinceEntityCommandList
+* @brief Commands recorded by one thread
+*/
+typedef struct LinceEntityCommandList {
+    array_t commands;     ///< array<LinceEntityCommand> -> in the order recorded
+    array_t data;         ///< array<uint8_t> -> packed component data of the add commands
+    array_t created;      ///< array<uint32_t> -> real IDs of the deferred entities, filled on playback
+} LinceEntityCommandList;
+
+/** @struct LinceEntityCommandBuffer
+* @brief Per-thread lists of recorded operations on a registry
+*/
+typedef struct LinceEntityCommandBuffer {
+    LinceEntityRegistry* reg;       ///< Registry the commands apply to
+    uint32_t list_count;            ///< Number of lists, one per thread
+    LinceEntityCommandList* lists;  ///< Command lists
+} LinceEntityCommandBuffer;
+
+/** @brief Creates a command buffer for a registry
+* @param reg Entity registry
+* @param thread_count Number of threads that will record commands,
+* e.g. `LinceGetThreadPoolWorkers`
+*/
+LinceEntityCommandBuffer* LinceCreateEntityCommandBuffer(LinceEntityRegistry* reg, uint32_t thread_count);
+
+/** @brief Frees a command buffer, discarding commands not played back */
+void LinceDestroyEntityCommandBuffer(LinceEntityCommandBuffer* cmds);
+
+/** @brief Records the creation of an entity.
+* @returns A deferred ID, which can only be used by later commands of the same thread
+*/
+uint32_t LinceDeferCreateEntity(LinceEntityCommandBuffer* cmds, uint32_t worker);
+
+/** @brief Records the deletion of an entity */
+void LinceDeferDeleteEntity(LinceEntityCommandBuffer* cmds, uint32_t worker, uint32_t entity_id);
+
+/** @brief Records the addition of a component. The data is copied. */
+void LinceDeferAddComponent(LinceEntityCommandBuffer* cmds, uint32_t worker,
+    uint32_t entity_id, uint32_t component_id, void* data);
+
+/** @brief Records the removal of a component */
+void LinceDeferRemoveComponent(LinceEntityCommandBuffer* cmds, uint32_t worker,
+    uint32_t entity_id, uint32_t component_id);
+
+/** @brief Applies all recorded commands to the registry, and clears them.
+* Lists are played back in order of worker index, and each list in the order recorded.
+* Commands on entities deleted by earlier commands are skipped,
+* unless a create command in between has recycled the ID.
+* Memory for all new entities is reserved at once beforehand.
+*/
+void LincePlaybackEntityCommands(LinceEntityCommandBuffer* cmds);
+
+#endif /* LINCE_COMMAND_BUFFER_H */
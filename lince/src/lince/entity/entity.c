@@ -1,62 +1,402 @@
 #include "entity.h"
+#include "core/cpu.h"
 
 #include <stdarg.h>
+#include <stdlib.h>
+
+#ifdef LINCE_X86
+    #include <emmintrin.h>
+    #include <immintrin.h>
+#endif
+
+#ifdef LINCE_WINDOWS
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+/* Returns the bit of a component in an entity mask */
+#define MaskIndex(component_id) ((component_id) / 64)
+#define MaskBit(component_id) ((uint64_t)1 << ((component_id) % 64))
+
+/* Returns the word and bit of an entity in the active bitset */
+#define ActiveIndex(entity_id) ((entity_id) / 64)
+#define ActiveBit(entity_id) ((uint64_t)1 << ((entity_id) % 64))
+
+/* Returns true if a component is stored in a sparse set */
+#define LinceIsComponentSparse(reg, component_id) \
+    (*(LinceComponentStorage*)array_get(&(reg)->component_storage, (component_id)) == LinceComponentStorage_Sparse)
+
+
+/* Initialises a sparse set for components of the given size */
+static void LinceInitSparseSet(LinceSparseSet* set, uint32_t size){
+    array_init(&set->dense, size);
+    array_init(&set->entities, sizeof(uint32_t));
+    array_init(&set->ticks, sizeof(uint32_t));
+    array_init(&set->pages, sizeof(uint32_t*));
+}
+
+static void LinceUninitSparseSet(LinceSparseSet* set){
+    for(uint32_t i = 0; i != set->pages.size; ++i){
+        uint32_t* page = *(uint32_t**)array_get(&set->pages, i);
+        LinceFree(page);
+    }
+    array_uninit(&set->dense);
+    array_uninit(&set->entities);
+    array_uninit(&set->ticks);
+    array_uninit(&set->pages);
+}
+
+/* Returns the slot that holds the dense index of an entity.
+   Missing pages are allocated if `create` is true, otherwise NULL is returned */
+static uint32_t* LinceGetSparseSlot(LinceSparseSet* set, uint32_t entity_id, LinceBool create){
+    uint32_t page_index = entity_id / LINCE_SPARSE_PAGE_SIZE;
+    while(create && set->pages.size <= page_index){
+        array_push_back(&set->pages, NULL);
+    }
+    if(page_index >= set->pages.size) return NULL;
+
+    uint32_t** page = array_get(&set->pages, page_index);
+    if(!*page){
+        if(!create) return NULL;
+        *page = LinceMalloc(sizeof(uint32_t) * LINCE_SPARSE_PAGE_SIZE);
+        memset(*page, 0xFF, sizeof(uint32_t) * LINCE_SPARSE_PAGE_SIZE); // LINCE_SPARSE_NONE
+    }
+    return &(*page)[entity_id % LINCE_SPARSE_PAGE_SIZE];
+}
+
+/* Returns the component of an entity in a sparse set, or NULL if it is not there */
+static void* LinceGetSparseComponent(LinceSparseSet* set, uint32_t entity_id){
+    uint32_t* slot = LinceGetSparseSlot(set, entity_id, LinceFalse);
+    if(!slot || *slot == LINCE_SPARSE_NONE) return NULL;
+    return array_get(&set->dense, *slot);
+}
+
+/* Removes an entity from a sparse set by moving the last element into its place */
+static void LinceRemoveSparseComponent(LinceSparseSet* set, uint32_t entity_id){
+    uint32_t* slot = LinceGetSparseSlot(set, entity_id, LinceFalse);
+    if(!slot || *slot == LINCE_SPARSE_NONE) return;
+
+    uint32_t index = *slot;
+    uint32_t last = set->entities.size - 1;
+    if(index != last){
+        memcpy(array_get(&set->dense, index), array_get(&set->dense, last), set->dense.element_size);
+        array_set(&set->ticks, array_get(&set->ticks, last), index);
+        uint32_t moved = *(uint32_t*)array_get(&set->entities, last);
+        array_set(&set->entities, &moved, index);
+        *LinceGetSparseSlot(set, moved, LinceFalse) = index;
+    }
+    array_pop_back(&set->dense);
+    array_pop_back(&set->entities);
+    array_pop_back(&set->ticks);
+    *slot = LINCE_SPARSE_NONE;
+}
+
+/* Mask matching kernels.
+   Each one tests a block of up to 64 consecutive entities against a query mask,
+   and returns a bit field with the entities whose masks contain the query */
+typedef uint64_t (*LinceMaskKernel)(const uint64_t* masks, const uint64_t* query, uint32_t count);
+
+static uint64_t LinceMatchMasksScalar(const uint64_t* masks, const uint64_t* query, uint32_t count){
+    uint64_t matches = 0;
+    for(uint32_t i = 0; i != count; ++i){
+        const uint64_t* mask = masks + i * LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT;
+        uint64_t match = 1;
+        for(uint32_t j = 0; j != LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT; ++j){
+            match &= (mask[j] & query[j]) == query[j];
+        }
+        matches |= match << i;
+    }
+    return matches;
+}
+
+#if defined(LINCE_X86) && LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT == 1
+
+/* Tests two entities per instruction. SSE2 has no 64-bit comparison,
+   so both 32-bit halves of a mask must compare equal */
+LINCE_TARGET_SSE2
+static uint64_t LinceMatchMasksSSE2(const uint64_t* masks, const uint64_t* query, uint32_t count){
+    const __m128i q = _mm_set1_epi64x((long long)query[0]);
+    uint64_t matches = 0;
+    uint32_t i = 0;
+    for(; i + 2 <= count; i += 2){
+        __m128i m = _mm_loadu_si128((const __m128i*)(masks + i));
+        __m128i eq = _mm_cmpeq_epi32(_mm_and_si128(m, q), q);
+        eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+        matches |= (uint64_t)_mm_movemask_pd(_mm_castsi128_pd(eq)) << i;
+    }
+    if(i == count) return matches;
+    return matches | (LinceMatchMasksScalar(masks + i, query, count - i) << i);
+}
+
+/* Tests four entities per instruction */
+LINCE_TARGET_AVX2
+static uint64_t LinceMatchMasksAVX2(const uint64_t* masks, const uint64_t* query, uint32_t count){
+    const __m256i q = _mm256_set1_epi64x((long long)query[0]);
+    uint64_t matches = 0;
+    uint32_t i = 0;
+    for(; i + 4 <= count; i += 4){
+        __m256i m = _mm256_loadu_si256((const __m256i*)(masks + i));
+        __m256i eq = _mm256_cmpeq_epi64(_mm256_and_si256(m, q), q);
+        matches |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(eq)) << i;
+    }
+    if(i == count) return matches;
+    return matches | (LinceMatchMasksScalar(masks + i, query, count - i) << i);
+}
+
+#endif
+
+/* Returns the fastest kernel supported by the CPU */
+static LinceMaskKernel LinceGetMaskKernel(){
+#if defined(LINCE_X86) && LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT == 1
+    uint32_t features = LinceGetCPUFeatures();
+    if(features & LinceCPUFeature_AVX2) return LinceMatchMasksAVX2;
+    if(features & LinceCPUFeature_SSE2) return LinceMatchMasksSSE2;
+#endif
+    return LinceMatchMasksScalar;
+}
+
+static int LinceCompareEntityIDs(const void* a, const void* b){
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+
+/* Returns true if the mask of an archetype has all the components in another mask */
+static LinceBool LinceMaskContains(const uint64_t* mask, const uint64_t* subset){
+    for(uint32_t i = 0; i != LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT; ++i){
+        if((mask[i] & subset[i]) != subset[i]) return LinceFalse;
+    }
+    return LinceTrue;
+}
+
+
+/* Initialises an archetype table for the components in the given mask */
+static void LinceInitArchetype(LinceEntityRegistry* reg, LinceArchetype* arch, LinceEntityMask mask){
+    memcpy(arch->mask, mask, sizeof(LinceEntityMask));
+    arch->column_count = 0;
+    for(uint32_t i = 0; i != reg->component_count; ++i){
+        if(mask[MaskIndex(i)] & MaskBit(i)) arch->column_count++;
+    }
+
+    arch->column_ids   = LinceCalloc(sizeof(uint32_t) * (arch->column_count + 1));
+    arch->columns      = LinceCalloc(sizeof(array_t)  * (arch->column_count + 1));
+    arch->ticks        = LinceCalloc(sizeof(array_t)  * (arch->column_count + 1));
+    arch->column_index = LinceMalloc(sizeof(int32_t)  * reg->component_count);
+    arch->add_edges    = LinceMalloc(sizeof(uint32_t) * reg->component_count);
+    arch->remove_edges = LinceMalloc(sizeof(uint32_t) * reg->component_count);
+
+    uint32_t column = 0;
+    for(uint32_t i = 0; i != reg->component_count; ++i){
+        arch->add_edges[i] = LINCE_ARCHETYPE_NONE;
+        arch->remove_edges[i] = LINCE_ARCHETYPE_NONE;
+        arch->column_index[i] = -1;
+        if(!(mask[MaskIndex(i)] & MaskBit(i))) continue;
+
+        uint32_t size = *(uint32_t*)array_get(&reg->component_sizes, i);
+        arch->column_ids[column] = i;
+        arch->column_index[i] = (int32_t)column;
+        array_init(&arch->columns[column], size);
+        array_init(&arch->ticks[column], sizeof(uint32_t));
+        column++;
+    }
+    array_init(&arch->entities, sizeof(uint32_t));
+}
+
+static void LinceUninitArchetype(LinceArchetype* arch){
+    for(uint32_t i = 0; i != arch->column_count; ++i){
+        array_uninit(&arch->columns[i]);
+        array_uninit(&arch->ticks[i]);
+    }
+    array_uninit(&arch->entities);
+    LinceFree(arch->column_ids);
+    LinceFree(arch->columns);
+    LinceFree(arch->ticks);
+    LinceFree(arch->column_index);
+    LinceFree(arch->add_edges);
+    LinceFree(arch->remove_edges);
+}
+
+/* Archetypes are few, and this is only reached when an edge is not yet known */
+uint32_t LinceGetArchetype(LinceEntityRegistry* reg, LinceEntityMask mask){
+    for(uint32_t i = 0; i != reg->archetypes.size; ++i){
+        LinceArchetype* arch = array_get(&reg->archetypes, i);
+        if(memcmp(arch->mask, mask, sizeof(LinceEntityMask)) == 0) return i;
+    }
+    LinceArchetype arch = {0};
+    LinceInitArchetype(reg, &arch, mask);
+    array_push_back(&reg->archetypes, &arch);
+    uint32_t index = reg->archetypes.size - 1;
+
+    // Persistent queries only need updating when new archetypes appear
+    for(uint32_t i = 0; i != reg->queries.size; ++i){
+        LinceEntityQuery* query = *(LinceEntityQuery**)array_get(&reg->queries, i);
+        if(LinceMaskContains(mask, query->table_mask)) array_push_back(&query->archetypes, &index);
+    }
+    return index;
+}
+
+/* Returns the archetype reached by adding (or removing) a component to another archetype */
+static uint32_t LinceGetArchetypeEdge(LinceEntityRegistry* reg, uint32_t from, uint32_t component_id, LinceBool add){
+    LinceArchetype* arch = array_get(&reg->archetypes, from);
+    uint32_t* edges = add ? arch->add_edges : arch->remove_edges;
+    if(edges[component_id] != LINCE_ARCHETYPE_NONE) return edges[component_id];
+
+    LinceEntityMask mask;
+    memcpy(mask, arch->mask, sizeof(LinceEntityMask));
+    if(add) mask[MaskIndex(component_id)] |= MaskBit(component_id);
+    else    mask[MaskIndex(component_id)] &= ~MaskBit(component_id);
+
+    uint32_t to = LinceGetArchetype(reg, mask);
+    arch = array_get(&reg->archetypes, from); // may have been reallocated
+    edges = add ? arch->add_edges : arch->remove_edges;
+    edges[component_id] = to;
+    return to;
+}
+
+/* Removes a row from an archetype by moving the last row into its place */
+static void LinceRemoveArchetypeRow(LinceEntityRegistry* reg, LinceArchetype* arch, uint32_t row){
+    uint32_t last = arch->entities.size - 1;
+    if(row != last){
+        for(uint32_t i = 0; i != arch->column_count; ++i){
+            array_t* column = &arch->columns[i];
+            memcpy(array_get(column, row), array_get(column, last), column->element_size);
+            array_set(&arch->ticks[i], array_get(&arch->ticks[i], last), row);
+        }
+        uint32_t moved = *(uint32_t*)array_get(&arch->entities, last);
+        array_set(&arch->entities, &moved, row);
+        LinceEntityRecord* record = array_get(&reg->entity_records, moved);
+        record->row = row;
+    }
+    for(uint32_t i = 0; i != arch->column_count; ++i){
+        array_pop_back(&arch->columns[i]);
+        array_pop_back(&arch->ticks[i]);
+    }
+    array_pop_back(&arch->entities);
+}
+
+/* Moves an entity to another archetype, copying the components both have in common.
+   Returns the new row, where components missing in the old archetype are zeroed */
+static uint32_t LinceMoveEntity(LinceEntityRegistry* reg, uint32_t entity_id, uint32_t to){
+    LinceEntityRecord* record = array_get(&reg->entity_records, entity_id);
+    LinceArchetype* src = array_get(&reg->archetypes, record->archetype);
+    LinceArchetype* dst = array_get(&reg->archetypes, to);
+    uint32_t row = dst->entities.size;
+
+    for(uint32_t i = 0; i != dst->column_count; ++i){
+        int32_t src_column = src->column_index[dst->column_ids[i]];
+        void* data = src_column < 0 ? NULL : array_get(&src->columns[src_column], record->row);
+        void* tick = src_column < 0 ? &reg->change_tick : array_get(&src->ticks[src_column], record->row);
+        array_push_back(&dst->columns[i], data);
+        array_push_back(&dst->ticks[i], tick);
+    }
+    array_push_back(&dst->entities, &entity_id);
+
+    LinceRemoveArchetypeRow(reg, src, record->row);
+    record->archetype = to;
+    record->row = row;
+    return row;
+}
+
 
 /* Creates a registry that will be used to spawn entities */
 LinceEntityRegistry* LinceCreateEntityRegistry(uint32_t component_count, ...){
     LINCE_ASSERT(component_count > 0, "Component count must be greater than zero");
 
+    // Fetch component sizes from varargs
+    LinceComponentInfo* components = LinceCalloc(sizeof(LinceComponentInfo) * component_count);
+    va_list args;
+    va_start(args, component_count);
+    for(uint32_t i = 0; i != component_count; ++i){
+        components[i].size = va_arg(args, uint32_t);
+        components[i].storage = LinceComponentStorage_Table;
+    }
+    va_end(args);
+
+    LinceEntityRegistry* reg = LinceCreateEntityRegistryFromInfo(component_count, components);
+    LinceFree(components);
+    return reg;
+}
+
+LinceEntityRegistry* LinceCreateEntityRegistryFromInfo(uint32_t component_count, LinceComponentInfo* components){
+    LINCE_ASSERT(component_count > 0, "Component count must be greater than zero");
+    LINCE_ASSERT(components, "NULL pointer");
+
     uint32_t max_components = LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT * sizeof(uint64_t) * 8;
     LINCE_ASSERT(component_count <= max_components,
         "Too many components, max is %u.", max_components);
-    
+
     LinceEntityRegistry* reg = LinceMalloc(sizeof(LinceEntityRegistry));
     LINCE_ASSERT_ALLOC(reg, sizeof(LinceEntityRegistry));
-    
+
     reg->component_count = component_count;
     reg->max_components = max_components;
     array_init(&reg->component_sizes, sizeof(uint32_t));
-    array_init(&reg->component_offsets, sizeof(uint32_t));
-    
-    // Fetch component sizes from varargs
-    va_list args;
-    va_start(args, component_count);
-    uint32_t entity_size = 0;
+    array_init(&reg->component_storage, sizeof(LinceComponentStorage));
+    array_init(&reg->sparse_sets, sizeof(LinceSparseSet));
+
+    uint32_t total_size = 0;
     for(uint32_t i = 0; i != component_count; ++i){
-        uint32_t comp_size = va_arg(args, uint32_t);
+        uint32_t comp_size = components[i].size;
+        LinceComponentStorage storage = components[i].storage;
         if(comp_size == 0){
             array_uninit(&reg->component_sizes);
-            array_uninit(&reg->component_offsets);
+            array_uninit(&reg->component_storage);
+            array_uninit(&reg->sparse_sets);
             LinceFree(reg);
             LINCE_ASSERT(0, "Size of component #%u is zero", i);
         }
         array_push_back(&reg->component_sizes, &comp_size);
-        array_push_back(&reg->component_offsets, &entity_size);
-        entity_size += comp_size;
+        array_push_back(&reg->component_storage, &storage);
+        array_push_back(&reg->sparse_sets, NULL);
+        if(storage == LinceComponentStorage_Sparse){
+            LinceInitSparseSet(array_get(&reg->sparse_sets, i), comp_size);
+        }
+        total_size += comp_size;
     }
-    va_end(args);
-    reg->entity_size = entity_size;
     reg->entity_count = 0;
+    reg->locked = LinceFalse;
+    reg->change_tick = 1;
+    reg->version = 0;
+
+    LINCE_INFO("Creating Entity Registry - %u components - %u bytes for all components",
+        component_count, total_size);
 
-    LINCE_INFO("Creating Entity Registry - %u components - %u bytes per entity",
-        component_count, entity_size);
-    
-    array_init(&reg->entity_data, entity_size);
-    array_init(&reg->entity_flags, sizeof(LinceEntityState));
+    array_init(&reg->archetypes, sizeof(LinceArchetype));
+    array_init(&reg->entity_records, sizeof(LinceEntityRecord));
+    array_init(&reg->entity_active, sizeof(uint64_t));
     array_init(&reg->entity_masks, sizeof(LinceEntityMask));
     array_init(&reg->entity_pool, sizeof(uint32_t));
-    
+    array_init(&reg->queries, sizeof(LinceEntityQuery*));
+
+    // Archetype of entities without components
+    LinceEntityMask empty = {0};
+    LinceGetArchetype(reg, empty);
+
     return reg;
 }
 
 void LinceDestroyEntityRegistry(LinceEntityRegistry* reg){
     LINCE_ASSERT(reg, "NULL pointer");
 
+    while(reg->queries.size > 0){
+        LinceDeleteEntityQuery(reg, *(LinceEntityQuery**)array_back(&reg->queries));
+    }
+    array_uninit(&reg->queries);
+
+    for(uint32_t i = 0; i != reg->archetypes.size; ++i){
+        LinceUninitArchetype(array_get(&reg->archetypes, i));
+    }
+    array_uninit(&reg->archetypes);
+    for(uint32_t i = 0; i != reg->component_count; ++i){
+        if(LinceIsComponentSparse(reg, i)) LinceUninitSparseSet(array_get(&reg->sparse_sets, i));
+    }
+    array_uninit(&reg->sparse_sets);
+    array_uninit(&reg->component_storage);
     array_uninit(&reg->component_sizes);
-    array_uninit(&reg->component_offsets);
 
-    array_uninit(&reg->entity_data);
-    array_uninit(&reg->entity_flags);
+    array_uninit(&reg->entity_records);
+    array_uninit(&reg->entity_active);
     array_uninit(&reg->entity_masks);
     array_uninit(&reg->entity_pool);
 
@@ -64,93 +404,212 @@ void LinceDestroyEntityRegistry(LinceEntityRegistry* reg){
 }
 
 
+/* Structural changes move entities between tables, which is unsafe while other threads iterate them */
+#define CheckUnlocked(reg) \
+    LINCE_ASSERT(!(reg)->locked, "Entities and components cannot be created or removed while the registry is locked")
+
 uint32_t LinceCreateEntity(LinceEntityRegistry* reg){
     LINCE_ASSERT(reg, "NULL pointer");
+    CheckUnlocked(reg);
+    reg->version++;
     uint32_t id = 0;
 
     if(reg->entity_pool.size > 0){
         // Draw from pool of unused entities
         id = *(uint32_t*)array_back(&reg->entity_pool);
         array_pop_back(&reg->entity_pool);
-        // Set alive flag
-        uint32_t* flag = array_get(&reg->entity_flags, id);
-        *flag = LinceEntityState_Active;
-        return id;
+    } else {
+        // Allocate new entity
+        id = reg->entity_count++;
+        array_push_back(&reg->entity_records, NULL);
+        array_push_back(&reg->entity_masks, NULL);
+        if(ActiveIndex(id) == reg->entity_active.size) array_push_back(&reg->entity_active, NULL);
     }
 
-    // Allocate new entity
-    id = reg->entity_count++;
-    // LinceEntityMask mask = {0};
-    LinceEntityState state = LinceEntityState_Active;
-    array_push_back(&reg->entity_data,  NULL);
-    array_push_back(&reg->entity_flags, &state);
-    array_push_back(&reg->entity_masks, NULL);
+    // Set alive flag
+    uint64_t* active = array_get(&reg->entity_active, ActiveIndex(id));
+    *active |= ActiveBit(id);
+
+    // Place in the table of entities without components
+    LinceArchetype* empty = array_get(&reg->archetypes, 0);
+    LinceEntityRecord* record = array_get(&reg->entity_records, id);
+    record->archetype = 0;
+    record->row = empty->entities.size;
+    array_push_back(&empty->entities, &id);
 
     return id;
 }
 
+void LinceReserveEntities(LinceEntityRegistry* reg, uint32_t count){
+    LINCE_ASSERT(reg, "NULL pointer");
+    // Recycled IDs need no new memory
+    if(count <= reg->entity_pool.size) return;
+    uint32_t total = reg->entity_count + count - reg->entity_pool.size;
+
+    array_reserve(&reg->entity_records, total);
+    array_reserve(&reg->entity_masks, total);
+    array_reserve(&reg->entity_active, ActiveIndex(total - 1) + 1);
+
+    // New entities start out without components
+    LinceArchetype* empty = array_get(&reg->archetypes, 0);
+    array_reserve(&empty->entities, empty->entities.size + count);
+}
+
 #define CheckEntityArgs(reg, entity_id, component_id) do{ \
     LINCE_ASSERT(reg, "NULL pointer"); \
     LINCE_ASSERT(entity_id < reg->entity_count, "Invalid entity ID"); \
     LINCE_ASSERT(component_id < reg->component_count, "Invalid component ID"); \
-    LINCE_ASSERT(*(uint32_t*)array_get(&reg->entity_flags, entity_id) & LinceEntityState_Active, \
-        "Entity is inactive"); \
+    LINCE_ASSERT(LinceIsEntityActive(reg, entity_id), "Entity is inactive"); \
 } while(0) \
 
 void LinceDeleteEntity(LinceEntityRegistry* reg, uint32_t entity_id){
     LINCE_ASSERT(reg, "NULL pointer");
     LINCE_ASSERT(entity_id < reg->entity_count, "Entity ID out of bounds");
+    CheckUnlocked(reg);
 
-    LinceEntityState* flag = array_get(&reg->entity_flags, entity_id);
-    *flag = 0;
+    uint64_t* active = array_get(&reg->entity_active, ActiveIndex(entity_id));
+    if(!(*active & ActiveBit(entity_id))) return;
+    *active &= ~ActiveBit(entity_id);
+    reg->version++;
+
+    LinceEntityRecord* record = array_get(&reg->entity_records, entity_id);
+    LinceRemoveArchetypeRow(reg, array_get(&reg->archetypes, record->archetype), record->row);
+    *record = (LinceEntityRecord){0};
 
     uint64_t* mask = array_get(&reg->entity_masks, entity_id);
+    for(uint32_t i = 0; i != reg->component_count; ++i){
+        if((mask[MaskIndex(i)] & MaskBit(i)) && LinceIsComponentSparse(reg, i)){
+            LinceRemoveSparseComponent(array_get(&reg->sparse_sets, i), entity_id);
+        }
+    }
     memset(mask, 0, sizeof(LinceEntityMask));
 
     array_push_back(&reg->entity_pool, &entity_id);
 }
 
+LinceBool LinceIsEntityActive(LinceEntityRegistry* reg, uint32_t entity_id){
+    LINCE_ASSERT(reg, "NULL pointer");
+    if(entity_id >= reg->entity_count) return LinceFalse;
+    uint64_t* active = array_get(&reg->entity_active, ActiveIndex(entity_id));
+    return (*active & ActiveBit(entity_id)) != 0;
+}
+
 void LinceAddEntityComponent(LinceEntityRegistry* reg, uint32_t entity_id, uint32_t component_id, void* data){
     CheckEntityArgs(reg, entity_id, component_id);
     LINCE_ASSERT(data, "NULL pointer");
 
-    // Copy component data to entity data array
-    uint8_t* entity_data = (uint8_t*)array_get(&reg->entity_data, entity_id);
-    uint8_t* comp_data = entity_data + *(uint32_t*)array_get(&reg->component_offsets, component_id);
-    uint32_t bytes = *(uint32_t*)array_get(&reg->component_sizes, component_id);
-    memmove(comp_data, data, bytes);
-    
-    // Set flag in component mask
+    if(LinceIsComponentSparse(reg, component_id)){
+        LinceSparseSet* set = array_get(&reg->sparse_sets, component_id);
+        uint32_t* slot = LinceGetSparseSlot(set, entity_id, LinceTrue);
+        if(*slot == LINCE_SPARSE_NONE){
+            CheckUnlocked(reg);
+            reg->version++;
+            *slot = set->entities.size;
+            array_push_back(&set->dense, data);
+            array_push_back(&set->entities, &entity_id);
+            array_push_back(&set->ticks, &reg->change_tick);
+            uint64_t* mask = array_get(&reg->entity_masks, entity_id);
+            mask[MaskIndex(component_id)] |= MaskBit(component_id);
+        } else {
+            memmove(array_get(&set->dense, *slot), data, set->dense.element_size);
+            array_set(&set->ticks, &reg->change_tick, *slot);
+        }
+        return;
+    }
+
+    // Move entity to the table that includes the new component
     uint64_t* mask = array_get(&reg->entity_masks, entity_id);
-    uint32_t i   = component_id / 64; // index in the array
-    uint32_t pos = component_id % 64; // bit position within the array element
-    mask[i] |= (1 << pos);
+    LinceEntityRecord* record = array_get(&reg->entity_records, entity_id);
+    if(!(mask[MaskIndex(component_id)] & MaskBit(component_id))){
+        CheckUnlocked(reg);
+        reg->version++;
+        uint32_t to = LinceGetArchetypeEdge(reg, record->archetype, component_id, LinceTrue);
+        LinceMoveEntity(reg, entity_id, to);
+        mask[MaskIndex(component_id)] |= MaskBit(component_id);
+    }
+
+    // Copy component data to its column
+    LinceArchetype* arch = array_get(&reg->archetypes, record->archetype);
+    int32_t column = arch->column_index[component_id];
+    memmove(array_get(&arch->columns[column], record->row), data, arch->columns[column].element_size);
+    array_set(&arch->ticks[column], &reg->change_tick, record->row);
 }
 
 LinceBool LinceHasEntityComponent(LinceEntityRegistry* reg, uint32_t entity_id, uint32_t component_id){
     CheckEntityArgs(reg, entity_id, component_id);
     uint64_t* mask = array_get(&reg->entity_masks, entity_id);
-    uint32_t i   = component_id / 64; // index in the array
-    uint32_t pos = component_id % 64; // bit position within the array element
-    return mask[i] & (1 << pos);
+    return (mask[MaskIndex(component_id)] & MaskBit(component_id)) != 0;
 }
 
 void* LinceGetEntityComponent(LinceEntityRegistry* reg, uint32_t entity_id, uint32_t component_id){
     CheckEntityArgs(reg, entity_id, component_id);
-    if(LinceHasEntityComponent(reg, entity_id, component_id) == LinceFalse){
-        return NULL;
+    if(LinceIsComponentSparse(reg, component_id)){
+        return LinceGetSparseComponent(array_get(&reg->sparse_sets, component_id), entity_id);
     }
-    uint8_t* entity_data = (uint8_t*)array_get(&reg->entity_data, entity_id);
-    uint8_t* comp_data = entity_data + *(uint32_t*)array_get(&reg->component_offsets, component_id);
-    return comp_data;
+    LinceEntityRecord* record = array_get(&reg->entity_records, entity_id);
+    LinceArchetype* arch = array_get(&reg->archetypes, record->archetype);
+    int32_t column = arch->column_index[component_id];
+    if(column < 0) return NULL;
+    return array_get(&arch->columns[column], record->row);
+}
+
+/* Returns the change tick of an entity's component, or NULL if it does not have it */
+static uint32_t* LinceGetComponentTickSlot(LinceEntityRegistry* reg, uint32_t entity_id, uint32_t component_id){
+    if(LinceIsComponentSparse(reg, component_id)){
+        LinceSparseSet* set = array_get(&reg->sparse_sets, component_id);
+        uint32_t* slot = LinceGetSparseSlot(set, entity_id, LinceFalse);
+        if(!slot || *slot == LINCE_SPARSE_NONE) return NULL;
+        return array_get(&set->ticks, *slot);
+    }
+    LinceEntityRecord* record = array_get(&reg->entity_records, entity_id);
+    LinceArchetype* arch = array_get(&reg->archetypes, record->archetype);
+    int32_t column = arch->column_index[component_id];
+    if(column < 0) return NULL;
+    return array_get(&arch->ticks[column], record->row);
+}
+
+void* LinceGetMutableEntityComponent(LinceEntityRegistry* reg, uint32_t entity_id, uint32_t component_id){
+    void* data = LinceGetEntityComponent(reg, entity_id, component_id);
+    if(data) *LinceGetComponentTickSlot(reg, entity_id, component_id) = reg->change_tick;
+    return data;
+}
+
+void LinceMarkEntityComponentChanged(LinceEntityRegistry* reg, uint32_t entity_id, uint32_t component_id){
+    CheckEntityArgs(reg, entity_id, component_id);
+    uint32_t* tick = LinceGetComponentTickSlot(reg, entity_id, component_id);
+    if(tick) *tick = reg->change_tick;
+}
+
+uint32_t LinceGetEntityComponentTick(LinceEntityRegistry* reg, uint32_t entity_id, uint32_t component_id){
+    CheckEntityArgs(reg, entity_id, component_id);
+    uint32_t* tick = LinceGetComponentTickSlot(reg, entity_id, component_id);
+    return tick ? *tick : 0;
+}
+
+uint32_t LinceAdvanceChangeTick(LinceEntityRegistry* reg){
+    LINCE_ASSERT(reg, "NULL pointer");
+    // Components marked from running systems read the tick
+    CheckUnlocked(reg);
+    return reg->change_tick++;
 }
 
 void LinceRemoveEntityComponent(LinceEntityRegistry* reg, uint32_t entity_id, uint32_t component_id){
     CheckEntityArgs(reg, entity_id, component_id);
     uint64_t* mask = array_get(&reg->entity_masks, entity_id);
-    uint32_t i   = component_id / 64; // index in the array
-    uint32_t pos = component_id % 64; // bit position within the array element
-    mask[i] &= ~(1 << pos);
+    if(!(mask[MaskIndex(component_id)] & MaskBit(component_id))) return;
+    CheckUnlocked(reg);
+    reg->version++;
+
+    if(LinceIsComponentSparse(reg, component_id)){
+        LinceRemoveSparseComponent(array_get(&reg->sparse_sets, component_id), entity_id);
+        mask[MaskIndex(component_id)] &= ~MaskBit(component_id);
+        return;
+    }
+
+    LinceEntityRecord* record = array_get(&reg->entity_records, entity_id);
+    uint32_t to = LinceGetArchetypeEdge(reg, record->archetype, component_id, LinceFalse);
+    LinceMoveEntity(reg, entity_id, to);
+    mask[MaskIndex(component_id)] &= ~MaskBit(component_id);
 }
 
 
@@ -158,34 +617,625 @@ uint32_t LinceQueryEntities(LinceEntityRegistry* reg, array_t* query, uint32_t c
     LINCE_ASSERT(reg && query, "NULL pointer");
     uint32_t query_count = 0;
     LinceEntityMask query_mask = {0};
+    LinceSparseSet* smallest = NULL;
     va_list args;
 
-    // Build component mask
+    // Build component mask, and find the sparse component with the fewest entities
     va_start(args, component_count);
     for(uint32_t i = 0; i != component_count; ++i){
         uint32_t comp_id = va_arg(args, uint32_t);
-        uint32_t ind = comp_id / 64; // index in the array
-        uint32_t pos = comp_id % 64; // bit position within the array element
-        query_mask[ind] |= (1 << pos);
+        query_mask[MaskIndex(comp_id)] |= MaskBit(comp_id);
+        if(!LinceIsComponentSparse(reg, comp_id)) continue;
+        LinceSparseSet* set = array_get(&reg->sparse_sets, comp_id);
+        if(!smallest || set->entities.size < smallest->entities.size) smallest = set;
     }
     va_end(args);
 
-    // Query entities that match bits in search mask
-    for(uint32_t id = 0; id != reg->entity_count; ++id){
-        uint32_t active = *(uint32_t*)array_get(&reg->entity_flags, id) & LinceEntityState_Active;
-        uint64_t* entity_mask = array_get(&reg->entity_masks, id);
-        
-        int masks_match = 1;
-        for(uint32_t i = 0; i != LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT; ++i){
-            masks_match = masks_match && query_mask[i] == (query_mask[i] & entity_mask[i]); 
+    // Only the entities in the smallest sparse set can match
+    if(smallest){
+        uint32_t first = query->size;
+        for(uint32_t i = 0; i != smallest->entities.size; ++i){
+            uint32_t id = *(uint32_t*)array_get(&smallest->entities, i);
+            uint64_t* entity_mask = array_get(&reg->entity_masks, id);
+            int masks_match = 1;
+            for(uint32_t j = 0; j != LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT; ++j){
+                masks_match = masks_match && query_mask[j] == (query_mask[j] & entity_mask[j]);
+            }
+            if(masks_match){
+                array_push_back(query, &id);
+                query_count++;
+            }
         }
-
-        if(active && masks_match){
-            array_push_back(query, &id);
-            query_count++;
+        if(query_count > 1){
+            qsort(array_get(query, first), query_count, sizeof(uint32_t), LinceCompareEntityIDs);
         }
+        return query_count;
     }
 
+    // Test the masks of 64 entities at a time, skipping blocks with no active entities,
+    // and write the IDs of the matches straight into the result array
+    LinceMaskKernel kernel = LinceGetMaskKernel();
+    const uint64_t* masks = reg->entity_masks.data;
+    const uint64_t* active = reg->entity_active.data;
+
+    for(uint32_t block = 0; block != reg->entity_active.size; ++block){
+        if(active[block] == 0) continue;
+        uint32_t first = block * 64;
+        uint32_t count = reg->entity_count - first < 64 ? reg->entity_count - first : 64;
+        uint64_t matches = active[block] & kernel(
+            masks + (size_t)first * LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT, query_mask, count);
+        if(matches == 0) continue;
+
+        uint32_t size = query->size;
+        array_resize(query, size + 64);
+        uint32_t* ids = array_get(query, size);
+        uint32_t n = 0;
+        while(matches){
+            ids[n++] = first + LinceCountTrailingZeros64(matches);
+            matches &= matches - 1;
+        }
+        array_resize(query, size + n);
+        query_count += n;
+    }
 
     return query_count;
+}
+
+
+/* Returns the sparse set with the fewest entities among the sparse components of a query */
+static LinceSparseSet* LinceGetSmallestSparseSet(LinceEntityRegistry* reg, LinceEntityQuery* query){
+    LinceSparseSet* smallest = NULL;
+    for(uint32_t i = 0; i != query->sparse_ids.size; ++i){
+        uint32_t comp_id = *(uint32_t*)array_get(&query->sparse_ids, i);
+        LinceSparseSet* set = array_get(&reg->sparse_sets, comp_id);
+        if(!smallest || set->entities.size < smallest->entities.size) smallest = set;
+    }
+    return smallest;
+}
+
+LinceEntityQuery* LinceCreateEntityQuery(LinceEntityRegistry* reg, uint32_t component_count, ...){
+    LINCE_ASSERT(reg, "NULL pointer");
+    LinceEntityQuery* query = LinceCalloc(sizeof(LinceEntityQuery));
+    LINCE_ASSERT_ALLOC(query, sizeof(LinceEntityQuery));
+    LINCE_ASSERT(component_count <= LINCE_QUERY_MAX_COMPONENTS,
+        "Too many components in query, max is %u", LINCE_QUERY_MAX_COMPONENTS);
+    array_init(&query->component_ids, sizeof(uint32_t));
+    array_init(&query->sparse_ids, sizeof(uint32_t));
+    array_init(&query->archetypes, sizeof(uint32_t));
+
+    va_list args;
+    va_start(args, component_count);
+    for(uint32_t i = 0; i != component_count; ++i){
+        uint32_t comp_id = va_arg(args, uint32_t);
+        LINCE_ASSERT(comp_id < reg->component_count, "Invalid component ID");
+        query->mask[MaskIndex(comp_id)] |= MaskBit(comp_id);
+        array_push_back(&query->component_ids, &comp_id);
+        if(LinceIsComponentSparse(reg, comp_id)){
+            array_push_back(&query->sparse_ids, &comp_id);
+        } else {
+            query->table_mask[MaskIndex(comp_id)] |= MaskBit(comp_id);
+        }
+    }
+    va_end(args);
+
+    for(uint32_t i = 0; i != reg->archetypes.size; ++i){
+        LinceArchetype* arch = array_get(&reg->archetypes, i);
+        if(LinceMaskContains(arch->mask, query->table_mask)) array_push_back(&query->archetypes, &i);
+    }
+    array_push_back(&reg->queries, &query);
+    return query;
+}
+
+void LinceDeleteEntityQuery(LinceEntityRegistry* reg, LinceEntityQuery* query){
+    LINCE_ASSERT(reg, "NULL pointer");
+    if(!query) return;
+    for(uint32_t i = 0; i != reg->queries.size; ++i){
+        if(*(LinceEntityQuery**)array_get(&reg->queries, i) != query) continue;
+        array_remove(&reg->queries, i);
+        break;
+    }
+    array_uninit(&query->component_ids);
+    array_uninit(&query->sparse_ids);
+    array_uninit(&query->archetypes);
+    LinceFree(query);
+}
+
+double LinceGetEntityClock(void){
+#ifdef LINCE_WINDOWS
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (double)count.QuadPart * 1000.0 / (double)freq.QuadPart;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec * 1000.0 + (double)t.tv_nsec / 1e6;
+#endif
+}
+
+void LinceRecordEntityQueryCall(LinceEntityQuery* query, double start_ms){
+    LINCE_ASSERT(query, "NULL pointer");
+    double elapsed = LinceGetEntityClock() - start_ms;
+    // Systems may use the same query from several threads
+#ifdef _MSC_VER
+    InterlockedIncrement((volatile LONG*)&query->call_count);
+    LONG64 old = *(volatile LONG64*)&query->time_ms;
+    while(1){
+        double sum;
+        memcpy(&sum, &old, sizeof(double));
+        sum += elapsed;
+        LONG64 desired;
+        memcpy(&desired, &sum, sizeof(double));
+        LONG64 seen = InterlockedCompareExchange64((volatile LONG64*)&query->time_ms, desired, old);
+        if(seen == old) break;
+        old = seen;
+    }
+#else
+    __atomic_fetch_add(&query->call_count, 1, __ATOMIC_RELAXED);
+    double old, sum;
+    __atomic_load(&query->time_ms, &old, __ATOMIC_RELAXED);
+    do {
+        sum = old + elapsed;
+    } while(!__atomic_compare_exchange(&query->time_ms, &old, &sum, LinceTrue, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+#endif
+}
+
+/* Collects the entities that match a query */
+static uint32_t LinceFetchQueryResults(LinceEntityRegistry* reg, LinceEntityQuery* query, array_t* result){
+    uint32_t count = 0;
+
+    // With sparse components, only the entities in the smallest sparse set can match
+    if(query->sparse_ids.size > 0){
+        LinceSparseSet* smallest = LinceGetSmallestSparseSet(reg, query);
+        for(uint32_t i = 0; i != smallest->entities.size; ++i){
+            uint32_t id = *(uint32_t*)array_get(&smallest->entities, i);
+            if(!LinceMaskContains(array_get(&reg->entity_masks, id), query->mask)) continue;
+            array_push_back(result, &id);
+            count++;
+        }
+        return count;
+    }
+
+    for(uint32_t i = 0; i != query->archetypes.size; ++i){
+        uint32_t index = *(uint32_t*)array_get(&query->archetypes, i);
+        LinceArchetype* arch = array_get(&reg->archetypes, index);
+        if(arch->entities.size == 0) continue;
+        uint32_t first = result->size;
+        array_resize(result, first + arch->entities.size);
+        memcpy(array_get(result, first), arch->entities.data, sizeof(uint32_t) * arch->entities.size);
+        count += arch->entities.size;
+    }
+    return count;
+}
+
+uint32_t LinceFetchEntityQuery(LinceEntityRegistry* reg, LinceEntityQuery* query, array_t* result){
+    LINCE_ASSERT(reg && query && result, "NULL pointer");
+    LINCE_ASSERT(result->element_size == sizeof(uint32_t), "Result array must hold uint32_t elements");
+    double start = LinceGetEntityClock();
+    uint32_t count = LinceFetchQueryResults(reg, query, result);
+    LinceRecordEntityQueryCall(query, start);
+    return count;
+}
+
+void LinceInitQueryIter(LinceQueryIter* it, LinceEntityRegistry* reg, LinceEntityQuery* query){
+    LINCE_ASSERT(it && reg && query, "NULL pointer");
+    *it = (LinceQueryIter){.reg = reg, .query = query, .start_ms = LinceGetEntityClock()};
+}
+
+/* Counts an iteration that reached the end, once */
+static LinceBool LinceEndQueryIter(LinceQueryIter* it){
+    it->count = 0;
+    if(it->start_ms >= 0.0) LinceRecordEntityQueryCall(it->query, it->start_ms);
+    it->start_ms = -1.0;
+    return LinceFalse;
+}
+
+/* Yields the next entity of the smallest sparse set that matches the query */
+static LinceBool LinceNextSparseQueryChunk(LinceQueryIter* it){
+    LinceEntityRegistry* reg = it->reg;
+    LinceEntityQuery* query = it->query;
+    LinceSparseSet* smallest = LinceGetSmallestSparseSet(reg, query);
+
+    while(it->next < smallest->entities.size){
+        uint32_t* id = array_get(&smallest->entities, it->next++);
+        if(!LinceMaskContains(array_get(&reg->entity_masks, *id), query->mask)) continue;
+
+        LinceEntityRecord* record = array_get(&reg->entity_records, *id);
+        LinceArchetype* arch = array_get(&reg->archetypes, record->archetype);
+        for(uint32_t i = 0; i != query->component_ids.size; ++i){
+            uint32_t comp_id = *(uint32_t*)array_get(&query->component_ids, i);
+            if(LinceIsComponentSparse(reg, comp_id)){
+                LinceSparseSet* set = array_get(&reg->sparse_sets, comp_id);
+                uint32_t dense = *LinceGetSparseSlot(set, *id, LinceFalse);
+                it->data[i] = array_get(&set->dense, dense);
+                it->stride[i] = set->dense.element_size;
+                it->ticks[i] = array_get(&set->ticks, dense);
+            } else {
+                int32_t column = arch->column_index[comp_id];
+                it->data[i] = array_get(&arch->columns[column], record->row);
+                it->stride[i] = arch->columns[column].element_size;
+                it->ticks[i] = array_get(&arch->ticks[column], record->row);
+            }
+        }
+        it->entities = id;
+        it->count = 1;
+        return LinceTrue;
+    }
+    return LinceEndQueryIter(it);
+}
+
+LinceBool LinceNextQueryChunk(LinceQueryIter* it){
+    LINCE_ASSERT(it && it->reg && it->query, "Query iterator not initialised");
+    LinceEntityQuery* query = it->query;
+    if(query->sparse_ids.size > 0) return LinceNextSparseQueryChunk(it);
+
+    // Each non-empty archetype is one chunk
+    while(it->next < query->archetypes.size){
+        uint32_t index = *(uint32_t*)array_get(&query->archetypes, it->next++);
+        LinceArchetype* arch = array_get(&it->reg->archetypes, index);
+        if(arch->entities.size == 0) continue;
+
+        for(uint32_t i = 0; i != query->component_ids.size; ++i){
+            uint32_t comp_id = *(uint32_t*)array_get(&query->component_ids, i);
+            int32_t column = arch->column_index[comp_id];
+            it->data[i] = arch->columns[column].data;
+            it->stride[i] = arch->columns[column].element_size;
+            it->ticks[i] = arch->ticks[column].data;
+        }
+        it->entities = arch->entities.data;
+        it->count = arch->entities.size;
+        return LinceTrue;
+    }
+    return LinceEndQueryIter(it);
+}
+
+void LinceMarkQueryChunkChanged(LinceQueryIter* it, uint32_t index){
+    LINCE_ASSERT(it && it->reg && it->query, "Query iterator not initialised");
+    LINCE_ASSERT(index < it->query->component_ids.size, "Invalid query component index");
+    uint32_t tick = it->reg->change_tick;
+    for(uint32_t i = 0; i != it->count; ++i) it->ticks[index][i] = tick;
+}
+
+uint32_t LinceFetchChangedEntities(LinceEntityRegistry* reg, LinceEntityQuery* query,
+    uint32_t component_id, uint32_t since, array_t* result)
+{
+    LINCE_ASSERT(reg && query && result, "NULL pointer");
+    LINCE_ASSERT(result->element_size == sizeof(uint32_t), "Result array must hold uint32_t elements");
+    LINCE_ASSERT(component_id < reg->component_count, "Invalid component ID");
+    LINCE_ASSERT(query->mask[MaskIndex(component_id)] & MaskBit(component_id),
+        "Component is not part of the query");
+
+    uint32_t index = 0;
+    while(*(uint32_t*)array_get(&query->component_ids, index) != component_id) index++;
+
+    uint32_t count = 0;
+    LinceQueryIter it;
+    LinceInitQueryIter(&it, reg, query);
+    while(LinceNextQueryChunk(&it)){
+        for(uint32_t i = 0; i != it.count; ++i){
+            if(it.ticks[index][i] <= since) continue;
+            array_push_back(result, &it.entities[i]);
+            count++;
+        }
+    }
+    return count;
+}
+
+
+/* Entity of a sparse set, paired with its current position, for sorting by ID */
+typedef struct LinceSparseEntry {
+    uint32_t entity_id;
+    uint32_t index;
+} LinceSparseEntry;
+
+static int LinceCompareSparseEntries(const void* a, const void* b){
+    return LinceCompareEntityIDs(&((const LinceSparseEntry*)a)->entity_id, &((const LinceSparseEntry*)b)->entity_id);
+}
+
+/* Renumbers the entities of a sparse set, sorts them by ID, and rebuilds its pages */
+static void LinceRemapSparseSet(LinceSparseSet* set, const uint32_t* remap){
+    uint32_t count = set->entities.size;
+    LinceSparseEntry* entries = LinceMalloc(sizeof(LinceSparseEntry) * (count + 1));
+    for(uint32_t i = 0; i != count; ++i){
+        uint32_t old_id = *(uint32_t*)array_get(&set->entities, i);
+        entries[i] = (LinceSparseEntry){.entity_id = remap[old_id], .index = i};
+    }
+    qsort(entries, count, sizeof(LinceSparseEntry), LinceCompareSparseEntries);
+
+    array_t dense, ticks;
+    array_init(&dense, set->dense.element_size);
+    array_init(&ticks, sizeof(uint32_t));
+    array_resize(&dense, count);
+    array_resize(&ticks, count);
+    for(uint32_t i = 0; i != count; ++i){
+        array_set(&dense, array_get(&set->dense, entries[i].index), i);
+        array_set(&ticks, array_get(&set->ticks, entries[i].index), i);
+        array_set(&set->entities, &entries[i].entity_id, i);
+    }
+    array_uninit(&set->dense);
+    array_uninit(&set->ticks);
+    set->dense = dense;
+    set->ticks = ticks;
+
+    for(uint32_t i = 0; i != set->pages.size; ++i){
+        uint32_t** page = array_get(&set->pages, i);
+        LinceFree(*page);
+    }
+    array_clear(&set->pages);
+    for(uint32_t i = 0; i != count; ++i){
+        *LinceGetSparseSlot(set, entries[i].entity_id, LinceTrue) = i;
+    }
+    array_shrink_to_fit(&set->entities);
+    array_shrink_to_fit(&set->pages);
+    LinceFree(entries);
+}
+
+uint32_t LinceCompactEntityRegistry(LinceEntityRegistry* reg, array_t* remap){
+    LINCE_ASSERT(reg, "NULL pointer");
+    CheckUnlocked(reg);
+    LINCE_ASSERT(!remap || remap->element_size == sizeof(uint32_t), "Remap array must hold uint32_t elements");
+    reg->version++;
+
+    uint32_t old_count = reg->entity_count;
+    uint32_t* table = LinceMalloc(sizeof(uint32_t) * (old_count + 1));
+    memset(table, 0xFF, sizeof(uint32_t) * old_count); // LINCE_ENTITY_REMOVED
+
+    // New IDs follow the rows of each archetype in turn
+    array_t masks, records;
+    array_init(&masks, sizeof(LinceEntityMask));
+    array_init(&records, sizeof(LinceEntityRecord));
+    array_reserve(&masks, old_count - reg->entity_pool.size);
+    array_reserve(&records, old_count - reg->entity_pool.size);
+    uint32_t next = 0;
+    for(uint32_t a = 0; a != reg->archetypes.size; ++a){
+        LinceArchetype* arch = array_get(&reg->archetypes, a);
+        uint32_t* ids = arch->entities.data;
+        for(uint32_t row = 0; row != arch->entities.size; ++row){
+            array_push_back(&masks, array_get(&reg->entity_masks, ids[row]));
+            array_push_back(&records, &(LinceEntityRecord){.archetype = a, .row = row});
+            table[ids[row]] = next;
+            ids[row] = next++;
+        }
+        for(uint32_t i = 0; i != arch->column_count; ++i){
+            array_shrink_to_fit(&arch->columns[i]);
+            array_shrink_to_fit(&arch->ticks[i]);
+        }
+        array_shrink_to_fit(&arch->entities);
+    }
+
+    for(uint32_t i = 0; i != reg->component_count; ++i){
+        if(LinceIsComponentSparse(reg, i)) LinceRemapSparseSet(array_get(&reg->sparse_sets, i), table);
+    }
+
+    array_uninit(&reg->entity_masks);
+    array_uninit(&reg->entity_records);
+    reg->entity_masks = masks;
+    reg->entity_records = records;
+    array_shrink_to_fit(&reg->entity_masks);
+    array_shrink_to_fit(&reg->entity_records);
+
+    // The first IDs are now all in use
+    uint32_t words = (next + 63) / 64;
+    array_resize(&reg->entity_active, words);
+    for(uint32_t i = 0; i != words; ++i){
+        uint64_t bits = (i + 1) * 64 <= next ? ~(uint64_t)0 : ((uint64_t)1 << (next % 64)) - 1;
+        array_set(&reg->entity_active, &bits, i);
+    }
+    array_shrink_to_fit(&reg->entity_active);
+    array_clear(&reg->entity_pool);
+    array_shrink_to_fit(&reg->entity_pool);
+    reg->entity_count = next;
+
+    if(remap){
+        array_resize(remap, old_count);
+        if(old_count > 0) memcpy(remap->data, table, sizeof(uint32_t) * old_count);
+    }
+    LinceFree(table);
+    return next;
+}
+
+/* Adds the memory of a column of components and its ticks to the stats of the component */
+static void LinceAddColumnStats(LinceComponentStats* stats, array_t* column, array_t* ticks){
+    stats->count += column->size;
+    stats->capacity += column->capacity;
+    stats->used_bytes += (uint64_t)column->size * (column->element_size + sizeof(uint32_t));
+    stats->allocated_bytes += (uint64_t)column->capacity * column->element_size;
+    stats->allocated_bytes += (uint64_t)ticks->capacity * sizeof(uint32_t);
+}
+
+void LinceGetEntityRegistryStats(LinceEntityRegistry* reg, LinceEntityRegistryStats* stats){
+    LINCE_ASSERT(reg && stats, "NULL pointer");
+    *stats = (LinceEntityRegistryStats){0};
+
+    const uint64_t* active = reg->entity_active.data;
+    for(uint32_t i = 0; i != reg->entity_active.size; ++i){
+        for(uint64_t bits = active[i]; bits; bits &= bits - 1) stats->live_count++;
+    }
+    stats->dead_count = reg->entity_count - stats->live_count;
+    stats->pooled_count = reg->entity_pool.size;
+    stats->entity_bytes =
+        (uint64_t)reg->entity_records.capacity * sizeof(LinceEntityRecord) +
+        (uint64_t)reg->entity_masks.capacity * sizeof(LinceEntityMask) +
+        (uint64_t)reg->entity_active.capacity * sizeof(uint64_t) +
+        (uint64_t)reg->entity_pool.capacity * sizeof(uint32_t);
+
+    stats->archetype_count = reg->archetypes.size;
+    for(uint32_t a = 0; a != reg->archetypes.size; ++a){
+        LinceArchetype* arch = array_get(&reg->archetypes, a);
+        if(arch->entities.size == 0) stats->empty_archetype_count++;
+        stats->table_bytes += (uint64_t)arch->entities.capacity * sizeof(uint32_t);
+        stats->table_bytes += (uint64_t)arch->column_count * (sizeof(uint32_t) + 2 * sizeof(array_t));
+        stats->table_bytes += (uint64_t)reg->component_count * (sizeof(int32_t) + 2 * sizeof(uint32_t));
+        for(uint32_t i = 0; i != arch->column_count; ++i){
+            LinceAddColumnStats(&stats->components[arch->column_ids[i]], &arch->columns[i], &arch->ticks[i]);
+        }
+    }
+
+    for(uint32_t c = 0; c != reg->component_count; ++c){
+        LinceComponentStats* comp = &stats->components[c];
+        if(LinceIsComponentSparse(reg, c)){
+            LinceSparseSet* set = array_get(&reg->sparse_sets, c);
+            LinceAddColumnStats(comp, &set->dense, &set->ticks);
+            comp->used_bytes += (uint64_t)set->entities.size * sizeof(uint32_t);
+            comp->allocated_bytes += (uint64_t)set->entities.capacity * sizeof(uint32_t);
+            comp->allocated_bytes += (uint64_t)set->pages.capacity * sizeof(uint32_t*);
+            for(uint32_t p = 0; p != set->pages.size; ++p){
+                if(*(uint32_t**)array_get(&set->pages, p)){
+                    comp->allocated_bytes += sizeof(uint32_t) * LINCE_SPARSE_PAGE_SIZE;
+                }
+            }
+        }
+        stats->used_bytes += comp->used_bytes;
+        stats->allocated_bytes += comp->allocated_bytes;
+    }
+
+    stats->query_count = reg->queries.size;
+    for(uint32_t i = 0; i != reg->queries.size; ++i){
+        LinceEntityQuery* query = *(LinceEntityQuery**)array_get(&reg->queries, i);
+        stats->query_calls += query->call_count;
+        stats->query_ms += query->time_ms;
+    }
+}
+
+void LinceResetEntityQueryStats(LinceEntityRegistry* reg){
+    LINCE_ASSERT(reg, "NULL pointer");
+    for(uint32_t i = 0; i != reg->queries.size; ++i){
+        LinceEntityQuery* query = *(LinceEntityQuery**)array_get(&reg->queries, i);
+        query->call_count = 0;
+        query->time_ms = 0.0;
+    }
+}
+
+
+LincePrefab* LinceCreatePrefab(LinceEntityRegistry* reg){
+    LINCE_ASSERT(reg, "NULL pointer");
+    LincePrefab* prefab = LinceCalloc(sizeof(LincePrefab));
+    LINCE_ASSERT_ALLOC(prefab, sizeof(LincePrefab));
+    prefab->component_count = reg->component_count;
+    prefab->components = LinceCalloc(sizeof(void*) * reg->component_count);
+    prefab->component_sizes = LinceMalloc(sizeof(uint32_t) * reg->component_count);
+    memcpy(prefab->component_sizes, reg->component_sizes.data, sizeof(uint32_t) * reg->component_count);
+    return prefab;
+}
+
+void LinceDestroyPrefab(LincePrefab* prefab){
+    if(!prefab) return;
+    for(uint32_t i = 0; i != prefab->component_count; ++i){
+        LinceFree(prefab->components[i]);
+    }
+    LinceFree(prefab->components);
+    LinceFree(prefab->component_sizes);
+    LinceFree(prefab);
+}
+
+void LinceSetPrefabComponent(LincePrefab* prefab, uint32_t component_id, void* data){
+    LINCE_ASSERT(prefab && data, "NULL pointer");
+    LINCE_ASSERT(component_id < prefab->component_count, "Invalid component ID");
+    uint32_t size = prefab->component_sizes[component_id];
+    if(!prefab->components[component_id]){
+        prefab->components[component_id] = LinceMalloc(size);
+        LINCE_ASSERT_ALLOC(prefab->components[component_id], size);
+    }
+    memmove(prefab->components[component_id], data, size);
+    prefab->mask[MaskIndex(component_id)] |= MaskBit(component_id);
+}
+
+void LinceRemovePrefabComponent(LincePrefab* prefab, uint32_t component_id){
+    LINCE_ASSERT(prefab, "NULL pointer");
+    LINCE_ASSERT(component_id < prefab->component_count, "Invalid component ID");
+    LinceFree(prefab->components[component_id]);
+    prefab->mask[MaskIndex(component_id)] &= ~MaskBit(component_id);
+}
+
+/* Fills consecutive elements with copies of the first one,
+   doubling the copied block each time so that only log2(count) copies are needed */
+static void LinceFillElements(uint8_t* dst, uint32_t size, uint32_t count){
+    uint32_t filled = 1;
+    while(filled < count){
+        uint32_t n = filled < count - filled ? filled : count - filled;
+        memcpy(dst + (size_t)filled * size, dst, (size_t)n * size);
+        filled += n;
+    }
+}
+
+void LinceInstantiate(LinceEntityRegistry* reg, LincePrefab* prefab, uint32_t count, uint32_t* ids){
+    LINCE_ASSERT(reg && prefab, "NULL pointer");
+    LINCE_ASSERT(prefab->component_count == reg->component_count, "Prefab was made for another registry");
+    CheckUnlocked(reg);
+    if(count == 0) return;
+    reg->version++;
+
+    // Sparse components do not take part in the archetype
+    LinceEntityMask table_mask;
+    memcpy(table_mask, prefab->mask, sizeof(LinceEntityMask));
+    for(uint32_t i = 0; i != reg->component_count; ++i){
+        if(LinceIsComponentSparse(reg, i)) table_mask[MaskIndex(i)] &= ~MaskBit(i);
+    }
+    uint32_t arch_index = LinceGetArchetype(reg, table_mask);
+    LinceArchetype* arch = array_get(&reg->archetypes, arch_index);
+    uint32_t first_row = arch->entities.size;
+
+    // Grow every column once, and fill it with the default values
+    for(uint32_t i = 0; i != arch->column_count; ++i){
+        array_t* column = &arch->columns[i];
+        array_resize(column, first_row + count);
+        uint8_t* dst = array_get(column, first_row);
+        memcpy(dst, prefab->components[arch->column_ids[i]], column->element_size);
+        LinceFillElements(dst, column->element_size, count);
+
+        array_resize(&arch->ticks[i], first_row + count);
+        uint32_t* ticks = array_get(&arch->ticks[i], first_row);
+        for(uint32_t j = 0; j != count; ++j) ticks[j] = reg->change_tick;
+    }
+    array_resize(&arch->entities, first_row + count);
+    uint32_t* row_ids = array_get(&arch->entities, first_row);
+
+    // Recycled IDs first, then new ones at the end of the entity arrays
+    uint32_t recycled = count < reg->entity_pool.size ? count : reg->entity_pool.size;
+    uint32_t fresh = count - recycled;
+    for(uint32_t i = 0; i != recycled; ++i){
+        row_ids[i] = *(uint32_t*)array_back(&reg->entity_pool);
+        array_pop_back(&reg->entity_pool);
+    }
+    uint32_t first_id = reg->entity_count;
+    if(fresh > 0){
+        reg->entity_count += fresh;
+        array_resize(&reg->entity_records, reg->entity_count);
+        array_resize(&reg->entity_masks, reg->entity_count);
+        while(reg->entity_active.size < ActiveIndex(reg->entity_count - 1) + 1){
+            array_push_back(&reg->entity_active, NULL);
+        }
+        for(uint32_t i = 0; i != fresh; ++i) row_ids[recycled + i] = first_id + i;
+    }
+
+    LinceEntityRecord* records = reg->entity_records.data;
+    LinceEntityMask* masks = reg->entity_masks.data;
+    uint64_t* active = reg->entity_active.data;
+    for(uint32_t i = 0; i != count; ++i){
+        uint32_t id = row_ids[i];
+        records[id] = (LinceEntityRecord){.archetype = arch_index, .row = first_row + i};
+        memcpy(masks[id], prefab->mask, sizeof(LinceEntityMask));
+        active[ActiveIndex(id)] |= ActiveBit(id);
+    }
+
+    // Sparse components are appended to the dense arrays of their sets
+    for(uint32_t c = 0; c != reg->component_count; ++c){
+        if(!(prefab->mask[MaskIndex(c)] & MaskBit(c)) || !LinceIsComponentSparse(reg, c)) continue;
+        LinceSparseSet* set = array_get(&reg->sparse_sets, c);
+        uint32_t first = set->entities.size;
+        array_resize(&set->dense, first + count);
+        array_resize(&set->entities, first + count);
+        array_resize(&set->ticks, first + count);
+        uint8_t* dst = array_get(&set->dense, first);
+        memcpy(dst, prefab->components[c], set->dense.element_size);
+        LinceFillElements(dst, set->dense.element_size, count);
+        memcpy(array_get(&set->entities, first), row_ids, sizeof(uint32_t) * count);
+        uint32_t* ticks = array_get(&set->ticks, first);
+        for(uint32_t i = 0; i != count; ++i){
+            *LinceGetSparseSlot(set, row_ids[i], LinceTrue) = first + i;
+            ticks[i] = reg->change_tick;
+        }
+    }
+
+    if(ids) memcpy(ids, row_ids, sizeof(uint32_t) * count);
 }
\ No newline at end of file
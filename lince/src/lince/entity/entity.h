@@ -25,30 +25,214 @@
 */
 typedef uint64_t LinceEntityMask[LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT];
 
-/** @enum LinceEntityState
-* @brief Entity flags
+/** @enum LinceComponentStorage
+* @brief How the data of a component is stored
 */
-typedef enum LinceEntityState {
-    LinceEntityState_Active = 0x1, ///< In use, not flagged for recycle
-} LinceEntityState;
+typedef enum LinceComponentStorage {
+    LinceComponentStorage_Table = 0, ///< Default. Stored in the archetype tables, best for common components.
+    LinceComponentStorage_Sparse,    ///< Stored in a sparse set, best for components that few entities have.
+} LinceComponentStorage;
+
+/** @struct LinceComponentInfo
+* @brief Definition of a component type
+*/
+typedef struct LinceComponentInfo {
+    uint32_t size;                 ///< Size in bytes of the component
+    LinceComponentStorage storage; ///< Storage type
+} LinceComponentInfo;
+
+/** @brief Number of entity IDs covered by each page of a sparse set */
+#define LINCE_SPARSE_PAGE_SIZE 1024
+
+/** @brief Marks an entity that is not in a sparse set */
+#define LINCE_SPARSE_NONE UINT32_MAX
+
+/** @struct LinceSparseSet
+* @brief Stores one component for only the entities that have it.
+*
+* Component values are packed in a dense array, and a sparse map
+* translates entity IDs into dense indices, giving constant-time
+* addition, removal and access, and iteration over exactly the entities
+* that have the component.
+* The sparse map is split into pages that are only allocated when used.
+*/
+typedef struct LinceSparseSet {
+    array_t dense;     ///< array<bytes> -> packed component data
+    array_t entities;  ///< array<uint32_t> -> entity ID of each dense element
+    array_t ticks;     ///< array<uint32_t> -> change tick of each dense element
+    array_t pages;     ///< array<uint32_t*> -> pages of dense indices, indexed by entity ID. NULL if unused.
+} LinceSparseSet;
+
+/** @struct LinceArchetype
+* @brief Table of the entities that have exactly the same set of components.
+*
+* Each component is stored in its own column of tightly packed values,
+* and each row of the table corresponds to one entity.
+* Adding or removing a component moves the entity to another table.
+*/
+typedef struct LinceArchetype {
+    LinceEntityMask mask;       ///< Components of the entities in the table
+    uint32_t column_count;      ///< Number of components in the table
+    uint32_t* column_ids;       ///< ID of the component stored in each column, in ascending order
+    int32_t* column_index;      ///< Column of each component ID in the registry, or -1 if not in the table
+    array_t* columns;           ///< array<bytes>[column_count] -> packed component data, one element per row
+    array_t* ticks;             ///< array<uint32_t>[column_count] -> tick at which each component last changed, one per row
+    array_t entities;           ///< array<uint32_t> -> ID of the entity in each row
+    uint32_t* add_edges;        ///< Archetype reached by adding each component, or LINCE_ARCHETYPE_NONE if not yet known
+    uint32_t* remove_edges;     ///< Archetype reached by removing each component, or LINCE_ARCHETYPE_NONE if not yet known
+} LinceArchetype;
+
+/** @brief Marks an unknown or missing archetype */
+#define LINCE_ARCHETYPE_NONE UINT32_MAX
+
+/** @struct LinceEntityRecord
+* @brief Location of an entity's components
+*/
+typedef struct LinceEntityRecord {
+    uint32_t archetype; ///< Index of the entity's archetype in the registry
+    uint32_t row;       ///< Row of the entity in the archetype table
+} LinceEntityRecord;
+
+/** @brief Maximum number of components in a persistent query */
+#define LINCE_QUERY_MAX_COMPONENTS 16
+
+/** @struct LinceEntityQuery
+* @brief Persistent query for the entities that have a set of components.
+*
+* The query keeps the list of archetypes whose tables hold its components,
+* which the registry updates whenever a new archetype is created.
+* Entities that gain or lose components move between archetype tables,
+* so fetching the results only visits matching entities.
+*/
+typedef struct LinceEntityQuery {
+    LinceEntityMask mask;       ///< All components in the query
+    array_t component_ids;      ///< array<uint32_t> -> components in the order they were requested
+    LinceEntityMask table_mask; ///< Components of the query stored in archetype tables
+    array_t sparse_ids;         ///< array<uint32_t> -> components of the query stored in sparse sets
+    array_t archetypes;         ///< array<uint32_t> -> indices of the archetypes that have the table components
+    uint32_t call_count;        ///< Number of fetches and iterations, see `LinceGetEntityRegistryStats`
+    double time_ms;             ///< Time spent on fetches and complete iterations, in milliseconds
+} LinceEntityQuery;
+
+/** @struct LinceQueryIter
+* @brief Iterates over the results of a persistent query in contiguous chunks.
+*
+* Each chunk holds, for every component in the query in the order requested,
+* a pointer to the component of its first entity and the number of bytes
+* between consecutive entities. Table components are tightly packed, so
+* `data[i]` can be indexed as a plain array of `count` components.
+* Entities are grouped by archetype, and queries with sparse components yield
+* one entity per chunk.
+*
+* Usage:
+* ```c
+* LinceQueryIter it;
+* LinceInitQueryIter(&it, reg, query); // query for {Position, Velocity}
+* while(LinceNextQueryChunk(&it)){
+*     Position* pos = it.data[0];
+*     Velocity* vel = it.data[1];
+*     for(uint32_t i = 0; i != it.count; ++i) pos[i].x += vel[i].vx;
+* }
+* ```
+* Adding or removing components, or creating or deleting entities,
+* invalidates an iterator in use.
+*
+* Writing to the data of a chunk does not mark it as changed,
+* see `LinceMarkQueryChunkChanged`.
+*/
+typedef struct LinceQueryIter {
+    struct LinceEntityRegistry* reg; ///< Registry being iterated
+    LinceEntityQuery* query;         ///< Query being iterated
+    uint32_t next;                   ///< Next archetype of the query, or element of the smallest sparse set
+    uint32_t count;                  ///< Number of entities in the current chunk
+    uint32_t* entities;              ///< IDs of the entities in the current chunk
+    void* data[LINCE_QUERY_MAX_COMPONENTS];       ///< Component data of the first entity in the chunk
+    uint32_t stride[LINCE_QUERY_MAX_COMPONENTS];  ///< Bytes between the components of consecutive entities
+    uint32_t* ticks[LINCE_QUERY_MAX_COMPONENTS];  ///< Change ticks of the components, one per entity in the chunk
+    double start_ms;                 ///< Time at which the iteration started, added to the query time when it ends, or negative to not count it
+} LinceQueryIter;
+
+/** @struct LincePrefab
+* @brief Template of an entity: a set of components with default values,
+* from which many identical entities can be spawned at once.
+*
+* Usage:
+* ```c
+* LincePrefab* bullet = LinceCreatePrefab(reg);
+* LinceSetPrefabComponent(bullet, Component_Sprite, &sprite);
+* LinceSetPrefabComponent(bullet, Component_Velocity, &velocity);
+* LinceInstantiate(reg, bullet, 1000, ids); // ids can hold 1000 entity IDs, or is NULL
+* LinceDestroyPrefab(bullet);
+* ```
+*/
+typedef struct LincePrefab {
+    LinceEntityMask mask;       ///< Components of the prefab
+    uint32_t component_count;   ///< Number of components defined in the registry
+    void** components;          ///< Default data of each component, indexed by component ID, or NULL if absent
+    uint32_t* component_sizes;  ///< Size in bytes of each component, indexed by component ID
+} LincePrefab;
 
 /** @struct LinceEntityRegistry
 * @brief Holds the state of a set of entities in a cache-friendly way.
+*
+* Entities are grouped into archetypes by the components they have,
+* so that each entity only takes up the memory of its own components,
+* and entities with the same components are stored contiguously.
+* The first archetype holds the entities with no components.
+*
+* Components created with `LinceComponentStorage_Sparse` are instead stored
+* in sparse sets, and do not take part in the archetype of an entity.
 */
 typedef struct LinceEntityRegistry {
     uint32_t component_count;    ///< Number of defined components
     uint32_t max_components;     ///< Maximum number of components, tweaked with LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT
     array_t  component_sizes;    ///< array<uint32_t> -> size in bytes of each defined component
-    array_t  component_offsets;  ///< array<uint32_t> -> byte offsets between components in an entity
+    array_t  component_storage;  ///< array<LinceComponentStorage> -> storage type of each defined component
+    array_t  sparse_sets;        ///< array<LinceSparseSet> -> one per component, only used by sparse components
 
-    uint32_t entity_size;     ///< size in bytes of an entity: sum all defined components
+    array_t archetypes;       ///< array<LinceArchetype> -> component tables
     uint32_t entity_count;    ///< number of loaded entities
-    array_t entity_data;      ///< array<bytes> -> component data of all entities
-    array_t entity_flags;     ///< array<LinceEntityState> -> further data in the form of flags
-    array_t entity_masks;     ///< array<uint64_t> -> bit fields that indicate which component each entity has
+    array_t entity_records;   ///< array<LinceEntityRecord> -> archetype and row of each entity
+    array_t entity_active;    ///< array<uint64_t> -> bit set with the entities in use, one bit per entity ID
+    array_t entity_masks;     ///< array<LinceEntityMask> -> bit fields that indicate which component each entity has, contiguous
     array_t entity_pool;      ///< array<uint32_t> -> entity IDs available to be re-used
+    array_t queries;          ///< array<LinceEntityQuery*> -> persistent queries kept up to date
+    LinceBool locked;         ///< Forbids structural changes, e.g. while systems run in parallel
+    uint32_t change_tick;     ///< Current tick, stamped on components when they are added or changed
+    uint32_t version;         ///< Incremented on every structural change, which may move component data in memory
 } LinceEntityRegistry;
 
+/** @struct LinceComponentStats
+* @brief Memory used by the storage of one component
+*/
+typedef struct LinceComponentStats {
+    uint32_t count;            ///< Number of components stored
+    uint32_t capacity;         ///< Number of components that fit in the allocated memory
+    uint64_t used_bytes;       ///< Bytes taken by the stored components and their change ticks
+    uint64_t allocated_bytes;  ///< Bytes allocated, including unused capacity and, for sparse components, the pages
+} LinceComponentStats;
+
+/** @struct LinceEntityRegistryStats
+* @brief Snapshot of the entity counts, memory usage and query costs of a registry.
+* Wasted memory is the difference between allocated and used bytes,
+* and the capacity headroom is the difference between capacity and count.
+*/
+typedef struct LinceEntityRegistryStats {
+    uint32_t live_count;            ///< Entities in use
+    uint32_t dead_count;            ///< Entity IDs not in use
+    uint32_t pooled_count;          ///< Entity IDs waiting to be recycled
+    uint32_t archetype_count;       ///< Archetype tables
+    uint32_t empty_archetype_count; ///< Archetype tables without entities
+    uint64_t entity_bytes;          ///< Bytes allocated for entity records, masks, active bits and the pool
+    uint64_t table_bytes;           ///< Bytes allocated for archetypes besides their columns, e.g. entity lists and edges
+    uint64_t used_bytes;            ///< Bytes used by all components
+    uint64_t allocated_bytes;       ///< Bytes allocated for all components
+    uint32_t query_count;           ///< Persistent queries
+    uint32_t query_calls;           ///< Fetches and iterations of all persistent queries
+    double query_ms;                ///< Time spent on all persistent queries, in milliseconds
+    LinceComponentStats components[LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT * 64]; ///< Memory used by each component
+} LinceEntityRegistryStats;
+
 
 /** @brief Creates a registry that will be used to spawn entities.
 *
@@ -74,14 +258,41 @@ typedef struct LinceEntityRegistry {
 * or if it failed to allocate memory.
 */
 LinceEntityRegistry* LinceCreateEntityRegistry(uint32_t component_count, ...);
+
+/** @brief Creates a registry from an array of component definitions,
+* which allows choosing the storage type of each component.
+* Example code:
+* ```c
+* LinceComponentInfo components[] = {
+*     {sizeof(SpriteComponent), LinceComponentStorage_Table},
+*     {sizeof(SelectedComponent), LinceComponentStorage_Sparse},
+* };
+* reg = LinceCreateEntityRegistryFromInfo(2, components);
+* ```
+*/
+LinceEntityRegistry* LinceCreateEntityRegistryFromInfo(uint32_t component_count, LinceComponentInfo* components);
+
 void LinceDestroyEntityRegistry(LinceEntityRegistry* reg);
 
+/** @brief Returns the index of the archetype table for a set of table components,
+* creating it if missing. Sparse components must not be included in the mask.
+*/
+uint32_t LinceGetArchetype(LinceEntityRegistry* reg, LinceEntityMask mask);
+
 /** @brief Creates a new entity and returns its ID. */
 uint32_t LinceCreateEntity(LinceEntityRegistry* reg);
 
+/** @brief Allocates memory for a number of new entities ahead of time,
+* so that creating them does not grow the registry one entity at a time.
+*/
+void LinceReserveEntities(LinceEntityRegistry* reg, uint32_t count);
+
 /** @brief Deletes an entity and flags its ID for recycling */
 void LinceDeleteEntity(LinceEntityRegistry* reg, uint32_t entity_id);
 
+/** @brief Returns true if an entity ID is in use */
+LinceBool LinceIsEntityActive(LinceEntityRegistry* reg, uint32_t entity_id);
+
 /** @brief Provides data for a component to an entity
 * @param reg Entity registry,
 * @param entity_id Entity to which add a component. Must have already been created.
@@ -97,6 +308,32 @@ LinceBool LinceHasEntityComponent(LinceEntityRegistry* reg, uint32_t entity_id,
 /** @brief Returns the component data from an entity */
 void* LinceGetEntityComponent(LinceEntityRegistry* reg, uint32_t entity_id, uint32_t component_id);
 
+/** @brief Returns the component data from an entity, and marks it as changed.
+* Use it instead of `LinceGetEntityComponent` when the component will be modified,
+* so that systems that only process changed components see the change.
+*/
+void* LinceGetMutableEntityComponent(LinceEntityRegistry* reg, uint32_t entity_id, uint32_t component_id);
+
+/** @brief Marks the component of an entity as changed at the current tick */
+void LinceMarkEntityComponentChanged(LinceEntityRegistry* reg, uint32_t entity_id, uint32_t component_id);
+
+/** @brief Returns the tick at which the component of an entity last changed,
+* or zero if the entity does not have it.
+*/
+uint32_t LinceGetEntityComponentTick(LinceEntityRegistry* reg, uint32_t entity_id, uint32_t component_id);
+
+/** @brief Ends the current change tick, so that later changes are stamped with the next one.
+* @returns The tick that ended. Changes made up to it have ticks less than or equal to it.
+*
+* A system that only processes changed components keeps the tick at which it last ran:
+* ```c
+* uint32_t now = LinceAdvanceChangeTick(reg);
+* LinceFetchChangedEntities(reg, query, Component_Sprite, last_tick, &changed);
+* last_tick = now;
+* ```
+*/
+uint32_t LinceAdvanceChangeTick(LinceEntityRegistry* reg);
+
 /** @brief Removes a component from an entity */
 void LinceRemoveEntityComponent(LinceEntityRegistry* reg, uint32_t entity_id, uint32_t component_id);
 
@@ -107,7 +344,132 @@ void LinceRemoveEntityComponent(LinceEntityRegistry* reg, uint32_t entity_id, ui
 * @param component_count Number of components to search for in entities.
 *       This is followed by the component IDs in the form of variadic arguments.
 * @returns The number of entities that match the query.
+*
+* If any of the components is sparse, only the entities in the smallest
+* sparse set are checked. Otherwise, the masks of all entities are tested
+* with SIMD instructions where supported by the CPU.
+* The IDs are returned in ascending order either way.
 */
 uint32_t LinceQueryEntities(LinceEntityRegistry* reg, array_t* query, uint32_t component_count, ...);
 
+/** @brief Creates a persistent query for the entities that have all of the specified components.
+* Unlike `LinceQueryEntities`, the registry keeps the query up to date,
+* and fetching its results only costs as much as the number of matches.
+* Queries are owned by the registry, and are freed along with it if not deleted earlier.
+* @param reg Entity registry
+* @param component_count Number of components to search for in entities.
+*       This is followed by the component IDs in the form of variadic arguments.
+*/
+LinceEntityQuery* LinceCreateEntityQuery(LinceEntityRegistry* reg, uint32_t component_count, ...);
+
+/** @brief Deletes a query created with `LinceCreateEntityQuery` */
+void LinceDeleteEntityQuery(LinceEntityRegistry* reg, LinceEntityQuery* query);
+
+/** @brief Appends the IDs of the entities that match a persistent query.
+* @param reg Entity registry
+* @param query Persistent query
+* @param result Array initialised for uint32_t elements
+* @returns The number of entities that match the query.
+*
+* Entities are returned grouped by archetype, not in ascending order.
+*/
+uint32_t LinceFetchEntityQuery(LinceEntityRegistry* reg, LinceEntityQuery* query, array_t* result);
+
+/** @brief Appends the IDs of the entities that match a persistent query,
+* and whose given component has changed after a tick.
+* @param reg Entity registry
+* @param query Persistent query
+* @param component_id Component to check for changes, which must be part of the query
+* @param since Tick after which changes are included, e.g. as returned by `LinceAdvanceChangeTick`.
+*        Zero includes all entities.
+* @param result Array initialised for uint32_t elements
+* @returns The number of entities appended
+*/
+uint32_t LinceFetchChangedEntities(LinceEntityRegistry* reg, LinceEntityQuery* query,
+    uint32_t component_id, uint32_t since, array_t* result);
+
+/** @brief Prepares an iterator over the results of a persistent query.
+* Call `LinceNextQueryChunk` to fetch the first chunk.
+*/
+void LinceInitQueryIter(LinceQueryIter* it, LinceEntityRegistry* reg, LinceEntityQuery* query);
+
+/** @brief Advances an iterator to the next chunk of entities.
+* @returns False when there are no more entities.
+*/
+LinceBool LinceNextQueryChunk(LinceQueryIter* it);
+
+/** @brief Marks a component of all entities in the current chunk of an iterator as changed
+* @param it Query iterator
+* @param index Position of the component in the query, as in `it->data`
+*/
+void LinceMarkQueryChunkChanged(LinceQueryIter* it, uint32_t index);
+
+/** @brief Marks an entity that no longer exists in a remap table */
+#define LINCE_ENTITY_REMOVED UINT32_MAX
+
+/** @brief Packs the live entities of a registry into consecutive IDs, and frees unused memory.
+*
+* Deleted entities leave their IDs unused until they are recycled,
+* which spreads the live entities across the entity arrays.
+* Compaction renumbers the live entities from zero, in the order of their archetypes,
+* so that entities with the same components are contiguous,
+* and releases the capacity left over by the deleted ones.
+*
+* IDs held elsewhere, such as in components, queries results or command buffers,
+* must be translated with the remap table, e.g. during a loading screen.
+* @param reg Entity registry
+* @param remap Optional array initialised for uint32_t elements, or NULL.
+*        Receives the new ID of each old ID, or LINCE_ENTITY_REMOVED for unused IDs.
+* @returns The number of live entities
+*/
+uint32_t LinceCompactEntityRegistry(LinceEntityRegistry* reg, array_t* remap);
+
+/** @brief Monotonic clock in milliseconds used to time queries and systems.
+* It does not depend on the window library, so that registries can run headless.
+*/
+double LinceGetEntityClock(void);
+
+/** @brief Adds a call to the statistics of a persistent query. Safe to call from several threads.
+* @param query Persistent query
+* @param start_ms Time at which the call started, from `LinceGetEntityClock`
+*/
+void LinceRecordEntityQueryCall(LinceEntityQuery* query, double start_ms);
+
+/** @brief Gathers the entity counts, memory usage and query costs of a registry.
+* Each persistent query counts the calls to `LinceFetchEntityQuery` and `LinceFetchChangedEntities`,
+* and the iterations that reach the end. The time of an iteration runs from `LinceInitQueryIter`
+* until `LinceNextQueryChunk` returns false, and so includes the work done on each chunk.
+* Queries are also counted when used by systems running in parallel,
+* and each call to `LinceParallelReduce` counts once for its whole run.
+* @param reg Entity registry
+* @param stats Receives the statistics
+*/
+void LinceGetEntityRegistryStats(LinceEntityRegistry* reg, LinceEntityRegistryStats* stats);
+
+/** @brief Resets the call counts and times of all persistent queries, e.g. at the start of each frame */
+void LinceResetEntityQueryStats(LinceEntityRegistry* reg);
+
+/** @brief Creates an empty prefab for the components of a registry */
+LincePrefab* LinceCreatePrefab(LinceEntityRegistry* reg);
+
+/** @brief Frees a prefab. Entities spawned from it are unaffected. */
+void LinceDestroyPrefab(LincePrefab* prefab);
+
+/** @brief Adds a component to a prefab, or overwrites its default value. The data is copied. */
+void LinceSetPrefabComponent(LincePrefab* prefab, uint32_t component_id, void* data);
+
+/** @brief Removes a component from a prefab */
+void LinceRemovePrefabComponent(LincePrefab* prefab, uint32_t component_id);
+
+/** @brief Creates a number of entities with the components of a prefab.
+* Rather than moving each entity through the archetypes of its components one by one,
+* the entities are placed directly into their final table, which is grown once,
+* and the default values are copied in bulk.
+* @param reg Entity registry
+* @param prefab Prefab created for the same registry
+* @param count Number of entities to create
+* @param ids Optional array that receives the IDs of the new entities, or NULL
+*/
+void LinceInstantiate(LinceEntityRegistry* reg, LincePrefab* prefab, uint32_t count, uint32_t* ids);
+
 #endif /* LINCE_ECS_H */
\ No newline at end of file
@@ -0,0 +1,389 @@
+#include "entity/snapshot.h"
+
+#include <stdio.h>
+
+#ifdef LINCE_WINDOWS
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+/* Blocks start at multiples of this, so that they can be read in place from the mapped file */
+#define SNAPSHOT_ALIGNMENT 8
+
+typedef struct LinceSnapshotHeader {
+    char magic[4];              // "LECS"
+    uint32_t version;           // LINCE_SNAPSHOT_VERSION
+    uint32_t mask_words;        // LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT
+    uint32_t component_count;
+    uint32_t entity_count;
+    uint32_t pool_size;
+    uint32_t archetype_count;
+    uint32_t change_tick;
+} LinceSnapshotHeader;
+
+/* Sizes and storage types of the components, followed by the remaining blocks:
+   active bitset, masks, pool, the archetypes, and the sparse sets */
+typedef struct LinceSnapshotComponent {
+    uint32_t size;
+    uint32_t storage;
+} LinceSnapshotComponent;
+
+/* Precedes the entities and columns of each archetype, and the elements of each sparse set */
+typedef struct LinceSnapshotTable {
+    LinceEntityMask mask;       // unused for sparse sets
+    uint32_t row_count;
+    uint32_t padding;
+} LinceSnapshotTable;
+
+
+/* Writes a block of data, padded to the alignment */
+static LinceBool LinceWriteBlock(FILE* file, const void* data, size_t bytes){
+    static const uint8_t zeros[SNAPSHOT_ALIGNMENT] = {0};
+    if(bytes > 0 && fwrite(data, 1, bytes, file) != bytes) return LinceFalse;
+    size_t padding = (SNAPSHOT_ALIGNMENT - bytes % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT;
+    return fwrite(zeros, 1, padding, file) == padding;
+}
+
+/* Writes a block of components, converted by the fixup callback on a copy */
+static LinceBool LinceWriteComponents(FILE* file, array_t* components, uint32_t component_id,
+    LinceSnapshotFixupFn fixup, void* user_data)
+{
+    size_t bytes = (size_t)components->size * components->element_size;
+    if(!fixup || components->size == 0) return LinceWriteBlock(file, components->data, bytes);
+
+    void* copy = LinceMalloc(bytes);
+    LINCE_ASSERT_ALLOC(copy, bytes);
+    memcpy(copy, components->data, bytes);
+    fixup(component_id, copy, components->size, LinceSnapshot_Save, user_data);
+    LinceBool ok = LinceWriteBlock(file, copy, bytes);
+    LinceFree(copy);
+    return ok;
+}
+
+LinceBool LinceSaveEntityRegistry(LinceEntityRegistry* reg, const char* path,
+    LinceSnapshotFixupFn fixup, void* user_data)
+{
+    LINCE_ASSERT(reg && path, "NULL pointer");
+    FILE* file = fopen(path, "wb");
+    if(!file){
+        LINCE_WARN("Failed to open '%s' to save entity registry", path);
+        return LinceFalse;
+    }
+
+    LinceSnapshotHeader header = {
+        .magic = {'L', 'E', 'C', 'S'},
+        .version = LINCE_SNAPSHOT_VERSION,
+        .mask_words = LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT,
+        .component_count = reg->component_count,
+        .entity_count = reg->entity_count,
+        .pool_size = reg->entity_pool.size,
+        .archetype_count = reg->archetypes.size,
+        .change_tick = reg->change_tick,
+    };
+    LinceBool ok = LinceWriteBlock(file, &header, sizeof(header));
+
+    LinceSnapshotComponent* components = LinceMalloc(sizeof(LinceSnapshotComponent) * reg->component_count);
+    for(uint32_t i = 0; i != reg->component_count; ++i){
+        components[i].size = *(uint32_t*)array_get(&reg->component_sizes, i);
+        components[i].storage = *(LinceComponentStorage*)array_get(&reg->component_storage, i);
+    }
+    ok = ok && LinceWriteBlock(file, components, sizeof(LinceSnapshotComponent) * reg->component_count);
+
+    ok = ok && LinceWriteBlock(file, reg->entity_active.data, sizeof(uint64_t) * ((reg->entity_count + 63) / 64));
+    ok = ok && LinceWriteBlock(file, reg->entity_masks.data, sizeof(LinceEntityMask) * reg->entity_count);
+    ok = ok && LinceWriteBlock(file, reg->entity_pool.data, sizeof(uint32_t) * reg->entity_pool.size);
+
+    for(uint32_t a = 0; ok && a != reg->archetypes.size; ++a){
+        LinceArchetype* arch = array_get(&reg->archetypes, a);
+        LinceSnapshotTable table = {.row_count = arch->entities.size};
+        memcpy(table.mask, arch->mask, sizeof(LinceEntityMask));
+        ok = ok && LinceWriteBlock(file, &table, sizeof(table));
+        ok = ok && LinceWriteBlock(file, arch->entities.data, sizeof(uint32_t) * arch->entities.size);
+        for(uint32_t i = 0; ok && i != arch->column_count; ++i){
+            ok = ok && LinceWriteComponents(file, &arch->columns[i], arch->column_ids[i], fixup, user_data);
+            ok = ok && LinceWriteBlock(file, arch->ticks[i].data, sizeof(uint32_t) * arch->ticks[i].size);
+        }
+    }
+
+    for(uint32_t c = 0; ok && c != reg->component_count; ++c){
+        if(components[c].storage != LinceComponentStorage_Sparse) continue;
+        LinceSparseSet* set = array_get(&reg->sparse_sets, c);
+        LinceSnapshotTable table = {.row_count = set->entities.size};
+        ok = ok && LinceWriteBlock(file, &table, sizeof(table));
+        ok = ok && LinceWriteBlock(file, set->entities.data, sizeof(uint32_t) * set->entities.size);
+        ok = ok && LinceWriteComponents(file, &set->dense, c, fixup, user_data);
+        ok = ok && LinceWriteBlock(file, set->ticks.data, sizeof(uint32_t) * set->ticks.size);
+    }
+
+    LinceFree(components);
+    if(fclose(file) != 0) ok = LinceFalse;
+    if(!ok) LINCE_WARN("Failed to write entity registry to '%s'", path);
+    return ok;
+}
+
+
+/* Read-only view of a whole file */
+typedef struct LinceMappedFile {
+    const uint8_t* data;
+    size_t size;
+#ifdef LINCE_WINDOWS
+    HANDLE file, mapping;
+#endif
+} LinceMappedFile;
+
+static LinceBool LinceMapFile(LinceMappedFile* map, const char* path){
+    *map = (LinceMappedFile){0};
+#ifdef LINCE_WINDOWS
+    map->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(map->file == INVALID_HANDLE_VALUE) return LinceFalse;
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(map->file, &size) || size.QuadPart == 0){
+        CloseHandle(map->file);
+        return LinceFalse;
+    }
+    map->size = (size_t)size.QuadPart;
+    map->mapping = CreateFileMappingA(map->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(!map->mapping){
+        CloseHandle(map->file);
+        return LinceFalse;
+    }
+    map->data = MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!map->data){
+        CloseHandle(map->mapping);
+        CloseHandle(map->file);
+        return LinceFalse;
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return LinceFalse;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0){
+        close(fd);
+        return LinceFalse;
+    }
+    map->size = (size_t)st.st_size;
+    void* data = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping stays valid
+    if(data == MAP_FAILED) return LinceFalse;
+    map->data = data;
+#endif
+    return LinceTrue;
+}
+
+static void LinceUnmapFile(LinceMappedFile* map){
+#ifdef LINCE_WINDOWS
+    UnmapViewOfFile(map->data);
+    CloseHandle(map->mapping);
+    CloseHandle(map->file);
+#else
+    munmap((void*)map->data, map->size);
+#endif
+    *map = (LinceMappedFile){0};
+}
+
+/* Sequential reader over a mapped snapshot */
+typedef struct LinceSnapshotReader {
+    LinceMappedFile map;
+    size_t offset;
+} LinceSnapshotReader;
+
+/* Returns a block in the file and skips its padding, or NULL if the file is too short */
+static const void* LinceReadBlock(LinceSnapshotReader* reader, size_t bytes){
+    if(bytes > reader->map.size - reader->offset) return NULL;
+    const void* block = reader->map.data + reader->offset;
+    reader->offset += bytes;
+    size_t padding = (SNAPSHOT_ALIGNMENT - bytes % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT;
+    reader->offset = reader->offset + padding < reader->map.size ? reader->offset + padding : reader->map.size;
+    return block;
+}
+
+/* Copies a block from the file into an array of the same number of elements */
+static LinceBool LinceReadArray(LinceSnapshotReader* reader, array_t* array, uint32_t count){
+    const void* block = LinceReadBlock(reader, (size_t)count * array->element_size);
+    if(!block) return LinceFalse;
+    array_resize(array, count);
+    if(count > 0) memcpy(array->data, block, (size_t)count * array->element_size);
+    return LinceTrue;
+}
+
+static LinceBool LinceIsSnapshotComponentSparse(LinceEntityRegistry* reg, uint32_t component_id){
+    return *(LinceComponentStorage*)array_get(&reg->component_storage, component_id) == LinceComponentStorage_Sparse;
+}
+
+/* Returns true if the mask of an entity has exactly the components of a table, besides sparse ones */
+static LinceBool LinceMatchesTableMask(LinceEntityRegistry* reg, uint32_t entity_id, const uint64_t* table_mask){
+    const uint64_t* mask = array_get(&reg->entity_masks, entity_id);
+    for(uint32_t c = 0; c != LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT * 64; ++c){
+        if(c < reg->component_count && LinceIsSnapshotComponentSparse(reg, c)) continue;
+        uint64_t bit = (uint64_t)1 << (c % 64);
+        if((mask[c / 64] & bit) != (table_mask[c / 64] & bit)) return LinceFalse;
+    }
+    return LinceTrue;
+}
+
+/* Reads an archetype table. Each mask may only appear once, and each entity in a single table.
+   @param placed Whether each entity has been read in a table
+   @param tables array<uint32_t> -> archetypes read so far */
+static LinceBool LinceReadSnapshotTable(LinceSnapshotReader* reader, LinceEntityRegistry* reg,
+    uint8_t* placed, array_t* tables, LinceSnapshotFixupFn fixup, void* user_data)
+{
+    const LinceSnapshotTable* table = LinceReadBlock(reader, sizeof(LinceSnapshotTable));
+    if(!table) return LinceFalse;
+    for(uint32_t c = 0; c != LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT * 64; ++c){
+        if(!(table->mask[c / 64] & ((uint64_t)1 << (c % 64)))) continue;
+        if(c >= reg->component_count || LinceIsSnapshotComponentSparse(reg, c)) return LinceFalse;
+    }
+    LinceEntityMask mask;
+    memcpy(mask, table->mask, sizeof(LinceEntityMask));
+    uint32_t index = LinceGetArchetype(reg, mask);
+    for(uint32_t i = 0; i != tables->size; ++i){
+        if(*(uint32_t*)array_get(tables, i) == index) return LinceFalse;
+    }
+    array_push_back(tables, &index);
+    LinceArchetype* arch = array_get(&reg->archetypes, index);
+
+    uint32_t rows = table->row_count;
+    if(!LinceReadArray(reader, &arch->entities, rows)) return LinceFalse;
+    uint32_t* ids = arch->entities.data;
+    for(uint32_t row = 0; row != rows; ++row){
+        uint32_t id = ids[row];
+        if(id >= reg->entity_count || placed[id] || !LinceIsEntityActive(reg, id)) return LinceFalse;
+        if(!LinceMatchesTableMask(reg, id, mask)) return LinceFalse;
+        placed[id] = 1;
+        array_set(&reg->entity_records, &(LinceEntityRecord){.archetype = index, .row = row}, id);
+    }
+    for(uint32_t i = 0; i != arch->column_count; ++i){
+        if(!LinceReadArray(reader, &arch->columns[i], rows)) return LinceFalse;
+        if(!LinceReadArray(reader, &arch->ticks[i], rows)) return LinceFalse;
+        if(fixup && rows > 0){
+            fixup(arch->column_ids[i], arch->columns[i].data, rows, LinceSnapshot_Load, user_data);
+        }
+    }
+    return LinceTrue;
+}
+
+/* Reads a sparse set. Its entities must be unique, and be all those whose mask has the component.
+   @param ticks Scratch space for the change ticks */
+static LinceBool LinceReadSnapshotSparseSet(LinceSnapshotReader* reader, LinceEntityRegistry* reg,
+    uint32_t component_id, array_t* ticks, LinceSnapshotFixupFn fixup, void* user_data)
+{
+    LinceSparseSet* set = array_get(&reg->sparse_sets, component_id);
+    const LinceSnapshotTable* table = LinceReadBlock(reader, sizeof(LinceSnapshotTable));
+    if(!table) return LinceFalse;
+    uint32_t rows = table->row_count;
+    const uint32_t* ids = LinceReadBlock(reader, sizeof(uint32_t) * rows);
+    const uint8_t* dense = LinceReadBlock(reader, (size_t)rows * set->dense.element_size);
+    if(!ids || !dense || !LinceReadArray(reader, ticks, rows)) return LinceFalse;
+
+    // Refilled one entity at a time to rebuild the pages
+    for(uint32_t i = 0; i != rows; ++i){
+        if(ids[i] >= reg->entity_count || !LinceIsEntityActive(reg, ids[i])) return LinceFalse;
+        if(!LinceHasEntityComponent(reg, ids[i], component_id)) return LinceFalse;
+        LinceAddEntityComponent(reg, ids[i], component_id, (void*)(dense + (size_t)i * set->dense.element_size));
+    }
+    // Repeated entities overwrite their first element instead of adding one
+    if(set->entities.size != rows) return LinceFalse;
+
+    uint32_t owners = 0;
+    for(uint32_t id = 0; id != reg->entity_count; ++id){
+        if(LinceIsEntityActive(reg, id) && LinceHasEntityComponent(reg, id, component_id)) owners++;
+    }
+    if(owners != rows) return LinceFalse;
+
+    if(rows > 0) memcpy(set->ticks.data, ticks->data, sizeof(uint32_t) * rows);
+    if(fixup && rows > 0) fixup(component_id, set->dense.data, rows, LinceSnapshot_Load, user_data);
+    return LinceTrue;
+}
+
+/* Reads the entity state, tables and sparse sets into a new registry */
+static LinceBool LinceReadSnapshot(LinceSnapshotReader* reader, LinceEntityRegistry* reg,
+    const LinceSnapshotHeader* header, LinceSnapshotFixupFn fixup, void* user_data)
+{
+    uint32_t count = header->entity_count;
+    reg->entity_count = count;
+    reg->change_tick = header->change_tick;
+
+    if(!LinceReadArray(reader, &reg->entity_active, (count + 63) / 64)) return LinceFalse;
+    if(!LinceReadArray(reader, &reg->entity_masks, count)) return LinceFalse;
+    if(!LinceReadArray(reader, &reg->entity_pool, header->pool_size)) return LinceFalse;
+    for(uint32_t i = 0; i != reg->entity_pool.size; ++i){
+        uint32_t id = *(uint32_t*)array_get(&reg->entity_pool, i);
+        if(id >= count || LinceIsEntityActive(reg, id)) return LinceFalse;
+    }
+    array_resize(&reg->entity_records, count);
+    if(count > 0) memset(reg->entity_records.data, 0, sizeof(LinceEntityRecord) * count);
+
+    uint8_t* placed = LinceCalloc(count + 1);
+    LINCE_ASSERT_ALLOC(placed, count + 1);
+    array_t tables;
+    array_init(&tables, sizeof(uint32_t));
+    LinceBool ok = LinceTrue;
+    for(uint32_t a = 0; ok && a != header->archetype_count; ++a){
+        ok = LinceReadSnapshotTable(reader, reg, placed, &tables, fixup, user_data);
+    }
+    // Every active entity is in a table
+    for(uint32_t id = 0; ok && id != count; ++id){
+        ok = placed[id] || !LinceIsEntityActive(reg, id);
+    }
+    array_uninit(&tables);
+    LinceFree(placed);
+
+    array_t ticks;
+    array_init(&ticks, sizeof(uint32_t));
+    for(uint32_t c = 0; ok && c != reg->component_count; ++c){
+        if(!LinceIsSnapshotComponentSparse(reg, c)) continue;
+        ok = LinceReadSnapshotSparseSet(reader, reg, c, &ticks, fixup, user_data);
+    }
+    array_uninit(&ticks);
+    return ok;
+}
+
+LinceEntityRegistry* LinceLoadEntityRegistry(const char* path, LinceSnapshotFixupFn fixup, void* user_data){
+    LINCE_ASSERT(path, "NULL pointer");
+    LinceSnapshotReader reader = {0};
+    if(!LinceMapFile(&reader.map, path)){
+        LINCE_WARN("Failed to open entity registry '%s'", path);
+        return NULL;
+    }
+
+    const LinceSnapshotHeader* header = LinceReadBlock(&reader, sizeof(LinceSnapshotHeader));
+    if(!header || memcmp(header->magic, "LECS", 4) != 0 || header->version != LINCE_SNAPSHOT_VERSION ||
+        header->mask_words != LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT ||
+        header->component_count == 0 || header->component_count > LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT * 64)
+    {
+        LINCE_WARN("'%s' is not a compatible entity registry snapshot", path);
+        LinceUnmapFile(&reader.map);
+        return NULL;
+    }
+
+    const LinceSnapshotComponent* components = LinceReadBlock(&reader,
+        sizeof(LinceSnapshotComponent) * header->component_count);
+    LinceBool valid = components != NULL;
+    for(uint32_t i = 0; valid && i != header->component_count; ++i){
+        valid = components[i].size > 0 && components[i].storage <= LinceComponentStorage_Sparse;
+    }
+    if(!valid){
+        LINCE_WARN("Invalid components in entity registry snapshot '%s'", path);
+        LinceUnmapFile(&reader.map);
+        return NULL;
+    }
+
+    LinceComponentInfo* info = LinceMalloc(sizeof(LinceComponentInfo) * header->component_count);
+    for(uint32_t i = 0; i != header->component_count; ++i){
+        info[i] = (LinceComponentInfo){.size = components[i].size, .storage = components[i].storage};
+    }
+    LinceEntityRegistry* reg = LinceCreateEntityRegistryFromInfo(header->component_count, info);
+    LinceFree(info);
+
+    if(!LinceReadSnapshot(&reader, reg, header, fixup, user_data)){
+        LINCE_WARN("Entity registry snapshot '%s' is truncated or corrupted", path);
+        LinceDestroyEntityRegistry(reg);
+        reg = NULL;
+    }
+    LinceUnmapFile(&reader.map);
+    return reg;
+}
@@ -0,0 +1,74 @@
+/** @file snapshot.h
+* Binary snapshots of an entity registry.
+*
+* A snapshot stores the component definitions, the state of every entity,
+* and the raw data of every archetype table and sparse set in large contiguous blocks,
+* so that saving and loading are mostly plain memory copies.
+* Snapshots are loaded by mapping the file into memory.
+*
+* Components that hold pointers, such as the texture of a `LinceSprite`,
+* cannot be stored as they are. A fixup callback receives each block of components
+* before it is written and after it is read, and can e.g. replace pointers with asset IDs:
+* ```c
+* void FixupSprites(uint32_t component_id, void* components, uint32_t count, LinceSnapshotOp op, void* user_data){
+*     if(component_id != Component_Sprite) return;
+*     LinceSprite* sprites = components;
+*     for(uint32_t i = 0; i != count; ++i){
+*         if(op == LinceSnapshot_Save) sprites[i].texture = (void*)(uintptr_t)FindTextureID(sprites[i].texture);
+*         else sprites[i].texture = GetTextureByID((uintptr_t)sprites[i].texture);
+*     }
+* }
+*
+* LinceSaveEntityRegistry(reg, "level.ecs", FixupSprites, NULL);
+* LinceEntityRegistry* loaded = LinceLoadEntityRegistry("level.ecs", FixupSprites, NULL);
+* ```
+* Persistent queries are not stored, and must be created again on the loaded registry.
+*/
+
+#ifndef LINCE_SNAPSHOT_H
+#define LINCE_SNAPSHOT_H
+
+#include "lince/core/core.h"
+#include "lince/entity/entity.h"
+
+/** @brief Version of the snapshot format, increased whenever it changes */
+#define LINCE_SNAPSHOT_VERSION 1
+
+/** @enum LinceSnapshotOp
+* @brief Direction in which component data is being converted
+*/
+typedef enum LinceSnapshotOp {
+    LinceSnapshot_Save, ///< Components are about to be written. They are a copy, and may be modified.
+    LinceSnapshot_Load, ///< Components have been read into the new registry
+} LinceSnapshotOp;
+
+/** @brief Converts the pointers held by a block of components.
+* @param component_id Component in the block
+* @param components Contiguous array of components
+* @param count Number of components in the block
+* @param op Whether the components are being saved or loaded
+* @param user_data User data passed to the save or load function
+*/
+typedef void (*LinceSnapshotFixupFn)(uint32_t component_id, void* components, uint32_t count,
+    LinceSnapshotOp op, void* user_data);
+
+/** @brief Writes a registry to a binary file.
+* @param reg Entity registry
+* @param path File to write
+* @param fixup Optional callback to convert pointers in components, or NULL
+* @param user_data Passed to the callback
+* @returns False if the file could not be written
+*/
+LinceBool LinceSaveEntityRegistry(LinceEntityRegistry* reg, const char* path,
+    LinceSnapshotFixupFn fixup, void* user_data);
+
+/** @brief Creates a registry from a binary file written by `LinceSaveEntityRegistry`.
+* Entity IDs and change ticks are the same as when the registry was saved.
+* @param path File to read
+* @param fixup Optional callback to convert pointers in components, or NULL
+* @param user_data Passed to the callback
+* @returns The new registry, or NULL if the file could not be read or is not a valid snapshot
+*/
+LinceEntityRegistry* LinceLoadEntityRegistry(const char* path, LinceSnapshotFixupFn fixup, void* user_data);
+
+#endif /* LINCE_SNAPSHOT_H */
@@ -0,0 +1,202 @@
+#include "entity/system.h"
+
+/* Returns true if both masks have a component in common */
+static LinceBool LinceMasksOverlap(const uint64_t* a, const uint64_t* b){
+    for(uint32_t i = 0; i != LINCE_MAX_ENTITY_COMPONENTS_U64_COUNT; ++i){
+        if(a[i] & b[i]) return LinceTrue;
+    }
+    return LinceFalse;
+}
+
+/* Two systems conflict if either writes a component the other one uses */
+static LinceBool LinceSystemsConflict(LinceSystem* a, LinceSystem* b){
+    return LinceMasksOverlap(a->writes, b->writes) ||
+        LinceMasksOverlap(a->writes, b->reads) ||
+        LinceMasksOverlap(a->reads, b->writes);
+}
+
+static void LinceRunSystem(void* data, uint32_t worker){
+    LINCE_UNUSED(worker);
+    LinceSystem* system = data;
+    double start = LinceGetEntityClock();
+    system->on_update(system->sched->reg, system->sched->dt, system->user_data);
+    system->time_ms = LinceGetEntityClock() - start;
+}
+
+
+LinceSystemScheduler* LinceCreateSystemScheduler(LinceEntityRegistry* reg, LinceThreadPool* pool){
+    LINCE_ASSERT(reg, "NULL pointer");
+    LinceSystemScheduler* sched = LinceCalloc(sizeof(LinceSystemScheduler));
+    LINCE_ASSERT_ALLOC(sched, sizeof(LinceSystemScheduler));
+    sched->reg = reg;
+    sched->pool = pool;
+    array_init(&sched->systems, sizeof(LinceSystem));
+    return sched;
+}
+
+void LinceDestroySystemScheduler(LinceSystemScheduler* sched){
+    if(!sched) return;
+    array_uninit(&sched->systems);
+    LinceFree(sched);
+}
+
+uint32_t LinceAddSystem(LinceSystemScheduler* sched, LinceSystemDesc* desc){
+    LINCE_ASSERT(sched && desc && desc->on_update, "NULL pointer");
+
+    LinceSystem system = {
+        .sched = sched,
+        .on_update = desc->on_update,
+        .user_data = desc->user_data,
+    };
+    snprintf(system.name, sizeof(system.name), "%s",
+        desc->name ? desc->name : "System");
+
+    for(uint32_t i = 0; i != desc->read_count; ++i){
+        uint32_t id = desc->reads[i];
+        LINCE_ASSERT(id < sched->reg->component_count, "Invalid component ID");
+        system.reads[id / 64] |= (uint64_t)1 << (id % 64);
+    }
+    for(uint32_t i = 0; i != desc->write_count; ++i){
+        uint32_t id = desc->writes[i];
+        LINCE_ASSERT(id < sched->reg->component_count, "Invalid component ID");
+        system.writes[id / 64] |= (uint64_t)1 << (id % 64);
+    }
+
+    // Run after the systems added earlier that it conflicts with
+    for(uint32_t i = 0; i != sched->systems.size; ++i){
+        LinceSystem* other = array_get(&sched->systems, i);
+        if(other->stage >= system.stage && LinceSystemsConflict(&system, other)){
+            system.stage = other->stage + 1;
+        }
+    }
+    if(system.stage + 1 > sched->stage_count) sched->stage_count = system.stage + 1;
+
+    array_push_back(&sched->systems, &system);
+    return sched->systems.size - 1;
+}
+
+LinceSystem* LinceGetSystem(LinceSystemScheduler* sched, uint32_t index){
+    LINCE_ASSERT(sched, "NULL pointer");
+    return array_get(&sched->systems, index);
+}
+
+void LinceRunSystems(LinceSystemScheduler* sched, float dt){
+    LINCE_ASSERT(sched, "NULL pointer");
+    double start = LinceGetEntityClock();
+    sched->dt = dt;
+    sched->reg->locked = LinceTrue;
+
+    for(uint32_t stage = 0; stage != sched->stage_count; ++stage){
+        for(uint32_t i = 0; i != sched->systems.size; ++i){
+            LinceSystem* system = array_get(&sched->systems, i);
+            if(system->stage != stage) continue;
+            if(sched->pool) LinceSubmitTask(sched->pool, LinceRunSystem, system);
+            else LinceRunSystem(system, 0);
+        }
+        if(sched->pool) LinceWaitThreadPool(sched->pool);
+    }
+
+    sched->reg->locked = LinceFalse;
+    sched->time_ms = LinceGetEntityClock() - start;
+}
+
+void LinceLogSystemTimes(LinceSystemScheduler* sched){
+    LINCE_ASSERT(sched, "NULL pointer");
+    LINCE_INFO("Systems: %u in %u stages, %.3f ms",
+        sched->systems.size, sched->stage_count, sched->time_ms);
+    for(uint32_t i = 0; i != sched->systems.size; ++i){
+        LinceSystem* system = array_get(&sched->systems, i);
+        LINCE_INFO("  [%u] %s: %.3f ms", system->stage, system->name, system->time_ms);
+    }
+}
+
+
+/* Chunk of entities given to a thread */
+typedef struct LinceForEachTask {
+    LinceQueryIter chunk;
+    LinceParallelDesc* desc;
+    uint8_t* scratch;      // scratch memory of all threads
+} LinceForEachTask;
+
+static void LinceRunForEachTask(void* data, uint32_t worker){
+    LinceForEachTask* task = data;
+    LinceParallelDesc* desc = task->desc;
+    void* scratch = desc->scratch_size ? task->scratch + (size_t)worker * desc->scratch_size : NULL;
+    desc->for_each(&task->chunk, desc->user_data, scratch);
+}
+
+void LinceParallelForEach(LinceThreadPool* pool, LinceEntityRegistry* reg, LinceEntityQuery* query,
+    LinceForEachFn fn, void* user_data, uint32_t min_chunk)
+{
+    LinceParallelDesc desc = {.for_each = fn, .user_data = user_data, .min_chunk = min_chunk};
+    LinceParallelReduce(pool, reg, query, &desc);
+}
+
+void LinceParallelReduce(LinceThreadPool* pool, LinceEntityRegistry* reg, LinceEntityQuery* query,
+    LinceParallelDesc* desc)
+{
+    LINCE_ASSERT(reg && query && desc && desc->for_each, "NULL pointer");
+    double start = LinceGetEntityClock();
+    LinceBool was_locked = reg->locked;
+    reg->locked = LinceTrue;
+
+    uint32_t workers = pool ? LinceGetThreadPoolWorkers(pool) : 1;
+    uint8_t* scratch = NULL;
+    if(desc->scratch_size > 0) scratch = LinceCalloc((size_t)workers * desc->scratch_size);
+
+    // Count the matches to pick a chunk size that gives every thread a few chunks
+    uint32_t total = 0;
+    LinceQueryIter it;
+    // The passes over the query are counted as a single call in its statistics
+    LinceInitQueryIter(&it, reg, query);
+    it.start_ms = -1.0;
+    while(LinceNextQueryChunk(&it)) total += it.count;
+
+    uint32_t chunk_size = desc->min_chunk ? desc->min_chunk : 64;
+    uint32_t even_size = (total + workers * 4 - 1) / (workers * 4);
+    if(even_size > chunk_size) chunk_size = even_size;
+
+    if(!pool || query->sparse_ids.size > 0 || total <= chunk_size){
+        LinceForEachTask task = {.desc = desc, .scratch = scratch};
+        LinceInitQueryIter(&it, reg, query);
+        it.start_ms = -1.0;
+        while(LinceNextQueryChunk(&it)){
+            task.chunk = it;
+            LinceRunForEachTask(&task, 0);
+        }
+    } else {
+        // Split each archetype into chunks, offsetting the component pointers
+        array_t tasks;
+        array_init(&tasks, sizeof(LinceForEachTask));
+        LinceInitQueryIter(&it, reg, query);
+        it.start_ms = -1.0;
+        while(LinceNextQueryChunk(&it)){
+            for(uint32_t first = 0; first < it.count; first += chunk_size){
+                LinceForEachTask task = {.chunk = it, .desc = desc, .scratch = scratch};
+                task.chunk.count = it.count - first < chunk_size ? it.count - first : chunk_size;
+                task.chunk.entities = it.entities + first;
+                for(uint32_t i = 0; i != query->component_ids.size; ++i){
+                    task.chunk.data[i] = (uint8_t*)it.data[i] + (size_t)first * it.stride[i];
+                    task.chunk.ticks[i] = it.ticks[i] + first;
+                }
+                array_push_back(&tasks, &task);
+            }
+        }
+        // Waiting on a group lets systems that run on the pool split their own work
+        LinceTaskGroup group = {0};
+        for(uint32_t i = 0; i != tasks.size; ++i){
+            LinceSubmitGroupTask(pool, &group, LinceRunForEachTask, array_get(&tasks, i));
+        }
+        LinceWaitTaskGroup(pool, &group);
+        array_uninit(&tasks);
+    }
+
+    if(desc->reduce && scratch){
+        for(uint32_t i = 0; i != workers; ++i){
+            desc->reduce(desc->user_data, scratch + (size_t)i * desc->scratch_size);
+        }
+    }
+    LinceFree(scratch);
+    LinceRecordEntityQueryCall(query, start);
+    reg->locked = was_locked;
+}
@@ -0,0 +1,158 @@
+/** @file system.h
+* Systems are functions that update the components of an entity registry
+* every frame, and declare which components they read and write.
+*
+* A scheduler runs systems that do not conflict at the same time on a thread pool.
+* Two systems conflict if one writes a component that the other reads or writes,
+* in which case they run in the order they were added.
+*
+* Usage:
+* ```c
+* LinceSystemScheduler* sched = LinceCreateSystemScheduler(reg, pool);
+* LinceAddSystem(sched, &(LinceSystemDesc){
+*     .name = "Movement", .on_update = MoveSystem,
+*     .reads = (uint32_t[]){Component_Velocity}, .read_count = 1,
+*     .writes = (uint32_t[]){Component_Position}, .write_count = 1,
+* });
+* LinceRunSystems(sched, dt); // every frame
+* ```
+*
+* While systems run, entities cannot be created or deleted, and components cannot
+* be added or removed, since other systems may be reading the same tables.
+*/
+
+#ifndef LINCE_SYSTEM_H
+#define LINCE_SYSTEM_H
+
+#include "lince/core/core.h"
+#include "lince/core/threadpool.h"
+#include "lince/entity/entity.h"
+
+/** @brief Function that updates the components of a registry
+* @param reg Entity registry
+* @param dt Time since the last frame in milliseconds
+* @param user_data Data given when the system was added
+*/
+typedef void (*LinceSystemFn)(LinceEntityRegistry* reg, float dt, void* user_data);
+
+/** @struct LinceSystemDesc
+* @brief Definition of a system, passed to `LinceAddSystem`
+*/
+typedef struct LinceSystemDesc {
+    const char* name;          ///< Name shown in logs and statistics. Optional.
+    LinceSystemFn on_update;   ///< Called on every run
+    void* user_data;           ///< Passed to `on_update`
+    const uint32_t* reads;     ///< Components that are only read
+    uint32_t read_count;       ///< Number of components read
+    const uint32_t* writes;    ///< Components that are written
+    uint32_t write_count;      ///< Number of components written
+} LinceSystemDesc;
+
+/** @struct LinceSystem
+* @brief System added to a scheduler
+*/
+typedef struct LinceSystem {
+    struct LinceSystemScheduler* sched; ///< Scheduler that runs the system
+    char name[LINCE_NAME_MAX];  ///< Name of the system
+    LinceSystemFn on_update;    ///< Called on every run
+    void* user_data;            ///< Passed to `on_update`
+    LinceEntityMask reads;      ///< Components that are only read
+    LinceEntityMask writes;     ///< Components that are written
+    uint32_t stage;             ///< Systems in the same stage run at the same time
+    double time_ms;             ///< Time taken by the last run, in milliseconds
+} LinceSystem;
+
+/** @struct LinceSystemScheduler
+* @brief Runs systems in parallel stages.
+*
+* Each system is placed in the stage after the last system added before it
+* that it conflicts with. Stages run one after the other, and the systems in
+* a stage run at the same time, so that conflicting systems always
+* run in the order they were added.
+*/
+typedef struct LinceSystemScheduler {
+    LinceEntityRegistry* reg;  ///< Registry given to the systems
+    LinceThreadPool* pool;     ///< Threads that run the systems. Systems run serially if NULL.
+    array_t systems;           ///< array<LinceSystem> -> systems in the order they were added
+    uint32_t stage_count;      ///< Number of stages
+    float dt;                  ///< Time step of the current run
+    double time_ms;            ///< Time taken by the last run of all systems, in milliseconds
+} LinceSystemScheduler;
+
+/** @brief Creates a scheduler for the systems of a registry.
+* @param reg Entity registry
+* @param pool Threads that run the systems. Not owned by the scheduler.
+* If NULL, systems run serially on the calling thread.
+*/
+LinceSystemScheduler* LinceCreateSystemScheduler(LinceEntityRegistry* reg, LinceThreadPool* pool);
+
+/** @brief Frees a scheduler */
+void LinceDestroySystemScheduler(LinceSystemScheduler* sched);
+
+/** @brief Adds a system and returns its index in the scheduler */
+uint32_t LinceAddSystem(LinceSystemScheduler* sched, LinceSystemDesc* desc);
+
+/** @brief Returns a system by its index, e.g. to read its timings */
+LinceSystem* LinceGetSystem(LinceSystemScheduler* sched, uint32_t index);
+
+/** @brief Runs all systems once, and waits for them to finish */
+void LinceRunSystems(LinceSystemScheduler* sched, float dt);
+
+/** @brief Logs the stage and time taken by each system on its last run */
+void LinceLogSystemTimes(LinceSystemScheduler* sched);
+
+
+/** @brief Function run on a chunk of the entities of a query by `LinceParallelForEach`.
+* @param chunk Chunk of entities, with the same layout as the chunks of `LinceQueryIter`.
+*       Only the components of these entities may be accessed.
+* @param user_data Data shared by all chunks
+* @param scratch Zeroed memory of the thread running the chunk, see `LinceParallelDesc`
+*/
+typedef void (*LinceForEachFn)(LinceQueryIter* chunk, void* user_data, void* scratch);
+
+/** @brief Combines the scratch memory of one thread into the user data */
+typedef void (*LinceReduceFn)(void* user_data, void* scratch);
+
+/** @struct LinceParallelDesc
+* @brief Options of `LinceParallelReduce`
+*/
+typedef struct LinceParallelDesc {
+    LinceForEachFn for_each; ///< Called on each chunk of entities
+    void* user_data;         ///< Passed to every call
+    uint32_t min_chunk;      ///< Minimum number of entities per chunk. Defaults to 64 if zero.
+    uint32_t scratch_size;   ///< Bytes of zeroed scratch memory given to each thread
+    LinceReduceFn reduce;    ///< Called for each thread's scratch once all chunks are done. Optional.
+} LinceParallelDesc;
+
+/** @brief Runs a function on the entities of a query, split into chunks that run in parallel.
+* While it runs, the registry is locked against structural changes.
+* Queries with sparse components run serially on the calling thread.
+* @param pool Threads that run the chunks. If NULL, runs serially on the calling thread.
+* @param reg Entity registry
+* @param query Persistent query
+* @param fn Function called on each chunk, with no scratch memory
+* @param user_data Passed to every call
+* @param min_chunk Minimum number of entities per chunk. Defaults to 64 if zero.
+*
+* Example: integrating the velocities of 100k colliders
+* ```c
+* void Integrate(LinceQueryIter* chunk, void* user_data, void* scratch){
+*     LinceBoxCollider* boxes = chunk->data[0];
+*     for(uint32_t i = 0; i != chunk->count; ++i){
+*         boxes[i].x += boxes[i].dx;
+*         boxes[i].y += boxes[i].dy;
+*     }
+* }
+* LinceParallelForEach(pool, reg, box_query, Integrate, NULL, 1024);
+* ```
+*/
+void LinceParallelForEach(LinceThreadPool* pool, LinceEntityRegistry* reg, LinceEntityQuery* query,
+    LinceForEachFn fn, void* user_data, uint32_t min_chunk);
+
+/** @brief Same as `LinceParallelForEach`, with per-thread scratch memory
+* and a reduction step, e.g. to sum values over all entities without locks.
+*/
+void LinceParallelReduce(LinceThreadPool* pool, LinceEntityRegistry* reg, LinceEntityQuery* query,
+    LinceParallelDesc* desc);
+
+#endif /* LINCE_SYSTEM_H */
@@ -0,0 +1,309 @@
+#include "entity/transform.h"
+
+#include <math.h>
+#include <cglm/cglm.h>
+
+/* Rebuilds the order of the nodes so that every parent comes before its children */
+static void LinceSortTransforms(LinceTransformHierarchy* hierarchy){
+    LinceEntityRegistry* reg = hierarchy->reg;
+    array_t nodes, depths, position;
+    array_init(&nodes, sizeof(LinceTransformNode));
+    array_init(&depths, sizeof(uint32_t));
+    array_init(&position, sizeof(uint32_t));
+
+    // Gather the nodes, and map entity IDs to them
+    LinceQueryIter it;
+    LinceInitQueryIter(&it, reg, hierarchy->query);
+    while(LinceNextQueryChunk(&it)){
+        LinceTransform* transforms = it.data[0];
+        for(uint32_t i = 0; i != it.count; ++i){
+            LinceTransformNode node = {
+                .entity_id = it.entities[i],
+                .transform = &transforms[i],
+                .tick = &it.ticks[0][i],
+            };
+            array_push_back(&nodes, &node);
+        }
+    }
+    array_resize(&position, reg->entity_count);
+    if(reg->entity_count > 0) memset(position.data, 0xFF, sizeof(uint32_t) * reg->entity_count);
+    for(uint32_t i = 0; i != nodes.size; ++i){
+        LinceTransformNode* node = array_get(&nodes, i);
+        array_set(&position, &i, node->entity_id);
+    }
+
+    // Parents that are missing make their children roots
+    uint32_t max_depth = 0;
+    array_resize(&depths, nodes.size);
+    for(uint32_t i = 0; i != nodes.size; ++i){
+        uint32_t depth = 0, current = i;
+        while(1){
+            LinceTransformNode* node = array_get(&nodes, current);
+            uint32_t parent = node->transform->parent;
+            if(parent == 0 || parent - 1 >= reg->entity_count) break;
+            uint32_t next = *(uint32_t*)array_get(&position, parent - 1);
+            if(next == LINCE_TRANSFORM_NO_PARENT) break;
+            current = next;
+            depth++;
+            LINCE_ASSERT(depth <= nodes.size, "Cycle in transform hierarchy");
+        }
+        array_set(&depths, &depth, i);
+        if(depth > max_depth) max_depth = depth;
+    }
+
+    // Counting sort by depth
+    uint32_t* first = LinceCalloc(sizeof(uint32_t) * (max_depth + 2));
+    for(uint32_t i = 0; i != nodes.size; ++i) first[*(uint32_t*)array_get(&depths, i) + 1]++;
+    for(uint32_t d = 0; d != max_depth + 1; ++d) first[d + 1] += first[d];
+
+    array_resize(&hierarchy->order, nodes.size);
+    for(uint32_t i = 0; i != nodes.size; ++i){
+        uint32_t slot = first[*(uint32_t*)array_get(&depths, i)]++;
+        array_set(&hierarchy->order, array_get(&nodes, i), slot);
+        LinceTransformNode* node = array_get(&hierarchy->order, slot);
+        array_set(&position, &slot, node->entity_id);
+    }
+
+    // Link each node to the position of its parent in the new order.
+    // Missing parents are cleared, so that their IDs cannot be recycled into new parents.
+    for(uint32_t i = 0; i != hierarchy->order.size; ++i){
+        LinceTransformNode* node = array_get(&hierarchy->order, i);
+        uint32_t parent = node->transform->parent;
+        node->parent = LINCE_TRANSFORM_NO_PARENT;
+        if(parent != 0 && parent - 1 < reg->entity_count){
+            node->parent = *(uint32_t*)array_get(&position, parent - 1);
+        }
+        if(node->parent == LINCE_TRANSFORM_NO_PARENT) node->transform->parent = 0;
+    }
+
+    array_resize(&hierarchy->updated, hierarchy->order.size);
+    hierarchy->version = reg->version;
+    hierarchy->dirty = LinceFalse;
+
+    LinceFree(first);
+    array_uninit(&nodes);
+    array_uninit(&depths);
+    array_uninit(&position);
+}
+
+/* Combines a local transform with the world transform of its parent */
+static void LinceComputeWorldTransform(LinceTransform* t, LinceTransform* parent){
+    float scale = t->scale == 0.0f ? 1.0f : t->scale;
+    if(!parent){
+        t->world_x = t->x;
+        t->world_y = t->y;
+        t->world_rotation = t->rotation;
+        t->world_scale = scale;
+        return;
+    }
+    // Clockwise rotation, as with sprites
+    float angle = glm_rad(parent->world_rotation);
+    float c = cosf(angle), s = sinf(angle);
+    float x = t->x * parent->world_scale;
+    float y = t->y * parent->world_scale;
+    t->world_x = parent->world_x + x * c + y * s;
+    t->world_y = parent->world_y - x * s + y * c;
+    t->world_rotation = parent->world_rotation + t->rotation;
+    t->world_scale = parent->world_scale * scale;
+}
+
+/* Returns the parent of a transform, or LINCE_TRANSFORM_NO_PARENT if it is deleted or has no transform */
+static uint32_t LinceFindTransformParent(LinceTransformHierarchy* hierarchy, LinceTransform* t){
+    LinceEntityRegistry* reg = hierarchy->reg;
+    if(t->parent == 0 || t->parent - 1 >= reg->entity_count) return LINCE_TRANSFORM_NO_PARENT;
+    uint32_t parent = t->parent - 1;
+    if(!LinceIsEntityActive(reg, parent)) return LINCE_TRANSFORM_NO_PARENT;
+    if(!LinceHasEntityComponent(reg, parent, hierarchy->component_id)) return LINCE_TRANSFORM_NO_PARENT;
+    return parent;
+}
+
+/* Copies the position of a root from its source component,
+   if that changed since the last update or all nodes are recomputed */
+static LinceBool LinceReadTransformSource(LinceTransformHierarchy* hierarchy, LinceTransformNode* node, LinceBool all){
+    LinceEntityRegistry* reg = hierarchy->reg;
+    LinceTransformTarget* source = &hierarchy->source;
+    if(!LinceHasEntityComponent(reg, node->entity_id, source->component_id)) return LinceFalse;
+    if(!all && LinceGetEntityComponentTick(reg, node->entity_id, source->component_id) <= hierarchy->last_tick){
+        return LinceFalse;
+    }
+    uint8_t* data = LinceGetEntityComponent(reg, node->entity_id, source->component_id);
+    memcpy(&node->transform->x, data + source->x_offset, sizeof(float));
+    memcpy(&node->transform->y, data + source->y_offset, sizeof(float));
+    *node->tick = reg->change_tick;
+    return LinceTrue;
+}
+
+/* Copies a world transform into the target components of an entity */
+static void LinceWriteTransformTargets(LinceTransformHierarchy* hierarchy, LinceTransformNode* node){
+    LinceEntityRegistry* reg = hierarchy->reg;
+    LinceTransform* t = node->transform;
+    for(uint32_t i = 0; i != hierarchy->target_count; ++i){
+        LinceTransformTarget* target = &hierarchy->targets[i];
+        if(!LinceHasEntityComponent(reg, node->entity_id, target->component_id)) continue;
+        uint8_t* data = LinceGetMutableEntityComponent(reg, node->entity_id, target->component_id);
+        memcpy(data + target->x_offset, &t->world_x, sizeof(float));
+        memcpy(data + target->y_offset, &t->world_y, sizeof(float));
+        if(target->rotation_offset != LINCE_TRANSFORM_NO_FIELD){
+            memcpy(data + target->rotation_offset, &t->world_rotation, sizeof(float));
+        }
+    }
+}
+
+
+LinceTransformHierarchy* LinceCreateTransformHierarchy(LinceEntityRegistry* reg, uint32_t transform_component_id){
+    LINCE_ASSERT(reg, "NULL pointer");
+    LINCE_ASSERT(transform_component_id < reg->component_count, "Invalid component ID");
+    LINCE_ASSERT(*(uint32_t*)array_get(&reg->component_sizes, transform_component_id) == sizeof(LinceTransform),
+        "Transform component must be a LinceTransform");
+
+    LinceTransformHierarchy* hierarchy = LinceCalloc(sizeof(LinceTransformHierarchy));
+    LINCE_ASSERT_ALLOC(hierarchy, sizeof(LinceTransformHierarchy));
+    hierarchy->reg = reg;
+    hierarchy->component_id = transform_component_id;
+    hierarchy->query = LinceCreateEntityQuery(reg, 1, transform_component_id);
+    hierarchy->dirty = LinceTrue;
+    array_init(&hierarchy->order, sizeof(LinceTransformNode));
+    array_init(&hierarchy->updated, sizeof(uint8_t));
+    return hierarchy;
+}
+
+void LinceDestroyTransformHierarchy(LinceTransformHierarchy* hierarchy){
+    if(!hierarchy) return;
+    LinceDeleteEntityQuery(hierarchy->reg, hierarchy->query);
+    array_uninit(&hierarchy->order);
+    array_uninit(&hierarchy->updated);
+    LinceFree(hierarchy);
+}
+
+void LinceAddTransformTarget(LinceTransformHierarchy* hierarchy, uint32_t component_id,
+    uint32_t x_offset, uint32_t y_offset, uint32_t rotation_offset)
+{
+    LINCE_ASSERT(hierarchy, "NULL pointer");
+    LINCE_ASSERT(component_id < hierarchy->reg->component_count, "Invalid component ID");
+    LINCE_ASSERT(hierarchy->target_count < LINCE_TRANSFORM_MAX_TARGETS,
+        "Too many transform targets, max is %u", LINCE_TRANSFORM_MAX_TARGETS);
+
+    uint32_t size = *(uint32_t*)array_get(&hierarchy->reg->component_sizes, component_id);
+    LINCE_ASSERT(x_offset + sizeof(float) <= size && y_offset + sizeof(float) <= size,
+        "Transform target fields out of bounds");
+    LINCE_ASSERT(rotation_offset == LINCE_TRANSFORM_NO_FIELD || rotation_offset + sizeof(float) <= size,
+        "Transform target fields out of bounds");
+
+    hierarchy->targets[hierarchy->target_count++] = (LinceTransformTarget){
+        .component_id = component_id,
+        .x_offset = x_offset,
+        .y_offset = y_offset,
+        .rotation_offset = rotation_offset,
+    };
+    hierarchy->dirty = LinceTrue;
+}
+
+void LinceSetTransformSource(LinceTransformHierarchy* hierarchy, uint32_t component_id,
+    uint32_t x_offset, uint32_t y_offset)
+{
+    LINCE_ASSERT(hierarchy, "NULL pointer");
+    LINCE_ASSERT(component_id < hierarchy->reg->component_count, "Invalid component ID");
+    LINCE_ASSERT(component_id != hierarchy->component_id, "Transform component cannot be its own source");
+    uint32_t size = *(uint32_t*)array_get(&hierarchy->reg->component_sizes, component_id);
+    LINCE_ASSERT(x_offset + sizeof(float) <= size && y_offset + sizeof(float) <= size,
+        "Transform source fields out of bounds");
+
+    hierarchy->source = (LinceTransformTarget){
+        .component_id = component_id,
+        .x_offset = x_offset,
+        .y_offset = y_offset,
+        .rotation_offset = LINCE_TRANSFORM_NO_FIELD,
+    };
+    hierarchy->has_source = LinceTrue;
+    hierarchy->dirty = LinceTrue;
+}
+
+LinceBool LinceSetTransformParent(LinceTransformHierarchy* hierarchy, uint32_t entity_id, uint32_t parent_id){
+    LINCE_ASSERT(hierarchy, "NULL pointer");
+    LINCE_ASSERT(entity_id != parent_id, "An entity cannot be its own parent");
+    LinceEntityRegistry* reg = hierarchy->reg;
+    LinceTransform* t = LinceGetEntityComponent(reg, entity_id, hierarchy->component_id);
+    LINCE_ASSERT(t, "Entity has no transform");
+
+    // The hierarchy has no cycles, so walking up from the parent ends at a root
+    uint32_t ancestor = parent_id;
+    while(ancestor != LINCE_TRANSFORM_NO_PARENT){
+        LinceTransform* at = LinceGetEntityComponent(reg, ancestor, hierarchy->component_id);
+        LINCE_ASSERT(at, "Parent entity has no transform");
+        ancestor = LinceFindTransformParent(hierarchy, at);
+        if(ancestor == entity_id){
+            LINCE_WARN("Entity %u descends from %u and cannot be its parent", parent_id, entity_id);
+            return LinceFalse;
+        }
+    }
+
+    t = LinceGetMutableEntityComponent(reg, entity_id, hierarchy->component_id);
+    t->parent = parent_id == LINCE_TRANSFORM_NO_PARENT ? 0 : parent_id + 1;
+    hierarchy->dirty = LinceTrue;
+    return LinceTrue;
+}
+
+uint32_t LinceGetTransformParent(LinceTransformHierarchy* hierarchy, uint32_t entity_id){
+    LINCE_ASSERT(hierarchy, "NULL pointer");
+    LinceTransform* t = LinceGetEntityComponent(hierarchy->reg, entity_id, hierarchy->component_id);
+    LINCE_ASSERT(t, "Entity has no transform");
+    return LinceFindTransformParent(hierarchy, t);
+}
+
+void LinceDeleteTransformEntity(LinceTransformHierarchy* hierarchy, uint32_t entity_id){
+    LINCE_ASSERT(hierarchy, "NULL pointer");
+    LinceQueryIter it;
+    LinceInitQueryIter(&it, hierarchy->reg, hierarchy->query);
+    while(LinceNextQueryChunk(&it)){
+        LinceTransform* transforms = it.data[0];
+        for(uint32_t i = 0; i != it.count; ++i){
+            if(transforms[i].parent != entity_id + 1) continue;
+            transforms[i].parent = 0;
+            it.ticks[0][i] = hierarchy->reg->change_tick;
+        }
+    }
+    LinceDeleteEntity(hierarchy->reg, entity_id);
+    hierarchy->dirty = LinceTrue;
+}
+
+void LinceRemapTransformParents(LinceTransformHierarchy* hierarchy, array_t* remap){
+    LINCE_ASSERT(hierarchy && remap, "NULL pointer");
+    LinceQueryIter it;
+    LinceInitQueryIter(&it, hierarchy->reg, hierarchy->query);
+    while(LinceNextQueryChunk(&it)){
+        LinceTransform* transforms = it.data[0];
+        for(uint32_t i = 0; i != it.count; ++i){
+            uint32_t parent = transforms[i].parent;
+            if(parent == 0) continue;
+            uint32_t new_id = parent - 1 < remap->size ? *(uint32_t*)array_get(remap, parent - 1) : LINCE_ENTITY_REMOVED;
+            transforms[i].parent = new_id == LINCE_ENTITY_REMOVED ? 0 : new_id + 1;
+        }
+    }
+    hierarchy->dirty = LinceTrue;
+}
+
+void LinceUpdateTransforms(LinceTransformHierarchy* hierarchy){
+    LINCE_ASSERT(hierarchy, "NULL pointer");
+    LinceBool rebuilt = hierarchy->dirty || hierarchy->version != hierarchy->reg->version;
+    if(rebuilt) LinceSortTransforms(hierarchy);
+
+    // Parents come first, so their world transforms are always up to date
+    uint8_t* updated = hierarchy->updated.data;
+    hierarchy->update_count = 0;
+    for(uint32_t i = 0; i != hierarchy->order.size; ++i){
+        LinceTransformNode* node = array_get(&hierarchy->order, i);
+        LinceBool parent_updated = node->parent != LINCE_TRANSFORM_NO_PARENT && updated[node->parent];
+        LinceBool moved = hierarchy->has_source && node->parent == LINCE_TRANSFORM_NO_PARENT &&
+            LinceReadTransformSource(hierarchy, node, rebuilt);
+        updated[i] = rebuilt || parent_updated || moved || *node->tick > hierarchy->last_tick;
+        if(!updated[i]) continue;
+
+        LinceTransformNode* parent = NULL;
+        if(node->parent != LINCE_TRANSFORM_NO_PARENT) parent = array_get(&hierarchy->order, node->parent);
+        LinceComputeWorldTransform(node->transform, parent ? parent->transform : NULL);
+        LinceWriteTransformTargets(hierarchy, node);
+        hierarchy->update_count++;
+    }
+
+    hierarchy->last_tick = LinceAdvanceChangeTick(hierarchy->reg);
+}
@@ -0,0 +1,159 @@
+/** @file transform.h
+* Parent-child hierarchy of entity positions.
+*
+* Entities with a `LinceTransform` component may be attached to a parent,
+* and their position, rotation and scale are then relative to it.
+* The transform hierarchy computes the resulting world transforms in a single pass
+* over the entities sorted by depth, so that parents are always updated before their children.
+* Only the transforms that changed since the last update, and their descendants, are recomputed
+* (see `LinceGetMutableEntityComponent`).
+*
+* World transforms can also be copied into other components, such as sprites and colliders,
+* which are then moved along with their parents.
+* Conversely, roots may take their position from a component moved by other means,
+* such as a box collider moved by physics.
+*
+* Usage:
+* ```c
+* LinceTransformHierarchy* hierarchy = LinceCreateTransformHierarchy(reg, Component_Transform);
+* LinceAddTransformTarget(hierarchy, Component_Sprite,
+*     offsetof(LinceSprite, x), offsetof(LinceSprite, y), offsetof(LinceSprite, rotation));
+* LinceAddTransformTarget(hierarchy, Component_BoxCollider,
+*     offsetof(LinceBoxCollider, x), offsetof(LinceBoxCollider, y), LINCE_TRANSFORM_NO_FIELD);
+* LinceSetTransformSource(hierarchy, Component_BoxCollider,
+*     offsetof(LinceBoxCollider, x), offsetof(LinceBoxCollider, y));
+*
+* LinceAddEntityComponent(reg, sword, Component_Transform, &(LinceTransform){.x = 0.1f});
+* LinceSetTransformParent(hierarchy, sword, player);
+*
+* // Every frame, after moving the parents
+* LinceUpdateTransforms(hierarchy);
+* ```
+*/
+
+#ifndef LINCE_TRANSFORM_H
+#define LINCE_TRANSFORM_H
+
+#include "lince/core/core.h"
+#include "lince/entity/entity.h"
+
+/** @brief Parent of the entities at the root of the hierarchy */
+#define LINCE_TRANSFORM_NO_PARENT UINT32_MAX
+
+/** @brief Marks a field missing in a transform target */
+#define LINCE_TRANSFORM_NO_FIELD UINT32_MAX
+
+/** @brief Maximum number of components that receive world transforms */
+#define LINCE_TRANSFORM_MAX_TARGETS 4
+
+/** @struct LinceTransform
+* @brief Position of an entity relative to its parent, and its cached position in the world.
+* The world transform is kept as position, rotation and uniform scale rather than as a matrix,
+* as that is what sprites and colliders consume.
+*/
+typedef struct LinceTransform {
+    float x, y;             ///< Position relative to the parent, or to the world if there is none
+    float rotation;         ///< Clockwise rotation in degrees relative to the parent
+    float scale;            ///< Uniform scale relative to the parent. Zero is treated as one.
+    uint32_t parent;        ///< ID of the parent entity plus one, so that zero-initialised transforms have none.
+                            ///< Set with `LinceSetTransformParent`.
+    float world_x, world_y; ///< Position in the world, computed by `LinceUpdateTransforms`
+    float world_rotation;   ///< Rotation in the world, computed by `LinceUpdateTransforms`
+    float world_scale;      ///< Scale in the world, computed by `LinceUpdateTransforms`
+} LinceTransform;
+
+/** @struct LinceTransformTarget
+* @brief Component that receives the world transform of its entity,
+* defined by the byte offsets of its fields
+*/
+typedef struct LinceTransformTarget {
+    uint32_t component_id;    ///< Component to write to
+    uint32_t x_offset;        ///< Offset of the float that receives the world x position
+    uint32_t y_offset;        ///< Offset of the float that receives the world y position
+    uint32_t rotation_offset; ///< Offset of the float that receives the world rotation, or LINCE_TRANSFORM_NO_FIELD
+} LinceTransformTarget;
+
+/** @struct LinceTransformNode
+* @brief Entity in the depth-sorted order of the hierarchy
+*/
+typedef struct LinceTransformNode {
+    uint32_t entity_id;         ///< Entity
+    uint32_t parent;            ///< Position of the parent in the order, or LINCE_TRANSFORM_NO_PARENT
+    LinceTransform* transform;  ///< Transform component of the entity
+    uint32_t* tick;             ///< Change tick of the transform component
+} LinceTransformNode;
+
+/** @struct LinceTransformHierarchy
+* @brief Caches the order in which transforms are updated.
+* The order is rebuilt whenever the registry changes structurally or a parent is set.
+*/
+typedef struct LinceTransformHierarchy {
+    LinceEntityRegistry* reg;      ///< Registry of the entities
+    uint32_t component_id;         ///< ID of the transform component
+    LinceEntityQuery* query;       ///< Entities with transforms
+    array_t order;                 ///< array<LinceTransformNode> -> entities sorted by depth
+    array_t updated;               ///< array<uint8_t> -> whether each node was recomputed in the last update
+    uint32_t version;              ///< Registry version when the order was built
+    LinceBool dirty;               ///< Forces the order to be rebuilt
+    uint32_t last_tick;            ///< Change tick of the last update
+    uint32_t update_count;         ///< Number of transforms recomputed in the last update
+    uint32_t target_count;         ///< Number of target components
+    LinceTransformTarget targets[LINCE_TRANSFORM_MAX_TARGETS]; ///< Components that receive world transforms
+    LinceBool has_source;          ///< Whether roots take their position from a source component
+    LinceTransformTarget source;   ///< Component from which roots take their position, without rotation
+} LinceTransformHierarchy;
+
+/** @brief Creates a hierarchy for the transform components of a registry */
+LinceTransformHierarchy* LinceCreateTransformHierarchy(LinceEntityRegistry* reg, uint32_t transform_component_id);
+
+/** @brief Frees a transform hierarchy. The transform components are unaffected. */
+void LinceDestroyTransformHierarchy(LinceTransformHierarchy* hierarchy);
+
+/** @brief Copies world transforms into a component of the same entities whenever they are recomputed
+* @param hierarchy Transform hierarchy
+* @param component_id Component to write to
+* @param x_offset Byte offset of the float that receives the world x position, e.g. `offsetof(LinceSprite, x)`
+* @param y_offset Byte offset of the float that receives the world y position
+* @param rotation_offset Byte offset of the float that receives the world rotation, or LINCE_TRANSFORM_NO_FIELD
+*/
+void LinceAddTransformTarget(LinceTransformHierarchy* hierarchy, uint32_t component_id,
+    uint32_t x_offset, uint32_t y_offset, uint32_t rotation_offset);
+
+/** @brief Sets the local position of root entities from one of their components whenever it changes,
+* e.g. a box collider moved by physics. Children are unaffected, as their position is relative.
+* @param hierarchy Transform hierarchy
+* @param component_id Component to read from
+* @param x_offset Byte offset of the float with the x position, e.g. `offsetof(LinceBoxCollider, x)`
+* @param y_offset Byte offset of the float with the y position
+*/
+void LinceSetTransformSource(LinceTransformHierarchy* hierarchy, uint32_t component_id,
+    uint32_t x_offset, uint32_t y_offset);
+
+/** @brief Attaches an entity to a parent, or detaches it with LINCE_TRANSFORM_NO_PARENT.
+* Both must have a transform component.
+* Entities whose parent loses its transform, or is deleted, are detached on the next `LinceUpdateTransforms`.
+* If the ID of a deleted parent is recycled before then, its children attach to the new entity,
+* which `LinceDeleteTransformEntity` avoids.
+* @returns false if the parent descends from the entity, in which case nothing changes
+*/
+LinceBool LinceSetTransformParent(LinceTransformHierarchy* hierarchy, uint32_t entity_id, uint32_t parent_id);
+
+/** @brief Returns the parent of an entity, or LINCE_TRANSFORM_NO_PARENT */
+uint32_t LinceGetTransformParent(LinceTransformHierarchy* hierarchy, uint32_t entity_id);
+
+/** @brief Detaches the children of an entity, which become roots, and deletes it */
+void LinceDeleteTransformEntity(LinceTransformHierarchy* hierarchy, uint32_t entity_id);
+
+/** @brief Translates the parents of all transforms after the registry is compacted
+* @param hierarchy Transform hierarchy
+* @param remap Remap table filled by `LinceCompactEntityRegistry`
+*/
+void LinceRemapTransformParents(LinceTransformHierarchy* hierarchy, array_t* remap);
+
+/** @brief Recomputes the world transforms that changed, along with their descendants,
+* and copies them into the target components, which are marked as changed.
+* Ends the current change tick of the registry.
+*/
+void LinceUpdateTransforms(LinceTransformHierarchy* hierarchy);
+
+#endif /* LINCE_TRANSFORM_H */
@@ -0,0 +1,557 @@
+#include "physics/aabb_tree.h"
+#include <math.h>
+
+/* Fattened bounds that exceed a box by more than this many margins are shrunk again */
+#define LINCE_AABB_TREE_SHRINK 4.0f
+
+static LinceAABB LinceUnionAABB(const LinceAABB* a, const LinceAABB* b){
+    return (LinceAABB){
+        .min = {fminf(a->min[0], b->min[0]), fminf(a->min[1], b->min[1])},
+        .max = {fmaxf(a->max[0], b->max[0]), fmaxf(a->max[1], b->max[1])},
+    };
+}
+
+static float LincePerimeterAABB(const LinceAABB* a){
+    return 2.0f * ((a->max[0] - a->min[0]) + (a->max[1] - a->min[1]));
+}
+
+static LinceBool LinceContainsAABB(const LinceAABB* a, const LinceAABB* b){
+    return a->min[0] <= b->min[0] && a->min[1] <= b->min[1] &&
+        b->max[0] <= a->max[0] && b->max[1] <= a->max[1];
+}
+
+static LinceBool LinceOverlapsAABB(const LinceAABB* a, const LinceAABB* b){
+    return a->min[0] <= b->max[0] && b->min[0] <= a->max[0] &&
+        a->min[1] <= b->max[1] && b->min[1] <= a->max[1];
+}
+
+/* Bounds of a box, optionally over its whole displacement */
+static LinceAABB LinceGetBoxBounds(LinceBoxCollider* box, LinceBool swept){
+    float dx = swept ? box->dx : 0.0f, dy = swept ? box->dy : 0.0f;
+    return (LinceAABB){
+        .min = {fminf(box->x, box->x + dx) - box->w / 2.0f, fminf(box->y, box->y + dy) - box->h / 2.0f},
+        .max = {fmaxf(box->x, box->x + dx) + box->w / 2.0f, fmaxf(box->y, box->y + dy) + box->h / 2.0f},
+    };
+}
+
+static LinceAABB LinceFattenAABB(const LinceAABB* a, float margin){
+    return (LinceAABB){
+        .min = {a->min[0] - margin, a->min[1] - margin},
+        .max = {a->max[0] + margin, a->max[1] + margin},
+    };
+}
+
+static LinceBool LinceIsAABBTreeLeaf(LinceAABBTreeNode* node){
+    return node->children[0] == LINCE_AABB_TREE_NONE;
+}
+
+static uint32_t LinceAllocateAABBTreeNode(LinceAABBTree* tree){
+    uint32_t index;
+    if(tree->free_list == LINCE_AABB_TREE_NONE){
+        index = tree->nodes.size;
+        array_push_back(&tree->nodes, NULL);
+    } else {
+        index = tree->free_list;
+        tree->free_list = ((LinceAABBTreeNode*)array_get(&tree->nodes, index))->parent;
+    }
+    LinceAABBTreeNode* node = array_get(&tree->nodes, index);
+    *node = (LinceAABBTreeNode){
+        .parent = LINCE_AABB_TREE_NONE,
+        .children = {LINCE_AABB_TREE_NONE, LINCE_AABB_TREE_NONE},
+        .user = LINCE_AABB_TREE_NONE,
+    };
+    return index;
+}
+
+static void LinceFreeAABBTreeNode(LinceAABBTree* tree, uint32_t index){
+    LinceAABBTreeNode* node = array_get(&tree->nodes, index);
+    node->parent = tree->free_list;
+    node->height = -1;
+    tree->free_list = index;
+}
+
+/* Replaces a child of a node, or the root if the node is missing */
+static void LinceReplaceAABBTreeChild(LinceAABBTree* tree, uint32_t parent, uint32_t old_child, uint32_t new_child){
+    if(parent == LINCE_AABB_TREE_NONE){
+        tree->root = new_child;
+        return;
+    }
+    LinceAABBTreeNode* node = array_get(&tree->nodes, parent);
+    if(node->children[0] == old_child) node->children[0] = new_child;
+    else node->children[1] = new_child;
+}
+
+/* Exchanges the places of two nodes in the tree. Neither may be an ancestor of the other. */
+static void LinceSwapAABBTreeNodes(LinceAABBTreeNode* nodes, uint32_t ix, uint32_t iy){
+    uint32_t px = nodes[ix].parent, py = nodes[iy].parent;
+    LinceAABBTreeNode* x_parent = &nodes[px];
+    LinceAABBTreeNode* y_parent = &nodes[py];
+    x_parent->children[x_parent->children[0] == ix ? 0 : 1] = iy;
+    y_parent->children[y_parent->children[0] == iy ? 0 : 1] = ix;
+    nodes[ix].parent = py;
+    nodes[iy].parent = px;
+}
+
+/* Recomputes the bounds and height of a node from its children */
+static void LinceFitAABBTreeNode(LinceAABBTreeNode* nodes, uint32_t index){
+    LinceAABBTreeNode* node = &nodes[index];
+    LinceAABBTreeNode* c0 = &nodes[node->children[0]];
+    LinceAABBTreeNode* c1 = &nodes[node->children[1]];
+    node->bounds = LinceUnionAABB(&c0->bounds, &c1->bounds);
+    node->height = 1 + (c0->height > c1->height ? c0->height : c1->height);
+}
+
+/* Swaps a child of a node with a grandchild, or two grandchildren,
+   if that reduces the perimeter of the children of the node.
+   Rotations keep the tree shallow as boxes are inserted and removed in any order. */
+static void LinceRotateAABBTree(LinceAABBTree* tree, uint32_t ia){
+    LinceAABBTreeNode* nodes = tree->nodes.data;
+    LinceAABBTreeNode* a = &nodes[ia];
+    if(a->height < 2) return;
+
+    // Children b and c, and their children d, e and f, g
+    uint32_t ib = a->children[0], ic = a->children[1];
+    LinceAABBTreeNode* b = &nodes[ib];
+    LinceAABBTreeNode* c = &nodes[ic];
+    float area_b = LinceIsAABBTreeLeaf(b) ? 0.0f : LincePerimeterAABB(&b->bounds);
+    float area_c = LinceIsAABBTreeLeaf(c) ? 0.0f : LincePerimeterAABB(&c->bounds);
+    float best = area_b + area_c;
+    uint32_t swap_x = LINCE_AABB_TREE_NONE, swap_y = LINCE_AABB_TREE_NONE;
+    LinceAABB u, v;
+
+    if(!LinceIsAABBTreeLeaf(c)){
+        uint32_t iff = c->children[0], ig = c->children[1];
+        // b with f, leaving b and g under c
+        u = LinceUnionAABB(&b->bounds, &nodes[ig].bounds);
+        if(area_b + LincePerimeterAABB(&u) < best){
+            best = area_b + LincePerimeterAABB(&u);
+            swap_x = ib; swap_y = iff;
+        }
+        u = LinceUnionAABB(&b->bounds, &nodes[iff].bounds);
+        if(area_b + LincePerimeterAABB(&u) < best){
+            best = area_b + LincePerimeterAABB(&u);
+            swap_x = ib; swap_y = ig;
+        }
+    }
+    if(!LinceIsAABBTreeLeaf(b)){
+        uint32_t id = b->children[0], ie = b->children[1];
+        u = LinceUnionAABB(&c->bounds, &nodes[ie].bounds);
+        if(area_c + LincePerimeterAABB(&u) < best){
+            best = area_c + LincePerimeterAABB(&u);
+            swap_x = ic; swap_y = id;
+        }
+        u = LinceUnionAABB(&c->bounds, &nodes[id].bounds);
+        if(area_c + LincePerimeterAABB(&u) < best){
+            best = area_c + LincePerimeterAABB(&u);
+            swap_x = ic; swap_y = ie;
+        }
+        if(!LinceIsAABBTreeLeaf(c)){
+            uint32_t iff = c->children[0], ig = c->children[1];
+            // d with f or g, exchanging grandchildren between b and c
+            u = LinceUnionAABB(&nodes[iff].bounds, &nodes[ie].bounds);
+            v = LinceUnionAABB(&nodes[id].bounds, &nodes[ig].bounds);
+            if(LincePerimeterAABB(&u) + LincePerimeterAABB(&v) < best){
+                best = LincePerimeterAABB(&u) + LincePerimeterAABB(&v);
+                swap_x = id; swap_y = iff;
+            }
+            u = LinceUnionAABB(&nodes[ig].bounds, &nodes[ie].bounds);
+            v = LinceUnionAABB(&nodes[id].bounds, &nodes[iff].bounds);
+            if(LincePerimeterAABB(&u) + LincePerimeterAABB(&v) < best){
+                best = LincePerimeterAABB(&u) + LincePerimeterAABB(&v);
+                swap_x = id; swap_y = ig;
+            }
+        }
+    }
+    if(swap_x == LINCE_AABB_TREE_NONE) return;
+
+    LinceSwapAABBTreeNodes(nodes, swap_x, swap_y);
+    if(!LinceIsAABBTreeLeaf(&nodes[a->children[0]])) LinceFitAABBTreeNode(nodes, a->children[0]);
+    if(!LinceIsAABBTreeLeaf(&nodes[a->children[1]])) LinceFitAABBTreeNode(nodes, a->children[1]);
+    LinceFitAABBTreeNode(nodes, ia);
+}
+
+/* Refits and rotates the ancestors of a node.
+   Once a node keeps its bounds and height, the nodes above it are unaffected. */
+static void LinceRefitAABBTree(LinceAABBTree* tree, uint32_t index){
+    LinceAABBTreeNode* nodes = tree->nodes.data;
+    while(index != LINCE_AABB_TREE_NONE){
+        LinceAABBTreeNode old = nodes[index];
+        LinceFitAABBTreeNode(nodes, index);
+        LinceRotateAABBTree(tree, index);
+        if(old.height == nodes[index].height && memcmp(&old.bounds, &nodes[index].bounds, sizeof(LinceAABB)) == 0) return;
+        index = nodes[index].parent;
+    }
+}
+
+/* Pairs a leaf with the sibling that least increases the total perimeter of the tree */
+static void LinceInsertAABBTreeNode(LinceAABBTree* tree, uint32_t leaf){
+    if(tree->root == LINCE_AABB_TREE_NONE){
+        tree->root = leaf;
+        ((LinceAABBTreeNode*)array_get(&tree->nodes, leaf))->parent = LINCE_AABB_TREE_NONE;
+        return;
+    }
+
+    LinceAABBTreeNode* nodes = tree->nodes.data;
+    LinceAABB bounds = nodes[leaf].bounds;
+    uint32_t index = tree->root;
+    while(!LinceIsAABBTreeLeaf(&nodes[index])){
+        LinceAABBTreeNode* node = &nodes[index];
+        LinceAABB combined = LinceUnionAABB(&node->bounds, &bounds);
+        float perimeter = LincePerimeterAABB(&combined);
+        // Pairing here creates a parent, and every ancestor grows by the same amount
+        float cost = 2.0f * perimeter;
+        float inherited = 2.0f * (perimeter - LincePerimeterAABB(&node->bounds));
+
+        float child_cost[2];
+        for(int i = 0; i != 2; ++i){
+            LinceAABBTreeNode* child = &nodes[node->children[i]];
+            LinceAABB u = LinceUnionAABB(&child->bounds, &bounds);
+            child_cost[i] = LincePerimeterAABB(&u) + inherited;
+            if(!LinceIsAABBTreeLeaf(child)) child_cost[i] -= LincePerimeterAABB(&child->bounds);
+        }
+        if(cost < child_cost[0] && cost < child_cost[1]) break;
+        index = node->children[child_cost[0] < child_cost[1] ? 0 : 1];
+    }
+
+    uint32_t sibling = index;
+    uint32_t parent = LinceAllocateAABBTreeNode(tree);
+    nodes = tree->nodes.data;
+    uint32_t old_parent = nodes[sibling].parent;
+    nodes[parent].parent = old_parent;
+    nodes[parent].bounds = LinceUnionAABB(&bounds, &nodes[sibling].bounds);
+    nodes[parent].height = nodes[sibling].height + 1;
+    nodes[parent].children[0] = sibling;
+    nodes[parent].children[1] = leaf;
+    LinceReplaceAABBTreeChild(tree, old_parent, sibling, parent);
+    nodes[sibling].parent = parent;
+    nodes[leaf].parent = parent;
+
+    LinceRefitAABBTree(tree, old_parent);
+}
+
+/* Detaches a leaf, and its sibling takes the place of their parent */
+static void LinceDetachAABBTreeNode(LinceAABBTree* tree, uint32_t leaf){
+    if(tree->root == leaf){
+        tree->root = LINCE_AABB_TREE_NONE;
+        return;
+    }
+    LinceAABBTreeNode* nodes = tree->nodes.data;
+    uint32_t parent = nodes[leaf].parent;
+    uint32_t grandparent = nodes[parent].parent;
+    uint32_t sibling = nodes[parent].children[nodes[parent].children[0] == leaf ? 1 : 0];
+
+    LinceReplaceAABBTreeChild(tree, grandparent, parent, sibling);
+    nodes[sibling].parent = grandparent;
+    LinceFreeAABBTreeNode(tree, parent);
+    LinceRefitAABBTree(tree, grandparent);
+}
+
+static uint32_t LinceInsertAABBTreeBounds(LinceAABBTree* tree, LinceAABB* box, uint32_t user){
+    uint32_t leaf = LinceAllocateAABBTreeNode(tree);
+    LinceAABBTreeNode* node = array_get(&tree->nodes, leaf);
+    node->box = *box;
+    node->bounds = LinceFattenAABB(box, tree->margin);
+    node->user = user;
+    LinceInsertAABBTreeNode(tree, leaf);
+    tree->leaf_count++;
+    return leaf;
+}
+
+static LinceBool LinceMoveAABBTreeBounds(LinceAABBTree* tree, uint32_t leaf, LinceAABB* box){
+    LINCE_ASSERT(leaf < tree->nodes.size, "Invalid leaf %u", leaf);
+    LinceAABBTreeNode* node = array_get(&tree->nodes, leaf);
+    LINCE_ASSERT(node->height == 0, "Node %u is not a leaf", leaf);
+    node->box = *box;
+
+    LinceAABB loose = LinceFattenAABB(box, LINCE_AABB_TREE_SHRINK * tree->margin);
+    if(LinceContainsAABB(&node->bounds, box) && LinceContainsAABB(&loose, &node->bounds)) return LinceFalse;
+
+    LinceDetachAABBTreeNode(tree, leaf);
+    node = array_get(&tree->nodes, leaf);
+    node->bounds = LinceFattenAABB(box, tree->margin);
+    LinceInsertAABBTreeNode(tree, leaf);
+    return LinceTrue;
+}
+
+/* Returns scratch space for a depth-first traversal from the root.
+   It holds at most one pending sibling per level, plus the two children of the current node. */
+static uint32_t* LinceGetAABBTreeStack(LinceAABBTree* tree){
+    LinceAABBTreeNode* root = array_get(&tree->nodes, tree->root);
+    array_resize(&tree->stack, (uint32_t)root->height + 2);
+    uint32_t* stack = tree->stack.data;
+    stack[0] = tree->root;
+    return stack;
+}
+
+/* Appends the user values of the leaves whose box overlaps a region */
+static void LinceCollectAABBTreeLeaves(LinceAABBTree* tree, LinceAABB* region, array_t* results){
+    if(tree->root == LINCE_AABB_TREE_NONE) return;
+    LinceAABBTreeNode* nodes = tree->nodes.data;
+    uint32_t* stack = LinceGetAABBTreeStack(tree);
+    uint32_t top = 1;
+    while(top > 0){
+        LinceAABBTreeNode* node = &nodes[stack[--top]];
+        if(!LinceOverlapsAABB(&node->bounds, region)) continue;
+        if(LinceIsAABBTreeLeaf(node)){
+            if(LinceOverlapsAABB(&node->box, region)) array_push_back(results, &node->user);
+            continue;
+        }
+        stack[top++] = node->children[0];
+        stack[top++] = node->children[1];
+    }
+}
+
+/* Returns true if a ray enters a box before a given distance.
+   The distance is zero if the ray starts inside, and the axis is -1 then. */
+static LinceBool LinceRaycastAABB(const LinceAABB* b, vec2 origin, vec2 direction, float max_distance,
+    float* distance, int* axis)
+{
+    float enter = 0.0f, exit = max_distance;
+    *axis = -1;
+    for(int i = 0; i != 2; ++i){
+        if(direction[i] == 0.0f){
+            if(origin[i] < b->min[i] || origin[i] > b->max[i]) return LinceFalse;
+            continue;
+        }
+        float t0 = (b->min[i] - origin[i]) / direction[i];
+        float t1 = (b->max[i] - origin[i]) / direction[i];
+        if(t0 > t1){
+            float t = t0;
+            t0 = t1;
+            t1 = t;
+        }
+        if(t0 > enter){
+            enter = t0;
+            *axis = i;
+        }
+        if(t1 < exit) exit = t1;
+        if(enter > exit) return LinceFalse;
+    }
+    *distance = enter;
+    return LinceTrue;
+}
+
+static float LinceDistanceSquaredAABB(const LinceAABB* b, vec2 point){
+    float dx = fmaxf(fmaxf(b->min[0] - point[0], point[0] - b->max[0]), 0.0f);
+    float dy = fmaxf(fmaxf(b->min[1] - point[1], point[1] - b->max[1]), 0.0f);
+    return dx * dx + dy * dy;
+}
+
+/* Keeps the tree in sync with the boxes of a list of entities */
+static void LinceSyncAABBTree(LinceAABBTree* tree, LinceEntityRegistry* reg, array_t* entities,
+    int box_component_id, LinceBool swept)
+{
+    tree->step++;
+    for(uint32_t i = 0; i != entities->size; ++i){
+        uint32_t id = *(uint32_t*)array_get(entities, i);
+        while(tree->proxies.size <= id){
+            LinceAABBTreeProxy none = {.leaf = LINCE_AABB_TREE_NONE};
+            array_push_back(&tree->proxies, &none);
+        }
+        LinceAABBTreeProxy* proxy = array_get(&tree->proxies, id);
+        // Only the collision step writes to the boxes
+        proxy->box = swept ? LinceGetEntityBoxCollider(reg, id, box_component_id)
+                           : LinceGetEntityComponent(reg, id, box_component_id);
+        proxy->step = tree->step;
+
+        LinceAABB bounds = LinceGetBoxBounds(proxy->box, swept);
+        if(proxy->leaf == LINCE_AABB_TREE_NONE){
+            proxy->leaf = LinceInsertAABBTreeBounds(tree, &bounds, id);
+        } else if(LinceMoveAABBTreeBounds(tree, proxy->leaf, &bounds)){
+            tree->reinsert_count++;
+        }
+    }
+
+    LinceAABBTreeProxy* proxies = tree->proxies.data;
+    for(uint32_t id = 0; id != tree->proxies.size; ++id){
+        if(proxies[id].leaf == LINCE_AABB_TREE_NONE || proxies[id].step == tree->step) continue;
+        LinceRemoveAABBTreeLeaf(tree, proxies[id].leaf);
+        proxies[id].leaf = LINCE_AABB_TREE_NONE;
+        proxies[id].box = NULL;
+    }
+}
+
+
+LinceAABBTree* LinceCreateAABBTree(float margin){
+    LINCE_ASSERT(margin >= 0.0f, "Margin must not be negative");
+    LinceAABBTree* tree = LinceCalloc(sizeof(LinceAABBTree));
+    LINCE_ASSERT_ALLOC(tree, sizeof(LinceAABBTree));
+    tree->margin = margin;
+    tree->root = LINCE_AABB_TREE_NONE;
+    tree->free_list = LINCE_AABB_TREE_NONE;
+    array_init(&tree->nodes, sizeof(LinceAABBTreeNode));
+    array_init(&tree->stack, sizeof(uint32_t));
+    array_init(&tree->results, sizeof(uint32_t));
+    array_init(&tree->proxies, sizeof(LinceAABBTreeProxy));
+    return tree;
+}
+
+void LinceDestroyAABBTree(LinceAABBTree* tree){
+    if(!tree) return;
+    array_uninit(&tree->nodes);
+    array_uninit(&tree->stack);
+    array_uninit(&tree->results);
+    array_uninit(&tree->proxies);
+    LinceFree(tree);
+}
+
+uint32_t LinceInsertAABBTreeLeaf(LinceAABBTree* tree, LinceBoxCollider* box, uint32_t user){
+    LINCE_ASSERT(tree && box, "NULL pointer");
+    LinceAABB bounds = LinceGetBoxBounds(box, LinceFalse);
+    return LinceInsertAABBTreeBounds(tree, &bounds, user);
+}
+
+void LinceRemoveAABBTreeLeaf(LinceAABBTree* tree, uint32_t leaf){
+    LINCE_ASSERT(tree, "NULL pointer");
+    LINCE_ASSERT(leaf < tree->nodes.size, "Invalid leaf %u", leaf);
+    LINCE_ASSERT(((LinceAABBTreeNode*)array_get(&tree->nodes, leaf))->height == 0, "Node %u is not a leaf", leaf);
+    LinceDetachAABBTreeNode(tree, leaf);
+    LinceFreeAABBTreeNode(tree, leaf);
+    tree->leaf_count--;
+}
+
+LinceBool LinceMoveAABBTreeLeaf(LinceAABBTree* tree, uint32_t leaf, LinceBoxCollider* box){
+    LINCE_ASSERT(tree && box, "NULL pointer");
+    LinceAABB bounds = LinceGetBoxBounds(box, LinceFalse);
+    return LinceMoveAABBTreeBounds(tree, leaf, &bounds);
+}
+
+void LinceQueryAABBTreePoint(LinceAABBTree* tree, vec2 point, array_t* results){
+    LINCE_ASSERT(tree && results, "NULL pointer");
+    LinceAABB region = {.min = {point[0], point[1]}, .max = {point[0], point[1]}};
+    LinceCollectAABBTreeLeaves(tree, &region, results);
+}
+
+void LinceQueryAABBTreeRegion(LinceAABBTree* tree, vec4 bounds, array_t* results){
+    LINCE_ASSERT(tree && results, "NULL pointer");
+    LinceAABB region = {.min = {bounds[0], bounds[1]}, .max = {bounds[2], bounds[3]}};
+    LinceCollectAABBTreeLeaves(tree, &region, results);
+}
+
+LinceBool LinceRaycastAABBTree(LinceAABBTree* tree, vec2 origin, vec2 direction,
+    float max_distance, LinceAABBTreeHit* hit)
+{
+    LINCE_ASSERT(tree && hit, "NULL pointer");
+    if(tree->root == LINCE_AABB_TREE_NONE) return LinceFalse;
+
+    uint32_t best = LINCE_AABB_TREE_NONE;
+    float best_distance = max_distance, distance;
+    int best_axis = -1, axis;
+    LinceAABBTreeNode* nodes = tree->nodes.data;
+    uint32_t* stack = LinceGetAABBTreeStack(tree);
+    uint32_t top = 1;
+    while(top > 0){
+        uint32_t index = stack[--top];
+        LinceAABBTreeNode* node = &nodes[index];
+        // Branches that start beyond the closest hit so far are skipped
+        if(!LinceRaycastAABB(&node->bounds, origin, direction, best_distance, &distance, &axis)) continue;
+        if(LinceIsAABBTreeLeaf(node)){
+            if(!LinceRaycastAABB(&node->box, origin, direction, best_distance, &distance, &axis)) continue;
+            if(best != LINCE_AABB_TREE_NONE && distance >= best_distance) continue;
+            best = index;
+            best_distance = distance;
+            best_axis = axis;
+            continue;
+        }
+        stack[top++] = node->children[0];
+        stack[top++] = node->children[1];
+    }
+    if(best == LINCE_AABB_TREE_NONE) return LinceFalse;
+
+    hit->user = nodes[best].user;
+    hit->distance = best_distance;
+    hit->point[0] = origin[0] + direction[0] * best_distance;
+    hit->point[1] = origin[1] + direction[1] * best_distance;
+    hit->normal[0] = hit->normal[1] = 0.0f;
+    if(best_axis >= 0) hit->normal[best_axis] = direction[best_axis] > 0.0f ? -1.0f : 1.0f;
+    return LinceTrue;
+}
+
+uint32_t LinceQueryAABBTreeNearest(LinceAABBTree* tree, vec2 point, float max_distance, float* distance){
+    LINCE_ASSERT(tree, "NULL pointer");
+    if(tree->root == LINCE_AABB_TREE_NONE) return LINCE_AABB_TREE_NONE;
+
+    uint32_t best = LINCE_AABB_TREE_NONE;
+    float best_d2 = max_distance * max_distance;
+    LinceAABBTreeNode* nodes = tree->nodes.data;
+    uint32_t* stack = LinceGetAABBTreeStack(tree);
+    uint32_t top = 1;
+    while(top > 0){
+        uint32_t index = stack[--top];
+        LinceAABBTreeNode* node = &nodes[index];
+        if(LinceDistanceSquaredAABB(&node->bounds, point) > best_d2) continue;
+        if(LinceIsAABBTreeLeaf(node)){
+            float d2 = LinceDistanceSquaredAABB(&node->box, point);
+            if(d2 < best_d2 || (best == LINCE_AABB_TREE_NONE && d2 <= best_d2)){
+                best = index;
+                best_d2 = d2;
+            }
+            continue;
+        }
+        // The closer child is visited first, as it is more likely to shrink the search
+        uint32_t near = node->children[0], far = node->children[1];
+        if(LinceDistanceSquaredAABB(&nodes[far].bounds, point) < LinceDistanceSquaredAABB(&nodes[near].bounds, point)){
+            near = node->children[1];
+            far = node->children[0];
+        }
+        stack[top++] = far;
+        stack[top++] = near;
+    }
+    if(best == LINCE_AABB_TREE_NONE) return LINCE_AABB_TREE_NONE;
+    if(distance) *distance = sqrtf(best_d2);
+    return nodes[best].user;
+}
+
+void LinceUpdateAABBTree(LinceAABBTree* tree, LinceEntityRegistry* reg, array_t* entities, int box_component_id){
+    LINCE_ASSERT(tree && reg && entities, "NULL pointer");
+    tree->reinsert_count = 0;
+    LinceSyncAABBTree(tree, reg, entities, box_component_id, LinceFalse);
+}
+
+void LinceCalculateEntityCollisionsTree(LinceEntityRegistry* reg, array_t* entities,
+    int box_component_id, LinceAABBTree* tree)
+{
+    LINCE_ASSERT(reg && entities && tree, "NULL pointer");
+    tree->reinsert_count = 0;
+    tree->test_count = 0;
+
+    // Boxes that move earlier in the step are tested at their new position,
+    // so the leaves cover the whole displacement of the boxes during the step
+    LinceSyncAABBTree(tree, reg, entities, box_component_id, LinceTrue);
+
+    // Boxes move in the order of the entities, as with the exhaustive search
+    LinceAABBTreeProxy* proxies = tree->proxies.data;
+    for(uint32_t i = 0; i != entities->size; ++i){
+        uint32_t id = *(uint32_t*)array_get(entities, i);
+        LinceBoxCollider* box = proxies[id].box;
+        if(box->dx == 0.0f && box->dy == 0.0f) continue;
+        if(box->flags & LinceBoxCollider_Static) continue;
+
+        LinceBoxCollider xb = *box, yb = *box;
+        xb.x += box->dx;
+        yb.y += box->dy;
+        LinceBool move_x = LinceTrue, move_y = LinceTrue;
+
+        LinceAABB path = LinceGetBoxBounds(box, LinceTrue);
+        array_clear(&tree->results);
+        LinceCollectAABBTreeLeaves(tree, &path, &tree->results);
+        uint32_t* others = tree->results.data;
+        for(uint32_t j = 0; j != tree->results.size; ++j){
+            if(others[j] == id) continue;
+            LinceBoxCollider* other = proxies[others[j]].box;
+            tree->test_count++;
+            if(move_x) move_x = !LinceBoxCollides(&xb, other);
+            if(move_y) move_y = !LinceBoxCollides(&yb, other);
+            if(!move_x && !move_y) break;
+        }
+
+        LinceResolveBoxMovement(box, move_x, move_y);
+    }
+
+    // Leave the final positions in the tree for queries
+    for(uint32_t i = 0; i != entities->size; ++i){
+        uint32_t id = *(uint32_t*)array_get(entities, i);
+        LinceAABB bounds = LinceGetBoxBounds(proxies[id].box, LinceFalse);
+        if(LinceMoveAABBTreeBounds(tree, proxies[id].leaf, &bounds)) tree->reinsert_count++;
+    }
+}
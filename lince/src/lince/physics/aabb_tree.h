@@ -0,0 +1,174 @@
+/** @file aabb_tree.h
+* Dynamic bounding volume tree of axis-aligned boxes.
+*
+* Each leaf holds the bounds of one box, and each internal node the bounds of its two children,
+* so that queries skip whole branches whose bounds miss the queried region.
+* Leaves are stored with bounds fattened by a margin, and a box that moves
+* within its fattened bounds does not change the tree.
+* Boxes that leave them are removed and inserted again,
+* and nodes are rotated as the tree changes to keep the bounds of its branches small.
+*
+* The tree can be filled by hand with any boxes, identified by a user value,
+* or kept in sync with the box colliders of a registry, identified by their entity ID.
+* It then answers queries for points, regions, rays and nearest boxes,
+* and can act as the broadphase for `LinceCalculateEntityCollisions`.
+*
+* Usage:
+* ```c
+* LinceAABBTree* tree = LinceCreateAABBTree(0.1f);
+*
+* // Every frame
+* LinceFetchEntityQuery(reg, box_query, &entities);
+* LinceCalculateEntityCollisionsTree(reg, &entities, Component_BoxCollider, tree);
+*
+* // Entities under the mouse
+* vec2 mouse;
+* LinceGetMousePosWorld(mouse, camera);
+* LinceQueryAABBTreePoint(tree, mouse, &picked);
+*
+* LinceDestroyAABBTree(tree);
+* ```
+*/
+
+#ifndef LINCE_AABB_TREE_H
+#define LINCE_AABB_TREE_H
+
+#include "lince/core/core.h"
+#include "lince/containers/array.h"
+#include "lince/entity/entity.h"
+#include "lince/physics/boxcollider.h"
+#include "cglm/types.h"
+
+/** @brief Marks a missing node, leaf or result */
+#define LINCE_AABB_TREE_NONE UINT32_MAX
+
+/** @struct LinceAABB
+* @brief Axis-aligned bounds
+*/
+typedef struct LinceAABB {
+    float min[2]; ///< Lower corner
+    float max[2]; ///< Upper corner
+} LinceAABB;
+
+/** @struct LinceAABBTreeNode
+* @brief Node of the tree. Nodes without children are leaves.
+*/
+typedef struct LinceAABBTreeNode {
+    LinceAABB bounds;      ///< Bounds of the children, or fattened bounds of the box
+    LinceAABB box;         ///< Exact bounds of the box, only for leaves
+    uint32_t parent;       ///< Parent node, or next free node
+    uint32_t children[2];  ///< Child nodes, or LINCE_AABB_TREE_NONE for leaves
+    int32_t height;        ///< Zero for leaves, and -1 for free nodes
+    uint32_t user;         ///< User value of a leaf, e.g. an entity ID
+} LinceAABBTreeNode;
+
+/** @struct LinceAABBTreeProxy
+* @brief Leaf of an entity when the tree mirrors a registry
+*/
+typedef struct LinceAABBTreeProxy {
+    uint32_t leaf;         ///< Leaf of the entity, or LINCE_AABB_TREE_NONE
+    uint32_t step;         ///< Last update in which the entity was listed
+    LinceBoxCollider* box; ///< Box collider of the entity, fetched on every update
+} LinceAABBTreeProxy;
+
+/** @struct LinceAABBTreeHit
+* @brief Result of a raycast
+*/
+typedef struct LinceAABBTreeHit {
+    uint32_t user;    ///< User value of the box hit
+    float distance;   ///< Distance from the origin of the ray, in units of the direction vector
+    vec2 point;       ///< Point where the ray enters the box
+    vec2 normal;      ///< Normal of the side hit, or zero if the ray starts inside the box
+} LinceAABBTreeHit;
+
+/** @struct LinceAABBTree
+* @brief Dynamic bounding volume tree
+*/
+typedef struct LinceAABBTree {
+    array_t nodes;        ///< array<LinceAABBTreeNode> -> nodes, including free ones
+    uint32_t root;        ///< Root node, or LINCE_AABB_TREE_NONE if the tree is empty
+    uint32_t free_list;   ///< First free node, or LINCE_AABB_TREE_NONE
+    uint32_t leaf_count;  ///< Number of boxes in the tree
+    float margin;         ///< Distance by which the bounds of the leaves are fattened
+    array_t stack;        ///< array<uint32_t> -> scratch space to traverse the tree
+    array_t results;      ///< array<uint32_t> -> scratch space for the collision step
+    array_t proxies;      ///< array<LinceAABBTreeProxy> -> leaf of each entity ID
+    uint32_t step;        ///< Number of updates from a registry
+    uint32_t reinsert_count; ///< Leaves inserted again in the last update
+    uint32_t test_count;  ///< Box pairs tested in the last collision step
+} LinceAABBTree;
+
+/** @brief Creates an empty tree
+* @param margin Distance by which boxes are fattened, so that small movements do not change the tree
+*/
+LinceAABBTree* LinceCreateAABBTree(float margin);
+
+/** @brief Frees a tree. The boxes are unaffected. */
+void LinceDestroyAABBTree(LinceAABBTree* tree);
+
+/** @brief Adds a box to the tree
+* @param box Box whose current position and size are stored. Its displacement is ignored.
+* @param user Value returned by the queries for this box
+* @returns leaf of the box
+*/
+uint32_t LinceInsertAABBTreeLeaf(LinceAABBTree* tree, LinceBoxCollider* box, uint32_t user);
+
+/** @brief Removes a box from the tree */
+void LinceRemoveAABBTreeLeaf(LinceAABBTree* tree, uint32_t leaf);
+
+/** @brief Updates the bounds of a box.
+* The leaf is only inserted again if the box left its fattened bounds,
+* or if they grew much larger than the box.
+* @returns true if the leaf was inserted again
+*/
+LinceBool LinceMoveAABBTreeLeaf(LinceAABBTree* tree, uint32_t leaf, LinceBoxCollider* box);
+
+/** @brief Appends the user values of the boxes that contain a point, edges included
+* @param results array<uint32_t>
+*/
+void LinceQueryAABBTreePoint(LinceAABBTree* tree, vec2 point, array_t* results);
+
+/** @brief Appends the user values of the boxes that overlap or touch a region
+* @param bounds Region as (xmin, ymin, xmax, ymax), as returned by `LinceGetCameraBounds`
+* @param results array<uint32_t>
+*/
+void LinceQueryAABBTreeRegion(LinceAABBTree* tree, vec4 bounds, array_t* results);
+
+/** @brief Finds the first box hit by a ray
+* @param origin Start of the ray
+* @param direction Direction of the ray. It need not be normalised.
+* @param max_distance Length of the ray, in units of the direction vector
+* @param hit Filled with the closest box hit, if any
+* @returns true if a box was hit
+*/
+LinceBool LinceRaycastAABBTree(LinceAABBTree* tree, vec2 origin, vec2 direction,
+    float max_distance, LinceAABBTreeHit* hit);
+
+/** @brief Finds the box closest to a point, zero for boxes that contain it
+* @param max_distance Boxes further away than this are ignored
+* @param distance Filled with the distance to the box found, if not NULL
+* @returns user value of the box, or LINCE_AABB_TREE_NONE if none is close enough
+*/
+uint32_t LinceQueryAABBTreeNearest(LinceAABBTree* tree, vec2 point, float max_distance, float* distance);
+
+/** @brief Mirrors the box colliders of a list of entities.
+* Leaves are added for new entities, moved for known ones,
+* and removed for entities that are no longer listed. Their user value is the entity ID.
+* @param reg Entity registry
+* @param entities Entities with a box collider
+* @param box_component_id Component of type `LinceBoxCollider`
+*/
+void LinceUpdateAABBTree(LinceAABBTree* tree, LinceEntityRegistry* reg, array_t* entities, int box_component_id);
+
+/** @brief Computes collisions between box colliders like `LinceCalculateEntityCollisions`,
+* but only tests each moving box against the boxes in the tree whose bounds overlap its path.
+* The tree is updated as with `LinceUpdateAABBTree`, and holds the new positions of the boxes afterwards.
+* @param reg Entity registry
+* @param entities Entities with a box collider
+* @param box_component_id Component of type `LinceBoxCollider`
+* @param tree Tree, which keeps the leaves between steps
+*/
+void LinceCalculateEntityCollisionsTree(LinceEntityRegistry* reg, array_t* entities,
+    int box_component_id, LinceAABBTree* tree);
+
+#endif /* LINCE_AABB_TREE_H */
@@ -31,12 +31,41 @@ LinceBool LinceBoxCollides(LinceBoxCollider* rect1, LinceBoxCollider* rect2){
 }
 
 
+void LinceResolveBoxMovement(LinceBoxCollider* box, LinceBool move_x, LinceBool move_y){
+    if(move_x){
+        box->x += box->dx;
+        box->flags &= ~LinceBoxCollider_CollisionX;
+    } else {
+        box->flags |= LinceBoxCollider_CollisionX;
+        if(box->flags & LinceBoxCollider_Bounce){
+            box->dx = -box->dx;
+        }
+    }
+
+    if(move_y){
+        box->y += box->dy;
+        box->flags &= ~LinceBoxCollider_CollisionY;
+    } else {
+        box->flags |= LinceBoxCollider_CollisionY;
+        if(box->flags & LinceBoxCollider_Bounce){
+            box->dy = -box->dy;
+        }
+    }
+}
+
+LinceBoxCollider* LinceGetEntityBoxCollider(LinceEntityRegistry* reg, uint32_t entity_id, int box_component_id){
+    LinceBoxCollider* box = LinceGetEntityComponent(reg, entity_id, box_component_id);
+    if(box->flags & LinceBoxCollider_Static) return box;
+    if(box->dx == 0.0f && box->dy == 0.0f) return box;
+    return LinceGetMutableEntityComponent(reg, entity_id, box_component_id);
+}
+
 void LinceCalculateEntityCollisions(LinceEntityRegistry* reg, array_t* entities, int box_component_id){
     uint32_t query_num = entities->size;
 
     for(uint32_t i = 0; i != query_num; ++i){
         uint32_t id = *(uint32_t*)array_get(entities, i);
-        LinceBoxCollider* box1 = LinceGetEntityComponent(reg, id, box_component_id);
+        LinceBoxCollider* box1 = LinceGetEntityBoxCollider(reg, id, box_component_id);
 
         // Ignore zero-size boxes
         if( fabs(box1->dx) == 0.0f && fabs(box1->dy) == 0.0f ) continue;
@@ -58,25 +87,7 @@ void LinceCalculateEntityCollisions(LinceEntityRegistry* reg, array_t* entities,
             if(!move_x && !move_y) break;
         }
         
-        if(move_x){
-            box1->x = xb.x;
-            box1->flags &= ~LinceBoxCollider_CollisionX;
-        } else {
-            box1->flags |= LinceBoxCollider_CollisionX;
-            if(box1->flags & LinceBoxCollider_Bounce){
-                box1->dx = -box1->dx;     
-            }       
-        }
-
-        if(move_y){
-            box1->y = yb.y;
-            box1->flags &= ~LinceBoxCollider_CollisionY;
-        } else {
-            box1->flags |= LinceBoxCollider_CollisionY;
-            if(box1->flags & LinceBoxCollider_Bounce){
-                box1->dy = -box1->dy;
-            }           
-        }
+        LinceResolveBoxMovement(box1, move_x, move_y);
     }
 
 }
\ No newline at end of file
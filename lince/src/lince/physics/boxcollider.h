@@ -34,9 +34,20 @@ LinceBool LinceBoxColliderContains(LinceBoxCollider* box1, LinceBoxCollider* box
 /** @brief Returns true if two box colliders are in contact */
 LinceBool LinceBoxCollides(LinceBoxCollider* rect1, LinceBoxCollider* rect2);
 
+/** @brief Moves a box by its displacement on each axis that is free,
+* and otherwise flags a collision on that axis and, with `LinceBoxCollider_Bounce`, reverses it.
+*/
+void LinceResolveBoxMovement(LinceBoxCollider* box, LinceBool move_x, LinceBool move_y);
+
+/** @brief Returns the box collider of an entity for a collision step.
+* Boxes that will move are marked as changed, so that `LinceFetchChangedEntities` sees them.
+*/
+LinceBoxCollider* LinceGetEntityBoxCollider(LinceEntityRegistry* reg, uint32_t entity_id, int box_component_id);
+
 /** @brief Computes collisions between all entities in a registry
 * that have a BoxCollider component.
-* @todo Improve neighbour search algorithm - spatial indexing?
+* Each moving box is tested against every other box.
+* For many colliders, see `LinceCalculateEntityCollisionsHashed`.
 */
 void LinceCalculateEntityCollisions(LinceEntityRegistry* reg, array_t* entities, int box_component_id);
 
@@ -0,0 +1,219 @@
+#include "physics/collision_world.h"
+#include "core/cpu.h"
+#include <math.h>
+
+#ifdef LINCE_X86
+    #include <emmintrin.h>
+    #include <immintrin.h>
+#endif
+
+/* Edges of a moving box, at its current position
+   and displaced along each axis on its own */
+typedef struct LinceCollisionQuery {
+    float min_x, max_x, min_y, max_y;
+    float moved_min_x, moved_max_x, moved_min_y, moved_max_y;
+} LinceCollisionQuery;
+
+/* Collision kernels.
+   Each one tests a moving box against every box in the world, and returns
+   whether its path is blocked along the x axis (bit 0) and along the y axis (bit 1).
+   The box itself must have empty edges. */
+typedef uint32_t (*LinceCollisionKernel)(LinceCollisionWorld* world, const LinceCollisionQuery* q);
+
+#define LINCE_BLOCKED_X 0x1
+#define LINCE_BLOCKED_Y 0x2
+
+static uint32_t LinceTestBoxesScalar(LinceCollisionWorld* world, const LinceCollisionQuery* q){
+    uint32_t blocked = 0;
+    uint32_t i = 0;
+    for(; i != world->count; ++i){
+        LinceBool x_now = q->min_x <= world->max_x[i] && q->max_x >= world->min_x[i];
+        LinceBool y_now = q->min_y <= world->max_y[i] && q->max_y >= world->min_y[i];
+        LinceBool x_moved = q->moved_min_x <= world->max_x[i] && q->moved_max_x >= world->min_x[i];
+        LinceBool y_moved = q->moved_min_y <= world->max_y[i] && q->moved_max_y >= world->min_y[i];
+        if(x_moved && y_now) blocked |= LINCE_BLOCKED_X;
+        if(x_now && y_moved) blocked |= LINCE_BLOCKED_Y;
+        if(blocked == (LINCE_BLOCKED_X | LINCE_BLOCKED_Y)) { i++; break; }
+    }
+    world->test_count += i;
+    return blocked;
+}
+
+#ifdef LINCE_X86
+
+/* Tests four boxes per instruction.
+   The padding at the end of the arrays has empty edges and never collides. */
+LINCE_TARGET_SSE2
+static uint32_t LinceTestBoxesSSE2(LinceCollisionWorld* world, const LinceCollisionQuery* q){
+    const __m128 min_x = _mm_set1_ps(q->min_x), max_x = _mm_set1_ps(q->max_x);
+    const __m128 min_y = _mm_set1_ps(q->min_y), max_y = _mm_set1_ps(q->max_y);
+    const __m128 moved_min_x = _mm_set1_ps(q->moved_min_x), moved_max_x = _mm_set1_ps(q->moved_max_x);
+    const __m128 moved_min_y = _mm_set1_ps(q->moved_min_y), moved_max_y = _mm_set1_ps(q->moved_max_y);
+    uint32_t blocked = 0;
+    uint32_t i = 0;
+    while(i < world->count){
+        __m128 box_min_x = _mm_loadu_ps(world->min_x + i), box_max_x = _mm_loadu_ps(world->max_x + i);
+        __m128 box_min_y = _mm_loadu_ps(world->min_y + i), box_max_y = _mm_loadu_ps(world->max_y + i);
+        __m128 x_now = _mm_and_ps(_mm_cmple_ps(min_x, box_max_x), _mm_cmpge_ps(max_x, box_min_x));
+        __m128 y_now = _mm_and_ps(_mm_cmple_ps(min_y, box_max_y), _mm_cmpge_ps(max_y, box_min_y));
+        __m128 x_moved = _mm_and_ps(_mm_cmple_ps(moved_min_x, box_max_x), _mm_cmpge_ps(moved_max_x, box_min_x));
+        __m128 y_moved = _mm_and_ps(_mm_cmple_ps(moved_min_y, box_max_y), _mm_cmpge_ps(moved_max_y, box_min_y));
+        if(_mm_movemask_ps(_mm_and_ps(x_moved, y_now))) blocked |= LINCE_BLOCKED_X;
+        if(_mm_movemask_ps(_mm_and_ps(x_now, y_moved))) blocked |= LINCE_BLOCKED_Y;
+        i += 4;
+        if(blocked == (LINCE_BLOCKED_X | LINCE_BLOCKED_Y)) break;
+    }
+    world->test_count += i < world->count ? i : world->count;
+    return blocked;
+}
+
+/* Tests eight boxes per instruction. The float comparisons only need AVX,
+   which every CPU with AVX2 supports. */
+LINCE_TARGET_AVX2
+static uint32_t LinceTestBoxesAVX2(LinceCollisionWorld* world, const LinceCollisionQuery* q){
+    const __m256 min_x = _mm256_set1_ps(q->min_x), max_x = _mm256_set1_ps(q->max_x);
+    const __m256 min_y = _mm256_set1_ps(q->min_y), max_y = _mm256_set1_ps(q->max_y);
+    const __m256 moved_min_x = _mm256_set1_ps(q->moved_min_x), moved_max_x = _mm256_set1_ps(q->moved_max_x);
+    const __m256 moved_min_y = _mm256_set1_ps(q->moved_min_y), moved_max_y = _mm256_set1_ps(q->moved_max_y);
+    uint32_t blocked = 0;
+    uint32_t i = 0;
+    while(i < world->count){
+        __m256 box_min_x = _mm256_loadu_ps(world->min_x + i), box_max_x = _mm256_loadu_ps(world->max_x + i);
+        __m256 box_min_y = _mm256_loadu_ps(world->min_y + i), box_max_y = _mm256_loadu_ps(world->max_y + i);
+        __m256 x_now = _mm256_and_ps(_mm256_cmp_ps(min_x, box_max_x, _CMP_LE_OQ),
+                                     _mm256_cmp_ps(max_x, box_min_x, _CMP_GE_OQ));
+        __m256 y_now = _mm256_and_ps(_mm256_cmp_ps(min_y, box_max_y, _CMP_LE_OQ),
+                                     _mm256_cmp_ps(max_y, box_min_y, _CMP_GE_OQ));
+        __m256 x_moved = _mm256_and_ps(_mm256_cmp_ps(moved_min_x, box_max_x, _CMP_LE_OQ),
+                                       _mm256_cmp_ps(moved_max_x, box_min_x, _CMP_GE_OQ));
+        __m256 y_moved = _mm256_and_ps(_mm256_cmp_ps(moved_min_y, box_max_y, _CMP_LE_OQ),
+                                       _mm256_cmp_ps(moved_max_y, box_min_y, _CMP_GE_OQ));
+        if(_mm256_movemask_ps(_mm256_and_ps(x_moved, y_now))) blocked |= LINCE_BLOCKED_X;
+        if(_mm256_movemask_ps(_mm256_and_ps(x_now, y_moved))) blocked |= LINCE_BLOCKED_Y;
+        i += 8;
+        if(blocked == (LINCE_BLOCKED_X | LINCE_BLOCKED_Y)) break;
+    }
+    world->test_count += i < world->count ? i : world->count;
+    return blocked;
+}
+
+#endif
+
+/* Returns the fastest kernel supported by the CPU */
+static LinceCollisionKernel LinceGetCollisionKernel(){
+#ifdef LINCE_X86
+    uint32_t features = LinceGetCPUFeatures();
+    if(features & LinceCPUFeature_AVX2) return LinceTestBoxesAVX2;
+    if(features & LinceCPUFeature_SSE2) return LinceTestBoxesSSE2;
+#endif
+    return LinceTestBoxesScalar;
+}
+
+/* Computes the edges of a box the same way as `LinceBoxCollides` */
+static void LinceSetCollisionWorldEdges(LinceCollisionWorld* world, uint32_t i){
+    LinceBoxCollider* box = world->boxes + i;
+    world->min_x[i] = box->x - box->w/2.0f;
+    world->max_x[i] = box->x + box->w/2.0f;
+    world->min_y[i] = box->y - box->h/2.0f;
+    world->max_y[i] = box->y + box->h/2.0f;
+}
+
+/* Gives a box edges that no other box overlaps */
+static void LinceClearCollisionWorldEdges(LinceCollisionWorld* world, uint32_t i){
+    world->min_x[i] = INFINITY;
+    world->max_x[i] = -INFINITY;
+    world->min_y[i] = INFINITY;
+    world->max_y[i] = -INFINITY;
+}
+
+static void LinceReserveCollisionWorld(LinceCollisionWorld* world, uint32_t count){
+    if(count <= world->capacity) return;
+    uint32_t capacity = world->capacity ? world->capacity : LINCE_COLLISION_WORLD_LANES;
+    while(capacity < count) capacity *= 2;
+
+    float** edges[] = {&world->min_x, &world->min_y, &world->max_x, &world->max_y};
+    for(uint32_t i = 0; i != sizeof(edges)/sizeof(edges[0]); ++i){
+        *edges[i] = LinceRealloc(*edges[i], sizeof(float) * capacity);
+        LINCE_ASSERT_ALLOC(*edges[i], sizeof(float) * capacity);
+    }
+    world->boxes = LinceRealloc(world->boxes, sizeof(LinceBoxCollider) * capacity);
+    LINCE_ASSERT_ALLOC(world->boxes, sizeof(LinceBoxCollider) * capacity);
+    world->entity_ids = LinceRealloc(world->entity_ids, sizeof(uint32_t) * capacity);
+    LINCE_ASSERT_ALLOC(world->entity_ids, sizeof(uint32_t) * capacity);
+    world->capacity = capacity;
+}
+
+
+LinceCollisionWorld* LinceCreateCollisionWorld(void){
+    LinceCollisionWorld* world = LinceCalloc(sizeof(LinceCollisionWorld));
+    LINCE_ASSERT_ALLOC(world, sizeof(LinceCollisionWorld));
+    return world;
+}
+
+void LinceDestroyCollisionWorld(LinceCollisionWorld* world){
+    if(!world) return;
+    LinceFree(world->min_x);
+    LinceFree(world->min_y);
+    LinceFree(world->max_x);
+    LinceFree(world->max_y);
+    LinceFree(world->boxes);
+    LinceFree(world->entity_ids);
+    LinceFree(world);
+}
+
+void LinceLoadCollisionWorld(LinceCollisionWorld* world, LinceEntityRegistry* reg,
+    array_t* entities, int box_component_id)
+{
+    LINCE_ASSERT(world && reg && entities, "NULL pointer");
+    uint32_t count = entities->size;
+    LinceReserveCollisionWorld(world, count);
+    world->count = count;
+
+    for(uint32_t i = 0; i != count; ++i){
+        uint32_t id = *(uint32_t*)array_get(entities, i);
+        world->entity_ids[i] = id;
+        world->boxes[i] = *(LinceBoxCollider*)LinceGetEntityComponent(reg, id, box_component_id);
+        LinceSetCollisionWorldEdges(world, i);
+    }
+    // The kernels read whole vectors past the last box
+    for(uint32_t i = count; i != world->capacity; ++i){
+        LinceClearCollisionWorldEdges(world, i);
+    }
+}
+
+void LinceStepCollisionWorld(LinceCollisionWorld* world){
+    LINCE_ASSERT(world, "NULL pointer");
+    LinceCollisionKernel kernel = LinceGetCollisionKernel();
+    world->test_count = 0;
+
+    for(uint32_t i = 0; i != world->count; ++i){
+        LinceBoxCollider* box = world->boxes + i;
+
+        // Same as `LinceCalculateEntityCollisions`
+        if( fabs(box->dx) == 0.0f && fabs(box->dy) == 0.0f ) continue;
+        if( box->flags & LinceBoxCollider_Static ) continue;
+
+        float moved_x = box->x + box->dx, moved_y = box->y + box->dy;
+        LinceCollisionQuery q = {
+            .min_x = world->min_x[i], .max_x = world->max_x[i],
+            .min_y = world->min_y[i], .max_y = world->max_y[i],
+            .moved_min_x = moved_x - box->w/2.0f, .moved_max_x = moved_x + box->w/2.0f,
+            .moved_min_y = moved_y - box->h/2.0f, .moved_max_y = moved_y + box->h/2.0f,
+        };
+
+        // Hide the box from its own test
+        LinceClearCollisionWorldEdges(world, i);
+        uint32_t blocked = kernel(world, &q);
+
+        LinceResolveBoxMovement(box, !(blocked & LINCE_BLOCKED_X), !(blocked & LINCE_BLOCKED_Y));
+        LinceSetCollisionWorldEdges(world, i);
+    }
+}
+
+void LinceStoreCollisionWorld(LinceCollisionWorld* world, LinceEntityRegistry* reg, int box_component_id){
+    LINCE_ASSERT(world && reg, "NULL pointer");
+    for(uint32_t i = 0; i != world->count; ++i){
+        LinceBoxCollider* box = LinceGetEntityBoxCollider(reg, world->entity_ids[i], box_component_id);
+        *box = world->boxes[i];
+    }
+}
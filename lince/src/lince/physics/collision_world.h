@@ -0,0 +1,79 @@
+/** @file collision_world.h
+* Box colliders mirrored into a structure of arrays, with vectorised collision tests.
+*
+* `LinceCalculateEntityCollisions` tests boxes one pair at a time,
+* fetching each component from the registry and computing its edges on every test.
+* A collision world instead copies the colliders once per step,
+* and keeps the edges of all boxes in separate contiguous arrays.
+* A moving box is then tested against 8 boxes per instruction with AVX2, or 4 with SSE2,
+* picked at runtime with `LinceGetCPUFeatures`, and with a scalar loop otherwise.
+*
+* Every moving box is still tested against every other box, which suits dense clusters of colliders.
+* For large, sparse scenes, a broadphase such as `spatial_hash.h` does fewer tests.
+* The results are the same as with `LinceCalculateEntityCollisions`.
+*
+* Usage:
+* ```c
+* LinceCollisionWorld* world = LinceCreateCollisionWorld();
+*
+* // Every frame
+* LinceFetchEntityQuery(reg, box_query, &entities);
+* LinceLoadCollisionWorld(world, reg, &entities, Component_BoxCollider);
+* LinceStepCollisionWorld(world);
+* LinceStoreCollisionWorld(world, reg, Component_BoxCollider);
+*
+* LinceDestroyCollisionWorld(world);
+* ```
+*/
+
+#ifndef LINCE_COLLISION_WORLD_H
+#define LINCE_COLLISION_WORLD_H
+
+#include "lince/core/core.h"
+#include "lince/containers/array.h"
+#include "lince/entity/entity.h"
+#include "lince/physics/boxcollider.h"
+
+/** @brief The arrays of edges are padded to a multiple of this many boxes, which never collide */
+#define LINCE_COLLISION_WORLD_LANES 8
+
+/** @struct LinceCollisionWorld
+* @brief Copies of a set of box colliders, with their edges stored contiguously
+*/
+typedef struct LinceCollisionWorld {
+    uint32_t count;          ///< Number of boxes
+    uint32_t capacity;       ///< Boxes that fit in the arrays, a multiple of LINCE_COLLISION_WORLD_LANES
+    float* min_x;            ///< Left edge of each box
+    float* min_y;            ///< Bottom edge of each box
+    float* max_x;            ///< Right edge of each box
+    float* max_y;            ///< Top edge of each box
+    LinceBoxCollider* boxes; ///< Copies of the box colliders, with their position, displacement and flags
+    uint32_t* entity_ids;    ///< Entity of each box
+    uint64_t test_count;     ///< Box pairs tested in the last step
+} LinceCollisionWorld;
+
+/** @brief Creates an empty collision world */
+LinceCollisionWorld* LinceCreateCollisionWorld(void);
+
+/** @brief Frees a collision world. The box colliders in the registry are unaffected. */
+void LinceDestroyCollisionWorld(LinceCollisionWorld* world);
+
+/** @brief Copies the box colliders of a list of entities into the world, replacing its contents
+* @param reg Entity registry
+* @param entities Entities with a box collider
+* @param box_component_id Component of type `LinceBoxCollider`
+*/
+void LinceLoadCollisionWorld(LinceCollisionWorld* world, LinceEntityRegistry* reg,
+    array_t* entities, int box_component_id);
+
+/** @brief Moves the boxes in the world as `LinceCalculateEntityCollisions` would,
+* in the order in which they were loaded
+*/
+void LinceStepCollisionWorld(LinceCollisionWorld* world);
+
+/** @brief Writes the boxes in the world back to the components of their entities,
+* marking those that moved as changed
+*/
+void LinceStoreCollisionWorld(LinceCollisionWorld* world, LinceEntityRegistry* reg, int box_component_id);
+
+#endif /* LINCE_COLLISION_WORLD_H */
@@ -0,0 +1,210 @@
+#include "physics/spatial_hash.h"
+#include <math.h>
+
+/* Range of cells overlapped by a region, inclusive */
+typedef struct LinceCellRange {
+    int32_t x0, y0, x1, y1;
+} LinceCellRange;
+
+static void LinceInitBoxColliderCells(LinceBoxColliderCells* cells){
+    cells->mask = 0;
+    array_init(&cells->starts, sizeof(uint32_t));
+    array_init(&cells->boxes, sizeof(LinceBoxCollider*));
+    array_init(&cells->large, sizeof(LinceBoxCollider*));
+}
+
+static void LinceUninitBoxColliderCells(LinceBoxColliderCells* cells){
+    array_uninit(&cells->starts);
+    array_uninit(&cells->boxes);
+    array_uninit(&cells->large);
+}
+
+static uint32_t LinceHashCell(int32_t x, int32_t y, uint32_t mask){
+    return ((uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u) & mask;
+}
+
+/* Returns the cells overlapped by a box along its whole displacement */
+static LinceCellRange LinceGetSweptCells(LinceBoxCollider* box, float cell_size){
+    float x0 = box->x < box->x + box->dx ? box->x : box->x + box->dx;
+    float x1 = box->x > box->x + box->dx ? box->x : box->x + box->dx;
+    float y0 = box->y < box->y + box->dy ? box->y : box->y + box->dy;
+    float y1 = box->y > box->y + box->dy ? box->y : box->y + box->dy;
+    return (LinceCellRange){
+        .x0 = (int32_t)floorf((x0 - box->w / 2.0f) / cell_size),
+        .y0 = (int32_t)floorf((y0 - box->h / 2.0f) / cell_size),
+        .x1 = (int32_t)floorf((x1 + box->w / 2.0f) / cell_size),
+        .y1 = (int32_t)floorf((y1 + box->h / 2.0f) / cell_size),
+    };
+}
+
+static uint64_t LinceCountCells(LinceCellRange* r){
+    return (uint64_t)((int64_t)r->x1 - r->x0 + 1) * (uint64_t)((int64_t)r->y1 - r->y0 + 1);
+}
+
+/* Lists boxes in the buckets of the cells they may occupy during the step.
+   Dynamic boxes are inserted along their displacement, since the boxes that move
+   earlier in the step are tested at their new position. */
+static void LinceFillBoxColliderCells(LinceBoxColliderGrid* grid, LinceBoxColliderCells* cells, array_t* boxes){
+    array_clear(&cells->boxes);
+    array_clear(&cells->large);
+
+    // Count the entries to size the buckets
+    uint32_t entries = 0;
+    for(uint32_t i = 0; i != boxes->size; ++i){
+        LinceBoxCollider* box = *(LinceBoxCollider**)array_get(boxes, i);
+        LinceCellRange r = LinceGetSweptCells(box, grid->cell_size);
+        uint64_t n = LinceCountCells(&r);
+        if(n > LINCE_GRID_MAX_CELLS) array_push_back(&cells->large, &box);
+        else entries += (uint32_t)n;
+    }
+    uint32_t bucket_count = 16;
+    while(bucket_count < entries) bucket_count *= 2;
+    cells->mask = bucket_count - 1;
+
+    array_resize(&cells->starts, bucket_count + 1);
+    uint32_t* starts = cells->starts.data;
+    memset(starts, 0, sizeof(uint32_t) * (bucket_count + 1));
+    for(uint32_t i = 0; i != boxes->size; ++i){
+        LinceBoxCollider* box = *(LinceBoxCollider**)array_get(boxes, i);
+        LinceCellRange r = LinceGetSweptCells(box, grid->cell_size);
+        if(LinceCountCells(&r) > LINCE_GRID_MAX_CELLS) continue;
+        for(int32_t y = r.y0; y <= r.y1; ++y){
+            for(int32_t x = r.x0; x <= r.x1; ++x) starts[LinceHashCell(x, y, cells->mask) + 1]++;
+        }
+    }
+    for(uint32_t b = 0; b != bucket_count; ++b) starts[b + 1] += starts[b];
+
+    // Place each box after the ones already in its buckets
+    array_resize(&grid->cursor, bucket_count);
+    uint32_t* cursor = grid->cursor.data;
+    memcpy(cursor, starts, sizeof(uint32_t) * bucket_count);
+    array_resize(&cells->boxes, entries);
+    LinceBoxCollider** items = cells->boxes.data;
+    for(uint32_t i = 0; i != boxes->size; ++i){
+        LinceBoxCollider* box = *(LinceBoxCollider**)array_get(boxes, i);
+        LinceCellRange r = LinceGetSweptCells(box, grid->cell_size);
+        if(LinceCountCells(&r) > LINCE_GRID_MAX_CELLS) continue;
+        for(int32_t y = r.y0; y <= r.y1; ++y){
+            for(int32_t x = r.x0; x <= r.x1; ++x) items[cursor[LinceHashCell(x, y, cells->mask)]++] = box;
+        }
+    }
+}
+
+/* Tests the moved copies of a box against a list of boxes.
+   Returns true once the box is blocked on both axes. */
+static LinceBool LinceTestBoxes(LinceBoxColliderGrid* grid, LinceBoxCollider* box,
+    LinceBoxCollider* xb, LinceBoxCollider* yb, LinceBoxCollider** others, uint32_t count,
+    LinceBool* move_x, LinceBool* move_y)
+{
+    for(uint32_t i = 0; i != count; ++i){
+        if(others[i] == box) continue;
+        grid->test_count++;
+        if(*move_x) *move_x = !LinceBoxCollides(xb, others[i]);
+        if(*move_y) *move_y = !LinceBoxCollides(yb, others[i]);
+        if(!*move_x && !*move_y) return LinceTrue;
+    }
+    return LinceFalse;
+}
+
+/* Tests the moved copies of a box against the boxes in a range of cells */
+static LinceBool LinceTestBoxColliderCells(LinceBoxColliderGrid* grid, LinceBoxColliderCells* cells,
+    LinceBoxCollider* box, LinceBoxCollider* xb, LinceBoxCollider* yb, LinceCellRange* r,
+    LinceBool* move_x, LinceBool* move_y)
+{
+    if(LinceTestBoxes(grid, box, xb, yb, cells->large.data, cells->large.size, move_x, move_y)) return LinceTrue;
+    if(cells->boxes.size == 0) return LinceFalse;
+
+    uint32_t* starts = cells->starts.data;
+    LinceBoxCollider** items = cells->boxes.data;
+    for(int32_t y = r->y0; y <= r->y1; ++y){
+        for(int32_t x = r->x0; x <= r->x1; ++x){
+            uint32_t b = LinceHashCell(x, y, cells->mask);
+            uint32_t count = starts[b + 1] - starts[b];
+            if(count == 0) continue;
+            if(LinceTestBoxes(grid, box, xb, yb, items + starts[b], count, move_x, move_y)) return LinceTrue;
+        }
+    }
+    return LinceFalse;
+}
+
+
+LinceBoxColliderGrid* LinceCreateBoxColliderGrid(float cell_size){
+    LINCE_ASSERT(cell_size > 0.0f, "Cell size must be positive");
+    LinceBoxColliderGrid* grid = LinceCalloc(sizeof(LinceBoxColliderGrid));
+    LINCE_ASSERT_ALLOC(grid, sizeof(LinceBoxColliderGrid));
+    grid->cell_size = cell_size;
+    grid->dirty = LinceTrue;
+    array_init(&grid->static_boxes, sizeof(LinceBoxCollider*));
+    array_init(&grid->dynamic_boxes, sizeof(LinceBoxCollider*));
+    array_init(&grid->cursor, sizeof(uint32_t));
+    LinceInitBoxColliderCells(&grid->static_cells);
+    LinceInitBoxColliderCells(&grid->dynamic_cells);
+    return grid;
+}
+
+void LinceDestroyBoxColliderGrid(LinceBoxColliderGrid* grid){
+    if(!grid) return;
+    array_uninit(&grid->static_boxes);
+    array_uninit(&grid->dynamic_boxes);
+    array_uninit(&grid->cursor);
+    LinceUninitBoxColliderCells(&grid->static_cells);
+    LinceUninitBoxColliderCells(&grid->dynamic_cells);
+    LinceFree(grid);
+}
+
+void LinceInvalidateBoxColliderGrid(LinceBoxColliderGrid* grid){
+    LINCE_ASSERT(grid, "NULL pointer");
+    grid->dirty = LinceTrue;
+}
+
+void LinceCalculateEntityCollisionsHashed(LinceEntityRegistry* reg, array_t* entities,
+    int box_component_id, LinceBoxColliderGrid* grid)
+{
+    LINCE_ASSERT(reg && entities && grid, "NULL pointer");
+
+    // Component data only moves on structural changes, so static boxes can be kept by address
+    uint32_t static_count = 0;
+    array_clear(&grid->dynamic_boxes);
+    for(uint32_t i = 0; i != entities->size; ++i){
+        uint32_t id = *(uint32_t*)array_get(entities, i);
+        LinceBoxCollider* box = LinceGetEntityBoxCollider(reg, id, box_component_id);
+        if(box->flags & LinceBoxCollider_Static) static_count++;
+        else array_push_back(&grid->dynamic_boxes, &box);
+    }
+
+    if(grid->dirty || grid->version != reg->version || static_count != grid->static_boxes.size){
+        array_clear(&grid->static_boxes);
+        for(uint32_t i = 0; i != entities->size; ++i){
+            uint32_t id = *(uint32_t*)array_get(entities, i);
+            LinceBoxCollider* box = LinceGetEntityComponent(reg, id, box_component_id);
+            if(box->flags & LinceBoxCollider_Static) array_push_back(&grid->static_boxes, &box);
+        }
+        LinceFillBoxColliderCells(grid, &grid->static_cells, &grid->static_boxes);
+        grid->version = reg->version;
+        grid->dirty = LinceFalse;
+    }
+    LinceFillBoxColliderCells(grid, &grid->dynamic_cells, &grid->dynamic_boxes);
+
+    // Boxes move in the order of the entities, as with the exhaustive search
+    grid->test_count = 0;
+    for(uint32_t i = 0; i != grid->dynamic_boxes.size; ++i){
+        LinceBoxCollider* box = *(LinceBoxCollider**)array_get(&grid->dynamic_boxes, i);
+        if(box->dx == 0.0f && box->dy == 0.0f) continue;
+
+        LinceBoxCollider xb = *box, yb = *box;
+        xb.x += box->dx;
+        yb.y += box->dy;
+        LinceBool move_x = LinceTrue, move_y = LinceTrue;
+
+        LinceCellRange r = LinceGetSweptCells(box, grid->cell_size);
+        if(LinceCountCells(&r) > LINCE_GRID_MAX_CELLS){
+            if(!LinceTestBoxes(grid, box, &xb, &yb, grid->static_boxes.data, grid->static_boxes.size, &move_x, &move_y)){
+                LinceTestBoxes(grid, box, &xb, &yb, grid->dynamic_boxes.data, grid->dynamic_boxes.size, &move_x, &move_y);
+            }
+        } else if(!LinceTestBoxColliderCells(grid, &grid->static_cells, box, &xb, &yb, &r, &move_x, &move_y)){
+            LinceTestBoxColliderCells(grid, &grid->dynamic_cells, box, &xb, &yb, &r, &move_x, &move_y);
+        }
+
+        LinceResolveBoxMovement(box, move_x, move_y);
+    }
+}
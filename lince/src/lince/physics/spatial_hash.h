@@ -0,0 +1,85 @@
+/** @file spatial_hash.h
+* Broadphase for box colliders based on a spatial hash.
+*
+* Space is divided into square cells, and each box is listed in the cells it overlaps.
+* Cells are hashed into a fixed number of buckets, so that the grid is unbounded
+* and only occupied cells take up memory.
+* A moving box is then only tested against the boxes listed in the cells along its path.
+*
+* Static boxes are kept in the grid between steps, and dynamic boxes are inserted again on every step.
+* The results are the same as with `LinceCalculateEntityCollisions`.
+*
+* Usage:
+* ```c
+* // Cells a few times the size of a typical box work best
+* LinceBoxColliderGrid* grid = LinceCreateBoxColliderGrid(1.0f);
+*
+* // Every frame
+* LinceFetchEntityQuery(reg, box_query, &entities);
+* LinceCalculateEntityCollisionsHashed(reg, &entities, Component_BoxCollider, grid);
+*
+* LinceDestroyBoxColliderGrid(grid);
+* ```
+*/
+
+#ifndef LINCE_SPATIAL_HASH_H
+#define LINCE_SPATIAL_HASH_H
+
+#include "lince/core/core.h"
+#include "lince/containers/array.h"
+#include "lince/entity/entity.h"
+#include "lince/physics/boxcollider.h"
+
+/** @brief Boxes that overlap more cells than this are tested against every moving box instead */
+#define LINCE_GRID_MAX_CELLS 64
+
+/** @struct LinceBoxColliderCells
+* @brief Buckets of boxes, stored contiguously in bucket order
+*/
+typedef struct LinceBoxColliderCells {
+    uint32_t mask;    ///< Number of buckets minus one. The number of buckets is a power of two.
+    array_t starts;   ///< array<uint32_t> -> first box of each bucket, plus the end of the last one
+    array_t boxes;    ///< array<LinceBoxCollider*> -> boxes in each bucket, one entry per overlapped cell
+    array_t large;    ///< array<LinceBoxCollider*> -> boxes that overlap too many cells
+} LinceBoxColliderCells;
+
+/** @struct LinceBoxColliderGrid
+* @brief Spatial hash of the box colliders of a registry
+*/
+typedef struct LinceBoxColliderGrid {
+    float cell_size;                    ///< Width and height of the cells
+    LinceBool dirty;                    ///< Forces the static boxes to be inserted again
+    uint32_t version;                   ///< Registry version when the static boxes were inserted
+    array_t static_boxes;               ///< array<LinceBoxCollider*> -> boxes with `LinceBoxCollider_Static`
+    array_t dynamic_boxes;              ///< array<LinceBoxCollider*> -> all other boxes
+    LinceBoxColliderCells static_cells; ///< Cells of the static boxes, kept between steps
+    LinceBoxColliderCells dynamic_cells;///< Cells of the dynamic boxes, rebuilt every step
+    array_t cursor;                     ///< array<uint32_t> -> scratch space to fill the buckets
+    uint32_t test_count;                ///< Box pairs tested in the last step
+} LinceBoxColliderGrid;
+
+/** @brief Creates an empty grid
+* @param cell_size Width and height of the cells, in world units
+*/
+LinceBoxColliderGrid* LinceCreateBoxColliderGrid(float cell_size);
+
+/** @brief Frees a grid. The box colliders are unaffected. */
+void LinceDestroyBoxColliderGrid(LinceBoxColliderGrid* grid);
+
+/** @brief Inserts the static boxes again on the next step.
+* This happens automatically when the registry changes structurally
+* or the number of static boxes changes, but not when a static box is moved.
+*/
+void LinceInvalidateBoxColliderGrid(LinceBoxColliderGrid* grid);
+
+/** @brief Computes collisions between box colliders like `LinceCalculateEntityCollisions`,
+* but only tests each moving box against the boxes in the cells it moves through.
+* @param reg Entity registry
+* @param entities Entities with a box collider
+* @param box_component_id Component of type `LinceBoxCollider`
+* @param grid Spatial hash, which keeps the static boxes between steps
+*/
+void LinceCalculateEntityCollisionsHashed(LinceEntityRegistry* reg, array_t* entities,
+    int box_component_id, LinceBoxColliderGrid* grid);
+
+#endif /* LINCE_SPATIAL_HASH_H */
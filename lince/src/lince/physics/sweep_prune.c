@@ -0,0 +1,328 @@
+#include "physics/sweep_prune.h"
+#include <stdlib.h>
+
+/* Markers of the slots of the pair set. Pairs always have two different boxes, so neither is a valid pair. */
+#define PAIR_EMPTY 0
+#define PAIR_REMOVED UINT64_MAX
+
+/* Returns the key of the pair of two boxes, which does not depend on their order */
+static uint64_t LinceGetPairKey(uint32_t a, uint32_t b){
+    return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+static uint32_t LinceHashPair(uint64_t key, uint32_t capacity){
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (capacity - 1);
+}
+
+/* Re-inserts all pairs into a set with the given number of slots */
+static void LinceResizePairs(LinceSweepAndPrune* sap, uint32_t capacity){
+    uint64_t* old = sap->pairs;
+    uint32_t old_capacity = sap->pair_capacity;
+    sap->pairs = LinceCalloc(sizeof(uint64_t) * capacity);
+    LINCE_ASSERT_ALLOC(sap->pairs, sizeof(uint64_t) * capacity);
+    sap->pair_capacity = capacity;
+    sap->pair_used = sap->pair_count;
+
+    for(uint32_t i = 0; i != old_capacity; ++i){
+        if(old[i] == PAIR_EMPTY || old[i] == PAIR_REMOVED) continue;
+        uint32_t slot = LinceHashPair(old[i], capacity);
+        while(sap->pairs[slot] != PAIR_EMPTY) slot = (slot + 1) & (capacity - 1);
+        sap->pairs[slot] = old[i];
+    }
+    LinceFree(old);
+}
+
+static void LinceAddPair(LinceSweepAndPrune* sap, uint32_t a, uint32_t b){
+    // Keep at least half of the slots empty so that probing stays short
+    if((sap->pair_used + 1) * 2 > sap->pair_capacity){
+        uint32_t capacity = sap->pair_capacity;
+        while((sap->pair_count + 1) * 2 > capacity / 2) capacity *= 2;
+        LinceResizePairs(sap, capacity);
+    }
+    uint64_t key = LinceGetPairKey(a, b);
+    uint32_t slot = LinceHashPair(key, sap->pair_capacity), removed = UINT32_MAX;
+    while(sap->pairs[slot] != PAIR_EMPTY){
+        if(sap->pairs[slot] == key) return;
+        if(sap->pairs[slot] == PAIR_REMOVED && removed == UINT32_MAX) removed = slot;
+        slot = (slot + 1) & (sap->pair_capacity - 1);
+    }
+    if(removed != UINT32_MAX){
+        slot = removed;
+    } else {
+        sap->pair_used++;
+    }
+    sap->pairs[slot] = key;
+    sap->pair_count++;
+}
+
+static void LinceRemovePair(LinceSweepAndPrune* sap, uint32_t a, uint32_t b){
+    uint64_t key = LinceGetPairKey(a, b);
+    uint32_t slot = LinceHashPair(key, sap->pair_capacity);
+    while(sap->pairs[slot] != PAIR_EMPTY){
+        if(sap->pairs[slot] == key){
+            sap->pairs[slot] = PAIR_REMOVED;
+            sap->pair_count--;
+            return;
+        }
+        slot = (slot + 1) & (sap->pair_capacity - 1);
+    }
+}
+
+/* Returns true if the bounds of two boxes overlap or touch.
+   Static boxes never move, so pairs of them are not tracked. */
+static LinceBool LinceSweepBoxesOverlap(LinceSweepBox* a, LinceSweepBox* b){
+    if(a->is_static && b->is_static) return LinceFalse;
+    return a->min[0] <= b->max[0] && b->min[0] <= a->max[0] &&
+        a->min[1] <= b->max[1] && b->min[1] <= a->max[1];
+}
+
+/* Bounds of a box over its displacement, as boxes that move earlier in the step
+   are tested at their new position */
+static void LinceUpdateSweepBounds(LinceSweepBox* sb){
+    LinceBoxCollider* box = sb->box;
+    float x0 = box->x < box->x + box->dx ? box->x : box->x + box->dx;
+    float x1 = box->x > box->x + box->dx ? box->x : box->x + box->dx;
+    float y0 = box->y < box->y + box->dy ? box->y : box->y + box->dy;
+    float y1 = box->y > box->y + box->dy ? box->y : box->y + box->dy;
+    sb->min[0] = x0 - box->w / 2.0f;
+    sb->max[0] = x1 + box->w / 2.0f;
+    sb->min[1] = y0 - box->h / 2.0f;
+    sb->max[1] = y1 + box->h / 2.0f;
+}
+
+/* Lower edges go first on ties, so that touching boxes are sorted as overlapping */
+static LinceBool LinceEndpointLess(const LinceSweepEndpoint* a, const LinceSweepEndpoint* b){
+    return a->value < b->value || (a->value == b->value && !(a->key & 1) && (b->key & 1));
+}
+
+static int LinceCompareEndpoints(const void* a, const void* b){
+    if(LinceEndpointLess(a, b)) return -1;
+    if(LinceEndpointLess(b, a)) return 1;
+    return 0;
+}
+
+/* Sorts the edges along an axis, which are nearly sorted from the last step.
+   The overlap of two boxes can only change when a lower edge of one
+   passes an upper edge of the other, so their pair is checked again then. */
+static void LinceSortEndpoints(LinceSweepAndPrune* sap, uint32_t axis){
+    LinceSweepBox* boxes = sap->boxes.data;
+    LinceSweepEndpoint* ep = sap->endpoints[axis].data;
+    uint32_t count = sap->endpoints[axis].size;
+
+    for(uint32_t i = 0; i != count; ++i){
+        LinceSweepBox* sb = &boxes[ep[i].key >> 1];
+        ep[i].value = (ep[i].key & 1) ? sb->max[axis] : sb->min[axis];
+    }
+
+    for(uint32_t j = 1; j < count; ++j){
+        LinceSweepEndpoint e = ep[j];
+        uint32_t i = j;
+        while(i > 0 && LinceEndpointLess(&e, &ep[i - 1])){
+            LinceSweepEndpoint* other = &ep[i - 1];
+            uint32_t a = e.key >> 1, b = other->key >> 1;
+            if((e.key & 1) != (other->key & 1) && a != b){
+                if(LinceSweepBoxesOverlap(&boxes[a], &boxes[b])) LinceAddPair(sap, a, b);
+                else LinceRemovePair(sap, a, b);
+            }
+            ep[i] = *other;
+            i--;
+            sap->swap_count++;
+        }
+        ep[i] = e;
+    }
+}
+
+/* Drops the boxes no longer listed, sorts all edges from scratch, and finds all pairs with a single sweep */
+static void LinceRebuildSweepAndPrune(LinceSweepAndPrune* sap){
+    // Compact the boxes
+    uint32_t count = 0;
+    LinceSweepBox* boxes = sap->boxes.data;
+    uint32_t* slots = sap->slots.data;
+    for(uint32_t i = 0; i != sap->boxes.size; ++i){
+        if(boxes[i].step != sap->step){
+            slots[boxes[i].entity_id] = LINCE_SWEEP_NONE;
+            continue;
+        }
+        boxes[i].is_static = (boxes[i].box->flags & LinceBoxCollider_Static) != 0;
+        boxes[count] = boxes[i];
+        slots[boxes[count].entity_id] = count;
+        count++;
+    }
+    array_resize(&sap->boxes, count);
+
+    for(uint32_t axis = 0; axis != 2; ++axis){
+        array_resize(&sap->endpoints[axis], count * 2);
+        LinceSweepEndpoint* ep = sap->endpoints[axis].data;
+        for(uint32_t i = 0; i != count; ++i){
+            ep[2 * i]     = (LinceSweepEndpoint){.value = boxes[i].min[axis], .key = i << 1};
+            ep[2 * i + 1] = (LinceSweepEndpoint){.value = boxes[i].max[axis], .key = (i << 1) | 1};
+        }
+        if(count > 0) qsort(ep, count * 2, sizeof(LinceSweepEndpoint), LinceCompareEndpoints);
+    }
+
+    memset(sap->pairs, 0, sizeof(uint64_t) * sap->pair_capacity);
+    sap->pair_count = sap->pair_used = 0;
+
+    // Boxes overlap on x while both are open during the sweep
+    array_t active;
+    array_init(&active, sizeof(uint32_t));
+    LinceSweepEndpoint* ep = sap->endpoints[0].data;
+    for(uint32_t i = 0; i != count * 2; ++i){
+        uint32_t a = ep[i].key >> 1;
+        if(ep[i].key & 1){
+            uint32_t* open = active.data;
+            for(uint32_t j = 0; j != active.size; ++j){
+                if(open[j] != a) continue;
+                open[j] = open[active.size - 1];
+                array_pop_back(&active);
+                break;
+            }
+            continue;
+        }
+        for(uint32_t j = 0; j != active.size; ++j){
+            uint32_t b = *(uint32_t*)array_get(&active, j);
+            if(LinceSweepBoxesOverlap(&boxes[a], &boxes[b])) LinceAddPair(sap, a, b);
+        }
+        array_push_back(&active, &a);
+    }
+    array_uninit(&active);
+}
+
+/* Lists the boxes paired with each box contiguously */
+static void LinceGatherNeighbours(LinceSweepAndPrune* sap){
+    uint32_t count = sap->boxes.size;
+    array_resize(&sap->neighbour_starts, count + 1);
+    uint32_t* starts = sap->neighbour_starts.data;
+    memset(starts, 0, sizeof(uint32_t) * (count + 1));
+    for(uint32_t i = 0; i != sap->pair_capacity; ++i){
+        uint64_t key = sap->pairs[i];
+        if(key == PAIR_EMPTY || key == PAIR_REMOVED) continue;
+        starts[(key >> 32) + 1]++;
+        starts[(key & 0xFFFFFFFF) + 1]++;
+    }
+    for(uint32_t i = 0; i != count; ++i) starts[i + 1] += starts[i];
+
+    array_resize(&sap->neighbours, starts[count]);
+    uint32_t* neighbours = sap->neighbours.data;
+    for(uint32_t i = 0; i != sap->pair_capacity; ++i){
+        uint64_t key = sap->pairs[i];
+        if(key == PAIR_EMPTY || key == PAIR_REMOVED) continue;
+        uint32_t a = (uint32_t)(key >> 32), b = (uint32_t)(key & 0xFFFFFFFF);
+        neighbours[starts[a]++] = b;
+        neighbours[starts[b]++] = a;
+    }
+    // Filling advanced each start to the next one
+    for(uint32_t i = count; i != 0; --i) starts[i] = starts[i - 1];
+    starts[0] = 0;
+}
+
+
+LinceSweepAndPrune* LinceCreateSweepAndPrune(void){
+    LinceSweepAndPrune* sap = LinceCalloc(sizeof(LinceSweepAndPrune));
+    LINCE_ASSERT_ALLOC(sap, sizeof(LinceSweepAndPrune));
+    array_init(&sap->boxes, sizeof(LinceSweepBox));
+    array_init(&sap->slots, sizeof(uint32_t));
+    array_init(&sap->endpoints[0], sizeof(LinceSweepEndpoint));
+    array_init(&sap->endpoints[1], sizeof(LinceSweepEndpoint));
+    array_init(&sap->neighbour_starts, sizeof(uint32_t));
+    array_init(&sap->neighbours, sizeof(uint32_t));
+    sap->pair_capacity = 64;
+    sap->pairs = LinceCalloc(sizeof(uint64_t) * sap->pair_capacity);
+    LINCE_ASSERT_ALLOC(sap->pairs, sizeof(uint64_t) * sap->pair_capacity);
+    return sap;
+}
+
+void LinceDestroySweepAndPrune(LinceSweepAndPrune* sap){
+    if(!sap) return;
+    array_uninit(&sap->boxes);
+    array_uninit(&sap->slots);
+    array_uninit(&sap->endpoints[0]);
+    array_uninit(&sap->endpoints[1]);
+    array_uninit(&sap->neighbour_starts);
+    array_uninit(&sap->neighbours);
+    LinceFree(sap->pairs);
+    LinceFree(sap);
+}
+
+void LinceCalculateEntityCollisionsPruned(LinceEntityRegistry* reg, array_t* entities,
+    int box_component_id, LinceSweepAndPrune* sap)
+{
+    LINCE_ASSERT(reg && entities && sap, "NULL pointer");
+    sap->step++;
+    sap->swap_count = 0;
+    sap->test_count = 0;
+
+    // Track new entities, and fetch the boxes again as they may have moved in memory
+    uint32_t added = 0;
+    LinceBool rebuild = LinceFalse;
+    for(uint32_t i = 0; i != entities->size; ++i){
+        uint32_t id = *(uint32_t*)array_get(entities, i);
+        while(sap->slots.size <= id){
+            uint32_t none = LINCE_SWEEP_NONE;
+            array_push_back(&sap->slots, &none);
+        }
+        LinceBoxCollider* box = LinceGetEntityBoxCollider(reg, id, box_component_id);
+        LinceBool is_static = (box->flags & LinceBoxCollider_Static) != 0;
+        uint32_t* slot = array_get(&sap->slots, id);
+
+        if(*slot == LINCE_SWEEP_NONE){
+            *slot = sap->boxes.size;
+            LinceSweepBox sb = {.entity_id = id, .box = box, .step = sap->step, .is_static = is_static};
+            array_push_back(&sap->boxes, &sb);
+            // New edges start at the end, and are sorted into place with the others
+            LinceSweepEndpoint lower = {.key = *slot << 1}, upper = {.key = (*slot << 1) | 1};
+            for(uint32_t axis = 0; axis != 2; ++axis){
+                array_push_back(&sap->endpoints[axis], &lower);
+                array_push_back(&sap->endpoints[axis], &upper);
+            }
+            added++;
+            continue;
+        }
+        LinceSweepBox* sb = array_get(&sap->boxes, *slot);
+        sb->box = box;
+        sb->step = sap->step;
+        if(sb->is_static != is_static) rebuild = LinceTrue;
+    }
+
+    LinceSweepBox* boxes = sap->boxes.data;
+    for(uint32_t i = 0; i != sap->boxes.size; ++i){
+        if(boxes[i].step != sap->step) rebuild = LinceTrue;
+        else LinceUpdateSweepBounds(&boxes[i]);
+    }
+
+    // Many new boxes are better sorted from scratch
+    if(rebuild || added * 4 > sap->boxes.size){
+        LinceRebuildSweepAndPrune(sap);
+    } else {
+        LinceSortEndpoints(sap, 0);
+        LinceSortEndpoints(sap, 1);
+    }
+    LinceGatherNeighbours(sap);
+
+    // Boxes move in the order of the entities, as with the exhaustive search
+    boxes = sap->boxes.data;
+    uint32_t* starts = sap->neighbour_starts.data;
+    uint32_t* neighbours = sap->neighbours.data;
+    for(uint32_t i = 0; i != entities->size; ++i){
+        uint32_t id = *(uint32_t*)array_get(entities, i);
+        uint32_t slot = *(uint32_t*)array_get(&sap->slots, id);
+        LinceBoxCollider* box = boxes[slot].box;
+        if(box->dx == 0.0f && box->dy == 0.0f) continue;
+        if(box->flags & LinceBoxCollider_Static) continue;
+
+        LinceBoxCollider xb = *box, yb = *box;
+        xb.x += box->dx;
+        yb.y += box->dy;
+        LinceBool move_x = LinceTrue, move_y = LinceTrue;
+
+        for(uint32_t j = starts[slot]; j != starts[slot + 1]; ++j){
+            LinceBoxCollider* other = boxes[neighbours[j]].box;
+            sap->test_count++;
+            if(move_x) move_x = !LinceBoxCollides(&xb, other);
+            if(move_y) move_y = !LinceBoxCollides(&yb, other);
+            if(!move_x && !move_y) break;
+        }
+
+        LinceResolveBoxMovement(box, move_x, move_y);
+    }
+}
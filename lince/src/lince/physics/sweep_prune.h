@@ -0,0 +1,92 @@
+/** @file sweep_prune.h
+* Broadphase for box colliders based on sweep and prune.
+*
+* The edges of all boxes are kept sorted along the x and y axes from one step to the next.
+* As boxes usually move little between steps, the lists are nearly sorted already,
+* and an insertion sort restores them in close to linear time.
+* Whenever the edges of two boxes swap places, their overlap is checked again,
+* so that the set of overlapping pairs is updated incrementally.
+* A moving box is then only tested against the boxes it is paired with.
+*
+* It suits scenes with many slow-moving colliders better than `spatial_hash.h`,
+* which needs no tuning of cell sizes but rebuilds the cells of dynamic boxes every step.
+* The results are the same as with `LinceCalculateEntityCollisions`.
+*
+* Usage:
+* ```c
+* LinceSweepAndPrune* sap = LinceCreateSweepAndPrune();
+*
+* // Every frame
+* LinceFetchEntityQuery(reg, box_query, &entities);
+* LinceCalculateEntityCollisionsPruned(reg, &entities, Component_BoxCollider, sap);
+*
+* LinceDestroySweepAndPrune(sap);
+* ```
+*/
+
+#ifndef LINCE_SWEEP_PRUNE_H
+#define LINCE_SWEEP_PRUNE_H
+
+#include "lince/core/core.h"
+#include "lince/containers/array.h"
+#include "lince/entity/entity.h"
+#include "lince/physics/boxcollider.h"
+
+/** @struct LinceSweepEndpoint
+* @brief Lower or upper edge of a box along one axis
+*/
+typedef struct LinceSweepEndpoint {
+    float value;    ///< Coordinate of the edge
+    uint32_t key;   ///< Index of the box shifted left by one, plus one if it is the upper edge
+} LinceSweepEndpoint;
+
+/** @struct LinceSweepBox
+* @brief Box tracked by the broadphase
+*/
+typedef struct LinceSweepBox {
+    uint32_t entity_id;     ///< Entity of the box
+    LinceBoxCollider* box;  ///< Box collider, fetched again on every step
+    float min[2], max[2];   ///< Bounds of the box over its whole displacement
+    uint32_t step;          ///< Last step in which the entity was listed
+    LinceBool is_static;    ///< Whether the box had `LinceBoxCollider_Static` when it was paired
+} LinceSweepBox;
+
+/** @struct LinceSweepAndPrune
+* @brief Sorted edges and overlapping pairs of a set of boxes, kept between steps
+*/
+typedef struct LinceSweepAndPrune {
+    array_t boxes;           ///< array<LinceSweepBox> -> tracked boxes
+    array_t slots;           ///< array<uint32_t> -> index of the box of each entity ID, or LINCE_SWEEP_NONE
+    array_t endpoints[2];    ///< array<LinceSweepEndpoint> -> edges of the boxes sorted along x and y
+    uint64_t* pairs;         ///< Open-addressing set of overlapping pairs, as two box indices
+    uint32_t pair_capacity;  ///< Slots in the pair set, a power of two
+    uint32_t pair_count;     ///< Pairs in the set
+    uint32_t pair_used;      ///< Slots in the set that are not empty, including removed pairs
+    array_t neighbour_starts;///< array<uint32_t> -> first neighbour of each box in the current step
+    array_t neighbours;      ///< array<uint32_t> -> boxes paired with each box in the current step
+    uint32_t step;           ///< Number of steps computed
+    uint32_t swap_count;     ///< Edges swapped by the sort in the last step
+    uint32_t test_count;     ///< Box pairs tested in the last step
+} LinceSweepAndPrune;
+
+/** @brief Marks an entity without a box in the broadphase */
+#define LINCE_SWEEP_NONE UINT32_MAX
+
+/** @brief Creates an empty sweep and prune broadphase */
+LinceSweepAndPrune* LinceCreateSweepAndPrune(void);
+
+/** @brief Frees a sweep and prune broadphase. The box colliders are unaffected. */
+void LinceDestroySweepAndPrune(LinceSweepAndPrune* sap);
+
+/** @brief Computes collisions between box colliders like `LinceCalculateEntityCollisions`,
+* but only tests each moving box against the boxes whose bounds overlap with it.
+* Entities that are no longer listed are removed from the broadphase.
+* @param reg Entity registry
+* @param entities Entities with a box collider
+* @param box_component_id Component of type `LinceBoxCollider`
+* @param sap Broadphase, which keeps the sorted edges and pairs between steps
+*/
+void LinceCalculateEntityCollisionsPruned(LinceEntityRegistry* reg, array_t* entities,
+    int box_component_id, LinceSweepAndPrune* sap);
+
+#endif /* LINCE_SWEEP_PRUNE_H */
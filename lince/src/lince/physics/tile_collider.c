@@ -0,0 +1,172 @@
+#include "physics/tile_collider.h"
+
+static LinceBool LinceIsTileSolid(LinceTileColliders* tc, uint32_t tile){
+    return tile < tc->solid_tiles.size && *(LinceBool*)array_get(&tc->solid_tiles, tile);
+}
+
+/* Returns true if a cell is solid and not yet covered by a rectangle */
+static LinceBool LinceIsCellFree(LinceTileColliders* tc, uint32_t col, uint32_t row){
+    uint32_t cell = row * tc->width + col;
+    return tc->solid[cell] && tc->owner[cell] == LINCE_TILE_RECT_NONE;
+}
+
+static void LinceSetRectOwner(LinceTileColliders* tc, LinceTileRect* rect, uint32_t owner){
+    for(uint32_t row = rect->row; row != rect->row + rect->h; ++row){
+        for(uint32_t col = rect->col; col != rect->col + rect->w; ++col){
+            tc->owner[row * tc->width + col] = owner;
+        }
+    }
+}
+
+static void LinceAddTileRect(LinceTileColliders* tc, LinceTileRect rect){
+    rect.entity_id = LINCE_TILE_RECT_NONE;
+    if(tc->reg){
+        LinceBoxCollider box = LinceGetTileRectCollider(tc, &rect);
+        rect.entity_id = LinceCreateEntity(tc->reg);
+        LinceAddEntityComponent(tc->reg, rect.entity_id, tc->box_component_id, &box);
+    }
+    LinceSetRectOwner(tc, &rect, tc->rects.size);
+    array_push_back(&tc->rects, &rect);
+}
+
+/* Removes a rectangle, and moves the last one to its place */
+static void LinceRemoveTileRect(LinceTileColliders* tc, uint32_t index){
+    LinceTileRect* rect = array_get(&tc->rects, index);
+    LinceSetRectOwner(tc, rect, LINCE_TILE_RECT_NONE);
+    if(rect->entity_id != LINCE_TILE_RECT_NONE) LinceDeleteEntity(tc->reg, rect->entity_id);
+
+    uint32_t last = tc->rects.size - 1;
+    if(index != last){
+        *rect = *(LinceTileRect*)array_get(&tc->rects, last);
+        LinceSetRectOwner(tc, rect, index);
+    }
+    array_pop_back(&tc->rects);
+}
+
+/* Removes the rectangle covering a cell, if any, and grows a region
+   (first column, first row, last column + 1, last row + 1) to include it */
+static void LinceTakeApartTileRect(LinceTileColliders* tc, uint32_t col, uint32_t row, uint32_t region[4]){
+    uint32_t owner = tc->owner[row * tc->width + col];
+    if(owner == LINCE_TILE_RECT_NONE) return;
+    LinceTileRect* rect = array_get(&tc->rects, owner);
+    if(rect->col < region[0]) region[0] = rect->col;
+    if(rect->row < region[1]) region[1] = rect->row;
+    if(rect->col + rect->w > region[2]) region[2] = rect->col + rect->w;
+    if(rect->row + rect->h > region[3]) region[3] = rect->row + rect->h;
+    LinceRemoveTileRect(tc, owner);
+}
+
+/* Covers the free cells in a region of the grid with rectangles.
+   Each rectangle grows right from the first free cell in reading order,
+   and then down while the whole row below is free. */
+static void LinceMeshTileRegion(LinceTileColliders* tc, uint32_t col0, uint32_t row0, uint32_t col1, uint32_t row1){
+    for(uint32_t row = row0; row != row1; ++row){
+        for(uint32_t col = col0; col != col1; ++col){
+            if(!LinceIsCellFree(tc, col, row)) continue;
+
+            uint32_t w = 1, h = 1;
+            while(col + w != col1 && LinceIsCellFree(tc, col + w, row)) w++;
+            for(; row + h != row1; ++h){
+                uint32_t i = 0;
+                while(i != w && LinceIsCellFree(tc, col + i, row + h)) i++;
+                if(i != w) break;
+            }
+            LinceAddTileRect(tc, (LinceTileRect){.col = col, .row = row, .w = w, .h = h});
+            col += w - 1;
+        }
+    }
+}
+
+
+void LinceInitTileColliders(LinceTileColliders* tc, LinceTilemap* map,
+    const LinceBool* solid_tiles, uint32_t tile_count,
+    LinceEntityRegistry* reg, int box_component_id)
+{
+    LINCE_ASSERT(tc && map && map->grid, "NULL pointer");
+    LINCE_ASSERT(solid_tiles || tile_count == 0, "NULL pointer");
+    LINCE_ASSERT(map->width > 0 && map->height > 0, "Map size must be greater than zero");
+
+    *tc = (LinceTileColliders){
+        .width = map->width, .height = map->height,
+        .offset = {map->offset[0], map->offset[1]},
+        .scale = {map->scale[0], map->scale[1]},
+        .reg = reg, .box_component_id = box_component_id,
+    };
+    // Same default scale as `LinceInitTilemap`
+    if(tc->scale[0] < 1e-7f) tc->scale[0] = 1.0f;
+    if(tc->scale[1] < 1e-7f) tc->scale[1] = 1.0f;
+
+    array_init(&tc->solid_tiles, sizeof(LinceBool));
+    array_resize(&tc->solid_tiles, tile_count);
+    if(tile_count > 0) memcpy(tc->solid_tiles.data, solid_tiles, sizeof(LinceBool) * tile_count);
+    array_init(&tc->rects, sizeof(LinceTileRect));
+
+    uint32_t cell_count = map->width * map->height;
+    tc->solid = LinceMalloc(sizeof(uint8_t) * cell_count);
+    LINCE_ASSERT_ALLOC(tc->solid, sizeof(uint8_t) * cell_count);
+    tc->owner = LinceMalloc(sizeof(uint32_t) * cell_count);
+    LINCE_ASSERT_ALLOC(tc->owner, sizeof(uint32_t) * cell_count);
+    for(uint32_t i = 0; i != cell_count; ++i){
+        tc->solid[i] = LinceIsTileSolid(tc, map->grid[i]);
+        tc->owner[i] = LINCE_TILE_RECT_NONE;
+    }
+    LinceMeshTileRegion(tc, 0, 0, tc->width, tc->height);
+}
+
+void LinceUninitTileColliders(LinceTileColliders* tc){
+    if(!tc) return;
+    if(tc->reg){
+        for(uint32_t i = 0; i != tc->rects.size; ++i){
+            LinceTileRect* rect = array_get(&tc->rects, i);
+            LinceDeleteEntity(tc->reg, rect->entity_id);
+        }
+    }
+    array_uninit(&tc->solid_tiles);
+    array_uninit(&tc->rects);
+    LinceFree(tc->solid);
+    LinceFree(tc->owner);
+}
+
+void LinceSetTileColliderCell(LinceTileColliders* tc, uint32_t col, uint32_t row, LinceBool solid){
+    LINCE_ASSERT(tc, "NULL pointer");
+    LINCE_ASSERT(col < tc->width && row < tc->height, "Cell (%u, %u) out of bounds", col, row);
+    uint32_t cell = row * tc->width + col;
+    if(tc->solid[cell] == (uint8_t)solid) return;
+    tc->solid[cell] = (uint8_t)solid;
+
+    // Take apart the rectangles that may change, and mesh their area again:
+    // the one covering an emptied cell, or those next to a new solid cell
+    uint32_t region[4] = {col, row, col + 1, row + 1};
+    if(!solid){
+        LinceTakeApartTileRect(tc, col, row, region);
+    } else {
+        if(col > 0) LinceTakeApartTileRect(tc, col - 1, row, region);
+        if(row > 0) LinceTakeApartTileRect(tc, col, row - 1, region);
+        if(col + 1 < tc->width) LinceTakeApartTileRect(tc, col + 1, row, region);
+        if(row + 1 < tc->height) LinceTakeApartTileRect(tc, col, row + 1, region);
+    }
+    LinceMeshTileRegion(tc, region[0], region[1], region[2], region[3]);
+}
+
+void LinceRefreshTileColliders(LinceTileColliders* tc, LinceTilemap* map){
+    LINCE_ASSERT(tc && map && map->grid, "NULL pointer");
+    LINCE_ASSERT(map->width == tc->width && map->height == tc->height, "Tilemap size changed");
+    for(uint32_t row = 0; row != tc->height; ++row){
+        for(uint32_t col = 0; col != tc->width; ++col){
+            LinceBool solid = LinceIsTileSolid(tc, map->grid[row * tc->width + col]);
+            LinceSetTileColliderCell(tc, col, row, solid);
+        }
+    }
+}
+
+LinceBoxCollider LinceGetTileRectCollider(LinceTileColliders* tc, LinceTileRect* rect){
+    LINCE_ASSERT(tc && rect, "NULL pointer");
+    // Rows of the grid run from the top of the map down, as in `LinceInitTilemap`
+    return (LinceBoxCollider){
+        .x = tc->offset[0] + ((float)rect->col + (float)rect->w / 2.0f) * tc->scale[0],
+        .y = tc->offset[1] + ((float)tc->height - (float)rect->row - (float)rect->h / 2.0f) * tc->scale[1],
+        .w = (float)rect->w * tc->scale[0],
+        .h = (float)rect->h * tc->scale[1],
+        .flags = LinceBoxCollider_Static,
+    };
+}
@@ -0,0 +1,89 @@
+/** @file tile_collider.h
+* Static box colliders baked from the solid cells of a tilemap.
+*
+* Rather than one collider per blocking tile, adjacent solid cells are merged
+* into as few rectangles as possible with greedy meshing:
+* each rectangle starts at the first uncovered solid cell in reading order,
+* grows to the right as far as it can, and then downwards while whole rows fit.
+*
+* When cells change, only the rectangles around them are taken apart and meshed again,
+* so the result stays valid but may use a few more rectangles than a full rebuild.
+* Rectangles can optionally be mirrored as entities with a `LinceBoxCollider_Static` box collider.
+*
+* Usage:
+* ```c
+* LinceBool solid_tiles[] = { [WALL_TILE] = LinceTrue, [ROCK_TILE] = LinceTrue, [LAST_TILE] = LinceFalse };
+* LinceTileColliders colliders;
+* LinceInitTileColliders(&colliders, &tilemap, solid_tiles, LAST_TILE + 1, reg, Component_BoxCollider);
+*
+* // After changing tiles in the grid of the tilemap
+* LinceRefreshTileColliders(&colliders, &tilemap);
+*
+* LinceUninitTileColliders(&colliders);
+* ```
+*/
+
+#ifndef LINCE_TILE_COLLIDER_H
+#define LINCE_TILE_COLLIDER_H
+
+#include "lince/core/core.h"
+#include "lince/containers/array.h"
+#include "lince/entity/entity.h"
+#include "lince/physics/boxcollider.h"
+#include "lince/tiles/tilemap.h"
+
+/** @brief Marks a cell not covered by any rectangle, or a rectangle without an entity */
+#define LINCE_TILE_RECT_NONE UINT32_MAX
+
+/** @struct LinceTileRect
+* @brief Rectangle of solid cells, in the layout of the tilemap grid
+*/
+typedef struct LinceTileRect {
+    uint32_t col, row;   ///< Left column and top row
+    uint32_t w, h;       ///< Size in cells
+    uint32_t entity_id;  ///< Entity with its box collider, or LINCE_TILE_RECT_NONE
+} LinceTileRect;
+
+/** @struct LinceTileColliders
+* @brief Merged colliders of a tilemap
+*/
+typedef struct LinceTileColliders {
+    uint32_t width, height;  ///< Size of the map in cells
+    vec2 offset, scale;      ///< Placement of the map in the world, as in `LinceTilemap`
+    array_t solid_tiles;     ///< array<LinceBool> -> whether each tile index is solid
+    uint8_t* solid;          ///< Whether each cell is solid
+    uint32_t* owner;         ///< Rectangle covering each cell, or LINCE_TILE_RECT_NONE
+    array_t rects;           ///< array<LinceTileRect> -> rectangles covering all solid cells
+    LinceEntityRegistry* reg;///< Registry where the rectangles are mirrored, if any
+    int box_component_id;    ///< Component of type `LinceBoxCollider` in the registry
+} LinceTileColliders;
+
+/** @brief Merges the solid cells of a tilemap into rectangles
+* @param tc Colliders to initialise
+* @param map Tilemap, of which only the grid, size, offset and scale are used
+* @param solid_tiles Whether each tile index is solid. Indices beyond the table are not.
+* @param tile_count Number of entries in the table
+* @param reg Registry in which to create an entity per rectangle, or NULL
+* @param box_component_id Component of type `LinceBoxCollider`, if a registry is given
+*/
+void LinceInitTileColliders(LinceTileColliders* tc, LinceTilemap* map,
+    const LinceBool* solid_tiles, uint32_t tile_count,
+    LinceEntityRegistry* reg, int box_component_id);
+
+/** @brief Frees the rectangles and deletes their entities */
+void LinceUninitTileColliders(LinceTileColliders* tc);
+
+/** @brief Makes a cell solid or empty, and meshes the rectangles around it again */
+void LinceSetTileColliderCell(LinceTileColliders* tc, uint32_t col, uint32_t row, LinceBool solid);
+
+/** @brief Compares the grid of a tilemap with the solid cells,
+* and updates the rectangles around the cells that changed
+*/
+void LinceRefreshTileColliders(LinceTileColliders* tc, LinceTilemap* map);
+
+/** @brief Returns the box collider of a rectangle in world coordinates,
+* flagged as `LinceBoxCollider_Static`
+*/
+LinceBoxCollider LinceGetTileRectCollider(LinceTileColliders* tc, LinceTileRect* rect);
+
+#endif /* LINCE_TILE_COLLIDER_H */
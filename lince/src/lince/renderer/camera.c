@@ -5,6 +5,7 @@
 #include <cglm/cam.h>
 #include <cglm/mat4.h>
 #include <cglm/affine.h>
+#include <math.h>
 
 static const LinceCamera default_camera = {
 	.scale = 1.0,
@@ -80,6 +81,24 @@ void LinceUpdateCamera(LinceCamera* cam) {
 	LINCE_PROFILER_END(timer);
 }
 
+void LinceGetCameraBounds(LinceCamera* cam, vec4 bounds){
+	LINCE_ASSERT(cam, "NULL pointer");
+	// The inverse is recomputed, as cameras that were never updated have none
+	mat4 inv;
+	glm_mat4_inv(cam->view_proj, inv);
+	bounds[0] = bounds[1] = INFINITY;
+	bounds[2] = bounds[3] = -INFINITY;
+	for(int i = 0; i != 4; ++i){
+		vec4 corner = {(i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, 0.0f, 1.0f};
+		vec4 world;
+		glm_mat4_mulv(inv, corner, world);
+		bounds[0] = fminf(bounds[0], world[0]);
+		bounds[1] = fminf(bounds[1], world[1]);
+		bounds[2] = fmaxf(bounds[2], world[0]);
+		bounds[3] = fmaxf(bounds[3], world[1]);
+	}
+}
+
 void LinceResizeCameraView(LinceCamera* cam, float aspect_ratio){
 	cam->aspect_ratio = aspect_ratio;
 	LinceCalculateProjection(
@@ -65,6 +65,11 @@ void LinceSetCameraProj(LinceCamera* cam, mat4 proj);
 */
 void LinceUpdateCamera(LinceCamera* cam);
 
+/** @brief Returns the region of the world seen by a camera
+* as its bounding box (xmin, ymin, xmax, ymax).
+*/
+void LinceGetCameraBounds(LinceCamera* cam, vec4 bounds);
+
 /** @brief Adapts projection to changes in window size */
 void LinceResizeCameraView(LinceCamera* cam, float aspect_ratio);
 
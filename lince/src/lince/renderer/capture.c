@@ -0,0 +1,219 @@
+#include "core/memory.h"
+#include "renderer/capture.h"
+
+static const char capture_magic[4] = {'L','C','A','P'};
+
+/* Recording state */
+typedef struct LinceCaptureState {
+	FILE* file;
+	uint32_t frames_left;  // zero means unlimited
+	array_t textures;      // array<LinceTexture*>, texture seen so far
+	array_t shaders;       // array<LinceShader*>, shaders seen so far
+} LinceCaptureState;
+
+static LinceCaptureState capture_state = {0};
+
+
+/* Returns the one-based index of a pointer in a list, adding it if missing */
+static uint32_t LinceGetCaptureIndex(array_t* list, void* ptr, LinceBool* is_new){
+	*is_new = LinceFalse;
+	if(!ptr) return 0;
+	for(uint32_t i = 0; i != list->size; ++i){
+		if(*(void**)array_get(list, i) == ptr) return i + 1;
+	}
+	array_push_back(list, &ptr);
+	*is_new = LinceTrue;
+	return list->size;
+}
+
+LinceBool LinceStartRenderCapture(const char* path, uint32_t frame_count){
+	LINCE_ASSERT(path, "NULL pointer");
+	if(capture_state.file) LinceStopRenderCapture();
+
+	capture_state.file = fopen(path, "wb");
+	if(!capture_state.file){
+		LINCE_WARN("Failed to open capture file '%s'", path);
+		return LinceFalse;
+	}
+	capture_state.frames_left = frame_count;
+	array_init(&capture_state.textures, sizeof(LinceTexture*));
+	array_init(&capture_state.shaders, sizeof(LinceShader*));
+
+	uint32_t version = LINCE_CAPTURE_VERSION;
+	fwrite(capture_magic, sizeof(capture_magic), 1, capture_state.file);
+	fwrite(&version, sizeof(version), 1, capture_state.file);
+
+	LINCE_INFO("Started render capture to '%s'", path);
+	return LinceTrue;
+}
+
+void LinceStopRenderCapture(){
+	if(!capture_state.file) return;
+	fclose(capture_state.file);
+	array_uninit(&capture_state.textures);
+	array_uninit(&capture_state.shaders);
+	capture_state = (LinceCaptureState){0};
+	LINCE_INFO("Stopped render capture");
+}
+
+LinceBool LinceIsRenderCaptureActive(){
+	return capture_state.file != NULL;
+}
+
+void LinceUpdateRenderCapture(){
+	if(!capture_state.file) return;
+	fputc('F', capture_state.file);
+	if(capture_state.frames_left == 0) return;
+	if(--capture_state.frames_left == 0) LinceStopRenderCapture();
+}
+
+void LinceRecordScene(LinceCamera* cam){
+	if(!capture_state.file) return;
+	fputc('B', capture_state.file);
+	fwrite(cam->view_proj, sizeof(mat4), 1, capture_state.file);
+}
+
+void LinceRecordSprite(LinceSprite* sprite, LinceShader* shader){
+	if(!capture_state.file) return;
+	FILE* file = capture_state.file;
+	LinceBool is_new;
+
+	uint32_t texture = LinceGetCaptureIndex(&capture_state.textures, sprite->texture, &is_new);
+	if(is_new){
+		LinceCaptureTexture def = {
+			.width = sprite->texture->width,
+			.height = sprite->texture->height,
+			.has_transparency = sprite->texture->has_transparency
+		};
+		fputc('T', file);
+		fwrite(&texture, sizeof(uint32_t), 1, file);
+		fwrite(&def, sizeof(def), 1, file);
+	}
+
+	uint32_t shader_index = LinceGetCaptureIndex(&capture_state.shaders, shader, &is_new);
+	if(is_new){
+		fputc('H', file);
+		fwrite(&shader_index, sizeof(uint32_t), 1, file);
+	}
+
+	LinceCaptureSprite record = {
+		.x = sprite->x, .y = sprite->y, .w = sprite->w, .h = sprite->h,
+		.zorder = sprite->zorder, .rotation = sprite->rotation,
+		.texture = texture, .shader = shader_index, .anim = sprite->anim,
+		.has_tile = sprite->tile != NULL
+	};
+	memcpy(record.color, sprite->color, sizeof(record.color));
+
+	// Tile coordinates are only stored when needed
+	size_t bytes = offsetof(LinceCaptureSprite, coords);
+	if(sprite->tile){
+		memcpy(record.coords, sprite->tile->coords, sizeof(record.coords));
+		bytes = sizeof(LinceCaptureSprite);
+	}
+	fputc(sprite->tile ? 'U' : 'S', file);
+	fwrite(&record, bytes, 1, file);
+}
+
+
+LinceBool LinceLoadRenderCapture(LinceRenderCapture* capture, const char* path){
+	LINCE_ASSERT(capture && path, "NULL pointer");
+
+	FILE* file = fopen(path, "rb");
+	if(!file){
+		LINCE_WARN("Failed to open capture file '%s'", path);
+		return LinceFalse;
+	}
+
+	char magic[4];
+	uint32_t version = 0;
+	if(fread(magic, sizeof(magic), 1, file) != 1 ||
+		memcmp(magic, capture_magic, sizeof(magic)) != 0 ||
+		fread(&version, sizeof(version), 1, file) != 1 ||
+		version != LINCE_CAPTURE_VERSION)
+	{
+		LINCE_WARN("Invalid capture file '%s'", path);
+		fclose(file);
+		return LinceFalse;
+	}
+
+	*capture = (LinceRenderCapture){0};
+	array_init(&capture->frames, sizeof(LinceCaptureFrame));
+	array_init(&capture->scenes, sizeof(LinceCaptureScene));
+	array_init(&capture->sprites, sizeof(LinceCaptureSprite));
+	array_init(&capture->textures, sizeof(LinceCaptureTexture));
+
+	LinceCaptureFrame frame = {0};
+	LinceCaptureScene* scene = NULL;
+	LinceBool valid = LinceTrue;
+	int tag;
+
+	while(valid && (tag = fgetc(file)) != EOF){
+		switch(tag){
+		case 'T': {
+			uint32_t index;
+			LinceCaptureTexture def;
+			valid = fread(&index, sizeof(index), 1, file) == 1 &&
+				fread(&def, sizeof(def), 1, file) == 1 &&
+				index == capture->textures.size + 1;
+			if(valid) array_push_back(&capture->textures, &def);
+			break;
+		}
+		case 'H': {
+			uint32_t index;
+			valid = fread(&index, sizeof(index), 1, file) == 1 && index == capture->shader_count + 1;
+			if(valid) capture->shader_count++;
+			break;
+		}
+		case 'B': {
+			LinceCaptureScene new_scene = {.first_sprite = capture->sprites.size};
+			valid = fread(new_scene.view_proj, sizeof(mat4), 1, file) == 1;
+			if(!valid) break;
+			if(frame.scene_count == 0) frame.first_scene = capture->scenes.size;
+			frame.scene_count++;
+			array_push_back(&capture->scenes, &new_scene);
+			scene = array_back(&capture->scenes);
+			break;
+		}
+		case 'S':
+		case 'U': {
+			LinceCaptureSprite sprite = {0};
+			size_t bytes = tag == 'U' ? sizeof(sprite) : offsetof(LinceCaptureSprite, coords);
+			valid = scene && fread(&sprite, bytes, 1, file) == 1 &&
+				sprite.texture <= capture->textures.size &&
+				sprite.shader <= capture->shader_count;
+			if(!valid) break;
+			array_push_back(&capture->sprites, &sprite);
+			scene->sprite_count++;
+			break;
+		}
+		case 'F':
+			array_push_back(&capture->frames, &frame);
+			frame = (LinceCaptureFrame){0};
+			scene = NULL;
+			break;
+		default:
+			valid = LinceFalse;
+			break;
+		}
+	}
+	fclose(file);
+
+	if(!valid){
+		LINCE_WARN("Corrupted capture file '%s'", path);
+		LinceUnloadRenderCapture(capture);
+		return LinceFalse;
+	}
+
+	LINCE_INFO("Loaded render capture '%s': %u frames, %u scenes, %u sprites",
+		path, capture->frames.size, capture->scenes.size, capture->sprites.size);
+	return LinceTrue;
+}
+
+void LinceUnloadRenderCapture(LinceRenderCapture* capture){
+	if(!capture) return;
+	array_uninit(&capture->frames);
+	array_uninit(&capture->scenes);
+	array_uninit(&capture->sprites);
+	array_uninit(&capture->textures);
+	capture->shader_count = 0;
+}
@@ -0,0 +1,120 @@
+/** @file capture.h
+* Records the sprites submitted to the renderer into a binary file,
+* so that heavy frames can be replayed and benchmarked offline
+* without running any game logic (see the `replay` tool).
+*
+* Usage:
+* ```c
+* LinceStartRenderCapture("frames.lcap", 10); // record the next 10 frames
+* ```
+*
+* File layout (native endianness):
+* | Record  | Tag | Payload                                             |
+* | ------- | --- | --------------------------------------------------- |
+* | Header  | --  | `"LCAP"` magic, uint32_t version                    |
+* | Texture | 'T' | uint32_t index, `LinceCaptureTexture`               |
+* | Shader  | 'H' | uint32_t index                                      |
+* | Scene   | 'B' | mat4 view-projection of `LinceBeginScene`           |
+* | Sprite  | 'S' | `LinceCaptureSprite`, without tile coordinates      |
+* | Tile    | 'U' | `LinceCaptureSprite`, including tile coordinates    |
+* | Frame   | 'F' | none - marks the end of a frame                     |
+*
+* Textures and shaders are identified by the order in which they were
+* first seen, starting from one. An index of zero means no texture,
+* or the default shader.
+*/
+
+#ifndef LINCE_CAPTURE_H
+#define LINCE_CAPTURE_H
+
+#include "lince/core/core.h"
+#include "lince/containers/array.h"
+#include "lince/renderer/renderer.h"
+
+#define LINCE_CAPTURE_VERSION 3 ///< Version of the capture file format
+
+/** @struct LinceCaptureTexture
+* @brief Properties of a texture that affect rendering. Its contents are not stored.
+*/
+typedef struct LinceCaptureTexture {
+	uint32_t width, height;    ///< Size in pixels
+	uint32_t has_transparency; ///< True if any pixel has an alpha below one
+} LinceCaptureTexture;
+
+/** @struct LinceCaptureSprite
+* @brief Sprite as stored in a capture file, with pointers replaced by indices.
+*/
+typedef struct LinceCaptureSprite {
+	float x, y, w, h;     ///< Position and size
+	float zorder;         ///< Depth
+	float rotation;       ///< Clockwise rotation in degrees
+	float color[4];       ///< Flat color in RGBA format
+	uint32_t texture;     ///< Texture index, zero if none
+	uint32_t shader;      ///< Shader index, zero for the default shader
+	LinceSpriteAnim anim; ///< GPU animation
+	float coords[8];      ///< Tile texture coordinates, only read if `has_tile` is set
+	uint32_t has_tile;    ///< True if the sprite uses a tile
+} LinceCaptureSprite;
+
+/** @struct LinceCaptureScene
+* @brief Sprites submitted between a `LinceBeginScene` and `LinceEndScene` pair
+*/
+typedef struct LinceCaptureScene {
+	mat4 view_proj;        ///< View-projection matrix of the camera
+	uint32_t first_sprite; ///< Index of the first sprite in the capture's sprite array
+	uint32_t sprite_count; ///< Number of sprites in the scene
+} LinceCaptureScene;
+
+/** @struct LinceCaptureFrame
+* @brief Scenes rendered during one application frame
+*/
+typedef struct LinceCaptureFrame {
+	uint32_t first_scene; ///< Index of the first scene in the capture's scene array
+	uint32_t scene_count; ///< Number of scenes in the frame
+} LinceCaptureFrame;
+
+/** @struct LinceRenderCapture
+* @brief Contents of a capture file loaded into memory
+*/
+typedef struct LinceRenderCapture {
+	array_t frames;         ///< array<LinceCaptureFrame>
+	array_t scenes;         ///< array<LinceCaptureScene>
+	array_t sprites;        ///< array<LinceCaptureSprite>
+	array_t textures;       ///< array<LinceCaptureTexture>, indexed from zero
+	uint32_t shader_count;  ///< Number of distinct custom shaders
+} LinceRenderCapture;
+
+/** @brief Starts recording the sprites submitted in the following frames.
+* @param path File where the capture is written. Overwritten if it exists.
+* @param frame_count Number of frames to record. If zero, records until
+*	`LinceStopRenderCapture` is called.
+* @returns LinceFalse if the file could not be opened.
+*/
+LinceBool LinceStartRenderCapture(const char* path, uint32_t frame_count);
+
+/** @brief Stops recording and closes the capture file */
+void LinceStopRenderCapture();
+
+/** @brief Returns LinceTrue if the renderer is being recorded */
+LinceBool LinceIsRenderCaptureActive();
+
+/** @brief Marks the end of a frame in the capture.
+* Called by the engine once per frame.
+*/
+void LinceUpdateRenderCapture();
+
+/** @brief Records the camera of a new scene. Called by `LinceBeginScene`. */
+void LinceRecordScene(LinceCamera* cam);
+
+/** @brief Records a submitted sprite. Called by `LinceDrawSprite`. */
+void LinceRecordSprite(LinceSprite* sprite, LinceShader* shader);
+
+/** @brief Loads a capture file into memory.
+* @returns LinceFalse if the file could not be read or is not a valid capture.
+*/
+LinceBool LinceLoadRenderCapture(LinceRenderCapture* capture, const char* path);
+
+/** @brief Frees the memory held by a loaded capture */
+void LinceUnloadRenderCapture(LinceRenderCapture* capture);
+
+#endif /* LINCE_CAPTURE_H */
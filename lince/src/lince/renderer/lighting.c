@@ -0,0 +1,270 @@
+#include "core/profiler.h"
+#include "core/memory.h"
+#include "containers/array.h"
+#include "renderer/lighting.h"
+#include "renderer/shader.h"
+#include <glad/glad.h>
+#include "cglm/mat4.h"
+#include "cglm/vec2.h"
+
+#define LIGHTS_BINDING 1       // binding point of the light buffer
+#define LIGHT_TILES_BINDING 2  // binding point of the light range of each tile
+#define LIGHT_INDICES_BINDING 3 // binding point of the light indices of all tiles
+
+
+/* Full-screen triangle generated from the vertex index */
+static const char lighting_vertex_source[] =
+	"#version 450 core\n"
+	"void main(){\n"
+	"   vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+	"   gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);\n"
+	"}\n";
+
+/* Adds up the lights of the fragment's tile.
+   The result is halved and blended as `src*dst + dst*src`,
+   so that lit areas can be up to twice as bright */
+static const char lighting_fragment_source[] =
+	"#version 450 core\n"
+	"layout(location = 0) out vec4 color;\n"
+	"struct PointLight {\n"
+	"   vec2 position;\n"
+	"   float radius;\n"
+	"   float padding;\n"
+	"   vec4 color;\n"
+	"};\n"
+	"layout (std430, binding = 1) readonly buffer LinceLights { PointLight uLights[]; };\n"
+	"layout (std430, binding = 2) readonly buffer LinceLightTiles { uvec2 uTiles[]; };\n"
+	"layout (std430, binding = 3) readonly buffer LinceLightIndices { uint uIndices[]; };\n"
+	"uniform vec3 uAmbientLight = vec3(1.0);\n"
+	"uniform vec2 uViewportOrigin = vec2(0.0);\n"
+	"uniform int uTileCountX = 1;\n"
+	"uniform float uTileSize = 32.0;\n"
+	"void main(){\n"
+	"   ivec2 tile = ivec2((gl_FragCoord.xy - uViewportOrigin) / uTileSize);\n"
+	"   uvec2 range = uTiles[tile.y * uTileCountX + tile.x];\n"
+	"   vec3 light = uAmbientLight;\n"
+	"   for (uint i = range.x; i != range.x + range.y; ++i){\n"
+	"      PointLight l = uLights[uIndices[i]];\n"
+	"      float f = clamp(1.0 - length(gl_FragCoord.xy - l.position) / l.radius, 0.0, 1.0);\n"
+	"      light += l.color.rgb * l.color.a * f * f;\n"
+	"   }\n"
+	"   color = vec4(0.5 * light, 1.0);\n"
+	"}\n";
+
+
+/* Point light in window coordinates, as read by the shader */
+typedef struct LinceScreenLight {
+	float x, y;
+	float radius;
+	float padding;
+	float color[4];
+} LinceScreenLight;
+
+typedef struct LinceLightingState {
+	LinceShader* shader;
+	uint32_t vao;            // empty, vertices are generated in the shader
+	uint32_t light_buffer;   // array<LinceScreenLight>
+	uint32_t tile_buffer;    // first index and count of the lights of each tile
+	uint32_t index_buffer;   // light indices of all tiles
+
+	float ambient[3];
+	mat4 view_proj;          // camera of the current pass
+	array_t lights;          // array<LincePointLight>, submitted in the current pass
+
+	// Binning
+	array_t screen_lights;   // array<LinceScreenLight>
+	array_t tiles;           // array<uint32_t[2]>
+	array_t indices;         // array<uint32_t>
+} LinceLightingState;
+
+static LinceLightingState lighting_state = {0};
+
+
+void LinceInitLighting(){
+	LINCE_PROFILER_START(timer);
+
+	lighting_state.shader = LinceCreateShaderFromSrc(
+		lighting_vertex_source,
+		lighting_fragment_source
+	);
+	glGenVertexArrays(1, &lighting_state.vao);
+	glGenBuffers(1, &lighting_state.light_buffer);
+	glGenBuffers(1, &lighting_state.tile_buffer);
+	glGenBuffers(1, &lighting_state.index_buffer);
+
+	array_init(&lighting_state.lights, sizeof(LincePointLight));
+	array_init(&lighting_state.screen_lights, sizeof(LinceScreenLight));
+	array_init(&lighting_state.tiles, sizeof(uint32_t)*2);
+	array_init(&lighting_state.indices, sizeof(uint32_t));
+	LinceSetAmbientLight(1.0f, 1.0f, 1.0f);
+
+	LINCE_PROFILER_END(timer);
+}
+
+void LinceTerminateLighting(){
+	if(!lighting_state.shader) return;
+	LinceDeleteShader(lighting_state.shader);
+	glDeleteVertexArrays(1, &lighting_state.vao);
+	glDeleteBuffers(1, &lighting_state.light_buffer);
+	glDeleteBuffers(1, &lighting_state.tile_buffer);
+	glDeleteBuffers(1, &lighting_state.index_buffer);
+	array_uninit(&lighting_state.lights);
+	array_uninit(&lighting_state.screen_lights);
+	array_uninit(&lighting_state.tiles);
+	array_uninit(&lighting_state.indices);
+	lighting_state = (LinceLightingState){0};
+}
+
+void LinceSetAmbientLight(float r, float g, float b){
+	lighting_state.ambient[0] = r;
+	lighting_state.ambient[1] = g;
+	lighting_state.ambient[2] = b;
+}
+
+void LinceBeginLighting(LinceCamera* cam){
+	LINCE_ASSERT(cam, "NULL pointer");
+	glm_mat4_copy(cam->view_proj, lighting_state.view_proj);
+	array_clear(&lighting_state.lights);
+}
+
+void LinceDrawPointLight(LincePointLight* light){
+	LINCE_ASSERT(light, "NULL pointer");
+	if(light->radius <= 0.0f) return;
+	array_push_back(&lighting_state.lights, light);
+}
+
+
+/* Transforms a point from world to window coordinates */
+static void LinceWorldToWindow(float x, float y, GLint viewport[4], float out[2]){
+	vec4 clip, world = {x, y, 0.0f, 1.0f};
+	glm_mat4_mulv(lighting_state.view_proj, world, clip);
+	out[0] = (clip[0] / clip[3] * 0.5f + 0.5f) * (float)viewport[2] + (float)viewport[0];
+	out[1] = (clip[1] / clip[3] * 0.5f + 0.5f) * (float)viewport[3] + (float)viewport[1];
+}
+
+/* Computes the range of tiles touched by a light. Returns false if it is off-screen */
+static LinceBool LinceGetLightTiles(
+	LinceScreenLight* light, GLint viewport[4],
+	uint32_t tiles_x, uint32_t tiles_y, uint32_t range[4]
+){
+	float min_x = (light->x - light->radius - (float)viewport[0]) / LINCE_LIGHT_TILE_SIZE;
+	float min_y = (light->y - light->radius - (float)viewport[1]) / LINCE_LIGHT_TILE_SIZE;
+	float max_x = (light->x + light->radius - (float)viewport[0]) / LINCE_LIGHT_TILE_SIZE;
+	float max_y = (light->y + light->radius - (float)viewport[1]) / LINCE_LIGHT_TILE_SIZE;
+	if(max_x < 0.0f || max_y < 0.0f || min_x >= (float)tiles_x || min_y >= (float)tiles_y){
+		return LinceFalse;
+	}
+	range[0] = min_x < 0.0f ? 0 : (uint32_t)min_x;
+	range[1] = min_y < 0.0f ? 0 : (uint32_t)min_y;
+	range[2] = max_x >= (float)tiles_x ? tiles_x - 1 : (uint32_t)max_x;
+	range[3] = max_y >= (float)tiles_y ? tiles_y - 1 : (uint32_t)max_y;
+	return LinceTrue;
+}
+
+/*
+Projects the lights onto the window and lists the lights that touch each tile.
+The lists of all tiles are stored contiguously in the index array,
+and each tile stores the offset and length of its list.
+*/
+static void LinceBinLights(GLint viewport[4], uint32_t tiles_x, uint32_t tiles_y){
+	uint32_t light_count = lighting_state.lights.size;
+	uint32_t tile_count = tiles_x * tiles_y;
+
+	array_resize(&lighting_state.screen_lights, light_count);
+	array_resize(&lighting_state.tiles, tile_count);
+	uint32_t (*tiles)[2] = lighting_state.tiles.data;
+	memset(tiles, 0, tile_count * sizeof(uint32_t) * 2);
+
+	// Project lights and count the lights of each tile
+	uint32_t total = 0, range[4];
+	for(uint32_t i = 0; i != light_count; ++i){
+		LincePointLight* light = array_get(&lighting_state.lights, i);
+		LinceScreenLight* screen = array_get(&lighting_state.screen_lights, i);
+		float centre[2], edge_x[2], edge_y[2];
+		LinceWorldToWindow(light->x, light->y, viewport, centre);
+		LinceWorldToWindow(light->x + light->radius, light->y, viewport, edge_x);
+		LinceWorldToWindow(light->x, light->y + light->radius, viewport, edge_y);
+		float rx = glm_vec2_distance(centre, edge_x);
+		float ry = glm_vec2_distance(centre, edge_y);
+
+		*screen = (LinceScreenLight){.x = centre[0], .y = centre[1], .radius = rx > ry ? rx : ry};
+		memcpy(screen->color, light->color, sizeof(screen->color));
+
+		if(!LinceGetLightTiles(screen, viewport, tiles_x, tiles_y, range)) continue;
+		for(uint32_t ty = range[1]; ty <= range[3]; ++ty){
+			for(uint32_t tx = range[0]; tx <= range[2]; ++tx){
+				tiles[ty * tiles_x + tx][1]++;
+			}
+		}
+		total += (range[2] - range[0] + 1) * (range[3] - range[1] + 1);
+	}
+
+	// Offset of each list
+	uint32_t offset = 0;
+	for(uint32_t i = 0; i != tile_count; ++i){
+		tiles[i][0] = offset;
+		offset += tiles[i][1];
+		tiles[i][1] = 0;
+	}
+
+	// Fill in the lists
+	array_resize(&lighting_state.indices, total);
+	uint32_t* indices = lighting_state.indices.data;
+	for(uint32_t i = 0; i != light_count; ++i){
+		LinceScreenLight* screen = array_get(&lighting_state.screen_lights, i);
+		if(!LinceGetLightTiles(screen, viewport, tiles_x, tiles_y, range)) continue;
+		for(uint32_t ty = range[1]; ty <= range[3]; ++ty){
+			for(uint32_t tx = range[0]; tx <= range[2]; ++tx){
+				uint32_t* tile = tiles[ty * tiles_x + tx];
+				indices[tile[0] + tile[1]++] = i;
+			}
+		}
+	}
+}
+
+/* Uploads an array to a storage buffer. Empty arrays upload one element, as empty buffers can't be bound */
+static void LinceUploadLightBuffer(uint32_t buffer, uint32_t binding, array_t* array){
+	uint32_t count = array->size > 0 ? array->size : 1;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, count * array->element_size, NULL, GL_STREAM_DRAW);
+	if(array->size > 0){
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, array->size * array->element_size, array->data);
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+}
+
+void LinceEndLighting(){
+	LINCE_PROFILER_START(timer);
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	if(viewport[2] <= 0 || viewport[3] <= 0) return;
+	uint32_t tiles_x = ((uint32_t)viewport[2] + LINCE_LIGHT_TILE_SIZE - 1) / LINCE_LIGHT_TILE_SIZE;
+	uint32_t tiles_y = ((uint32_t)viewport[3] + LINCE_LIGHT_TILE_SIZE - 1) / LINCE_LIGHT_TILE_SIZE;
+
+	LinceBinLights(viewport, tiles_x, tiles_y);
+	LinceUploadLightBuffer(lighting_state.light_buffer, LIGHTS_BINDING, &lighting_state.screen_lights);
+	LinceUploadLightBuffer(lighting_state.tile_buffer, LIGHT_TILES_BINDING, &lighting_state.tiles);
+	LinceUploadLightBuffer(lighting_state.index_buffer, LIGHT_INDICES_BINDING, &lighting_state.indices);
+
+	LinceShader* shader = lighting_state.shader;
+	LinceBindShader(shader);
+	LinceSetShaderUniformVec3(shader, "uAmbientLight", lighting_state.ambient);
+	LinceSetShaderUniformVec2(shader, "uViewportOrigin", (vec2){(float)viewport[0], (float)viewport[1]});
+	LinceSetShaderUniformInt(shader, "uTileCountX", (int)tiles_x);
+	LinceSetShaderUniformFloat(shader, "uTileSize", (float)LINCE_LIGHT_TILE_SIZE);
+
+	// Multiply the scene colour by twice the output, keeping the scene alpha
+	GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFuncSeparate(GL_DST_COLOR, GL_SRC_COLOR, GL_ZERO, GL_ONE);
+
+	glBindVertexArray(lighting_state.vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	if(depth_test) glEnable(GL_DEPTH_TEST);
+
+	LINCE_PROFILER_END(timer);
+}
@@ -0,0 +1,66 @@
+/** @file lighting.h
+* 2D lighting pass drawn on top of a rendered scene.
+*
+* Point lights are binned into screen tiles on the CPU,
+* and a single full-screen pass multiplies the scene colour
+* by the ambient light plus the lights that touch each tile.
+* Hundreds of lights therefore cost a single draw call,
+* and each pixel only evaluates the lights near it.
+*
+* Usage:
+* ```c
+* LinceBeginScene(cam);
+* // draw sprites
+* LinceEndScene();
+*
+* LinceBeginLighting(cam);
+* LinceDrawPointLight(&(LincePointLight){.x=1, .y=2, .radius=3, .color={1,0.5,0,1}});
+* LinceEndLighting();
+* ```
+*/
+
+#ifndef LINCE_LIGHTING_H
+#define LINCE_LIGHTING_H
+
+#include "lince/core/core.h"
+#include "lince/renderer/camera.h"
+
+#define LINCE_LIGHT_TILE_SIZE 32 ///< Size in pixels of the screen tiles lights are binned into
+
+/** @struct LincePointLight
+* @brief Light that fades out with the distance from a point
+*/
+typedef struct LincePointLight {
+	float x, y;     ///< Position in world coordinates
+	float radius;   ///< Distance in world units at which the light has faded out
+	float color[4]; ///< RGB colour of the light, and its intensity as alpha
+} LincePointLight;
+
+/** @brief Compiles the lighting shader and creates its buffers.
+* Called by `LinceInitRenderer`.
+*/
+void LinceInitLighting();
+
+/** @brief Frees the lighting resources. Called by `LinceTerminateRenderer` */
+void LinceTerminateLighting();
+
+/** @brief Sets the light that reaches every pixel.
+* Defaults to white, which leaves unlit areas unchanged.
+* Lit areas can become up to twice as bright as the original colour.
+*/
+void LinceSetAmbientLight(float r, float g, float b);
+
+/** @brief Starts collecting lights for a lighting pass.
+* @param cam Camera used to render the scene the lights apply to
+*/
+void LinceBeginLighting(LinceCamera* cam);
+
+/** @brief Submits a point light to the current lighting pass */
+void LinceDrawPointLight(LincePointLight* light);
+
+/** @brief Bins the submitted lights into screen tiles
+* and applies them to the whole screen
+*/
+void LinceEndLighting();
+
+#endif /* LINCE_LIGHTING_H */
@@ -1,8 +1,11 @@
 #include <stdlib.h>
+#include <math.h>
 #include "core/profiler.h"
 #include "core/memory.h"
 #include "renderer/renderer.h"
 #include "renderer/camera.h"
+#include "renderer/capture.h"
+#include "renderer/lighting.h"
 #include <glad/glad.h>
 #include "cglm/types.h"
 #include "cglm/vec4.h"
@@ -13,10 +16,15 @@
 #define QUAD_VERTEX_COUNT 4 // number of vertices in one quad
 #define QUAD_INDEX_COUNT 6  // number of indices required to index one quad
 
-#define MAX_QUADS 20000    // Maximum number of quads in a single vertex batch
-#define MAX_VERTICES (MAX_QUADS * QUAD_VERTEX_COUNT) // max number of vertices in a batch
-#define MAX_INDICES (MAX_QUADS * QUAD_INDEX_COUNT)   // max number of indices in a batch
+#define MAX_QUADS 20000    // Maximum number of quads in the vertex region of a scene
+#define MAX_VERTICES (MAX_QUADS * QUAD_VERTEX_COUNT) // max number of vertices in a scene
+#define MAX_INDICES (MAX_QUADS * QUAD_INDEX_COUNT)   // max number of indices in a single draw
 #define MAX_TEXTURE_SLOTS 32   // max number of textures the GPU can bind simultaneously
+#define MAX_DRAWS 1024         // max number of draws in a scene
+#define MAX_COMMANDS (MAX_DRAWS * LinceQuadClass_Count) // max number of draw commands in a scene
+
+#define DRAW_TABLE_BINDING 0   // binding point of the per-draw texture tables
+#define SPRITE_CACHE_KEY_SIZE 6 // sprite fields that determine its vertex positions
 
 
 const char default_fragment_source[] =
@@ -32,13 +40,32 @@ const char default_fragment_source[] =
 	"	// temporary solution for full transparency, not translucency.\n"
 	"}\n";
 
+/* Variant for fully opaque quads. Without discard, early depth testing can skip hidden fragments */
+const char opaque_fragment_source[] =
+	"#version 450 core\n"
+	"layout(location = 0) out vec4 color;\n"
+	"in vec4 vColor;\n"
+	"in vec2 vTexCoord;\n"
+	"in float vTextureID;\n"
+	"uniform sampler2D uTextureSlots[32];\n"
+	"void main(){\n"
+	"	color = texture(uTextureSlots[int(vTextureID)], vTexCoord) * vColor;\n"
+	"}\n";
+
 const char default_vertex_source[] = 
 	"#version 450 core\n"
 	"layout (location = 0) in vec3 aPos;\n"
 	"layout (location = 1) in vec2 aTexCoord;\n"
 	"layout (location = 2) in vec4 aColor;\n"
 	"layout (location = 3) in float aTextureID;\n"
+	"layout (location = 4) in vec4 aAnim;\n"
+	"layout (location = 5) in vec2 aAnimTime;\n"
+	"layout (location = 6) in uint aDrawID;\n"
+	"layout (std430, binding = 0) readonly buffer LinceDrawTables {\n"
+	"   uint uDrawTables[];\n"
+	"};\n"
 	"uniform mat4 u_view_proj = mat4(1.0);\n"
+	"uniform float u_time = 0.0;\n"
 	"out vec4 vColor;\n"
 	"out vec2 vTexCoord;\n"
 	"out float vTextureID;\n"
@@ -46,7 +73,17 @@ const char default_vertex_source[] =
 	"   gl_Position = u_view_proj * vec4(aPos, 1.0);\n"
 	"   vColor = aColor;\n"
 	"   vTexCoord = aTexCoord;\n"
-	"   vTextureID = aTextureID;\n"
+	"   if (aAnim.z > 1.0) {\n"
+	"      float step = floor(max(u_time - aAnimTime.x, 0.0) / aAnim.w);\n"
+	"      float frame = mod(step, aAnim.z);\n"
+	"      if (aAnimTime.y > 0.5) {\n"
+	"         float period = 2.0 * aAnim.z - 2.0;\n"
+	"         frame = mod(step, period);\n"
+	"         if (frame >= aAnim.z) frame = period - frame;\n"
+	"      }\n"
+	"      vTexCoord += aAnim.xy * frame;\n"
+	"   }\n"
+	"   vTextureID = float(uDrawTables[aDrawID * 32u + uint(aTextureID)]);\n"
 	"}\n";
 
 
@@ -57,30 +94,104 @@ float LinceYSortedZ(float y, vec2 ylim, vec2 zlim){
     return z;
 }
 
+/* Render lists. Quads of each draw are split into these and drawn in this order */
+typedef enum LinceQuadClass {
+	LinceQuadClass_Opaque = 0,  // opaque color and texture, drawn front to back without discard
+	LinceQuadClass_Cutout,      // opaque color on a texture with transparent pixels
+	LinceQuadClass_Translucent, // translucent color, drawn back to front without depth writes
+	LinceQuadClass_Count
+} LinceQuadClass;
+
 // stores information of one vertex
 // Should be packed because everything is a float
 typedef struct LinceQuadVertex {
 	float x, y, z; 	   // position
 	float s, t; 	   // texture coordinates
 	float color[4];	   // rgba color
-	float texture_id;  // binding slot for the texture
+	float texture_id;  // slot in the texture table of the draw
+	float anim[4];     // frame stride (s,t), frame count, and frame time
+	float anim_time[2];// start time, and ping-pong mode
 } LinceQuadVertex;
 
+// Indirect draw command, as read by glMultiDrawElementsIndirect
+typedef struct LinceDrawCommand {
+	uint32_t count;          // number of indices
+	uint32_t instance_count; // always one
+	uint32_t first_index;    // always zero, draws are offset with the base vertex
+	int32_t base_vertex;     // first vertex of the draw in the vertex region
+	uint32_t base_instance;  // index of the draw, selects its texture table
+} LinceDrawCommand;
+
+// Sorting key of a quad
+typedef struct LinceQuadKey {
+	uint32_t quad_class;
+	float z;
+	uint32_t index;
+} LinceQuadKey;
+
+// Range of quads that share a shader and a texture table
+typedef struct LinceDraw {
+	LinceShader* shader;
+	uint32_t first_quad, quad_count;
+	uint32_t class_counts[LinceQuadClass_Count]; // quads of each render list
+	uint32_t texture_count;
+	LinceTexture* textures[MAX_TEXTURE_SLOTS]; // indexed by the vertex texture_id
+} LinceDraw;
+
+// Consecutive draws submitted together with the same shader and texture units
+typedef struct LinceDrawGroup {
+	LinceShader* shader;
+	uint32_t first_draw, draw_count;
+	uint32_t first_command[LinceQuadClass_Count]; // commands of each render list
+	uint32_t command_count[LinceQuadClass_Count];
+	uint32_t unit_count;
+	LinceTexture* units[MAX_TEXTURE_SLOTS];
+} LinceDrawGroup;
+
+// Sprite geometry cached between frames, valid while the key fields of the sprite are unchanged
+typedef struct LinceSpriteCacheEntry {
+	float key[SPRITE_CACHE_KEY_SIZE];      // x, y, w, h, zorder and rotation of the sprite
+	float corners[QUAD_VERTEX_COUNT][3];   // world position of the vertices
+	float bounds[4];                       // bounding box (xmin, ymin, xmax, ymax)
+} LinceSpriteCacheEntry;
+
 typedef struct LinceRendererState {
-	LinceShader *default_shader, *shader;
+	LinceShader *default_shader, *opaque_shader, *shader;
 	LinceTexture* white_texture;
 	
 	LinceVertexArray* va;
     LinceVertexBuffer vb;
     LinceIndexBuffer ib;
+	uint32_t draw_id_buffer;   // sequence of draw indices, one per instance
+	uint32_t indirect_buffer;  // draw commands
+	uint32_t table_buffer;     // texture table of each draw, as texture units
 
-	// Batch rendering
-	unsigned int quad_count;       // number of quads in the batch
+	// Vertex region of the scene
+	unsigned int quad_count;       // number of quads in the region
 	LinceQuadVertex* vertex_batch; // collection of vertices to render
-	unsigned int* index_batch;     // collection of indices to render
-
-	unsigned int texture_slot_count;
-	LinceTexture* texture_slots[MAX_TEXTURE_SLOTS];
+	LinceQuadVertex* sorted_batch; // vertices reordered by render list and depth
+	uint8_t* quad_classes;         // render list of each quad
+	LinceQuadKey* quad_keys;       // sorting keys of the quads in a draw
+	unsigned int* index_batch;     // indices of one full draw
+
+	// Draws recorded in the region, submitted together on `LinceEndScene`
+	uint32_t draw_count;
+	LinceDraw* draws;
+	uint32_t command_count;
+	LinceDrawCommand* commands;
+	uint32_t* tables;              // MAX_TEXTURE_SLOTS texture units per draw
+	uint32_t group_count;
+	LinceDrawGroup* groups;
+
+	float time;                    // scene time in millisec, for sprite animations
+
+	// Corners of entity sprites, indexed by entity ID, see `LinceDrawEntitySprites`
+	uint32_t sprite_cache_size;
+	LinceSpriteCacheEntry* sprite_cache;
+
+	LinceRendererStats stats;
+	LinceBool overdraw_stats;      // measure samples drawn with occlusion queries
+	uint32_t sample_queries[LinceQuadClass_Count];
 
 } LinceRendererState;
 
@@ -138,7 +249,14 @@ void LinceInitRenderer() {
 
 	// Initialise geometry
 	renderer_state.vertex_batch = LinceCalloc(MAX_VERTICES*sizeof(LinceQuadVertex));
+	renderer_state.sorted_batch = LinceCalloc(MAX_VERTICES*sizeof(LinceQuadVertex));
+	renderer_state.quad_classes = LinceCalloc(MAX_QUADS*sizeof(uint8_t));
+	renderer_state.quad_keys = LinceCalloc(MAX_QUADS*sizeof(LinceQuadKey));
 	renderer_state.index_batch = LinceCalloc(MAX_INDICES*sizeof(unsigned int));
+	renderer_state.draws = LinceCalloc(MAX_DRAWS*sizeof(LinceDraw));
+	renderer_state.commands = LinceCalloc(MAX_COMMANDS*sizeof(LinceDrawCommand));
+	renderer_state.tables = LinceCalloc(MAX_DRAWS*MAX_TEXTURE_SLOTS*sizeof(uint32_t));
+	renderer_state.groups = LinceCalloc(MAX_DRAWS*sizeof(LinceDrawGroup));
 	
 	renderer_state.vb = LinceCreateVertexBuffer(
 		renderer_state.vertex_batch,
@@ -148,7 +266,9 @@ void LinceInitRenderer() {
         {LinceBufferType_Float3, "aPos",       0,0,0,0},
         {LinceBufferType_Float2, "aTexCoord",  0,0,0,0},
         {LinceBufferType_Float4, "aColor",     0,0,0,0},
-		{LinceBufferType_Float,  "aTextureID", 0,0,0,0}
+		{LinceBufferType_Float,  "aTextureID", 0,0,0,0},
+		{LinceBufferType_Float4, "aAnim",      0,0,0,0},
+		{LinceBufferType_Float2, "aAnimTime",  0,0,0,0}
     };
 
 	// Generate indices for all quads in a full batch
@@ -170,6 +290,27 @@ void LinceInitRenderer() {
 		renderer_state.vb,
 		layout, elem_count
 	);
+
+	/* The index of each draw reaches the shader as an instanced attribute
+	   offset by the base instance of its command, which works on OpenGL 4.5
+	   unlike gl_DrawID */
+	uint32_t* draw_ids = LinceMalloc(MAX_DRAWS*sizeof(uint32_t));
+	for (uint32_t i = 0; i != MAX_DRAWS; ++i) draw_ids[i] = i;
+	renderer_state.draw_id_buffer = LinceCreateVertexBuffer(draw_ids, MAX_DRAWS*sizeof(uint32_t));
+	LinceFree(draw_ids);
+	glEnableVertexAttribArray(elem_count);
+	glVertexAttribIPointer(elem_count, 1, GL_UNSIGNED_INT, sizeof(uint32_t), 0);
+	glVertexAttribDivisor(elem_count, 1);
+
+	glGenBuffers(1, &renderer_state.indirect_buffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, renderer_state.indirect_buffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, MAX_COMMANDS*sizeof(LinceDrawCommand), NULL, GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &renderer_state.table_buffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, renderer_state.table_buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, MAX_DRAWS*MAX_TEXTURE_SLOTS*sizeof(uint32_t), NULL, GL_DYNAMIC_DRAW);
+
+	glGenQueries(LinceQuadClass_Count, renderer_state.sample_queries);
 	
 	// create default white texture
 	renderer_state.white_texture = LinceCreateEmptyTexture(1, 1);
@@ -186,8 +327,17 @@ void LinceInitRenderer() {
 	int samplers[MAX_TEXTURE_SLOTS] = { 0 };
 	for (int i = 0; i != MAX_TEXTURE_SLOTS; ++i) samplers[i] = i;
 	LinceSetShaderUniformIntN(renderer_state.default_shader, "uTextureSlots", samplers, MAX_TEXTURE_SLOTS);
+
+	renderer_state.opaque_shader = LinceCreateShaderFromSrc(
+		default_vertex_source,
+		opaque_fragment_source
+	);
+	LinceBindShader(renderer_state.opaque_shader);
+	LinceSetShaderUniformIntN(renderer_state.opaque_shader, "uTextureSlots", samplers, MAX_TEXTURE_SLOTS);
 	renderer_state.shader = renderer_state.default_shader;
 
+	LinceInitLighting();
+
 	LINCE_PROFILER_END(timer);
 }
 
@@ -201,11 +351,28 @@ void LinceTerminateRenderer() {
 		LinceFree(renderer_state.index_batch);
 		renderer_state.index_batch = NULL;
 	}
-
+	LinceFree(renderer_state.sorted_batch);
+	LinceFree(renderer_state.quad_classes);
+	LinceFree(renderer_state.quad_keys);
+	renderer_state.draw_count = 0;
+	renderer_state.command_count = 0;
+	LinceFree(renderer_state.draws);
+	LinceFree(renderer_state.commands);
+	LinceFree(renderer_state.tables);
+	LinceFree(renderer_state.groups);
+	LinceFree(renderer_state.sprite_cache);
+	renderer_state.sprite_cache_size = 0;
+
+	LinceTerminateLighting();
 	LinceDeleteShader(renderer_state.default_shader);
+	LinceDeleteShader(renderer_state.opaque_shader);
     LinceDeleteTexture(renderer_state.white_texture);
 
 	LinceDeleteVertexBuffer(renderer_state.vb);
+	LinceDeleteVertexBuffer(renderer_state.draw_id_buffer);
+	glDeleteBuffers(1, &renderer_state.indirect_buffer);
+	glDeleteBuffers(1, &renderer_state.table_buffer);
+	glDeleteQueries(LinceQuadClass_Count, renderer_state.sample_queries);
     LinceDeleteIndexBuffer(renderer_state.ib);
     LinceDeleteVertexArray(renderer_state.va);
 }
@@ -225,129 +392,404 @@ void LinceBeginScene(LinceCamera* cam) {
 	/* Update camera */
 	LinceSetShaderUniformMat4(renderer_state.default_shader,
 		"u_view_proj", cam->view_proj);
+	LinceBindShader(renderer_state.opaque_shader);
+	LinceSetShaderUniformMat4(renderer_state.opaque_shader,
+		"u_view_proj", cam->view_proj);
+	LinceRecordScene(cam);
+	renderer_state.time = (float)LinceGetTimeMillisec();
 	
-	/* Reset batch */
+	/* Reset vertex region and statistics */
+	renderer_state.stats = (LinceRendererStats){0};
 	renderer_state.quad_count = 0;
-	renderer_state.texture_slots[0] = renderer_state.white_texture;
-	renderer_state.texture_slot_count = 1;
-
-	size_t size = (MAX_VERTICES * sizeof(LinceQuadVertex));
-	memset(renderer_state.vertex_batch, 0, size);
+	renderer_state.draw_count = 0;
+	renderer_state.shader = renderer_state.default_shader;
 
 	LINCE_PROFILER_END(timer);
 }
 
+/* Returns true if the shader reads the per-draw texture tables */
+static LinceBool LinceShaderHasDrawTables(LinceShader* shader){
+	return glGetProgramResourceIndex(shader->id,
+		GL_SHADER_STORAGE_BLOCK, "LinceDrawTables") != GL_INVALID_INDEX;
+}
+
+/*
+Splits the recorded draws into groups of consecutive draws with the same shader
+whose textures fit together in the available texture units,
+and fills in the texture table of each draw with the units of its textures.
+*/
+static void LinceGroupDraws(){
+	LinceDrawGroup* group = NULL;
+	renderer_state.group_count = 0;
+
+	for (uint32_t i = 0; i != renderer_state.draw_count; ++i){
+		LinceDraw* draw = renderer_state.draws + i;
+		uint32_t* table = renderer_state.tables + i * MAX_TEXTURE_SLOTS;
+
+		LinceBool fits = group && group->shader == draw->shader;
+		uint32_t unit_count = fits ? group->unit_count : 0;
+		for (uint32_t j = 0; fits && j != draw->texture_count; ++j){
+			uint32_t unit = 0;
+			while (unit != unit_count && group->units[unit] != draw->textures[j]) unit++;
+			if (unit == unit_count){
+				fits = unit_count != MAX_TEXTURE_SLOTS;
+				if (fits) group->units[unit_count++] = draw->textures[j];
+			}
+			table[j] = unit;
+		}
+
+		if (fits){
+			group->unit_count = unit_count;
+			group->draw_count++;
+			continue;
+		}
+
+		// Start a new group, where the table of the draw always fits on its own
+		group = renderer_state.groups + renderer_state.group_count++;
+		group->shader = draw->shader;
+		group->first_draw = i;
+		group->draw_count = 1;
+		group->unit_count = draw->texture_count;
+		for (uint32_t j = 0; j != draw->texture_count; ++j){
+			group->units[j] = draw->textures[j];
+			table[j] = j;
+		}
+	}
+}
+
+/*
+Issues the draws of a group for one render list.
+Shaders that read the texture tables receive all of them in a single indirect call.
+Shaders without the tables are drawn one command at a time,
+with the textures bound in the order of each draw's table.
+*/
+static void LinceSubmitDrawGroup(LinceDrawGroup* group, LinceQuadClass quad_class){
+	uint32_t first = group->first_command[quad_class];
+	uint32_t count = group->command_count[quad_class];
+	if (count == 0) return;
+
+	// Opaque quads of the default shader skip the discard
+	LinceShader* shader = group->shader;
+	if (quad_class == LinceQuadClass_Opaque && shader == renderer_state.default_shader){
+		shader = renderer_state.opaque_shader;
+	}
+	LinceBindShader(shader);
+
+	// Clock of the sprite animations, if the shader has it
+	GLint time_location = glGetUniformLocation(shader->id, "u_time");
+	if (time_location >= 0) glUniform1f(time_location, renderer_state.time);
+
+	if(LinceShaderHasDrawTables(shader)){
+		for (uint32_t i = 0; i != group->unit_count; ++i){
+			LinceBindTexture(group->units[i], i);
+		}
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+			(const void*)(uintptr_t)(first * sizeof(LinceDrawCommand)),
+			(GLsizei)count, 0);
+		renderer_state.stats.submit_count++;
+		return;
+	}
+
+	for (uint32_t i = first; i != first + count; ++i){
+		LinceDrawCommand* cmd = renderer_state.commands + i;
+		LinceDraw* draw = renderer_state.draws + cmd->base_instance;
+		for (uint32_t j = 0; j != draw->texture_count; ++j){
+			LinceBindTexture(draw->textures[j], j);
+		}
+		glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)cmd->count,
+			GL_UNSIGNED_INT, 0, cmd->base_vertex);
+		renderer_state.stats.submit_count++;
+	}
+}
+
+/* Reads the samples drawn by each render list, and the resulting overdraw */
+static void LinceReadOverdrawStats(){
+	LinceRendererStats* stats = &renderer_state.stats;
+	GLuint64 samples[LinceQuadClass_Count];
+	for (uint32_t i = 0; i != LinceQuadClass_Count; ++i){
+		glGetQueryObjectui64v(renderer_state.sample_queries[i], GL_QUERY_RESULT, &samples[i]);
+	}
+	stats->opaque_samples += samples[LinceQuadClass_Opaque];
+	stats->cutout_samples += samples[LinceQuadClass_Cutout];
+	stats->translucent_samples += samples[LinceQuadClass_Translucent];
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	double pixels = (double)viewport[2] * (double)viewport[3];
+	uint64_t total = stats->opaque_samples + stats->cutout_samples + stats->translucent_samples;
+	stats->overdraw = pixels > 0 ? (double)total / pixels : 0.0;
+}
+
+/*
+Draws the render lists in order: opaque quads front to back,
+quads with transparent texels, and translucent quads back to front
+without writing to the depth buffer.
+*/
 void LinceFlushScene(){
 	LINCE_PROFILER_START(timer);
+	double start = LinceGetTimeMillisec();
+
+	LinceBindVertexArray(renderer_state.va);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, renderer_state.indirect_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_TABLE_BINDING, renderer_state.table_buffer);
 
-	for (uint32_t i = 0; i != renderer_state.texture_slot_count; ++i){
-		LinceBindTexture(renderer_state.texture_slots[i], i);
+	for (uint32_t c = 0; c != LinceQuadClass_Count; ++c){
+		glDepthMask(c == LinceQuadClass_Translucent ? GL_FALSE : GL_TRUE);
+		if (renderer_state.overdraw_stats){
+			glBeginQuery(GL_SAMPLES_PASSED, renderer_state.sample_queries[c]);
+		}
+		for (uint32_t i = 0; i != renderer_state.group_count; ++i){
+			LinceSubmitDrawGroup(renderer_state.groups + i, (LinceQuadClass)c);
+		}
+		if (renderer_state.overdraw_stats){
+			glEndQuery(GL_SAMPLES_PASSED);
+		}
 	}
-	LinceDrawIndexed(renderer_state.shader, renderer_state.va, renderer_state.ib);
+	glDepthMask(GL_TRUE);
 	
+	renderer_state.stats.draw_ms += LinceGetTimeMillisec() - start;
+	if (renderer_state.overdraw_stats) LinceReadOverdrawStats();
 	LINCE_PROFILER_END(timer);
 }
 
 
-static int LinceCompareQuadsBlendOrder(const void *a, const void *b){
-	float alpha1 = ((const LinceQuadVertex*)(a))->color[3];
-	float alpha2 = ((const LinceQuadVertex*)(b))->color[3];
-	// If both opaque or both translucent, sort by z order
-	if ((alpha1 == 1.0 && alpha2 == 1.0) || (alpha1 < 1.0 && alpha2 < 1.0)){
-		float z1 = ((const LinceQuadVertex*)(a))->z;
-		float z2 = ((const LinceQuadVertex*)(b))->z;
-		return z1 > z2 ? 1 : -1; // ascending
+/* Render list first, then front to back for opaque quads and back to front otherwise */
+static int LinceCompareQuadKeys(const void *a, const void *b){
+	const LinceQuadKey* k1 = a;
+	const LinceQuadKey* k2 = b;
+	if (k1->quad_class != k2->quad_class){
+		return k1->quad_class > k2->quad_class ? 1 : -1;
 	}
-	// If one opaque and one translucent,
-	// always return translucent > opaque
-	return alpha2 > alpha1 ? 1 : -1; // descending
+	if (k1->z == k2->z){
+		return k1->index > k2->index ? 1 : -1; // keep submission order
+	}
+	if (k1->quad_class == LinceQuadClass_Opaque){
+		return k1->z < k2->z ? 1 : -1; // descending
+	}
+	return k1->z > k2->z ? 1 : -1; // ascending
 }
 
 /*
 Enables depth test with translucency.
-Sorts quads such that opaque ones are drawn first,
-followed by translucent ones from back to front.
+Sorts the quads of each draw by render list and depth.
+Opaque quads are drawn front to back so that hidden fragments fail the depth test early,
+and translucent ones back to front so that they blend correctly.
 See https://www.opengl.org/archives/resources/faq/technical/transparency.htm
 Also see https://learnopengl.com/Advanced-OpenGL/Blending
 */
 static void LinceSortQuadsForBlending(){
-	LinceQuadVertex *batch = renderer_state.vertex_batch;
-	uint32_t count = renderer_state.quad_count;
-	qsort(batch, count, sizeof(LinceQuadVertex)*4, LinceCompareQuadsBlendOrder);
+	LinceQuadKey* keys = renderer_state.quad_keys;
+	const size_t quad_size = sizeof(LinceQuadVertex) * QUAD_VERTEX_COUNT;
+
+	for (uint32_t i = 0; i != renderer_state.draw_count; ++i){
+		LinceDraw* draw = renderer_state.draws + i;
+		LinceQuadVertex* src = renderer_state.vertex_batch + draw->first_quad * QUAD_VERTEX_COUNT;
+		LinceQuadVertex* dst = renderer_state.sorted_batch + draw->first_quad * QUAD_VERTEX_COUNT;
+
+		for (uint32_t q = 0; q != draw->quad_count; ++q){
+			keys[q] = (LinceQuadKey){
+				.quad_class = renderer_state.quad_classes[draw->first_quad + q],
+				.z = src[q * QUAD_VERTEX_COUNT].z,
+				.index = q
+			};
+		}
+		qsort(keys, draw->quad_count, sizeof(LinceQuadKey), LinceCompareQuadKeys);
+		for (uint32_t q = 0; q != draw->quad_count; ++q){
+			memcpy(dst + q * QUAD_VERTEX_COUNT, src + keys[q].index * QUAD_VERTEX_COUNT, quad_size);
+		}
+	}
+
+	LinceQuadVertex* sorted = renderer_state.sorted_batch;
+	renderer_state.sorted_batch = renderer_state.vertex_batch;
+	renderer_state.vertex_batch = sorted;
+}
+
+/*
+Writes the draw commands, grouped by render list and then by draw group,
+so that the commands of each group and list are contiguous.
+All commands of a draw share its texture table.
+*/
+static void LinceBuildDrawCommands(){
+	renderer_state.command_count = 0;
+	for (uint32_t c = 0; c != LinceQuadClass_Count; ++c){
+		for (uint32_t g = 0; g != renderer_state.group_count; ++g){
+			LinceDrawGroup* group = renderer_state.groups + g;
+			group->first_command[c] = renderer_state.command_count;
+			group->command_count[c] = 0;
+
+			for (uint32_t i = group->first_draw; i != group->first_draw + group->draw_count; ++i){
+				LinceDraw* draw = renderer_state.draws + i;
+				if (draw->class_counts[c] == 0) continue;
+
+				uint32_t first_quad = draw->first_quad;
+				for (uint32_t k = 0; k != c; ++k) first_quad += draw->class_counts[k];
+
+				renderer_state.commands[renderer_state.command_count++] = (LinceDrawCommand){
+					.count = draw->class_counts[c] * QUAD_INDEX_COUNT,
+					.instance_count = 1,
+					.first_index = 0,
+					.base_vertex = (int32_t)(first_quad * QUAD_VERTEX_COUNT),
+					.base_instance = i
+				};
+				group->command_count[c]++;
+			}
+		}
+	}
+}
+
+/* Uploads the vertex region, the draw commands, and the texture table of each draw */
+static void LinceUploadDraws(){
+	uint32_t size = renderer_state.quad_count * QUAD_VERTEX_COUNT * sizeof(LinceQuadVertex);
+	LinceSetVertexBufferData(renderer_state.vb, renderer_state.vertex_batch, size);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, renderer_state.indirect_buffer);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0,
+		renderer_state.command_count * sizeof(LinceDrawCommand), renderer_state.commands);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, renderer_state.table_buffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+		renderer_state.draw_count * MAX_TEXTURE_SLOTS * sizeof(uint32_t), renderer_state.tables);
 }
 
 
 void LinceEndScene() {
+	if(renderer_state.draw_count == 0) return;
+
+	double start = LinceGetTimeMillisec();
 	LinceSortQuadsForBlending();
-	uint32_t size = (uint32_t)(MAX_VERTICES * sizeof(LinceQuadVertex));
-	LinceSetVertexBufferData(renderer_state.vb, renderer_state.vertex_batch, size);
+	double sorted = LinceGetTimeMillisec();
+	LinceGroupDraws();
+	LinceBuildDrawCommands();
+	double grouped = LinceGetTimeMillisec();
+	LinceUploadDraws();
+	
+	renderer_state.stats.sort_ms += sorted - start;
+	renderer_state.stats.upload_ms += LinceGetTimeMillisec() - grouped;
+	renderer_state.stats.batch_count += renderer_state.draw_count;
 	LinceFlushScene();
 }
 
 void LinceStartNewBatch(){
 	LinceEndScene();
 	renderer_state.quad_count = 0;
-	renderer_state.texture_slots[0] = renderer_state.white_texture;
-	renderer_state.texture_slot_count = 1;
+	renderer_state.draw_count = 0;
 }
 
-void LinceDrawSprite(LinceSprite* sprite, LinceShader* shader) {
-	LINCE_PROFILER_START(timer);
+void LinceInitSpriteAnim(
+	LinceSpriteAnim* anim,
+	LinceTile* first,
+	LinceTile* next,
+	uint32_t frame_count,
+	float frame_time,
+	uint32_t flags
+){
+	LINCE_ASSERT(anim && first && next, "NULL pointer");
+	LINCE_ASSERT(frame_time > 0.0f, "Frame time must be positive");
+	*anim = (LinceSpriteAnim){
+		.stride = {next->coords[0] - first->coords[0], next->coords[1] - first->coords[1]},
+		.frame_count = frame_count,
+		.frame_time = frame_time,
+		.start_time = (float)LinceGetTimeMillisec(),
+		.flags = flags
+	};
+}
+
+const LinceRendererStats* LinceGetRendererStats(){
+	return &renderer_state.stats;
+}
+
+void LinceSetRendererOverdrawStats(LinceBool enable){
+	renderer_state.overdraw_stats = enable;
+}
 
-	// Choose shader
-	if(!shader){
-		shader = renderer_state.default_shader;
-		LinceBindShader(renderer_state.default_shader);
-	} else if (shader != renderer_state.shader){
+/* Returns the slot of a texture in the current draw, or -1 if it does not fit */
+static int LinceGetDrawTextureSlot(LinceDraw* draw, LinceTexture* texture){
+	for (uint32_t i = 0; i != draw->texture_count; ++i){
+		if (draw->textures[i] == texture) return (int)i;
+	}
+	if (draw->texture_count == MAX_TEXTURE_SLOTS) return -1;
+	draw->textures[draw->texture_count] = texture;
+	return (int)draw->texture_count++;
+}
+
+/* Closes the current draw and starts a new one at the end of the vertex region */
+static LinceDraw* LinceStartNewDraw(LinceShader* shader){
+	if (renderer_state.draw_count == MAX_DRAWS) LinceStartNewBatch();
+	LinceDraw* draw = renderer_state.draws + renderer_state.draw_count++;
+	draw->shader = shader;
+	draw->first_quad = renderer_state.quad_count;
+	draw->quad_count = 0;
+	memset(draw->class_counts, 0, sizeof(draw->class_counts));
+	draw->textures[0] = renderer_state.white_texture;
+	draw->texture_count = 1;
+	return draw;
+}
+
+/* Computes the world position of the corners of a sprite */
+static void LinceComputeSpriteCorners(LinceSprite* sprite, float corners[QUAD_VERTEX_COUNT][3]){
+	// Scale, rotate clockwise, and translate the unit quad
+	float angle = glm_rad(sprite->rotation);
+	float c = cosf(angle), s = sinf(angle);
+	for (uint32_t i = 0; i != QUAD_VERTEX_COUNT; ++i) {
+		float x = quad_vertices[i].x * sprite->w;
+		float y = quad_vertices[i].y * sprite->h;
+		corners[i][0] = sprite->x + x * c + y * s;
+		corners[i][1] = sprite->y - x * s + y * c;
+		corners[i][2] = sprite->zorder;
+	}
+}
+
+/* Appends a sprite to the vertex region with precomputed corners */
+static void LincePushSpriteQuad(LinceSprite* sprite, LinceShader* shader, float corners[QUAD_VERTEX_COUNT][3]){
+	// vertex region size check
+	if (renderer_state.quad_count >= MAX_QUADS){
 		LinceStartNewBatch();
-		LinceBindShader(renderer_state.shader);
 	}
+
+	// Choose draw
+	if(!shader) shader = renderer_state.default_shader;
 	renderer_state.shader = shader;
 
-	// batch size check
-	if (renderer_state.quad_count >= MAX_QUADS ||
-		renderer_state.texture_slot_count >= MAX_TEXTURE_SLOTS)
-	{
-		LinceStartNewBatch();
+	LinceDraw* draw = NULL;
+	if (renderer_state.draw_count > 0){
+		draw = renderer_state.draws + renderer_state.draw_count - 1;
+	}
+	if (!draw || draw->shader != shader){
+		draw = LinceStartNewDraw(shader);
 	}
 	
 	// calculate texture index
 	float texture_index = 0.0f;
-	
 	if(sprite->texture){
-		uint32_t slots = renderer_state.texture_slot_count;
-
-		// check if texture already in slots
-		for(uint32_t i = 0; i != slots; ++i){
-			if(sprite->texture != renderer_state.texture_slots[i]) continue;
-			texture_index = (float)i;
-			break;
- 		}
-		// otherwise add texture
-		if(texture_index <= 0.5f){
-			renderer_state.texture_slots[slots] = sprite->texture;
-			renderer_state.texture_slot_count++;
-			texture_index = (float)slots;
+		int slot = LinceGetDrawTextureSlot(draw, sprite->texture);
+		if (slot < 0){
+			draw = LinceStartNewDraw(shader);
+			slot = LinceGetDrawTextureSlot(draw, sprite->texture);
 		}
+		texture_index = (float)slot;
 	}
 
-	// calculate transform
-	mat4 transform = GLM_MAT4_IDENTITY_INIT;
-	vec4 pos = {sprite->x, sprite->y, sprite->zorder, 1.0};
-	vec3 scale = {sprite->w, sprite->h, 1.0};
-    glm_translate(transform, pos);
-	glm_rotate(transform, glm_rad(sprite->rotation), (vec3){0.0, 0.0, -1.0});
-    glm_scale(transform, scale);
+	// choose render list
+	LinceQuadClass quad_class = LinceQuadClass_Opaque;
+	if (sprite->color[3] < 1.0f){
+		quad_class = LinceQuadClass_Translucent;
+		renderer_state.stats.translucent_count++;
+	} else if (sprite->texture && sprite->texture->has_transparency){
+		quad_class = LinceQuadClass_Cutout;
+		renderer_state.stats.cutout_count++;
+	} else {
+		renderer_state.stats.opaque_count++;
+	}
+	renderer_state.quad_classes[renderer_state.quad_count] = (uint8_t)quad_class;
+	draw->class_counts[quad_class]++;
 
-	// append transformed vertices to batch
+	// append vertices to batch
+	LinceQuadVertex* vertices = renderer_state.vertex_batch + renderer_state.quad_count * QUAD_VERTEX_COUNT;
 	for (uint32_t i = 0; i != QUAD_VERTEX_COUNT; ++i) {
-		LinceQuadVertex vertex = {0};
-		vec4 vpos = {quad_vertices[i].x, quad_vertices[i].y, 0.0, 1.0};
-		vec4 res;
-		glm_mat4_mulv(transform, vpos, res);
-		vertex.x = res[0];
-		vertex.y = res[1];
-		vertex.z = res[2];
+		LinceQuadVertex vertex = {
+			.x = corners[i][0], .y = corners[i][1], .z = corners[i][2],
+			.texture_id = texture_index
+		};
 
 		if(sprite->tile){
 			vertex.s = sprite->tile->coords[i*2];
@@ -357,13 +799,114 @@ void LinceDrawSprite(LinceSprite* sprite, LinceShader* shader) {
 			vertex.t = quad_vertices[i].t;
 		}
 
-		vertex.texture_id = texture_index;
 		memcpy(vertex.color, sprite->color, sizeof(float)*4);
-		size_t offset = renderer_state.quad_count * QUAD_VERTEX_COUNT + i;
-		memcpy(renderer_state.vertex_batch + offset, &vertex, sizeof(vertex));
+		if(sprite->anim.frame_count > 1){
+			vertex.anim[0] = sprite->anim.stride[0];
+			vertex.anim[1] = sprite->anim.stride[1];
+			vertex.anim[2] = (float)sprite->anim.frame_count;
+			vertex.anim[3] = sprite->anim.frame_time;
+			vertex.anim_time[0] = sprite->anim.start_time;
+			vertex.anim_time[1] = (sprite->anim.flags & LinceSpriteAnimFlag_PingPong) ? 1.0f : 0.0f;
+		}
+		memcpy(vertices + i, &vertex, sizeof(vertex));
 	}
 	renderer_state.quad_count++;
+	draw->quad_count++;
+	renderer_state.stats.quad_count++;
+}
+
+void LinceDrawSprite(LinceSprite* sprite, LinceShader* shader) {
+	LINCE_PROFILER_START(timer);
+	LinceRecordSprite(sprite, shader);
+
+	float corners[QUAD_VERTEX_COUNT][3];
+	LinceComputeSpriteCorners(sprite, corners);
+	LincePushSpriteQuad(sprite, shader, corners);
 
 	LINCE_PROFILER_END(timer);
 }
 
+/* Returns the cached corners of an entity's sprite, recomputing them if the sprite moved */
+static LinceSpriteCacheEntry* LinceGetCachedSprite(uint32_t entity_id, LinceSprite* sprite){
+	LinceSpriteCacheEntry* entry = renderer_state.sprite_cache + entity_id;
+	float key[SPRITE_CACHE_KEY_SIZE] = {
+		sprite->x, sprite->y, sprite->w, sprite->h, sprite->zorder, sprite->rotation
+	};
+	if (memcmp(entry->key, key, sizeof(key)) == 0) return entry;
+
+	memcpy(entry->key, key, sizeof(key));
+	LinceComputeSpriteCorners(sprite, entry->corners);
+	entry->bounds[0] = entry->bounds[2] = entry->corners[0][0];
+	entry->bounds[1] = entry->bounds[3] = entry->corners[0][1];
+	for (uint32_t i = 1; i != QUAD_VERTEX_COUNT; ++i){
+		entry->bounds[0] = fminf(entry->bounds[0], entry->corners[i][0]);
+		entry->bounds[1] = fminf(entry->bounds[1], entry->corners[i][1]);
+		entry->bounds[2] = fmaxf(entry->bounds[2], entry->corners[i][0]);
+		entry->bounds[3] = fmaxf(entry->bounds[3], entry->corners[i][1]);
+	}
+	return entry;
+}
+
+/* Submits a contiguous array of sprites, skipping those outside the camera bounds */
+static void LinceDrawSpriteColumn(
+	uint8_t* sprites, uint32_t stride, uint32_t* entities, uint32_t count,
+	vec4 bounds, LinceShader* shader
+) {
+	for (uint32_t i = 0; i != count; ++i){
+		LinceSprite* sprite = (LinceSprite*)(sprites + (size_t)i * stride);
+		LinceSpriteCacheEntry* entry = LinceGetCachedSprite(entities[i], sprite);
+		if (entry->bounds[2] < bounds[0] || entry->bounds[0] > bounds[2] ||
+			entry->bounds[3] < bounds[1] || entry->bounds[1] > bounds[3]) {
+			renderer_state.stats.culled_count++;
+			continue;
+		}
+		LinceRecordSprite(sprite, shader);
+		LincePushSpriteQuad(sprite, shader, entry->corners);
+	}
+}
+
+void LinceDrawEntitySprites(
+	LinceEntityRegistry* reg,
+	uint32_t sprite_component_id,
+	LinceCamera* camera,
+	LinceShader* shader
+) {
+	LINCE_PROFILER_START(timer);
+	LINCE_ASSERT(reg && camera, "NULL pointer");
+	LINCE_ASSERT(sprite_component_id < reg->component_count, "Invalid component ID");
+	LINCE_ASSERT(*(uint32_t*)array_get(&reg->component_sizes, sprite_component_id) == sizeof(LinceSprite),
+		"Sprite component must be a LinceSprite");
+
+	// Entries only hold the corners of the sprite values they were computed from,
+	// so they remain valid when entities are deleted or moved to another registry
+	if (renderer_state.sprite_cache_size < reg->entity_count){
+		uint32_t size = reg->entity_count + reg->entity_count / 2;
+		renderer_state.sprite_cache = LinceRealloc(renderer_state.sprite_cache, sizeof(LinceSpriteCacheEntry) * size);
+		LINCE_ASSERT_ALLOC(renderer_state.sprite_cache, sizeof(LinceSpriteCacheEntry) * size);
+		memset(renderer_state.sprite_cache + renderer_state.sprite_cache_size, 0xFF,
+			sizeof(LinceSpriteCacheEntry) * (size - renderer_state.sprite_cache_size));
+		renderer_state.sprite_cache_size = size;
+	}
+
+	vec4 bounds;
+	LinceGetCameraBounds(camera, bounds);
+
+	LinceComponentStorage storage = *(LinceComponentStorage*)array_get(&reg->component_storage, sprite_component_id);
+	if (storage == LinceComponentStorage_Sparse){
+		LinceSparseSet* set = array_get(&reg->sparse_sets, sprite_component_id);
+		LinceDrawSpriteColumn(set->dense.data, sizeof(LinceSprite),
+			set->entities.data, set->entities.size, bounds, shader);
+	} else {
+		for (uint32_t a = 0; a != reg->archetypes.size; ++a){
+			LinceArchetype* arch = array_get(&reg->archetypes, a);
+			if (arch->entities.size == 0) continue;
+			for (uint32_t c = 0; c != arch->column_count; ++c){
+				if (arch->column_ids[c] != sprite_component_id) continue;
+				LinceDrawSpriteColumn(arch->columns[c].data, sizeof(LinceSprite),
+					arch->entities.data, arch->entities.size, bounds, shader);
+			}
+		}
+	}
+
+	LINCE_PROFILER_END(timer);
+}
@@ -14,6 +14,7 @@
 #include "lince/renderer/camera.h"
 #include "lince/core/window.h"
 #include "lince/tiles/tileset.h"
+#include "lince/entity/entity.h"
 
 /** @brief Calculates the z-order based on the 'y' value of the position,
 * such that objects at lower 'y' are drawn objects at higher 'y'.
@@ -27,6 +28,31 @@
 */
 float LinceYSortedZ(float y, vec2 ylim, vec2 zlim);
 
+/** @enum LinceSpriteAnimFlags
+* @brief Settings for LinceSpriteAnim
+*/
+typedef enum LinceSpriteAnimFlags {
+	LinceSpriteAnimFlag_Loop     = 0x0, ///< Default. Restarts from the first frame after the last one.
+	LinceSpriteAnimFlag_PingPong = 0x1, ///< Plays the frames forwards and then backwards.
+} LinceSpriteAnimFlags;
+
+/** @struct LinceSpriteAnim
+* @brief Sprite-sheet animation computed by the vertex shader,
+* which costs nothing on the CPU once the sprite is submitted.
+*
+* The frames must be evenly spaced in the texture.
+* The sprite's tile (or the full texture if none) is the first frame,
+* and each following frame is offset by `stride` in texture coordinates.
+* Unlike `LinceTileAnim`, it does not support callbacks or a limited number of repeats.
+*/
+typedef struct LinceSpriteAnim {
+	vec2 stride;          ///< Offset between consecutive frames in texture coordinates
+	uint32_t frame_count; ///< Number of frames. The animation is disabled if below two.
+	float frame_time;     ///< Duration of each frame in millisec
+	float start_time;     ///< Time of the first frame in millisec, see `LinceGetTimeMillisec`
+	uint32_t flags;       ///< LinceSpriteAnimFlags
+} LinceSpriteAnim;
+
 /** @struct LinceSprite
 * @brief Visual and spatial properties of a rectangle.
 */
@@ -38,8 +64,31 @@ typedef struct LinceSprite{
 	float color[4]; 		///< Flat color in RGBA format
 	LinceTexture* texture;	///< LinceTexture object. If NULL, only colour is used.
 	LinceTile* tile;		///< LinceTile or subtexture. If NULL, full texture is used.
+	LinceSpriteAnim anim;	///< Animation run on the GPU. Disabled if zeroed.
 } LinceSprite;
 
+/** @struct LinceRendererStats
+* @brief Counters and CPU timings of the renderer,
+* accumulated since the last call to `LinceBeginScene`.
+* Timings only measure CPU-side work, as OpenGL commands run asynchronously.
+*/
+typedef struct LinceRendererStats {
+	uint32_t quad_count;          ///< Number of sprites submitted
+	uint32_t batch_count;         ///< Number of draw commands (runs of quads sharing a shader and texture table)
+	uint32_t submit_count;        ///< Number of OpenGL draw calls issued
+	uint32_t opaque_count;        ///< Opaque quads, drawn front to back without discard
+	uint32_t cutout_count;        ///< Opaque quads whose texture has transparent pixels
+	uint32_t translucent_count;   ///< Quads with translucent color, drawn back to front
+	uint32_t culled_count;        ///< Entity sprites skipped outside the camera, see `LinceDrawEntitySprites`
+	uint64_t opaque_samples;      ///< Samples drawn by opaque quads. See `LinceSetRendererOverdrawStats`.
+	uint64_t cutout_samples;      ///< Samples drawn by cutout quads
+	uint64_t translucent_samples; ///< Samples drawn by translucent quads
+	double overdraw;              ///< Samples drawn per viewport pixel
+	double sort_ms;               ///< Time spent sorting quads for blending
+	double upload_ms;             ///< Time spent uploading vertices, draw commands and texture tables
+	double draw_ms;               ///< Time spent binding textures and issuing draw calls
+} LinceRendererStats;
+
 /** @brief Initialises renderer state and openGL rendering settings */
 void LinceInitRenderer();
 
@@ -51,15 +100,58 @@ void LinceTerminateRenderer();
 */
 void LinceBeginScene(LinceCamera* cam);
 
-/** @brief Renders scene and flushes batch buffers to the screen */
+/** @brief Renders scene and flushes batch buffers to the screen.
+* All sprites of the scene are uploaded at once, and consecutive draws
+* with the same shader are submitted with a single `glMultiDrawElementsIndirect`.
+*
+* Sprites are drawn in three passes: opaque sprites from front to back,
+* then opaque sprites whose texture has transparent pixels,
+* and finally translucent sprites (color alpha below one) from back to front
+* without writing to the depth buffer.
+*/
 void LinceEndScene();
 
 /** @brief Submits a recangle sprite for rendering
 * @param sprite Sprite to render
 * @param shader LinceShader to bind. If NULL, a default minimal shader is used.
+*
+* Sprites are drawn when the scene ends, so the uniforms of a custom shader
+* must not change between its sprites within the same scene.
+* The attribute `aTextureID` is a slot in the texture table of the sprite's draw.
+* Custom shaders should translate it into a texture unit by declaring
+* the draw index and the tables as follows (see `light.vert.glsl` in the sandbox):
+* ```glsl
+* layout (location = 4) in vec4 aAnim;     // sprite animation, see LinceSpriteAnim
+* layout (location = 5) in vec2 aAnimTime;
+* layout (location = 6) in uint aDrawID;
+* layout (std430, binding = 0) readonly buffer LinceDrawTables { uint uDrawTables[]; };
+* // ...
+* vTextureID = float(uDrawTables[aDrawID * 32u + uint(aTextureID)]);
+* ```
+* Shaders without the `LinceDrawTables` block are still supported,
+* but their draws are issued one by one.
+* The uniform `u_time` (float, millisec) is set on every shader that declares it.
 */
 void LinceDrawSprite(LinceSprite* sprite, LinceShader* shader);
 
+/** @brief Submits the sprite components of all entities in a registry
+* that are within the view of a camera.
+* @param reg Entity registry
+* @param sprite_component_id Component of type `LinceSprite`
+* @param camera Camera used to discard sprites out of view, usually the one of the scene
+* @param shader LinceShader to bind. If NULL, a default minimal shader is used.
+*
+* The sprite columns are read directly, which avoids the overhead of a query
+* and of submitting sprites one by one. The vertex positions of each entity are cached
+* and only recomputed when its position, size, depth or rotation changes.
+*/
+void LinceDrawEntitySprites(
+	LinceEntityRegistry* reg,
+	uint32_t sprite_component_id,
+	LinceCamera* camera,
+	LinceShader* shader
+);
+
 /** @brief Draws provided vertices directly */
 void LinceDrawIndexed(
 	LinceShader* shader,
@@ -67,14 +159,43 @@ void LinceDrawIndexed(
 	LinceIndexBuffer vb
 );
 
+/** @brief Sets up a GPU animation over evenly spaced frames of a sprite sheet,
+* starting at the current time.
+* @param anim Animation to initialise
+* @param first Tile of the first frame, which should be the tile of the sprite
+* @param next Tile of the second frame, which defines the spacing of the frames
+* @param frame_count Number of frames
+* @param frame_time Duration of each frame in millisec
+* @param flags LinceSpriteAnimFlags
+*/
+void LinceInitSpriteAnim(
+	LinceSpriteAnim* anim,
+	LinceTile* first,
+	LinceTile* next,
+	uint32_t frame_count,
+	float frame_time,
+	uint32_t flags
+);
+
 /** @brief Empties screen buffer */
 void LinceClear();
 
 /** @brief Sets the default background screen color */
 void LinceSetClearColor(float r, float g, float b, float a);
 
-/** @brief Draw stored vertices and clear vertex batch */
+/** @brief Draw stored vertices and clear vertex batch.
+* Called automatically when the vertex region of the scene is full.
+*/
 void LinceStartNewBatch();
 
+/** @brief Returns the renderer statistics gathered since the last scene began */
+const LinceRendererStats* LinceGetRendererStats();
+
+/** @brief Enables measuring the samples that pass the depth test
+* and the overdraw in the renderer statistics.
+* The measurement waits for the GPU to finish each scene, so it is disabled by default.
+*/
+void LinceSetRendererOverdrawStats(LinceBool enable);
+
 
 #endif // LINCE_RENDERER_H
\ No newline at end of file
@@ -70,6 +70,15 @@ void LinceSetTextureData(LinceTexture* texture, unsigned char* data){
 		GL_UNSIGNED_BYTE,     // data type
 		data                  // buffer
 	);
+
+	// Look for any alpha below one (only RGBA supported)
+	size_t pixels = (size_t)texture->width * texture->height;
+	texture->has_transparency = LinceFalse;
+	for(size_t i = 0; i != pixels; ++i){
+		if(data[i*4 + 3] == 0xFF) continue;
+		texture->has_transparency = LinceTrue;
+		break;
+	}
 	LINCE_PROFILER_END(timer);
 }
 
@@ -19,6 +19,7 @@ typedef struct LinceTexture {
 	uint32_t width, height;    	///< 2D size
 	int32_t data_format;     	///< Input format of texture file, e.g. RGBA
 	int32_t internal_format; 	///< Output format of data in OpenGL buffer
+	LinceBool has_transparency; ///< True if any pixel has an alpha below one. Set by `LinceSetTextureData`.
 } LinceTexture;
 
 /** @brief Loads a texture from file
@@ -33,7 +34,10 @@ LinceTexture* LinceLoadTexture(const char* path, uint32_t flags);
 */
 LinceTexture* LinceCreateEmptyTexture(uint32_t width, uint32_t height);
 
-/** @brief Provides custom data to an existing texture buffer */
+/** @brief Provides custom data to an existing texture buffer.
+* The data is scanned for transparent pixels, so that fully opaque
+* textures can be rendered without blending.
+*/
 void LinceSetTextureData(LinceTexture* texture, unsigned char* data);
 
 /** @brief Deallocates texture memory and destroys OpenGL texture object */
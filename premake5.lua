@@ -40,4 +40,5 @@ workspace "lince"
     group "tools"
         include "editor/premake5.lua"
         include "sandbox"
+        include "replay"
     group ""
@@ -0,0 +1,226 @@
+/*
+Replays a render capture recorded with `LinceStartRenderCapture`.
+The captured frames are resubmitted in a loop with no game logic,
+and the average time spent on each renderer phase is reported at the end.
+
+Usage:
+    replay <capture file> [loops] [--overdraw]
+
+With --overdraw, the samples drawn per pixel are also measured,
+which waits for the GPU to finish every scene and so inflates the timings.
+*/
+
+#include <lince.h>
+#include <lince/core/profiler.h>
+#include <GLFW/glfw3.h>
+
+/* Minimal shader used in place of the custom shaders found in the capture */
+static const char replay_vertex_source[] =
+	"#version 450 core\n"
+	"layout (location = 0) in vec3 aPos;\n"
+	"layout (location = 1) in vec2 aTexCoord;\n"
+	"layout (location = 2) in vec4 aColor;\n"
+	"layout (location = 3) in float aTextureID;\n"
+	"uniform mat4 u_view_proj = mat4(1.0);\n"
+	"out vec4 vColor;\n"
+	"out vec2 vTexCoord;\n"
+	"out float vTextureID;\n"
+	"void main(){\n"
+	"   gl_Position = u_view_proj * vec4(aPos, 1.0);\n"
+	"   vColor = aColor;\n"
+	"   vTexCoord = aTexCoord;\n"
+	"   vTextureID = aTextureID;\n"
+	"}\n";
+
+static const char replay_fragment_source[] =
+	"#version 450 core\n"
+	"layout(location = 0) out vec4 color;\n"
+	"in vec4 vColor;\n"
+	"in vec2 vTexCoord;\n"
+	"in float vTextureID;\n"
+	"uniform sampler2D uTextureSlots[32];\n"
+	"void main(){\n"
+	"	color = texture(uTextureSlots[int(vTextureID)], vTexCoord) * vColor;\n"
+	"	if (color.a == 0.0) discard;\n"
+	"}\n";
+
+typedef struct ReplayState {
+	const char* path;
+	uint32_t loops;
+	uint32_t frame;           // frames replayed so far
+
+	LinceRenderCapture capture;
+	array_t textures;         // array<LinceTexture*>
+	array_t shaders;          // array<LinceShader*>
+
+	// Accumulated timings in milliseconds
+	double total_ms, sort_ms, upload_ms, draw_ms;
+	uint64_t quad_count, batch_count, submit_count;
+	uint64_t opaque_count, cutout_count, translucent_count;
+	LinceBool overdraw;       // measure overdraw, which stalls every scene
+	double overdraw_sum;
+} ReplayState;
+
+static ReplayState STATE = {0};
+
+
+static void ReplayInit(){
+	if(!LinceLoadRenderCapture(&STATE.capture, STATE.path) || STATE.capture.frames.size == 0){
+		LINCE_ERROR("Nothing to replay in '%s'", STATE.path);
+		LinceGetApp()->running = LinceFalse;
+		return;
+	}
+
+	// Benchmark without waiting for the screen refresh
+	glfwSwapInterval(0);
+	LinceSetRendererOverdrawStats(STATE.overdraw);
+
+	// Textures are recreated with their original sizes and blank contents.
+	// Transparent textures get one transparent pixel, so that they are drawn in the same pass.
+	array_init(&STATE.textures, sizeof(LinceTexture*));
+	for(uint32_t i = 0; i != STATE.capture.textures.size; ++i){
+		LinceCaptureTexture* def = array_get(&STATE.capture.textures, i);
+		LinceTexture* tex = LinceCreateEmptyTexture(def->width, def->height);
+		unsigned char* pixels = LinceMalloc(def->width * def->height * 4);
+		memset(pixels, 0xFF, def->width * def->height * 4);
+		if(def->has_transparency) pixels[3] = 0;
+		LinceSetTextureData(tex, pixels);
+		LinceFree(pixels);
+		array_push_back(&STATE.textures, &tex);
+	}
+
+	// Each custom shader gets its own program, so that shader switches still break batches
+	int samplers[32];
+	for(int i = 0; i != 32; ++i) samplers[i] = i;
+	array_init(&STATE.shaders, sizeof(LinceShader*));
+	for(uint32_t i = 0; i != STATE.capture.shader_count; ++i){
+		LinceShader* shader = LinceCreateShaderFromSrc(replay_vertex_source, replay_fragment_source);
+		LinceBindShader(shader);
+		LinceSetShaderUniformIntN(shader, "uTextureSlots", samplers, 32);
+		array_push_back(&STATE.shaders, &shader);
+	}
+}
+
+static void ReplayScene(LinceCaptureScene* scene){
+	LinceCamera camera = {0};
+	memcpy(camera.view_proj, scene->view_proj, sizeof(mat4));
+
+	LinceBeginScene(&camera);
+	for(uint32_t i = 0; i != STATE.shaders.size; ++i){
+		LinceShader* shader = *(LinceShader**)array_get(&STATE.shaders, i);
+		LinceBindShader(shader);
+		LinceSetShaderUniformMat4(shader, "u_view_proj", camera.view_proj);
+	}
+
+	for(uint32_t i = 0; i != scene->sprite_count; ++i){
+		LinceCaptureSprite* rec = array_get(&STATE.capture.sprites, scene->first_sprite + i);
+		LinceTile tile = {0};
+		LinceSprite sprite = {
+			.x = rec->x, .y = rec->y, .w = rec->w, .h = rec->h,
+			.zorder = rec->zorder, .rotation = rec->rotation,
+			.anim = rec->anim,
+		};
+		memcpy(sprite.color, rec->color, sizeof(sprite.color));
+		if(rec->texture){
+			sprite.texture = *(LinceTexture**)array_get(&STATE.textures, rec->texture - 1);
+		}
+		if(rec->has_tile){
+			memcpy(tile.coords, rec->coords, sizeof(tile.coords));
+			sprite.tile = &tile;
+		}
+		LinceShader* shader = NULL;
+		if(rec->shader){
+			shader = *(LinceShader**)array_get(&STATE.shaders, rec->shader - 1);
+		}
+		LinceDrawSprite(&sprite, shader);
+	}
+	LinceEndScene();
+
+	const LinceRendererStats* stats = LinceGetRendererStats();
+	STATE.sort_ms     += stats->sort_ms;
+	STATE.upload_ms   += stats->upload_ms;
+	STATE.draw_ms     += stats->draw_ms;
+	STATE.quad_count  += stats->quad_count;
+	STATE.batch_count += stats->batch_count;
+	STATE.submit_count += stats->submit_count;
+	STATE.opaque_count += stats->opaque_count;
+	STATE.cutout_count += stats->cutout_count;
+	STATE.translucent_count += stats->translucent_count;
+	STATE.overdraw_sum += stats->overdraw;
+}
+
+static void ReplayUpdate(float dt){
+	LINCE_UNUSED(dt);
+	LinceApp* app = LinceGetApp();
+	if(!app->running) return;
+
+	uint32_t frame_count = STATE.capture.frames.size;
+	LinceCaptureFrame* frame = array_get(&STATE.capture.frames, STATE.frame % frame_count);
+
+	double start = LinceGetTimeMillisec();
+	for(uint32_t i = 0; i != frame->scene_count; ++i){
+		ReplayScene(array_get(&STATE.capture.scenes, frame->first_scene + i));
+	}
+	STATE.total_ms += LinceGetTimeMillisec() - start;
+
+	STATE.frame++;
+	if(STATE.frame == frame_count * STATE.loops) app->running = LinceFalse;
+}
+
+static void ReplayTerminate(){
+	if(STATE.frame > 0){
+		double n = (double)STATE.frame;
+		double batch_ms = STATE.total_ms - STATE.sort_ms - STATE.upload_ms - STATE.draw_ms;
+		printf("Replayed %u frames from '%s'\n", STATE.frame, STATE.path);
+		printf("  quads/frame:   %.1f\n", (double)STATE.quad_count / n);
+		printf("  batches/frame: %.1f\n", (double)STATE.batch_count / n);
+		printf("  calls/frame:   %.1f\n", (double)STATE.submit_count / n);
+		printf("  opaque/cutout/translucent quads: %.1f / %.1f / %.1f\n",
+			(double)STATE.opaque_count / n, (double)STATE.cutout_count / n,
+			(double)STATE.translucent_count / n);
+		if(STATE.overdraw){
+			printf("  overdraw:      %.2f samples/pixel\n", STATE.overdraw_sum / n);
+		}
+		printf("  total:         %.4f ms/frame\n", STATE.total_ms / n);
+		printf("  batching:      %.4f ms/frame\n", batch_ms / n);
+		printf("  sort:          %.4f ms/frame\n", STATE.sort_ms / n);
+		printf("  upload:        %.4f ms/frame\n", STATE.upload_ms / n);
+		printf("  draw:          %.4f ms/frame\n", STATE.draw_ms / n);
+	}
+
+	for(uint32_t i = 0; i != STATE.textures.size; ++i){
+		LinceDeleteTexture(*(LinceTexture**)array_get(&STATE.textures, i));
+	}
+	for(uint32_t i = 0; i != STATE.shaders.size; ++i){
+		LinceDeleteShader(*(LinceShader**)array_get(&STATE.shaders, i));
+	}
+	array_uninit(&STATE.textures);
+	array_uninit(&STATE.shaders);
+	LinceUnloadRenderCapture(&STATE.capture);
+}
+
+
+int main(int argc, const char* argv[]) {
+	if(argc < 2){
+		fprintf(stderr, "Usage: %s <capture file> [loops] [--overdraw]\n", argv[0]);
+		return 1;
+	}
+	STATE.path = argv[1];
+	STATE.loops = 100;
+	for(int i = 2; i < argc; ++i){
+		if(strcmp(argv[i], "--overdraw") == 0) STATE.overdraw = LinceTrue;
+		else STATE.loops = (uint32_t)atoi(argv[i]);
+	}
+	if(STATE.loops == 0) STATE.loops = 1;
+
+	LinceApp* app = LinceGetApp();
+	app->screen_width = 1280;
+	app->screen_height = 720;
+	app->title = "Replay";
+	app->on_init = ReplayInit;
+	app->on_update = ReplayUpdate;
+	app->on_terminate = ReplayTerminate;
+
+	LinceRun();
+	return 0;
+}
@@ -4,8 +4,17 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
 layout (location = 2) in vec4 aColor;
 layout (location = 3) in float aTextureID;
+layout (location = 4) in vec4 aAnim; // frame stride, frame count, frame time
+layout (location = 5) in vec2 aAnimTime; // start time, ping-pong mode
+layout (location = 6) in uint aDrawID;
+
+// Texture unit of each texture slot, for each draw
+layout (std430, binding = 0) readonly buffer LinceDrawTables {
+    uint uDrawTables[];
+};
 
 uniform mat4 u_view_proj = mat4(1.0); // uViewProj
+uniform float u_time = 0.0; // millisec, set by the renderer
 
 out vec4 vColor;
 out vec2 vTexCoord;
@@ -15,5 +24,15 @@ void main(){
    gl_Position = u_view_proj * vec4(aPos, 1.0);
    vColor = aColor;
    vTexCoord = aTexCoord;
-   vTextureID = aTextureID;
+   if (aAnim.z > 1.0) {
+      float step = floor(max(u_time - aAnimTime.x, 0.0) / aAnim.w);
+      float frame = mod(step, aAnim.z);
+      if (aAnimTime.y > 0.5) {
+         float period = 2.0 * aAnim.z - 2.0;
+         frame = mod(step, period);
+         if (frame >= aAnim.z) frame = period - frame;
+      }
+      vTexCoord += aAnim.xy * frame;
+   }
+   vTextureID = float(uDrawTables[aDrawID * 32u + uint(aTextureID)]);
 };
\ No newline at end of file
@@ -24,6 +24,7 @@ typedef enum Component {
     Component_Tilemap,
     Component_TileAnim,
     Component_BoxCollider,
+    Component_Transform,
 
     Component_Count
 } Component;
@@ -33,6 +34,7 @@ typedef enum Component {
         sizeof(LinceSprite),        \
         sizeof(LinceTilemap),       \
         sizeof(LinceTileAnim),      \
-        sizeof(LinceBoxCollider)
+        sizeof(LinceBoxCollider),   \
+        sizeof(LinceTransform)
 
 #endif // GAME_DATA_H
\ No newline at end of file
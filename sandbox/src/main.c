@@ -6,6 +6,7 @@
 #include <lince.h>
 #include <lince/audio/audio.h>
 #include <lince/physics/boxcollider.h>
+#include <lince/physics/spatial_hash.h>
 
 #include "gamedata.h"
 
@@ -53,6 +54,11 @@ typedef struct OldGameData {
 
     // Entities
     LinceEntityRegistry* reg;
+    LinceEntityQuery* anim_query;     // {TileAnim, Sprite}
+    LinceEntityQuery* collider_query; // {Sprite, BoxCollider}
+    LinceEntityQuery* box_query;      // {BoxCollider}
+    LinceTransformHierarchy* transforms;
+    LinceBoxColliderGrid* collider_grid;
     uint32_t player;
 
     // Tile animation test
@@ -210,20 +216,17 @@ void SetupChickenAnimation(){
 
 void UpdateTileAnimations(float dt){
     
-    LinceSprite* sprite;
-    LinceTileAnim* anim;
-    array_t query;
-    array_init(&query, sizeof(uint32_t));
-    LinceQueryEntities(game_data.reg, &query, 2, Component_TileAnim, Component_Sprite);
-    
-    for (uint32_t i = 0; i != query.size; ++i){
-        uint32_t id = *(uint32_t*)array_get(&query, i);
-        sprite = LinceGetEntityComponent(game_data.reg, id, Component_Sprite);
-        anim   = LinceGetEntityComponent(game_data.reg, id, Component_TileAnim);
-        LinceUpdateTileAnim(anim, dt);
-        sprite->tile = anim->current_tile;
+    LinceQueryIter it;
+    LinceInitQueryIter(&it, game_data.reg, game_data.anim_query);
+
+    while(LinceNextQueryChunk(&it)){
+        LinceTileAnim* anims = it.data[0];
+        LinceSprite* sprites = it.data[1];
+        for (uint32_t i = 0; i != it.count; ++i){
+            LinceUpdateTileAnim(&anims[i], dt);
+            sprites[i].tile = anims[i].current_tile;
+        }
     }
-    array_uninit(&query);
 
 }
 
@@ -248,18 +251,8 @@ void LinceDrawSprites(LinceEntityRegistry* reg){
     LinceSetShaderUniformVec2(game_data.custom_shader, "uPointLightPositions[1]", player_pos);
     LinceSetShaderUniformFloat(game_data.custom_shader, "uPointLightCount", 2.0);
 
-    // Draw all entities
-    static array_t result;
-    array_init(&result, sizeof(uint32_t));
-    uint32_t num = LinceQueryEntities(reg, &result, 1, Component_Sprite);
-
-    for(uint32_t i = 0; i != num; ++i){
-        uint32_t id = *(uint32_t*)array_get(&result, i);
-        LinceSprite* sprite = LinceGetEntityComponent(reg, id, Component_Sprite);
-        // LinceShader* shader = LinceGetEntityComponent(reg, id, Component_Shader);
-        // BindUniformBuffer(...);
-        LinceDrawSprite(sprite, game_data.custom_shader);
-    }
+    // Draw all entities in view
+    LinceDrawEntitySprites(reg, Component_Sprite, &game_data.camera, game_data.custom_shader);
 
     // You need to start a new batch in order to change the value of an uniform
     // Otherwise, changing the uniform will overwrite the old value.
@@ -272,26 +265,28 @@ void LinceDrawSprites(LinceEntityRegistry* reg){
     //     .w = 3.0, .h = 2.0,
     //     .color = {0.1,0.1,0.1,1}
     // }, game_data.custom_shader);
-
-    array_uninit(&result);
 }
 
 static const float vel = 8e-4;
 
 
 void UpdateSpritePositions(LinceEntityRegistry* reg){
-    static array_t result;
-    array_init(&result, sizeof(uint32_t));
-    uint32_t num = LinceQueryEntities(reg, &result, 2, Component_Sprite, Component_BoxCollider);
-
-    for(uint32_t i = 0; i != num; ++i){
-        uint32_t id = *(uint32_t*)array_get(&result, i);
-        LinceSprite* sprite = LinceGetEntityComponent(game_data.reg, id, Component_Sprite);
-        LinceBoxCollider* box = LinceGetEntityComponent(game_data.reg, id, Component_BoxCollider);
-        sprite->x = box->x;
-        sprite->y = box->y;
+    LinceQueryIter it;
+    LinceInitQueryIter(&it, reg, game_data.collider_query);
+
+    while(LinceNextQueryChunk(&it)){
+        LinceSprite* sprites = it.data[0];
+        LinceBoxCollider* boxes = it.data[1];
+        for(uint32_t i = 0; i != it.count; ++i){
+            sprites[i].x = boxes[i].x;
+            sprites[i].y = boxes[i].y;
+        }
     }
-    array_uninit(&result);
+}
+
+/* Moves the entities attached to the player along with it */
+void UpdateTransforms(){
+    LinceUpdateTransforms(game_data.transforms);
 }
 
 void MovePlayer(float dt){
@@ -331,6 +326,9 @@ void GameStateInit(){
     game_data.reg = LinceCreateEntityRegistry(
         Component_Count, COMPONENT_SIZES
     );
+    game_data.anim_query = LinceCreateEntityQuery(game_data.reg, 2, Component_TileAnim, Component_Sprite);
+    game_data.collider_query = LinceCreateEntityQuery(game_data.reg, 2, Component_Sprite, Component_BoxCollider);
+    game_data.box_query = LinceCreateEntityQuery(game_data.reg, 1, Component_BoxCollider);
 
     // --> walls
     /*
@@ -360,6 +358,24 @@ void GameStateInit(){
     game_data.player = LinceCreateEntity(game_data.reg);
     LinceAddEntityComponent(game_data.reg, game_data.player, Component_Sprite, &sprite);
     LinceAddEntityComponent(game_data.reg, game_data.player, Component_BoxCollider, &box);
+    LinceAddEntityComponent(game_data.reg, game_data.player, Component_Transform, &(LinceTransform){0});
+
+    game_data.collider_grid = LinceCreateBoxColliderGrid(1.0f);
+
+    // --> marker that follows the player
+    game_data.transforms = LinceCreateTransformHierarchy(game_data.reg, Component_Transform);
+    LinceAddTransformTarget(game_data.transforms, Component_Sprite,
+        offsetof(LinceSprite, x), offsetof(LinceSprite, y), offsetof(LinceSprite, rotation));
+    // Attached colliders follow their parents, and the player follows its own collider
+    LinceAddTransformTarget(game_data.transforms, Component_BoxCollider,
+        offsetof(LinceBoxCollider, x), offsetof(LinceBoxCollider, y), LINCE_TRANSFORM_NO_FIELD);
+    LinceSetTransformSource(game_data.transforms, Component_BoxCollider,
+        offsetof(LinceBoxCollider, x), offsetof(LinceBoxCollider, y));
+    uint32_t marker = LinceCreateEntity(game_data.reg);
+    LinceAddEntityComponent(game_data.reg, marker, Component_Sprite, &(LinceSprite){
+        .w = 0.03, .h = 0.03, .color = {1.0, 1.0, 0.0, 1.0}});
+    LinceAddEntityComponent(game_data.reg, marker, Component_Transform, &(LinceTransform){.y = 0.08f});
+    LinceSetTransformParent(game_data.transforms, marker, game_data.player);
 
     // --> static blocks
     /*
@@ -390,23 +406,28 @@ void GameStateInit(){
     sprite.color[1] = 1.0;
     sprite.w = MOVERS_SIZE;
     sprite.h = MOVERS_SIZE;
+    LincePrefab* mover = LinceCreatePrefab(game_data.reg);
+    LinceSetPrefabComponent(mover, Component_Sprite, &sprite);
+    LinceSetPrefabComponent(mover, Component_BoxCollider, &(LinceBoxCollider){
+        .w=sprite.w, .h=sprite.h, .flags = LinceBoxCollider_Bounce });
+    uint32_t* mover_ids = LinceMalloc(sizeof(uint32_t) * MOVERS_COUNT);
+    LinceInstantiate(game_data.reg, mover, MOVERS_COUNT, mover_ids);
+    LinceDestroyPrefab(mover);
+
     for(int i = 0; i != MOVERS_COUNT; ++i){
-        uint32_t mover_id = LinceCreateEntity(game_data.reg);
+        LinceSprite* msprite = LinceGetEntityComponent(game_data.reg, mover_ids[i], Component_Sprite);
+        LinceBoxCollider* mbox = LinceGetEntityComponent(game_data.reg, mover_ids[i], Component_BoxCollider);
         float min = -1.0f, max = 1.0f;
-        sprite.x = min + rand()/(float)RAND_MAX * (max - min);
-        sprite.y = min + rand()/(float)RAND_MAX * (max - min);
+        msprite->x = min + rand()/(float)RAND_MAX * (max - min);
+        msprite->y = min + rand()/(float)RAND_MAX * (max - min);
         min = -8e-4;
         max =  8e-4;
-        float dx = min + rand()/(float)RAND_MAX * (max - min);
-        float dy = min + rand()/(float)RAND_MAX * (max - min);
-        LinceBoxCollider mbox = {
-            .x=sprite.x, .y=sprite.y,
-            .w=sprite.w, .h=sprite.h,
-            .dx=dx, .dy=dy,
-            .flags = LinceBoxCollider_Bounce };
-        LinceAddEntityComponent(game_data.reg, mover_id, Component_Sprite, &sprite);
-        LinceAddEntityComponent(game_data.reg, mover_id, Component_BoxCollider, &mbox);
+        mbox->x = msprite->x;
+        mbox->y = msprite->y;
+        mbox->dx = min + rand()/(float)RAND_MAX * (max - min);
+        mbox->dy = min + rand()/(float)RAND_MAX * (max - min);
     }
+    LinceFree(mover_ids);
 
     // Tile animation test
     SetupChickenAnimation();
@@ -466,6 +487,7 @@ void GameStateUpdate(float dt){
     LinceSetShaderUniformMat4(game_data.custom_shader,
         "u_view_proj", game_data.camera.view_proj);
     UpdateSpritePositions(game_data.reg);
+    UpdateTransforms();
     LinceDrawSprites(game_data.reg);
 
     // LinceDrawTilemap(&game_data.mapgrid, game_data.custom_shader);
@@ -492,8 +514,8 @@ void GameStateUpdate(float dt){
 
     array_t entities;
     array_init(&entities, sizeof(uint32_t));
-    LinceQueryEntities(game_data.reg, &entities, 1, Component_BoxCollider);
-    LinceCalculateEntityCollisions(game_data.reg, &entities, Component_BoxCollider);
+    LinceFetchEntityQuery(game_data.reg, game_data.box_query, &entities);
+    LinceCalculateEntityCollisionsHashed(game_data.reg, &entities, Component_BoxCollider, game_data.collider_grid);
     array_uninit(&entities);
 
     // Draw UI text
@@ -550,6 +572,8 @@ void GameTerminate(){
     LinceUninitTilemap(&game_data.mapgrid);
     LinceUninitTilemap(&game_data.citygrid);
 
+    LinceDestroyTransformHierarchy(game_data.transforms);
+    LinceDestroyBoxColliderGrid(game_data.collider_grid);
     LinceDestroyEntityRegistry(game_data.reg);
     LinceDeleteShader(game_data.custom_shader);
     
@@ -12,7 +12,29 @@ void test_array(void** state);
 void test_hashmap(void** state);
 void test_linkedlist(void** state);
 void test_entity(void** state);
+void test_entity_sparse(void** state);
+void test_entity_query(void** state);
+void test_entity_query_iter(void** state);
+void test_entity_query_simd(void** state);
+void test_entity_prefab(void** state);
+void test_entity_changes(void** state);
+void test_transform(void** state);
+void test_entity_compact(void** state);
+void test_entity_snapshot(void** state);
+void test_entity_stats(void** state);
+void test_box_collider(void** state);
+void test_box_collider_hashed(void** state);
+void test_box_collider_pruned(void** state);
+void test_aabb_tree(void** state);
+void test_box_collider_tree(void** state);
+void test_tile_colliders(void** state);
+void test_collision_world(void** state);
+void test_box_collider_changes(void** state);
 void test_uuid(void** state);
+void test_threadpool(void** state);
+void test_system(void** state);
+void test_parallel_for_each(void** state);
+void test_command_buffer(void** state);
 
 int main() {
     const struct CMUnitTest tests[] = {
@@ -20,7 +42,29 @@ int main() {
         cmocka_unit_test(test_hashmap),
         cmocka_unit_test(test_linkedlist),
         cmocka_unit_test(test_entity),
-        cmocka_unit_test(test_uuid)
+        cmocka_unit_test(test_entity_sparse),
+        cmocka_unit_test(test_entity_query),
+        cmocka_unit_test(test_entity_query_iter),
+        cmocka_unit_test(test_entity_query_simd),
+        cmocka_unit_test(test_entity_prefab),
+        cmocka_unit_test(test_entity_changes),
+        cmocka_unit_test(test_transform),
+        cmocka_unit_test(test_entity_compact),
+        cmocka_unit_test(test_entity_snapshot),
+        cmocka_unit_test(test_entity_stats),
+        cmocka_unit_test(test_box_collider),
+        cmocka_unit_test(test_box_collider_hashed),
+        cmocka_unit_test(test_box_collider_pruned),
+        cmocka_unit_test(test_aabb_tree),
+        cmocka_unit_test(test_box_collider_tree),
+        cmocka_unit_test(test_tile_colliders),
+        cmocka_unit_test(test_collision_world),
+        cmocka_unit_test(test_box_collider_changes),
+        cmocka_unit_test(test_uuid),
+        cmocka_unit_test(test_threadpool),
+        cmocka_unit_test(test_system),
+        cmocka_unit_test(test_parallel_for_each),
+        cmocka_unit_test(test_command_buffer)
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
\ No newline at end of file
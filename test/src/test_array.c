@@ -79,6 +79,17 @@ void test_array(void** state){
 	assert_true(a->capacity==16);
 	assert_non_null(a->data);
 
+	// Reserve
+	r = array_reserve(a, 40);
+	assert_non_null(r);
+	assert_true(a->size==10);
+	assert_true(a->capacity==64);
+	r = array_reserve(a, 20);
+	assert_true(a->capacity==64);
+	r = array_shrink_to_fit(a);
+	assert_non_null(r);
+	assert_true(a->capacity==10);
+
 	// Setting elements
 	int res = 1;
 	for(int i = 0; i != (int)a->size; ++i){
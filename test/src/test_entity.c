@@ -5,8 +5,12 @@
 #include <cmocka.h>
 
 #include <time.h>
+#include <math.h>
 #include <lince/renderer/renderer.h>
 #include <lince/entity/entity.h>
+#include <lince/entity/transform.h>
+#include <lince/entity/snapshot.h>
+#include <lince/core/cpu.h>
 #include "test.h"
 
 typedef struct Position { float x, y; } Position;
@@ -81,7 +85,6 @@ void test_entity(void** state){
     // reg = LinceCreateEntityRegistry(3, /*sizes:*/ 1, 2, 0); // error: component is zero-sized
 
     uint32_t comp_sizes[] = {sizeof(struct Position), sizeof(struct Velocity), sizeof(struct Sprite)};
-    uint32_t comp_offsets[] = {0, comp_sizes[0], comp_sizes[0]+comp_sizes[1]}; 
     uint32_t comp_num = 3;
 
     // Create Registry
@@ -92,35 +95,39 @@ void test_entity(void** state){
     
     for(uint32_t i=0; i != comp_num; ++i){
         assert_true(comp_sizes[i] == *(uint32_t*)array_get(&reg->component_sizes, i));
-        assert_true(comp_offsets[i] == *(uint32_t*)array_get(&reg->component_offsets, i));
     }
 
+    // Only the archetype of entities without components exists
+    assert_true(reg->archetypes.size == 1);
+
     // Create Entity
     uint32_t id = LinceCreateEntity(reg);
     assert_true(id == 0);
     assert_true(reg->entity_count == 1);
     assert_true(reg->entity_masks.size == 1);
-    assert_true(reg->entity_flags.size == 1);
-    assert_true(reg->entity_data.size == 1);
+    assert_true(reg->entity_active.size == 1);
+    assert_true(reg->entity_records.size == 1);
     
     uint64_t* mask = array_get(&reg->entity_masks, id);
-    LinceEntityState* flag = array_get(&reg->entity_flags, id);
-    assert_true(*flag & LinceEntityState_Active);
+    assert_true(LinceIsEntityActive(reg, id));
     assert_true(*mask == 0);
+    LinceEntityRecord* record = array_get(&reg->entity_records, id);
+    assert_true(record->archetype == 0);
+    assert_true(record->row == 0);
 
     // Create second entity
     uint32_t id2 = LinceCreateEntity(reg);
     assert_true(id2 == 1);
     assert_true(reg->entity_count == 2);
     assert_true(reg->entity_masks.size == 2);
-    assert_true(reg->entity_flags.size == 2);
-    assert_true(reg->entity_data.size == 2);
+    assert_true(reg->entity_active.size == 1);
+    assert_true(reg->entity_records.size == 2);
 
     // Delete first entity
-    flag = array_get(&reg->entity_flags, id);
     mask = array_get(&reg->entity_masks, id);
     LinceDeleteEntity(reg, id);
-    assert_true(*flag == 0);
+    assert_false(LinceIsEntityActive(reg, id));
+    assert_true(LinceIsEntityActive(reg, id2));
     assert_true(*mask == 0);
     assert_true(reg->entity_pool.size == 1);
     assert_true(*(uint32_t*)array_get(&reg->entity_pool, 0) == id);
@@ -130,8 +137,8 @@ void test_entity(void** state){
     assert_true(id3 == id);
     assert_true(reg->entity_count == 2);
     assert_true(reg->entity_masks.size == 2);
-    assert_true(reg->entity_flags.size == 2);
-    assert_true(reg->entity_data.size == 2);
+    assert_true(reg->entity_active.size == 1);
+    assert_true(reg->entity_records.size == 2);
 
     // Add components to entity third entity
     LinceAddEntityComponent(reg, id3, CompPosition, &(struct Position){1.0, 2.0});
@@ -151,6 +158,17 @@ void test_entity(void** state){
     assert_true(pos->x == 1.0);
     assert_true(pos->y == 2.0);
 
+    // Entity was moved through the {Position} archetype to {Position, Sprite}
+    assert_true(reg->archetypes.size == 3);
+    record = array_get(&reg->entity_records, id3);
+    LinceArchetype* arch = array_get(&reg->archetypes, record->archetype);
+    assert_true(arch->column_count == 2);
+    assert_true(arch->entities.size == 1);
+    assert_true(arch->columns[0].element_size == sizeof(struct Position));
+    assert_true(arch->columns[1].element_size == sizeof(struct Sprite));
+    assert_true(arch->column_index[CompVelocity] == -1);
+    assert_true(pos == array_get(&arch->columns[0], record->row));
+
     // Add components to second entity
     LinceAddEntityComponent(reg, id2, CompPosition, &(struct Position){1.0, 2.0});
     LinceAddEntityComponent(reg, id2, CompVelocity, &(struct Velocity){-1.0, 5.0});
@@ -175,6 +193,17 @@ void test_entity(void** state){
     LinceRemoveEntityComponent(reg, id2, CompVelocity);
     assert_false(LinceHasEntityComponent(reg, id2, CompVelocity));
 
+    // Remaining components are kept when moving between archetypes
+    pos = LinceGetEntityComponent(reg, id2, CompPosition);
+    assert_non_null(pos);
+    assert_true(pos->x == 1.0);
+    assert_true(pos->y == 2.0);
+    assert_null(LinceGetEntityComponent(reg, id2, CompVelocity));
+    record = array_get(&reg->entity_records, id2);
+    arch = array_get(&reg->archetypes, record->archetype);
+    assert_true(arch->column_count == 1);
+    assert_true(arch->column_ids[0] == CompPosition);
+
     // Query entities
     // -- Query sprite component
     array_t query_result_sprite;
@@ -218,3 +247,742 @@ void test_entity(void** state){
     // Destroy
     LinceDestroyEntityRegistry(reg);
 }
+
+void test_entity_sparse(void** state){
+    (void)state;
+
+    // Velocity is kept in a sparse set, the rest in archetype tables
+    LinceComponentInfo components[] = {
+        {sizeof(struct Position), LinceComponentStorage_Table},
+        {sizeof(struct Velocity), LinceComponentStorage_Sparse},
+        {sizeof(struct Sprite),   LinceComponentStorage_Table},
+    };
+    LinceEntityRegistry* reg = LinceCreateEntityRegistryFromInfo(3, components);
+    assert_true(reg->component_count == 3);
+
+    uint32_t ids[4];
+    for(uint32_t i = 0; i != 4; ++i){
+        ids[i] = LinceCreateEntity(reg);
+        LinceAddEntityComponent(reg, ids[i], CompPosition, &(struct Position){(float)i, 0.0});
+    }
+
+    // Adding a sparse component does not change the archetype
+    LinceEntityRecord* record = array_get(&reg->entity_records, ids[3]);
+    uint32_t archetype = record->archetype;
+    LinceAddEntityComponent(reg, ids[3], CompVelocity, &(struct Velocity){3.0, 1.0});
+    LinceAddEntityComponent(reg, ids[1], CompVelocity, &(struct Velocity){1.0, 1.0});
+    LinceAddEntityComponent(reg, ids[2], CompVelocity, &(struct Velocity){2.0, 1.0});
+    record = array_get(&reg->entity_records, ids[3]);
+    assert_true(record->archetype == archetype);
+    assert_true(reg->archetypes.size == 2);
+
+    LinceSparseSet* set = array_get(&reg->sparse_sets, CompVelocity);
+    assert_true(set->dense.size == 3);
+    assert_true(set->entities.size == 3);
+    assert_true(LinceHasEntityComponent(reg, ids[1], CompVelocity));
+    assert_false(LinceHasEntityComponent(reg, ids[0], CompVelocity));
+    assert_null(LinceGetEntityComponent(reg, ids[0], CompVelocity));
+
+    struct Velocity* vel = LinceGetEntityComponent(reg, ids[2], CompVelocity);
+    assert_non_null(vel);
+    assert_true(vel->vx == 2.0);
+
+    // Overwriting keeps a single element
+    LinceAddEntityComponent(reg, ids[2], CompVelocity, &(struct Velocity){5.0, 1.0});
+    assert_true(set->dense.size == 3);
+    vel = LinceGetEntityComponent(reg, ids[2], CompVelocity);
+    assert_true(vel->vx == 5.0);
+
+    // Removing moves the last element into the hole
+    LinceRemoveEntityComponent(reg, ids[3], CompVelocity);
+    assert_false(LinceHasEntityComponent(reg, ids[3], CompVelocity));
+    assert_true(set->dense.size == 2);
+    vel = LinceGetEntityComponent(reg, ids[1], CompVelocity);
+    assert_true(vel->vx == 1.0);
+    vel = LinceGetEntityComponent(reg, ids[2], CompVelocity);
+    assert_true(vel->vx == 5.0);
+
+    // Queries with sparse components return IDs in ascending order
+    array_t query;
+    array_init(&query, sizeof(uint32_t));
+    uint32_t count = LinceQueryEntities(reg, &query, 2, CompPosition, CompVelocity);
+    assert_true(count == 2);
+    assert_true(*(uint32_t*)array_get(&query, 0) == ids[1]);
+    assert_true(*(uint32_t*)array_get(&query, 1) == ids[2]);
+    array_clear(&query);
+
+    count = LinceQueryEntities(reg, &query, 2, CompVelocity, CompSprite);
+    assert_true(count == 0);
+    array_uninit(&query);
+
+    // Deleting an entity removes its sparse components
+    LinceDeleteEntity(reg, ids[1]);
+    assert_true(set->dense.size == 1);
+    uint32_t id = LinceCreateEntity(reg);
+    assert_true(id == ids[1]);
+    assert_false(LinceHasEntityComponent(reg, id, CompVelocity));
+
+    // Entity IDs beyond the first page
+    for(uint32_t i = 0; i != LINCE_SPARSE_PAGE_SIZE + 1; ++i) id = LinceCreateEntity(reg);
+    LinceAddEntityComponent(reg, id, CompVelocity, &(struct Velocity){7.0, 0.0});
+    vel = LinceGetEntityComponent(reg, id, CompVelocity);
+    assert_true(vel->vx == 7.0);
+    assert_true(set->pages.size == 2);
+
+    LinceDestroyEntityRegistry(reg);
+}
+
+void test_entity_query(void** state){
+    (void)state;
+
+    LinceComponentInfo components[] = {
+        {sizeof(struct Position), LinceComponentStorage_Table},
+        {sizeof(struct Velocity), LinceComponentStorage_Sparse},
+        {sizeof(struct Sprite),   LinceComponentStorage_Table},
+    };
+    LinceEntityRegistry* reg = LinceCreateEntityRegistryFromInfo(3, components);
+
+    uint32_t a = LinceCreateEntity(reg);
+    LinceAddEntityComponent(reg, a, CompPosition, &(struct Position){0});
+
+    // Queries match the archetypes that already exist
+    LinceEntityQuery* pos_query = LinceCreateEntityQuery(reg, 1, CompPosition);
+    LinceEntityQuery* pos_sprite_query = LinceCreateEntityQuery(reg, 2, CompPosition, CompSprite);
+    LinceEntityQuery* vel_query = LinceCreateEntityQuery(reg, 2, CompPosition, CompVelocity);
+    assert_true(reg->queries.size == 3);
+    assert_true(pos_query->archetypes.size == 1);
+    assert_true(pos_sprite_query->archetypes.size == 0);
+    assert_true(vel_query->sparse_ids.size == 1);
+
+    array_t result;
+    array_init(&result, sizeof(uint32_t));
+    assert_true(LinceFetchEntityQuery(reg, pos_query, &result) == 1);
+    assert_true(*(uint32_t*)array_get(&result, 0) == a);
+    array_clear(&result);
+
+    // New archetypes are added to the queries that match them
+    uint32_t b = LinceCreateEntity(reg);
+    LinceAddEntityComponent(reg, b, CompSprite, &(struct Sprite){0});
+    LinceAddEntityComponent(reg, b, CompPosition, &(struct Position){0});
+    assert_true(pos_query->archetypes.size == 2);
+    assert_true(pos_sprite_query->archetypes.size == 1);
+
+    assert_true(LinceFetchEntityQuery(reg, pos_query, &result) == 2);
+    array_clear(&result);
+    assert_true(LinceFetchEntityQuery(reg, pos_sprite_query, &result) == 1);
+    assert_true(*(uint32_t*)array_get(&result, 0) == b);
+    array_clear(&result);
+
+    // Entities follow their components
+    LinceRemoveEntityComponent(reg, b, CompSprite);
+    assert_true(LinceFetchEntityQuery(reg, pos_sprite_query, &result) == 0);
+    assert_true(LinceFetchEntityQuery(reg, pos_query, &result) == 2);
+    array_clear(&result);
+
+    LinceDeleteEntity(reg, a);
+    assert_true(LinceFetchEntityQuery(reg, pos_query, &result) == 1);
+    assert_true(*(uint32_t*)array_get(&result, 0) == b);
+    array_clear(&result);
+
+    // Queries with sparse components
+    assert_true(LinceFetchEntityQuery(reg, vel_query, &result) == 0);
+    LinceAddEntityComponent(reg, b, CompVelocity, &(struct Velocity){0});
+    uint32_t c = LinceCreateEntity(reg);
+    LinceAddEntityComponent(reg, c, CompVelocity, &(struct Velocity){0});
+    assert_true(LinceFetchEntityQuery(reg, vel_query, &result) == 1);
+    assert_true(*(uint32_t*)array_get(&result, 0) == b);
+    array_uninit(&result);
+
+    LinceDeleteEntityQuery(reg, pos_query);
+    assert_true(reg->queries.size == 2);
+
+    // Remaining queries are deleted with the registry
+    LinceDestroyEntityRegistry(reg);
+}
+
+void test_entity_query_iter(void** state){
+    (void)state;
+
+    LinceComponentInfo components[] = {
+        {sizeof(struct Position), LinceComponentStorage_Table},
+        {sizeof(struct Velocity), LinceComponentStorage_Sparse},
+        {sizeof(struct Sprite),   LinceComponentStorage_Table},
+    };
+    LinceEntityRegistry* reg = LinceCreateEntityRegistryFromInfo(3, components);
+    LinceEntityQuery* query = LinceCreateEntityQuery(reg, 1, CompPosition);
+    LinceEntityQuery* sparse_query = LinceCreateEntityQuery(reg, 2, CompVelocity, CompPosition);
+
+    // Two archetypes: {Position} and {Position, Sprite}
+    for(uint32_t i = 0; i != 10; ++i){
+        uint32_t id = LinceCreateEntity(reg);
+        LinceAddEntityComponent(reg, id, CompPosition, &(struct Position){(float)id, 0.0});
+        if(i % 2) LinceAddEntityComponent(reg, id, CompSprite, &(struct Sprite){0});
+        if(i % 5 == 0) LinceAddEntityComponent(reg, id, CompVelocity, &(struct Velocity){(float)id, 0.0});
+    }
+
+    LinceQueryIter it;
+    LinceInitQueryIter(&it, reg, query);
+    uint32_t chunks = 0, count = 0;
+    while(LinceNextQueryChunk(&it)){
+        struct Position* pos = it.data[0];
+        assert_true(it.stride[0] == sizeof(struct Position));
+        for(uint32_t i = 0; i != it.count; ++i){
+            assert_true(pos[i].x == (float)it.entities[i]);
+        }
+        chunks++;
+        count += it.count;
+    }
+    assert_true(chunks == 2);
+    assert_true(count == 10);
+
+    // Sparse queries yield one entity at a time, in the order requested
+    LinceInitQueryIter(&it, reg, sparse_query);
+    count = 0;
+    while(LinceNextQueryChunk(&it)){
+        assert_true(it.count == 1);
+        struct Velocity* vel = it.data[0];
+        struct Position* pos = it.data[1];
+        assert_true(vel->vx == (float)it.entities[0]);
+        assert_true(pos->x == (float)it.entities[0]);
+        count++;
+    }
+    assert_true(count == 2);
+
+    LinceDestroyEntityRegistry(reg);
+}
+
+void test_entity_query_simd(void** state){
+    (void)state;
+
+    LinceEntityRegistry* reg = LinceCreateEntityRegistry(5, SIZES);
+    void* instances[5] = {&(Position){0}, &(Velocity){0}, &(Sprite){0}, &(Timer){0}, &(BoxCollider){0}};
+
+    // Random components, with some entities deleted to leave holes in the active set
+    srand(1234);
+    uint32_t num = 100000;
+    for(uint32_t i = 0; i != num; ++i){
+        uint32_t id = LinceCreateEntity(reg);
+        for(uint32_t c = 0; c != 5; ++c){
+            if(rand() % 2) LinceAddEntityComponent(reg, id, c, instances[c]);
+        }
+    }
+    for(uint32_t i = 0; i < num; i += 7) LinceDeleteEntity(reg, i);
+    for(uint32_t i = 640; i != 768; ++i) LinceDeleteEntity(reg, i);
+
+    array_t expected, result;
+    array_init(&expected, sizeof(uint32_t));
+    array_init(&result, sizeof(uint32_t));
+
+    // Every kernel returns the same IDs as the scalar fallback
+    uint32_t features[] = {0, LinceCPUFeature_SSE2, UINT32_MAX};
+    for(uint32_t q = 0; q != 3; ++q){
+        array_clear(&expected);
+        LinceSetCPUFeatureMask(0);
+        uint32_t n = LinceQueryEntities(reg, &expected, 2, q, q + 2);
+        assert_true(n == expected.size);
+
+        for(uint32_t i = 0; i != n; ++i){
+            uint32_t id = *(uint32_t*)array_get(&expected, i);
+            assert_true(LinceIsEntityActive(reg, id));
+            assert_true(LinceHasEntityComponent(reg, id, q));
+            assert_true(LinceHasEntityComponent(reg, id, q + 2));
+            if(i > 0) assert_true(id > *(uint32_t*)array_get(&expected, i - 1));
+        }
+
+        for(uint32_t f = 1; f != 3; ++f){
+            array_clear(&result);
+            LinceSetCPUFeatureMask(features[f]);
+            assert_true(LinceQueryEntities(reg, &result, 2, q, q + 2) == n);
+            assert_memory_equal(result.data, expected.data, n * sizeof(uint32_t));
+        }
+    }
+    LinceSetCPUFeatureMask(UINT32_MAX);
+
+    array_uninit(&expected);
+    array_uninit(&result);
+    LinceDestroyEntityRegistry(reg);
+}
+
+void test_entity_prefab(void** state){
+    (void)state;
+
+    LinceComponentInfo components[] = {
+        {sizeof(struct Position), LinceComponentStorage_Table},
+        {sizeof(struct Velocity), LinceComponentStorage_Sparse},
+        {sizeof(struct Sprite),   LinceComponentStorage_Table},
+    };
+    LinceEntityRegistry* reg = LinceCreateEntityRegistryFromInfo(3, components);
+    LinceEntityQuery* query = LinceCreateEntityQuery(reg, 2, CompPosition, CompVelocity);
+
+    LincePrefab* prefab = LinceCreatePrefab(reg);
+    LinceSetPrefabComponent(prefab, CompPosition, &(struct Position){1.0, 2.0});
+    LinceSetPrefabComponent(prefab, CompVelocity, &(struct Velocity){3.0, 4.0});
+    LinceSetPrefabComponent(prefab, CompSprite, &(struct Sprite){0});
+    LinceRemovePrefabComponent(prefab, CompSprite);
+
+    // Deleted IDs are recycled before new ones are allocated
+    uint32_t first = LinceCreateEntity(reg);
+    LinceCreateEntity(reg);
+    LinceDeleteEntity(reg, first);
+
+    uint32_t num = 1000;
+    uint32_t ids[1000];
+    LinceInstantiate(reg, prefab, num, ids);
+    assert_true(ids[0] == first);
+    assert_true(reg->entity_count == num + 1);
+
+    for(uint32_t i = 0; i != num; ++i){
+        assert_true(LinceIsEntityActive(reg, ids[i]));
+        assert_false(LinceHasEntityComponent(reg, ids[i], CompSprite));
+        struct Position* pos = LinceGetEntityComponent(reg, ids[i], CompPosition);
+        struct Velocity* vel = LinceGetEntityComponent(reg, ids[i], CompVelocity);
+        assert_true(pos->x == 1.0 && pos->y == 2.0);
+        assert_true(vel->vx == 3.0 && vel->vy == 4.0);
+    }
+
+    array_t result;
+    array_init(&result, sizeof(uint32_t));
+    assert_true(LinceFetchEntityQuery(reg, query, &result) == num);
+    array_uninit(&result);
+
+    // Instances behave like any other entity
+    LinceRemoveEntityComponent(reg, ids[10], CompPosition);
+    LinceDeleteEntity(reg, ids[0]);
+    struct Position* pos = LinceGetEntityComponent(reg, ids[num - 1], CompPosition);
+    assert_true(pos->x == 1.0);
+    assert_true(LinceGetEntityComponent(reg, ids[10], CompVelocity) != NULL);
+
+    LinceDestroyPrefab(prefab);
+    LinceDestroyEntityRegistry(reg);
+}
+
+void test_entity_changes(void** state){
+    (void)state;
+
+    LinceComponentInfo components[] = {
+        {sizeof(struct Position), LinceComponentStorage_Table},
+        {sizeof(struct Velocity), LinceComponentStorage_Sparse},
+        {sizeof(struct Sprite),   LinceComponentStorage_Table},
+    };
+    LinceEntityRegistry* reg = LinceCreateEntityRegistryFromInfo(3, components);
+    LinceEntityQuery* query = LinceCreateEntityQuery(reg, 1, CompPosition);
+    LinceEntityQuery* sparse_query = LinceCreateEntityQuery(reg, 2, CompPosition, CompVelocity);
+    array_t changed;
+    array_init(&changed, sizeof(uint32_t));
+
+    uint32_t ids[10];
+    for(uint32_t i = 0; i != 10; ++i){
+        ids[i] = LinceCreateEntity(reg);
+        LinceAddEntityComponent(reg, ids[i], CompPosition, &(struct Position){(float)i, 0.0});
+        LinceAddEntityComponent(reg, ids[i], CompVelocity, &(struct Velocity){0.0, 0.0});
+    }
+    assert_true(LinceGetEntityComponentTick(reg, ids[0], CompPosition) == 1);
+    assert_true(LinceGetEntityComponentTick(reg, ids[0], CompSprite) == 0);
+
+    // Everything changed since the start
+    assert_true(LinceFetchChangedEntities(reg, query, CompPosition, 0, &changed) == 10);
+    uint32_t last = LinceAdvanceChangeTick(reg);
+    assert_true(last == 1);
+    array_clear(&changed);
+    assert_true(LinceFetchChangedEntities(reg, query, CompPosition, last, &changed) == 0);
+
+    // Reading does not count as a change, writing does
+    LinceGetEntityComponent(reg, ids[1], CompPosition);
+    struct Position* pos = LinceGetMutableEntityComponent(reg, ids[2], CompPosition);
+    pos->x = 20.0;
+    LinceMarkEntityComponentChanged(reg, ids[3], CompPosition);
+    LinceGetMutableEntityComponent(reg, ids[4], CompVelocity);
+    assert_true(LinceFetchChangedEntities(reg, query, CompPosition, last, &changed) == 2);
+    assert_true(LinceFetchChangedEntities(reg, sparse_query, CompVelocity, last, &changed) == 1);
+    assert_true(*(uint32_t*)array_get(&changed, 2) == ids[4]);
+
+    // Ticks move along with entities between tables and within them
+    LinceAddEntityComponent(reg, ids[2], CompSprite, &(struct Sprite){0});
+    LinceDeleteEntity(reg, ids[0]);
+    assert_true(LinceGetEntityComponentTick(reg, ids[2], CompPosition) == 2);
+    assert_true(LinceGetEntityComponentTick(reg, ids[9], CompPosition) == 1);
+    LinceRemoveEntityComponent(reg, ids[4], CompVelocity);
+    assert_true(LinceGetEntityComponentTick(reg, ids[5], CompVelocity) == 1);
+
+    // Marking whole chunks
+    last = LinceAdvanceChangeTick(reg);
+    LinceQueryIter it;
+    LinceInitQueryIter(&it, reg, query);
+    while(LinceNextQueryChunk(&it)) LinceMarkQueryChunkChanged(&it, 0);
+    array_clear(&changed);
+    assert_true(LinceFetchChangedEntities(reg, query, CompPosition, last, &changed) == 9);
+
+    array_uninit(&changed);
+    LinceDestroyEntityRegistry(reg);
+}
+
+static int float_eq(float a, float b){
+    return fabsf(a - b) < 1e-5f;
+}
+
+void test_transform(void** state){
+    (void)state;
+
+    enum { CompTransform, CompTarget };
+    LinceEntityRegistry* reg = LinceCreateEntityRegistry(2, sizeof(LinceTransform), sizeof(Position));
+    LinceTransformHierarchy* hierarchy = LinceCreateTransformHierarchy(reg, CompTransform);
+    LinceAddTransformTarget(hierarchy, CompTarget,
+        offsetof(Position, x), offsetof(Position, y), LINCE_TRANSFORM_NO_FIELD);
+
+    // Children are created before their parents, so the order must be sorted
+    uint32_t grandchild = LinceCreateEntity(reg);
+    uint32_t child = LinceCreateEntity(reg);
+    uint32_t root = LinceCreateEntity(reg);
+    uint32_t other = LinceCreateEntity(reg);
+    LinceAddEntityComponent(reg, root, CompTransform, &(LinceTransform){.x = 1.0f, .y = 2.0f, .scale = 2.0f});
+    LinceAddEntityComponent(reg, child, CompTransform, &(LinceTransform){.x = 1.0f, .rotation = 90.0f});
+    LinceAddEntityComponent(reg, grandchild, CompTransform, &(LinceTransform){.x = 1.0f});
+    LinceAddEntityComponent(reg, other, CompTransform, &(LinceTransform){.x = 5.0f});
+    LinceAddEntityComponent(reg, grandchild, CompTarget, &(Position){0});
+    LinceSetTransformParent(hierarchy, child, root);
+    LinceSetTransformParent(hierarchy, grandchild, child);
+    assert_true(LinceGetTransformParent(hierarchy, grandchild) == child);
+    assert_true(LinceGetTransformParent(hierarchy, root) == LINCE_TRANSFORM_NO_PARENT);
+
+    LinceUpdateTransforms(hierarchy);
+    assert_true(hierarchy->update_count == 4);
+
+    // The child is rotated a quarter turn clockwise, so x points down
+    LinceTransform* t = LinceGetEntityComponent(reg, grandchild, CompTransform);
+    assert_true(float_eq(t->world_x, 3.0f));
+    assert_true(float_eq(t->world_y, 0.0f));
+    assert_true(float_eq(t->world_rotation, 90.0f));
+    assert_true(float_eq(t->world_scale, 2.0f));
+    Position* pos = LinceGetEntityComponent(reg, grandchild, CompTarget);
+    assert_true(float_eq(pos->x, 3.0f) && float_eq(pos->y, 0.0f));
+
+    // Nothing changed
+    LinceUpdateTransforms(hierarchy);
+    assert_true(hierarchy->update_count == 0);
+
+    // Moving a parent updates its subtree only
+    t = LinceGetMutableEntityComponent(reg, root, CompTransform);
+    t->x = 2.0f;
+    LinceUpdateTransforms(hierarchy);
+    assert_true(hierarchy->update_count == 3);
+    pos = LinceGetEntityComponent(reg, grandchild, CompTarget);
+    assert_true(float_eq(pos->x, 4.0f));
+
+    // Detached entities are roots
+    LinceSetTransformParent(hierarchy, grandchild, LINCE_TRANSFORM_NO_PARENT);
+    LinceUpdateTransforms(hierarchy);
+    t = LinceGetEntityComponent(reg, grandchild, CompTransform);
+    assert_true(float_eq(t->world_x, 1.0f) && float_eq(t->world_y, 0.0f));
+
+    // Deleting a parent turns its children into roots
+    LinceSetTransformParent(hierarchy, grandchild, child);
+    LinceDeleteEntity(reg, child);
+    LinceUpdateTransforms(hierarchy);
+    t = LinceGetEntityComponent(reg, grandchild, CompTransform);
+    assert_true(float_eq(t->world_x, 1.0f));
+    assert_true(hierarchy->order.size == 3);
+    // and they stay roots once the ID is recycled
+    uint32_t recycled = LinceCreateEntity(reg);
+    assert_true(recycled == child);
+    LinceAddEntityComponent(reg, recycled, CompTransform, &(LinceTransform){0});
+    assert_true(LinceGetTransformParent(hierarchy, grandchild) == LINCE_TRANSFORM_NO_PARENT);
+
+    // Cycles are rejected when the parent is set
+    assert_true(LinceSetTransformParent(hierarchy, grandchild, root));
+    assert_true(LinceSetTransformParent(hierarchy, recycled, grandchild));
+    assert_false(LinceSetTransformParent(hierarchy, root, recycled));
+    assert_false(LinceSetTransformParent(hierarchy, grandchild, recycled));
+    assert_true(LinceGetTransformParent(hierarchy, root) == LINCE_TRANSFORM_NO_PARENT);
+    assert_true(LinceGetTransformParent(hierarchy, grandchild) == root);
+
+    // Deleting through the hierarchy detaches the children at once
+    LinceDeleteTransformEntity(hierarchy, grandchild);
+    uint32_t reused = LinceCreateEntity(reg);
+    assert_true(reused == grandchild);
+    LinceAddEntityComponent(reg, reused, CompTransform, &(LinceTransform){0});
+    assert_true(LinceGetTransformParent(hierarchy, recycled) == LINCE_TRANSFORM_NO_PARENT);
+
+    // Roots take their position from the source component when it changes
+    LinceSetTransformSource(hierarchy, CompTarget, offsetof(Position, x), offsetof(Position, y));
+    LinceAddEntityComponent(reg, root, CompTarget, &(Position){7.0f, 8.0f});
+    LinceSetTransformParent(hierarchy, recycled, root);
+    LinceUpdateTransforms(hierarchy);
+    t = LinceGetEntityComponent(reg, recycled, CompTransform);
+    assert_true(float_eq(t->world_x, 7.0f) && float_eq(t->world_y, 8.0f));
+    LinceUpdateTransforms(hierarchy);
+    assert_true(hierarchy->update_count == 0);
+    pos = LinceGetMutableEntityComponent(reg, root, CompTarget);
+    pos->x = 9.0f;
+    LinceUpdateTransforms(hierarchy);
+    assert_true(hierarchy->update_count == 2);
+    assert_true(float_eq(t->world_x, 9.0f));
+
+    LinceDestroyTransformHierarchy(hierarchy);
+    LinceDestroyEntityRegistry(reg);
+}
+
+void test_entity_compact(void** state){
+    (void)state;
+
+    LinceComponentInfo components[] = {
+        {sizeof(struct Position), LinceComponentStorage_Table},
+        {sizeof(struct Velocity), LinceComponentStorage_Sparse},
+        {sizeof(LinceTransform),  LinceComponentStorage_Table},
+    };
+    enum { CompTransform = 2 };
+    LinceEntityRegistry* reg = LinceCreateEntityRegistryFromInfo(3, components);
+    LinceEntityQuery* query = LinceCreateEntityQuery(reg, 1, CompPosition);
+    LinceTransformHierarchy* hierarchy = LinceCreateTransformHierarchy(reg, CompTransform);
+
+    // Interleave two archetypes, then delete most entities
+    uint32_t num = 3000;
+    for(uint32_t i = 0; i != num; ++i){
+        uint32_t id = LinceCreateEntity(reg);
+        LinceAddEntityComponent(reg, id, CompPosition, &(struct Position){(float)i, 0.0});
+        if(i % 2) LinceAddEntityComponent(reg, id, CompVelocity, &(struct Velocity){(float)i, 0.0});
+    }
+    for(uint32_t i = 0; i != num; ++i){
+        if(i % 3) LinceDeleteEntity(reg, i);
+    }
+    uint32_t parent = 2997, child = 2994; // both multiples of three
+    LinceAddEntityComponent(reg, parent, CompTransform, &(LinceTransform){0});
+    LinceAddEntityComponent(reg, child, CompTransform, &(LinceTransform){0});
+    LinceSetTransformParent(hierarchy, child, parent);
+
+    array_t remap;
+    array_init(&remap, sizeof(uint32_t));
+    uint32_t live = LinceCompactEntityRegistry(reg, &remap);
+    assert_true(live == num / 3);
+    assert_true(reg->entity_count == live);
+    assert_true(reg->entity_pool.size == 0);
+    assert_true(reg->entity_masks.capacity == live);
+    assert_true(remap.size == num);
+
+    // Components follow their entities
+    for(uint32_t i = 0; i != num; ++i){
+        uint32_t id = *(uint32_t*)array_get(&remap, i);
+        if(i % 3){
+            assert_true(id == LINCE_ENTITY_REMOVED);
+            continue;
+        }
+        assert_true(id < live);
+        assert_true(LinceIsEntityActive(reg, id));
+        struct Position* pos = LinceGetEntityComponent(reg, id, CompPosition);
+        assert_true(pos->x == (float)i);
+        struct Velocity* vel = LinceGetEntityComponent(reg, id, CompVelocity);
+        assert_true((vel != NULL) == (i % 2 == 1));
+        if(vel) assert_true(vel->vx == (float)i);
+    }
+
+    // Entities of the same archetype have consecutive IDs
+    array_t result;
+    array_init(&result, sizeof(uint32_t));
+    LinceFetchEntityQuery(reg, query, &result);
+    for(uint32_t i = 1; i != result.size; ++i){
+        assert_true(*(uint32_t*)array_get(&result, i) == *(uint32_t*)array_get(&result, i - 1) + 1);
+    }
+    array_uninit(&result);
+
+    // New entities follow the live ones
+    assert_true(LinceCreateEntity(reg) == live);
+
+    LinceRemapTransformParents(hierarchy, &remap);
+    uint32_t new_child = *(uint32_t*)array_get(&remap, child);
+    uint32_t new_parent = *(uint32_t*)array_get(&remap, parent);
+    assert_true(LinceGetTransformParent(hierarchy, new_child) == new_parent);
+
+    array_uninit(&remap);
+    LinceDestroyTransformHierarchy(hierarchy);
+    LinceDestroyEntityRegistry(reg);
+}
+
+/* Stores the x position as an offset from a base, and restores it on load */
+static void SnapshotFixup(uint32_t component_id, void* components, uint32_t count,
+    LinceSnapshotOp op, void* user_data)
+{
+    if(component_id != CompPosition) return;
+    float base = *(float*)user_data;
+    struct Position* pos = components;
+    for(uint32_t i = 0; i != count; ++i){
+        pos[i].x += op == LinceSnapshot_Save ? -base : base;
+    }
+}
+
+void test_entity_snapshot(void** state){
+    (void)state;
+    const char* path = "test_entity_snapshot.ecs";
+
+    LinceComponentInfo components[] = {
+        {sizeof(struct Position), LinceComponentStorage_Table},
+        {sizeof(struct Velocity), LinceComponentStorage_Sparse},
+    };
+    LinceEntityRegistry* reg = LinceCreateEntityRegistryFromInfo(2, components);
+
+    uint32_t num = 1000;
+    for(uint32_t i = 0; i != num; ++i){
+        uint32_t id = LinceCreateEntity(reg);
+        LinceAddEntityComponent(reg, id, CompPosition, &(struct Position){(float)i, 1.0});
+        if(i % 2) LinceAddEntityComponent(reg, id, CompVelocity, &(struct Velocity){(float)i, 2.0});
+    }
+    for(uint32_t i = 0; i < num; i += 5) LinceDeleteEntity(reg, i);
+    LinceAdvanceChangeTick(reg);
+    LinceMarkEntityComponentChanged(reg, 1, CompPosition);
+
+    float base = 100.0f;
+    assert_true(LinceSaveEntityRegistry(reg, path, SnapshotFixup, &base));
+    // The fixup converts a copy
+    assert_true(((struct Position*)LinceGetEntityComponent(reg, 1, CompPosition))->x == 1.0f);
+
+    LinceEntityRegistry* loaded = LinceLoadEntityRegistry(path, SnapshotFixup, &base);
+    assert_non_null(loaded);
+    assert_true(loaded->entity_count == reg->entity_count);
+    assert_true(loaded->entity_pool.size == reg->entity_pool.size);
+    assert_true(loaded->change_tick == reg->change_tick);
+
+    for(uint32_t i = 0; i != num; ++i){
+        assert_true(LinceIsEntityActive(loaded, i) == LinceIsEntityActive(reg, i));
+        if(!LinceIsEntityActive(reg, i)) continue;
+        struct Position* pos = LinceGetEntityComponent(loaded, i, CompPosition);
+        assert_non_null(pos);
+        assert_true(pos->x == (float)i && pos->y == 1.0f);
+        struct Velocity* vel = LinceGetEntityComponent(loaded, i, CompVelocity);
+        assert_true((vel != NULL) == (i % 2 == 1));
+        if(vel) assert_true(vel->vx == (float)i && vel->vy == 2.0f);
+        assert_true(LinceGetEntityComponentTick(loaded, i, CompPosition) ==
+            LinceGetEntityComponentTick(reg, i, CompPosition));
+        assert_true(LinceGetEntityComponentTick(loaded, i, CompVelocity) ==
+            LinceGetEntityComponentTick(reg, i, CompVelocity));
+    }
+
+    // Queries and recycled IDs work on the loaded registry
+    LinceEntityQuery* query = LinceCreateEntityQuery(loaded, 2, CompPosition, CompVelocity);
+    array_t result;
+    array_init(&result, sizeof(uint32_t));
+    LinceFetchEntityQuery(loaded, query, &result);
+    assert_true(result.size == 400); // odd IDs not multiple of five
+    array_uninit(&result);
+    uint32_t id = LinceCreateEntity(loaded);
+    assert_true(id < num && id % 5 == 0);
+    LinceAddEntityComponent(loaded, id, CompVelocity, &(struct Velocity){0});
+    assert_true(LinceHasEntityComponent(loaded, id, CompVelocity));
+
+    LinceDestroyEntityRegistry(loaded);
+
+    // Inconsistent files are rejected: a sparse set with a repeated entity,
+    LinceSparseSet* set = array_get(&reg->sparse_sets, CompVelocity);
+    uint32_t repeated = *(uint32_t*)array_get(&set->entities, 0), tick = 0;
+    struct Velocity vel = *(struct Velocity*)array_get(&set->dense, 0);
+    array_push_back(&set->entities, &repeated);
+    array_push_back(&set->dense, &vel);
+    array_push_back(&set->ticks, &tick);
+    assert_true(LinceSaveEntityRegistry(reg, path, NULL, NULL));
+    assert_null(LinceLoadEntityRegistry(path, NULL, NULL));
+    array_pop_back(&set->entities);
+    array_pop_back(&set->dense);
+    array_pop_back(&set->ticks);
+
+    // a table saved twice,
+    LinceArchetype table = *(LinceArchetype*)array_get(&reg->archetypes, 1);
+    array_push_back(&reg->archetypes, &table);
+    assert_true(LinceSaveEntityRegistry(reg, path, NULL, NULL));
+    assert_null(LinceLoadEntityRegistry(path, NULL, NULL));
+    array_pop_back(&reg->archetypes);
+
+    // and an entity whose mask does not match its table
+    uint64_t* mask = array_get(&reg->entity_masks, 1);
+    mask[0] ^= (uint64_t)1 << CompPosition;
+    assert_true(LinceSaveEntityRegistry(reg, path, NULL, NULL));
+    assert_null(LinceLoadEntityRegistry(path, NULL, NULL));
+    mask[0] ^= (uint64_t)1 << CompPosition;
+    assert_true(LinceSaveEntityRegistry(reg, path, NULL, NULL));
+    loaded = LinceLoadEntityRegistry(path, NULL, NULL);
+    assert_non_null(loaded);
+    LinceDestroyEntityRegistry(loaded);
+
+    // Truncated and foreign files are rejected
+    FILE* file = fopen(path, "rb");
+    assert_non_null(file);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* bytes = LinceMalloc(size);
+    assert_true(fread(bytes, 1, size, file) == (size_t)size);
+    fclose(file);
+    file = fopen(path, "wb");
+    fwrite(bytes, 1, size / 2, file);
+    fclose(file);
+    LinceFree(bytes);
+    assert_null(LinceLoadEntityRegistry(path, NULL, NULL));
+    file = fopen(path, "wb");
+    fputs("not a snapshot", file);
+    fclose(file);
+    assert_null(LinceLoadEntityRegistry(path, NULL, NULL));
+    assert_null(LinceLoadEntityRegistry("missing_snapshot.ecs", NULL, NULL));
+
+    remove(path);
+    LinceDestroyEntityRegistry(reg);
+}
+
+void test_entity_stats(void** state){
+    (void)state;
+
+    LinceComponentInfo components[] = {
+        {sizeof(struct Position), LinceComponentStorage_Table},
+        {sizeof(struct Velocity), LinceComponentStorage_Sparse},
+    };
+    LinceEntityRegistry* reg = LinceCreateEntityRegistryFromInfo(2, components);
+    LinceEntityQuery* query = LinceCreateEntityQuery(reg, 1, CompPosition);
+
+    uint32_t num = 100;
+    for(uint32_t i = 0; i != num; ++i){
+        uint32_t id = LinceCreateEntity(reg);
+        LinceAddEntityComponent(reg, id, CompPosition, &(struct Position){0});
+        if(i < 10) LinceAddEntityComponent(reg, id, CompVelocity, &(struct Velocity){0});
+    }
+    for(uint32_t i = 0; i != 20; ++i) LinceDeleteEntity(reg, i);
+
+    LinceEntityRegistryStats stats;
+    LinceGetEntityRegistryStats(reg, &stats);
+    assert_int_equal(stats.live_count, 80);
+    assert_int_equal(stats.dead_count, 20);
+    assert_int_equal(stats.pooled_count, 20);
+    assert_int_equal(stats.archetype_count, reg->archetypes.size);
+    assert_true(stats.entity_bytes >= num * (sizeof(LinceEntityRecord) + sizeof(LinceEntityMask)));
+
+    LinceComponentStats* pos = &stats.components[CompPosition];
+    assert_int_equal(pos->count, 80);
+    assert_true(pos->capacity >= pos->count);
+    assert_true(pos->used_bytes == 80 * (sizeof(struct Position) + sizeof(uint32_t)));
+    assert_true(pos->allocated_bytes >= pos->used_bytes);
+    LinceComponentStats* vel = &stats.components[CompVelocity];
+    assert_int_equal(vel->count, 0);
+    assert_true(vel->allocated_bytes >= sizeof(uint32_t) * LINCE_SPARSE_PAGE_SIZE); // one page
+    assert_true(stats.used_bytes == pos->used_bytes + vel->used_bytes);
+
+    // Fetches and complete iterations are counted
+    assert_int_equal(stats.query_count, 1);
+    assert_int_equal(query->call_count, 0);
+    array_t result;
+    array_init(&result, sizeof(uint32_t));
+    LinceFetchEntityQuery(reg, query, &result);
+    LinceQueryIter it;
+    LinceInitQueryIter(&it, reg, query);
+    while(LinceNextQueryChunk(&it));
+    assert_false(LinceNextQueryChunk(&it));
+    assert_int_equal(query->call_count, 2);
+    assert_true(query->time_ms >= 0.0);
+
+    // Also while the registry is locked
+    reg->locked = LinceTrue;
+    LinceFetchEntityQuery(reg, query, &result);
+    reg->locked = LinceFalse;
+    LinceGetEntityRegistryStats(reg, &stats);
+    assert_int_equal(stats.query_calls, 3);
+
+    LinceResetEntityQueryStats(reg);
+    assert_int_equal(query->call_count, 0);
+    assert_true(query->time_ms == 0.0);
+
+    array_uninit(&result);
+    LinceDestroyEntityRegistry(reg);
+}
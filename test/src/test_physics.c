@@ -0,0 +1,584 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <lince/entity/entity.h>
+#include <lince/physics/boxcollider.h>
+#include <lince/physics/spatial_hash.h>
+#include <lince/physics/sweep_prune.h>
+#include <lince/physics/aabb_tree.h>
+#include <lince/physics/tile_collider.h>
+#include <lince/physics/collision_world.h>
+#include <lince/core/cpu.h>
+#include "test.h"
+
+enum { CompBox };
+
+/* Fills a registry with a closed room of static walls and a crowd of moving boxes */
+static LinceEntityRegistry* CreateBoxScene(uint32_t mover_count, uint32_t seed, array_t* entities){
+    LinceEntityRegistry* reg = LinceCreateEntityRegistry(1, sizeof(LinceBoxCollider));
+    srand(seed);
+
+    float size = 20.0f;
+    LinceBoxCollider walls[] = {
+        {.x = 0.0f, .y = -size, .w = 2.0f * size, .h = 1.0f, .flags = LinceBoxCollider_Static},
+        {.x = 0.0f, .y =  size, .w = 2.0f * size, .h = 1.0f, .flags = LinceBoxCollider_Static},
+        {.x = -size, .y = 0.0f, .w = 1.0f, .h = 2.0f * size, .flags = LinceBoxCollider_Static},
+        {.x =  size, .y = 0.0f, .w = 1.0f, .h = 2.0f * size, .flags = LinceBoxCollider_Static},
+    };
+    for(uint32_t i = 0; i != sizeof(walls) / sizeof(walls[0]); ++i){
+        uint32_t id = LinceCreateEntity(reg);
+        LinceAddEntityComponent(reg, id, CompBox, &walls[i]);
+    }
+    // Pillars inside the room
+    for(uint32_t i = 0; i != 50; ++i){
+        uint32_t id = LinceCreateEntity(reg);
+        LinceAddEntityComponent(reg, id, CompBox, &(LinceBoxCollider){
+            .x = (float)(rand() % 36) - 18.0f, .y = (float)(rand() % 36) - 18.0f,
+            .w = 0.5f, .h = 0.5f, .flags = LinceBoxCollider_Static
+        });
+    }
+    for(uint32_t i = 0; i != mover_count; ++i){
+        uint32_t id = LinceCreateEntity(reg);
+        LinceAddEntityComponent(reg, id, CompBox, &(LinceBoxCollider){
+            .x = (float)rand() / (float)RAND_MAX * 36.0f - 18.0f,
+            .y = (float)rand() / (float)RAND_MAX * 36.0f - 18.0f,
+            .w = 0.2f, .h = 0.2f,
+            .dx = (float)rand() / (float)RAND_MAX * 0.2f - 0.1f,
+            .dy = i % 7 ? (float)rand() / (float)RAND_MAX * 0.2f - 0.1f : 0.0f,
+            .flags = i % 2 ? LinceBoxCollider_Bounce : 0
+        });
+    }
+
+    array_init(entities, sizeof(uint32_t));
+    for(uint32_t i = 0; i != reg->entity_count; ++i) array_push_back(entities, &i);
+    return reg;
+}
+
+/* Returns true if the boxes of both registries are identical */
+static LinceBool CompareBoxScenes(LinceEntityRegistry* a, LinceEntityRegistry* b){
+    for(uint32_t i = 0; i != a->entity_count; ++i){
+        if(!LinceIsEntityActive(a, i)) continue;
+        LinceBoxCollider* box_a = LinceGetEntityComponent(a, i, CompBox);
+        LinceBoxCollider* box_b = LinceGetEntityComponent(b, i, CompBox);
+        if(memcmp(box_a, box_b, sizeof(LinceBoxCollider)) != 0) return LinceFalse;
+    }
+    return LinceTrue;
+}
+
+void test_box_collider(void** state){
+    (void)state;
+
+    LinceBoxCollider a = {.x = 0.0f, .y = 0.0f, .w = 2.0f, .h = 2.0f};
+    LinceBoxCollider b = {.x = 2.0f, .y = 0.0f, .w = 2.0f, .h = 2.0f};
+    assert_true(LinceBoxCollides(&a, &b)); // touching edges collide
+    b.x += 0.01f;
+    assert_false(LinceBoxCollides(&a, &b));
+
+    // A blocked axis does not prevent moving along the other
+    LinceEntityRegistry* reg = LinceCreateEntityRegistry(1, sizeof(LinceBoxCollider));
+    uint32_t wall = LinceCreateEntity(reg), mover = LinceCreateEntity(reg);
+    LinceAddEntityComponent(reg, wall, CompBox, &(LinceBoxCollider){
+        .x = 1.0f, .y = 0.0f, .w = 1.0f, .h = 10.0f, .flags = LinceBoxCollider_Static});
+    LinceAddEntityComponent(reg, mover, CompBox, &(LinceBoxCollider){
+        .x = 0.0f, .y = 0.0f, .w = 0.5f, .h = 0.5f, .dx = 0.3f, .dy = 0.1f, .flags = LinceBoxCollider_Bounce});
+    array_t entities;
+    array_init(&entities, sizeof(uint32_t));
+    LinceFetchEntityQuery(reg, LinceCreateEntityQuery(reg, 1, CompBox), &entities);
+
+    LinceCalculateEntityCollisions(reg, &entities, CompBox);
+    LinceBoxCollider* box = LinceGetEntityComponent(reg, mover, CompBox);
+    assert_true(box->x == 0.0f && box->y == 0.1f);
+    assert_true(box->flags & LinceBoxCollider_CollisionX);
+    assert_false(box->flags & LinceBoxCollider_CollisionY);
+    assert_true(box->dx == -0.3f); // bounced
+
+    array_uninit(&entities);
+    LinceDestroyEntityRegistry(reg);
+}
+
+void test_box_collider_hashed(void** state){
+    (void)state;
+
+    uint32_t movers = 2000;
+    array_t entities, copy;
+    LinceEntityRegistry* brute = CreateBoxScene(movers, 7, &entities);
+    LinceEntityRegistry* hashed = CreateBoxScene(movers, 7, &copy);
+    array_uninit(&copy);
+    LinceBoxColliderGrid* grid = LinceCreateBoxColliderGrid(0.5f);
+
+    // The same boxes collide and move, step after step
+    for(uint32_t step = 0; step != 20; ++step){
+        LinceCalculateEntityCollisions(brute, &entities, CompBox);
+        LinceCalculateEntityCollisionsHashed(hashed, &entities, CompBox, grid);
+        assert_true(CompareBoxScenes(brute, hashed));
+    }
+    uint32_t total = brute->entity_count, collided = 0;
+    for(uint32_t i = 0; i != total; ++i){
+        LinceBoxCollider* box = LinceGetEntityComponent(hashed, i, CompBox);
+        if(box->flags & LinceBoxCollider_Collision) collided++;
+    }
+    assert_true(collided > 0);
+    assert_true(grid->test_count < total * total / 50);
+
+    // Static boxes are inserted again after they move
+    LinceBoxCollider* pillar = LinceGetEntityComponent(hashed, 10, CompBox);
+    LinceBoxCollider* other = LinceGetEntityComponent(brute, 10, CompBox);
+    pillar->x = other->x = 0.0f;
+    pillar->y = other->y = 0.0f;
+    LinceInvalidateBoxColliderGrid(grid);
+    for(uint32_t step = 0; step != 5; ++step){
+        LinceCalculateEntityCollisions(brute, &entities, CompBox);
+        LinceCalculateEntityCollisionsHashed(hashed, &entities, CompBox, grid);
+        assert_true(CompareBoxScenes(brute, hashed));
+    }
+
+    // And after structural changes
+    LinceDeleteEntity(brute, 0);
+    LinceDeleteEntity(hashed, 0);
+    array_remove(&entities, 0);
+    for(uint32_t step = 0; step != 5; ++step){
+        LinceCalculateEntityCollisions(brute, &entities, CompBox);
+        LinceCalculateEntityCollisionsHashed(hashed, &entities, CompBox, grid);
+        assert_true(CompareBoxScenes(brute, hashed));
+    }
+
+    LinceDestroyBoxColliderGrid(grid);
+    array_uninit(&entities);
+    LinceDestroyEntityRegistry(brute);
+    LinceDestroyEntityRegistry(hashed);
+}
+
+void test_box_collider_pruned(void** state){
+    (void)state;
+
+    uint32_t movers = 2000;
+    array_t entities, copy;
+    LinceEntityRegistry* brute = CreateBoxScene(movers, 11, &entities);
+    LinceEntityRegistry* pruned = CreateBoxScene(movers, 11, &copy);
+    array_uninit(&copy);
+    LinceSweepAndPrune* sap = LinceCreateSweepAndPrune();
+
+    for(uint32_t step = 0; step != 20; ++step){
+        LinceCalculateEntityCollisions(brute, &entities, CompBox);
+        LinceCalculateEntityCollisionsPruned(pruned, &entities, CompBox, sap);
+        assert_true(CompareBoxScenes(brute, pruned));
+    }
+    uint32_t total = brute->entity_count;
+    assert_true(sap->boxes.size == total);
+    assert_true(sap->test_count < total * total / 50);
+    // Boxes move little each step, so edges only pass a few others
+    assert_true(sap->swap_count < total * total / 100);
+
+    // Static boxes may move without further notice
+    LinceBoxCollider* pillar = LinceGetEntityComponent(pruned, 10, CompBox);
+    LinceBoxCollider* other = LinceGetEntityComponent(brute, 10, CompBox);
+    pillar->x = other->x = 0.0f;
+    pillar->y = other->y = 0.0f;
+    for(uint32_t step = 0; step != 5; ++step){
+        LinceCalculateEntityCollisions(brute, &entities, CompBox);
+        LinceCalculateEntityCollisionsPruned(pruned, &entities, CompBox, sap);
+        assert_true(CompareBoxScenes(brute, pruned));
+    }
+
+    // Unlisted entities are dropped, and new ones are sorted into place
+    LinceDeleteEntity(brute, 0);
+    LinceDeleteEntity(pruned, 0);
+    array_remove(&entities, 0);
+    for(uint32_t i = 0; i != 10; ++i){
+        LinceBoxCollider box = {.x = (float)i - 5.0f, .y = 0.5f, .w = 0.3f, .h = 0.3f, .dy = 0.05f};
+        uint32_t id = LinceCreateEntity(brute);
+        LinceAddEntityComponent(brute, id, CompBox, &box);
+        LinceAddEntityComponent(pruned, LinceCreateEntity(pruned), CompBox, &box);
+        array_push_back(&entities, &id);
+    }
+    for(uint32_t step = 0; step != 5; ++step){
+        LinceCalculateEntityCollisions(brute, &entities, CompBox);
+        LinceCalculateEntityCollisionsPruned(pruned, &entities, CompBox, sap);
+        assert_true(CompareBoxScenes(brute, pruned));
+    }
+    assert_true(sap->boxes.size == entities.size);
+
+    // Nothing is swapped once all boxes stand still
+    for(uint32_t i = 0; i != entities.size; ++i){
+        LinceBoxCollider* box = LinceGetEntityComponent(pruned, *(uint32_t*)array_get(&entities, i), CompBox);
+        box->dx = box->dy = 0.0f;
+    }
+    LinceCalculateEntityCollisionsPruned(pruned, &entities, CompBox, sap);
+    LinceCalculateEntityCollisionsPruned(pruned, &entities, CompBox, sap);
+    assert_true(sap->swap_count == 0);
+
+    LinceDestroySweepAndPrune(sap);
+    array_uninit(&entities);
+    LinceDestroyEntityRegistry(brute);
+    LinceDestroyEntityRegistry(pruned);
+}
+
+/* Checks the links, bounds and heights of a subtree, and returns its number of leaves */
+static uint32_t CheckAABBTreeNode(LinceAABBTree* tree, uint32_t index, uint32_t parent){
+    LinceAABBTreeNode* node = array_get(&tree->nodes, index);
+    assert_true(node->parent == parent);
+    if(node->children[0] == LINCE_AABB_TREE_NONE){
+        assert_true(node->height == 0);
+        assert_true(node->bounds.min[0] <= node->box.min[0] && node->box.max[0] <= node->bounds.max[0]);
+        assert_true(node->bounds.min[1] <= node->box.min[1] && node->box.max[1] <= node->bounds.max[1]);
+        return 1;
+    }
+    LinceAABBTreeNode* c0 = array_get(&tree->nodes, node->children[0]);
+    LinceAABBTreeNode* c1 = array_get(&tree->nodes, node->children[1]);
+    assert_true(node->height == 1 + (c0->height > c1->height ? c0->height : c1->height));
+    for(int i = 0; i != 2; ++i){
+        LinceAABBTreeNode* c = i ? c1 : c0;
+        assert_true(node->bounds.min[0] <= c->bounds.min[0] && c->bounds.max[0] <= node->bounds.max[0]);
+        assert_true(node->bounds.min[1] <= c->bounds.min[1] && c->bounds.max[1] <= node->bounds.max[1]);
+    }
+    return CheckAABBTreeNode(tree, node->children[0], index) + CheckAABBTreeNode(tree, node->children[1], index);
+}
+
+static int CompareIDs(const void* a, const void* b){
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+void test_aabb_tree(void** state){
+    (void)state;
+
+    // Standalone boxes, identified by their index
+    uint32_t count = 500;
+    LinceBoxCollider boxes[500];
+    uint32_t leaves[500];
+    LinceAABBTree* tree = LinceCreateAABBTree(0.1f);
+    srand(5);
+    for(uint32_t i = 0; i != count; ++i){
+        boxes[i] = (LinceBoxCollider){
+            .x = (float)rand() / (float)RAND_MAX * 100.0f, .y = (float)rand() / (float)RAND_MAX * 100.0f,
+            .w = 0.5f + (float)(rand() % 4), .h = 0.5f + (float)(rand() % 4)
+        };
+        leaves[i] = LinceInsertAABBTreeLeaf(tree, &boxes[i], i);
+    }
+    assert_true(tree->leaf_count == count);
+    assert_true(CheckAABBTreeNode(tree, tree->root, LINCE_AABB_TREE_NONE) == count);
+    assert_true(((LinceAABBTreeNode*)array_get(&tree->nodes, tree->root))->height < 20);
+
+    // Small movements keep the leaves, and large ones insert them again
+    boxes[0].x += 0.05f;
+    assert_false(LinceMoveAABBTreeLeaf(tree, leaves[0], &boxes[0]));
+    boxes[0].x += 10.0f;
+    assert_true(LinceMoveAABBTreeLeaf(tree, leaves[0], &boxes[0]));
+    for(uint32_t i = 0; i < count; i += 3){
+        LinceRemoveAABBTreeLeaf(tree, leaves[i]);
+        leaves[i] = LINCE_AABB_TREE_NONE;
+    }
+    assert_true(CheckAABBTreeNode(tree, tree->root, LINCE_AABB_TREE_NONE) == tree->leaf_count);
+
+    // Queries match an exhaustive search
+    array_t found, expected;
+    array_init(&found, sizeof(uint32_t));
+    array_init(&expected, sizeof(uint32_t));
+    for(uint32_t q = 0; q != 100; ++q){
+        vec2 p = {(float)rand() / (float)RAND_MAX * 100.0f, (float)rand() / (float)RAND_MAX * 100.0f};
+        vec4 region = {p[0], p[1], p[0] + 5.0f, p[1] + 2.0f};
+        LinceBoxCollider probe = {.x = p[0] + 2.5f, .y = p[1] + 1.0f, .w = 5.0f, .h = 2.0f};
+
+        array_clear(&found);
+        array_clear(&expected);
+        LinceQueryAABBTreeRegion(tree, region, &found);
+        float nearest = INFINITY;
+        uint32_t nearest_id = LINCE_AABB_TREE_NONE;
+        for(uint32_t i = 0; i != count; ++i){
+            if(leaves[i] == LINCE_AABB_TREE_NONE) continue;
+            if(LinceBoxCollides(&boxes[i], &probe)) array_push_back(&expected, &i);
+            float dx = fmaxf(fabsf(boxes[i].x - p[0]) - boxes[i].w / 2.0f, 0.0f);
+            float dy = fmaxf(fabsf(boxes[i].y - p[1]) - boxes[i].h / 2.0f, 0.0f);
+            if(dx * dx + dy * dy < nearest){
+                nearest = dx * dx + dy * dy;
+                nearest_id = i;
+            }
+        }
+        assert_true(found.size == expected.size);
+        qsort(found.data, found.size, sizeof(uint32_t), CompareIDs);
+        assert_memory_equal(found.data, expected.data, found.size * sizeof(uint32_t));
+
+        float distance;
+        uint32_t id = LinceQueryAABBTreeNearest(tree, p, 1000.0f, &distance);
+        assert_true(id != LINCE_AABB_TREE_NONE);
+        assert_true(fabsf(distance * distance - nearest) < 1e-3f);
+        if(nearest > 0.0f) assert_true(id == nearest_id || fabsf(distance * distance - nearest) < 1e-6f);
+    }
+    array_clear(&found);
+    LinceQueryAABBTreePoint(tree, (vec2){boxes[1].x, boxes[1].y}, &found);
+    LinceBool picked = LinceFalse;
+    for(uint32_t i = 0; i != found.size; ++i) picked |= *(uint32_t*)array_get(&found, i) == 1;
+    assert_true(picked);
+    assert_true(LinceQueryAABBTreeNearest(tree, (vec2){-500.0f, -500.0f}, 10.0f, NULL) == LINCE_AABB_TREE_NONE);
+
+    // Rays stop at the first box along their path
+    LinceAABBTree* line = LinceCreateAABBTree(0.1f);
+    for(uint32_t i = 0; i != 5; ++i){
+        LinceBoxCollider box = {.x = 2.0f + 2.0f * (float)(4 - i), .y = 0.0f, .w = 1.0f, .h = 1.0f};
+        LinceInsertAABBTreeLeaf(line, &box, i);
+    }
+    LinceAABBTreeHit hit;
+    assert_true(LinceRaycastAABBTree(line, (vec2){0.0f, 0.0f}, (vec2){1.0f, 0.0f}, 100.0f, &hit));
+    assert_true(hit.user == 4 && hit.distance == 1.5f && hit.normal[0] == -1.0f && hit.normal[1] == 0.0f);
+    assert_true(hit.point[0] == 1.5f && hit.point[1] == 0.0f);
+    assert_false(LinceRaycastAABBTree(line, (vec2){0.0f, 0.0f}, (vec2){1.0f, 0.0f}, 1.0f, &hit));
+    assert_false(LinceRaycastAABBTree(line, (vec2){0.0f, 0.0f}, (vec2){0.0f, 1.0f}, 100.0f, &hit));
+    assert_true(LinceRaycastAABBTree(line, (vec2){6.0f, 5.0f}, (vec2){0.0f, -2.0f}, 100.0f, &hit));
+    assert_true(hit.user == 2 && hit.distance == 2.25f && hit.normal[1] == 1.0f);
+    LinceDestroyAABBTree(line);
+
+    array_uninit(&found);
+    array_uninit(&expected);
+    LinceDestroyAABBTree(tree);
+}
+
+void test_box_collider_tree(void** state){
+    (void)state;
+
+    uint32_t movers = 2000;
+    array_t entities, copy;
+    LinceEntityRegistry* brute = CreateBoxScene(movers, 13, &entities);
+    LinceEntityRegistry* treed = CreateBoxScene(movers, 13, &copy);
+    array_uninit(&copy);
+    LinceAABBTree* tree = LinceCreateAABBTree(0.2f);
+
+    for(uint32_t step = 0; step != 20; ++step){
+        LinceCalculateEntityCollisions(brute, &entities, CompBox);
+        LinceCalculateEntityCollisionsTree(treed, &entities, CompBox, tree);
+        assert_true(CompareBoxScenes(brute, treed));
+    }
+    uint32_t total = brute->entity_count;
+    assert_true(tree->leaf_count == total);
+    assert_true(tree->test_count < total * total / 50);
+    assert_true(tree->reinsert_count < total);
+    assert_true(CheckAABBTreeNode(tree, tree->root, LINCE_AABB_TREE_NONE) == total);
+
+    // The tree holds the new positions for picking
+    LinceBoxCollider* mover = LinceGetEntityComponent(treed, total - 1, CompBox);
+    array_t picked;
+    array_init(&picked, sizeof(uint32_t));
+    LinceQueryAABBTreePoint(tree, (vec2){mover->x, mover->y}, &picked);
+    LinceBool found = LinceFalse;
+    for(uint32_t i = 0; i != picked.size; ++i) found |= *(uint32_t*)array_get(&picked, i) == total - 1;
+    assert_true(found);
+    array_uninit(&picked);
+
+    // Unlisted entities are removed
+    LinceDeleteEntity(brute, 0);
+    LinceDeleteEntity(treed, 0);
+    array_remove(&entities, 0);
+    for(uint32_t step = 0; step != 5; ++step){
+        LinceCalculateEntityCollisions(brute, &entities, CompBox);
+        LinceCalculateEntityCollisionsTree(treed, &entities, CompBox, tree);
+        assert_true(CompareBoxScenes(brute, treed));
+    }
+    assert_true(tree->leaf_count == entities.size);
+    LinceUpdateAABBTree(tree, treed, &entities, CompBox);
+    assert_true(tree->reinsert_count == 0);
+
+    LinceDestroyAABBTree(tree);
+    array_uninit(&entities);
+    LinceDestroyEntityRegistry(brute);
+    LinceDestroyEntityRegistry(treed);
+}
+
+/* Returns true if the rectangles cover every solid cell exactly once, and their entities match them */
+static LinceBool CheckTileColliders(LinceTileColliders* tc){
+    uint32_t* cover = calloc(tc->width * tc->height, sizeof(uint32_t));
+    for(uint32_t i = 0; i != tc->rects.size; ++i){
+        LinceTileRect* rect = array_get(&tc->rects, i);
+        for(uint32_t row = rect->row; row != rect->row + rect->h; ++row){
+            for(uint32_t col = rect->col; col != rect->col + rect->w; ++col) cover[row * tc->width + col]++;
+        }
+        if(tc->reg){
+            LinceBoxCollider box = LinceGetTileRectCollider(tc, rect);
+            LinceBoxCollider* entity_box = LinceGetEntityComponent(tc->reg, rect->entity_id, CompBox);
+            if(memcmp(&box, entity_box, sizeof(LinceBoxCollider)) != 0) cover[0] = 2;
+        }
+    }
+    LinceBool valid = LinceTrue;
+    for(uint32_t i = 0; i != tc->width * tc->height; ++i) valid &= cover[i] == tc->solid[i];
+    free(cover);
+    return valid;
+}
+
+static uint32_t CountBoxEntities(LinceEntityRegistry* reg){
+    array_t query;
+    array_init(&query, sizeof(uint32_t));
+    LinceQueryEntities(reg, &query, 1, CompBox);
+    uint32_t count = query.size;
+    array_uninit(&query);
+    return count;
+}
+
+void test_tile_colliders(void** state){
+    (void)state;
+
+    // Walls of tile 1 around a floor of tile 0, with a block of tile 2 inside
+    uint32_t grid[] = {
+        1, 1, 1, 1, 1, 1, 1, 1,
+        1, 0, 0, 0, 0, 0, 0, 1,
+        1, 0, 0, 2, 2, 0, 0, 1,
+        1, 0, 0, 2, 2, 0, 0, 1,
+        1, 0, 0, 0, 0, 0, 0, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,
+    };
+    LinceBool solid_tiles[] = {LinceFalse, LinceTrue, LinceTrue};
+    LinceTilemap map = {.width = 8, .height = 6, .grid = grid, .offset = {-1.0f, -1.0f}, .scale = {0.5f, 0.5f}};
+    LinceEntityRegistry* reg = LinceCreateEntityRegistry(1, sizeof(LinceBoxCollider));
+
+    LinceTileColliders tc;
+    LinceInitTileColliders(&tc, &map, solid_tiles, 3, reg, CompBox);
+    assert_true(CheckTileColliders(&tc));
+    assert_true(tc.rects.size == 5); // top, bottom, left and right walls, and the block
+    assert_true(CountBoxEntities(reg) == 5);
+    LinceTileRect* top = array_get(&tc.rects, 0);
+    LinceBoxCollider* box = LinceGetEntityComponent(reg, top->entity_id, CompBox);
+    assert_true(box->x == 1.0f && box->y == 1.75f && box->w == 4.0f && box->h == 0.5f);
+    assert_true(box->flags & LinceBoxCollider_Static);
+
+    // Opening a door splits the wall, and closing it merges it again
+    grid[3] = 0;
+    LinceRefreshTileColliders(&tc, &map);
+    assert_true(CheckTileColliders(&tc));
+    assert_true(tc.rects.size == 6);
+    grid[3] = 1;
+    LinceRefreshTileColliders(&tc, &map);
+    assert_true(CheckTileColliders(&tc));
+    assert_true(tc.rects.size == 5);
+    assert_true(CountBoxEntities(reg) == 5);
+
+    // Random edits stay valid
+    srand(17);
+    for(uint32_t i = 0; i != 300; ++i){
+        uint32_t cell = rand() % (map.width * map.height);
+        grid[cell] = rand() % 3;
+        LinceRefreshTileColliders(&tc, &map);
+        assert_true(CheckTileColliders(&tc));
+    }
+    assert_true(CountBoxEntities(reg) == tc.rects.size);
+
+    // Without a registry, only the rectangles are kept
+    LinceTileColliders rebuilt;
+    LinceInitTileColliders(&rebuilt, &map, solid_tiles, 3, NULL, 0);
+    assert_true(CheckTileColliders(&rebuilt));
+    LinceUninitTileColliders(&rebuilt);
+
+    LinceUninitTileColliders(&tc);
+    assert_true(CountBoxEntities(reg) == 0);
+    LinceDestroyEntityRegistry(reg);
+}
+
+void test_collision_world(void** state){
+    (void)state;
+
+    // An odd number of boxes, so that the last vector is only partly filled
+    uint32_t movers = 301;
+    uint32_t features[] = {0, LinceCPUFeature_SSE2, UINT32_MAX};
+    for(uint32_t f = 0; f != 3; ++f){
+        LinceSetCPUFeatureMask(features[f]);
+        array_t entities, copy;
+        LinceEntityRegistry* brute = CreateBoxScene(movers, 13, &entities);
+        LinceEntityRegistry* simd = CreateBoxScene(movers, 13, &copy);
+        array_uninit(&copy);
+        LinceCollisionWorld* world = LinceCreateCollisionWorld();
+
+        for(uint32_t step = 0; step != 20; ++step){
+            LinceCalculateEntityCollisions(brute, &entities, CompBox);
+            LinceLoadCollisionWorld(world, simd, &entities, CompBox);
+            LinceStepCollisionWorld(world);
+            LinceStoreCollisionWorld(world, simd, CompBox);
+            assert_true(CompareBoxScenes(brute, simd));
+        }
+        assert_true(world->count == entities.size);
+        assert_true(world->capacity % LINCE_COLLISION_WORLD_LANES == 0);
+        assert_true(world->test_count > 0);
+
+        // Several steps may run before the results are stored
+        LinceLoadCollisionWorld(world, simd, &entities, CompBox);
+        for(uint32_t step = 0; step != 5; ++step){
+            LinceCalculateEntityCollisions(brute, &entities, CompBox);
+            LinceStepCollisionWorld(world);
+        }
+        assert_false(CompareBoxScenes(brute, simd));
+        LinceStoreCollisionWorld(world, simd, CompBox);
+        assert_true(CompareBoxScenes(brute, simd));
+
+        // Fewer boxes are loaded after entities are removed
+        for(uint32_t i = 0; i != 100; ++i){
+            uint32_t id = *(uint32_t*)array_back(&entities);
+            LinceDeleteEntity(brute, id);
+            LinceDeleteEntity(simd, id);
+            array_pop_back(&entities);
+        }
+        for(uint32_t step = 0; step != 5; ++step){
+            LinceCalculateEntityCollisions(brute, &entities, CompBox);
+            LinceLoadCollisionWorld(world, simd, &entities, CompBox);
+            LinceStepCollisionWorld(world);
+            LinceStoreCollisionWorld(world, simd, CompBox);
+            assert_true(CompareBoxScenes(brute, simd));
+        }
+        assert_true(world->count == entities.size);
+
+        LinceDestroyCollisionWorld(world);
+        array_uninit(&entities);
+        LinceDestroyEntityRegistry(brute);
+        LinceDestroyEntityRegistry(simd);
+    }
+    LinceSetCPUFeatureMask(UINT32_MAX);
+}
+
+/* Counts the boxes that changed after a tick */
+static uint32_t CountChangedBoxes(LinceEntityRegistry* reg, array_t* entities, uint32_t since){
+    uint32_t count = 0;
+    for(uint32_t i = 0; i != entities->size; ++i){
+        uint32_t id = *(uint32_t*)array_get(entities, i);
+        if(LinceGetEntityComponentTick(reg, id, CompBox) > since) count++;
+    }
+    return count;
+}
+
+void test_box_collider_changes(void** state){
+    (void)state;
+
+    // Every collision step marks the moving boxes as changed, and only them
+    uint32_t movers = 200;
+    for(uint32_t method = 0; method != 5; ++method){
+        array_t entities;
+        LinceEntityRegistry* reg = CreateBoxScene(movers, 17, &entities);
+        LinceBoxColliderGrid* grid = LinceCreateBoxColliderGrid(0.5f);
+        LinceSweepAndPrune* sap = LinceCreateSweepAndPrune();
+        LinceAABBTree* tree = LinceCreateAABBTree(0.1f);
+        LinceCollisionWorld* world = LinceCreateCollisionWorld();
+
+        uint32_t since = LinceAdvanceChangeTick(reg);
+        switch(method){
+            case 0: LinceCalculateEntityCollisions(reg, &entities, CompBox); break;
+            case 1: LinceCalculateEntityCollisionsHashed(reg, &entities, CompBox, grid); break;
+            case 2: LinceCalculateEntityCollisionsPruned(reg, &entities, CompBox, sap); break;
+            case 3: LinceCalculateEntityCollisionsTree(reg, &entities, CompBox, tree); break;
+            case 4:
+                LinceLoadCollisionWorld(world, reg, &entities, CompBox);
+                LinceStepCollisionWorld(world);
+                LinceStoreCollisionWorld(world, reg, CompBox);
+                break;
+        }
+        assert_true(CountChangedBoxes(reg, &entities, since) == movers);
+
+        // Syncing the tree alone does not
+        since = LinceAdvanceChangeTick(reg);
+        LinceUpdateAABBTree(tree, reg, &entities, CompBox);
+        assert_true(CountChangedBoxes(reg, &entities, since) == 0);
+
+        LinceDestroyCollisionWorld(world);
+        LinceDestroyAABBTree(tree);
+        LinceDestroySweepAndPrune(sap);
+        LinceDestroyBoxColliderGrid(grid);
+        array_uninit(&entities);
+        LinceDestroyEntityRegistry(reg);
+    }
+}
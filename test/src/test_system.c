@@ -0,0 +1,325 @@
+#include "lince/core/threadpool.h"
+#include "lince/entity/system.h"
+#include "lince/entity/command_buffer.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+enum { CompA, CompB, CompC, CompD };
+
+typedef struct Counter {
+    uint32_t values[64];
+} Counter;
+
+static void CountTask(void* data, uint32_t worker){
+    Counter* counter = data;
+    counter->values[worker]++;
+}
+
+typedef struct SystemLog {
+    uint32_t runs;                 // times the system has run
+    uint32_t unlocked_runs;        // runs during which the registry was not locked
+    uint32_t early_runs;           // runs before the systems in `after` had run
+    struct SystemLog* after[2];    // systems that must have run before this one
+} SystemLog;
+
+// Systems run on worker threads, so the log is checked after the run on the main thread
+
+static void LogSystem(LinceEntityRegistry* reg, float dt, void* user_data){
+    LINCE_UNUSED(dt);
+    SystemLog* log = user_data;
+    if(!reg->locked) log->unlocked_runs++;
+    log->runs++;
+    for(uint32_t i = 0; i != 2; ++i){
+        if(log->after[i] && log->after[i]->runs != log->runs) log->early_runs++;
+    }
+}
+
+void test_threadpool(void** state){
+    (void)state;
+
+    // Tasks run on every thread, the waiting one included
+    LinceThreadPool* pool = LinceCreateThreadPool(3);
+    assert_true(LinceGetThreadPoolWorkers(pool) == 4);
+
+    Counter counter[100] = {0};
+    for(uint32_t i = 0; i != 100; ++i) LinceSubmitTask(pool, CountTask, &counter[i]);
+    LinceWaitThreadPool(pool);
+
+    for(uint32_t i = 0; i != 100; ++i){
+        uint32_t runs = 0;
+        for(uint32_t w = 0; w != 4; ++w) runs += counter[i].values[w];
+        assert_true(runs == 1);
+    }
+    LinceDestroyThreadPool(pool);
+}
+
+void test_system(void** state){
+    (void)state;
+
+    LinceEntityRegistry* reg = LinceCreateEntityRegistry(4, 4, 4, 4, 4);
+    LinceThreadPool* pool = LinceCreateThreadPool(2);
+    LinceSystemScheduler* sched = LinceCreateSystemScheduler(reg, pool);
+
+    // A writes {A}, reads {B}
+    // B reads {B}           -> no conflict with A, same stage
+    // C writes {B}          -> conflicts with A and B, runs after both
+    // D reads {A}           -> conflicts with A only, runs after it
+    SystemLog logs[4] = {0};
+    logs[2].after[0] = &logs[0];
+    logs[2].after[1] = &logs[1];
+    logs[3].after[0] = &logs[0];
+    uint32_t a = LinceAddSystem(sched, &(LinceSystemDesc){
+        .name = "A", .on_update = LogSystem, .user_data = &logs[0],
+        .writes = (uint32_t[]){CompA}, .write_count = 1,
+        .reads = (uint32_t[]){CompB}, .read_count = 1,
+    });
+    uint32_t b = LinceAddSystem(sched, &(LinceSystemDesc){
+        .name = "B", .on_update = LogSystem, .user_data = &logs[1],
+        .reads = (uint32_t[]){CompB}, .read_count = 1,
+    });
+    uint32_t c = LinceAddSystem(sched, &(LinceSystemDesc){
+        .name = "C", .on_update = LogSystem, .user_data = &logs[2],
+        .writes = (uint32_t[]){CompB}, .write_count = 1,
+    });
+    uint32_t d = LinceAddSystem(sched, &(LinceSystemDesc){
+        .name = "D", .on_update = LogSystem, .user_data = &logs[3],
+        .reads = (uint32_t[]){CompA}, .read_count = 1,
+    });
+
+    assert_true(LinceGetSystem(sched, a)->stage == 0);
+    assert_true(LinceGetSystem(sched, b)->stage == 0);
+    assert_true(LinceGetSystem(sched, c)->stage == 1);
+    assert_true(LinceGetSystem(sched, d)->stage == 1);
+    assert_true(sched->stage_count == 2);
+
+    for(uint32_t run = 0; run != 10; ++run) LinceRunSystems(sched, 16.0f);
+    for(uint32_t i = 0; i != 4; ++i){
+        assert_true(logs[i].runs == 10);
+        assert_true(logs[i].unlocked_runs == 0);
+        assert_true(logs[i].early_runs == 0);
+    }
+    assert_false(reg->locked);
+    assert_true(LinceGetSystem(sched, a)->time_ms >= 0.0);
+
+    // Without a thread pool, systems run serially on the caller
+    SystemLog log = {0};
+    LinceSystemScheduler* serial = LinceCreateSystemScheduler(reg, NULL);
+    LinceAddSystem(serial, &(LinceSystemDesc){.on_update = LogSystem, .user_data = &log});
+    LinceRunSystems(serial, 16.0f);
+    assert_true(log.runs == 1);
+    assert_true(log.unlocked_runs == 0);
+    assert_string_equal(LinceGetSystem(serial, 0)->name, "System");
+
+    LinceDestroySystemScheduler(serial);
+    LinceDestroySystemScheduler(sched);
+    LinceDestroyThreadPool(pool);
+    LinceDestroyEntityRegistry(reg);
+}
+
+typedef struct Mover { float x, dx; } Mover;
+
+typedef struct MoverSum {
+    double sum;
+    uint32_t count;
+} MoverSum;
+
+static void MoveChunk(LinceQueryIter* chunk, void* user_data, void* scratch){
+    LINCE_UNUSED(user_data);
+    Mover* movers = chunk->data[0];
+    MoverSum* partial = scratch;
+    for(uint32_t i = 0; i != chunk->count; ++i){
+        movers[i].x += movers[i].dx;
+        if(partial){
+            partial->sum += movers[i].x;
+            partial->count++;
+        }
+    }
+}
+
+static void SumMovers(void* user_data, void* scratch){
+    MoverSum* total = user_data;
+    MoverSum* partial = scratch;
+    total->sum += partial->sum;
+    total->count += partial->count;
+}
+
+typedef struct MoveSystemData {
+    LinceThreadPool* pool;
+    LinceEntityQuery* query;
+} MoveSystemData;
+
+/* System that splits its work over the same pool that runs it */
+static void MoveSystem(LinceEntityRegistry* reg, float dt, void* user_data){
+    LINCE_UNUSED(dt);
+    MoveSystemData* data = user_data;
+    LinceParallelForEach(data->pool, reg, data->query, MoveChunk, NULL, 100);
+}
+
+static void MarkChunk(LinceQueryIter* chunk, void* user_data, void* scratch){
+    LINCE_UNUSED(user_data);
+    LINCE_UNUSED(scratch);
+    LinceMarkQueryChunkChanged(chunk, 0);
+}
+
+void test_parallel_for_each(void** state){
+    (void)state;
+
+    LinceEntityRegistry* reg = LinceCreateEntityRegistry(2, sizeof(Mover), sizeof(uint32_t));
+    LinceEntityQuery* query = LinceCreateEntityQuery(reg, 1, CompA);
+    LinceThreadPool* pool = LinceCreateThreadPool(3);
+
+    // Two archetypes, so that chunks come from different tables
+    uint32_t num = 10000;
+    for(uint32_t i = 0; i != num; ++i){
+        uint32_t id = LinceCreateEntity(reg);
+        LinceAddEntityComponent(reg, id, CompA, &(Mover){.x = 0.0f, .dx = 1.0f});
+        if(i % 3 == 0) LinceAddEntityComponent(reg, id, CompB, &i);
+    }
+
+    LinceParallelForEach(pool, reg, query, MoveChunk, NULL, 100);
+    assert_false(reg->locked);
+
+    // Per-thread partial sums combined after the run
+    MoverSum total = {0};
+    LinceParallelReduce(pool, reg, query, &(LinceParallelDesc){
+        .for_each = MoveChunk, .user_data = &total,
+        .min_chunk = 100, .scratch_size = sizeof(MoverSum), .reduce = SumMovers
+    });
+    assert_true(total.count == num);
+    assert_true(total.sum == 2.0 * num);
+
+    // Without a pool, and nested inside a system run on the pool
+    LinceParallelForEach(NULL, reg, query, MoveChunk, NULL, 0);
+    MoveSystemData data = {.pool = pool, .query = query};
+    LinceSystemScheduler* sched = LinceCreateSystemScheduler(reg, pool);
+    for(uint32_t i = 0; i != 2; ++i){
+        LinceAddSystem(sched, &(LinceSystemDesc){.on_update = MoveSystem, .user_data = &data,
+            .writes = (uint32_t[]){CompA}, .write_count = 1});
+    }
+    LinceRunSystems(sched, 16.0f);
+
+    for(uint32_t i = 0; i != num; ++i){
+        Mover* mover = LinceGetEntityComponent(reg, i, CompA);
+        assert_true(mover->x == 5.0f);
+    }
+
+    // Each parallel run counts once in the query statistics, also from systems
+    assert_int_equal(query->call_count, 5);
+
+    // Changes marked from each chunk land on the rows of that chunk
+    array_t changed;
+    array_init(&changed, sizeof(uint32_t));
+    uint32_t since = LinceAdvanceChangeTick(reg);
+    LinceParallelForEach(pool, reg, query, MarkChunk, NULL, 256);
+    assert_true(LinceFetchChangedEntities(reg, query, CompA, since, &changed) == num);
+    array_uninit(&changed);
+
+    LinceDestroySystemScheduler(sched);
+    LinceDestroyThreadPool(pool);
+    LinceDestroyEntityRegistry(reg);
+}
+
+
+typedef struct SpawnData {
+    LinceThreadPool* pool;
+    LinceEntityCommandBuffer* cmds;
+    uint32_t invalid_ids[4];       // IDs without the deferred flag, counted per worker
+} SpawnData;
+
+/* Replaces every entity with an odd value by a new one with twice the value */
+static void SpawnChunk(LinceQueryIter* chunk, void* user_data, void* scratch){
+    LINCE_UNUSED(scratch);
+    SpawnData* data = user_data;
+    uint32_t worker = LinceGetWorkerIndex(data->pool);
+    uint32_t* values = chunk->data[0];
+    for(uint32_t i = 0; i != chunk->count; ++i){
+        if(values[i] % 2 == 0) continue;
+        LinceDeferDeleteEntity(data->cmds, worker, chunk->entities[i]);
+        LinceDeferDeleteEntity(data->cmds, worker, chunk->entities[i]);
+        uint32_t value = values[i] * 2;
+        uint32_t id = LinceDeferCreateEntity(data->cmds, worker);
+        if(!(id & LINCE_DEFERRED_ENTITY)) data->invalid_ids[worker]++;
+        LinceDeferAddComponent(data->cmds, worker, id, CompA, &value);
+        LinceDeferAddComponent(data->cmds, worker, id, CompB, &value);
+        LinceDeferRemoveComponent(data->cmds, worker, id, CompB);
+    }
+}
+
+void test_command_buffer(void** state){
+    (void)state;
+
+    LinceEntityRegistry* reg = LinceCreateEntityRegistry(2, sizeof(uint32_t), sizeof(uint32_t));
+    LinceEntityQuery* query = LinceCreateEntityQuery(reg, 1, CompA);
+    LinceThreadPool* pool = LinceCreateThreadPool(3);
+    LinceEntityCommandBuffer* cmds = LinceCreateEntityCommandBuffer(reg, LinceGetThreadPoolWorkers(pool));
+
+    uint32_t num = 5000;
+    for(uint32_t i = 0; i != num; ++i){
+        uint32_t id = LinceCreateEntity(reg);
+        LinceAddEntityComponent(reg, id, CompA, &i);
+    }
+
+    // Nothing changes until the commands are played back
+    SpawnData data = {.pool = pool, .cmds = cmds};
+    LinceParallelForEach(pool, reg, query, SpawnChunk, &data, 100);
+    for(uint32_t i = 0; i != 4; ++i) assert_true(data.invalid_ids[i] == 0);
+    array_t result;
+    array_init(&result, sizeof(uint32_t));
+    assert_true(LinceFetchEntityQuery(reg, query, &result) == num);
+
+    LincePlaybackEntityCommands(cmds);
+    array_clear(&result);
+    assert_true(LinceFetchEntityQuery(reg, query, &result) == num);
+    uint64_t sum = 0;
+    for(uint32_t i = 0; i != result.size; ++i){
+        uint32_t id = *(uint32_t*)array_get(&result, i);
+        uint32_t value = *(uint32_t*)LinceGetEntityComponent(reg, id, CompA);
+        assert_false(LinceHasEntityComponent(reg, id, CompB));
+        assert_true(value % 2 == 0);
+        sum += value;
+    }
+    // Even values kept, odd values doubled
+    uint64_t expected = 0;
+    for(uint32_t i = 0; i != num; ++i) expected += i % 2 ? 2 * i : i;
+    assert_true(sum == expected);
+
+    // Deleted IDs are recycled, so the registry did not grow
+    assert_true(reg->entity_count == num);
+    for(uint32_t i = 0; i != cmds->list_count; ++i){
+        assert_true(cmds->lists[i].commands.size == 0);
+    }
+
+    // A later list skips an entity deleted by an earlier one...
+    uint32_t value = 7;
+    uint32_t x = LinceCreateEntity(reg);
+    LinceDeferDeleteEntity(cmds, 0, x);
+    LinceDeferAddComponent(cmds, 1, x, CompB, &value);
+    LincePlaybackEntityCommands(cmds);
+    assert_false(LinceIsEntityActive(reg, x));
+
+    // ...unless a create in between recycled its ID, and then acts on the new entity
+    x = LinceCreateEntity(reg);
+    LinceDeferDeleteEntity(cmds, 0, x);
+    uint32_t spawned = LinceDeferCreateEntity(cmds, 0);
+    LinceDeferAddComponent(cmds, 0, spawned, CompA, &value);
+    LinceDeferAddComponent(cmds, 1, x, CompB, &value);
+    LincePlaybackEntityCommands(cmds);
+    assert_true(LinceIsEntityActive(reg, x));
+    assert_true(*(uint32_t*)LinceGetEntityComponent(reg, x, CompA) == 7);
+    assert_true(*(uint32_t*)LinceGetEntityComponent(reg, x, CompB) == 7);
+
+    // Memory for new entities is reserved ahead of time
+    LinceReserveEntities(reg, 1000);
+    void* records = reg->entity_records.data;
+    for(uint32_t i = 0; i != 1000; ++i) LinceCreateEntity(reg);
+    assert_true(reg->entity_records.data == records);
+
+    array_uninit(&result);
+    LinceDestroyEntityCommandBuffer(cmds);
+    LinceDestroyThreadPool(pool);
+    LinceDestroyEntityRegistry(reg);
+}